@@ -0,0 +1,5 @@
+
+bench: all
+	@$(PHP_EXECUTABLE) -n -d extension_dir=$(phplibdir) -d extension=lapack.$(SHLIB_DL_SUFFIX_NAME) $(srcdir)/bench/run.php $(BENCH_ARGS)
+
+.PHONY: bench
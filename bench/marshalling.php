@@ -0,0 +1,61 @@
+<?php
+/*
+ * Time the conversion between nested PHP arrays and LAPACK buffers.
+ *
+ *   php -d extension=modules/lapack.so bench/marshalling.php [size] [repeats]
+ *
+ * Only array arguments and methods that every release has are used, so the
+ * same script runs on the PHP 5 builds from before the PHP 7 port as well
+ * as on current ones, which makes it the one to compare them with:
+ *
+ *   Lapack::identity             builds a size x size array, which is all
+ *                                reassembly
+ *   solveLinearEquation          converts a size x size and a size x 1 array,
+ *                                solves with dgesv and returns size x 1
+ *
+ * Each line gives the best of the repeats in milliseconds.
+ */
+
+if (!extension_loaded('lapack')) {
+    fwrite(STDERR, "lapack extension not loaded\n");
+    exit(1);
+}
+
+ini_set('memory_limit', '-1');
+
+$size = isset($argv[1]) ? (int)$argv[1] : 1000;
+$repeats = isset($argv[2]) ? max(1, (int)$argv[2]) : 5;
+
+/* All floats, so that builds which convert their arguments in place find
+   nothing to convert and every repeat does the same work */
+mt_srand(42);
+$a = array();
+for ($i = 0; $i < $size; $i++) {
+    for ($j = 0; $j < $size; $j++) {
+        $a[$i][$j] = mt_rand() / mt_getrandmax();
+    }
+    $a[$i][$i] += $size;
+}
+$b = array();
+for ($i = 0; $i < $size; $i++) {
+    $b[$i] = array(mt_rand() / mt_getrandmax());
+}
+
+function best($repeats, $fn) {
+    $best = INF;
+    for ($r = 0; $r < $repeats; $r++) {
+        $start = microtime(true);
+        $fn();
+        $best = min($best, microtime(true) - $start);
+    }
+    return $best * 1000;
+}
+
+printf("size %dx%d, best of %d, PHP %s\n", $size, $size, $repeats, PHP_VERSION);
+printf("%-40s %10.2f ms\n", "Lapack::identity", best($repeats, function () use ($size) {
+    Lapack::identity($size);
+}));
+printf("%-40s %10.2f ms\n", "Lapack::solveLinearEquation", best($repeats, function () use ($a, $b) {
+    Lapack::solveLinearEquation($a, $b);
+}));
+printf("%-40s %10.2f MB\n", "peak memory", memory_get_peak_usage() / 1048576);
@@ -0,0 +1,223 @@
+<?php
+/*
+ * Benchmark every Lapack method over a sweep of shapes, and split the time
+ * of each between the three stages of a call made with PHP arrays:
+ *
+ *   linearize    converting the array operands to column-major buffers,
+ *                timed as new LapackMatrix() on each of them
+ *   compute      the call itself made with LapackMatrix operands, which
+ *                skips both conversions and is almost all LAPACK and BLAS
+ *   reassemble   converting the result back to arrays, timed as toArray()
+ *
+ * "total" is the ordinary call with arrays in and arrays out. Each figure is
+ * the best of the repeats, in milliseconds. Peak memory is per case where
+ * the PHP version can reset it (8.2 and later), and for the whole run
+ * otherwise. The report is JSON on stdout:
+ *
+ *   make bench BENCH_ARGS="--quick --filter=svd"
+ *   php -d extension=modules/lapack.so bench/run.php [--quick] [--repeats=N] [--filter=text]
+ */
+
+if (!extension_loaded('lapack')) {
+    fwrite(STDERR, "lapack extension not loaded\n");
+    exit(1);
+}
+
+$options = getopt('', array('quick', 'repeats:', 'filter:'));
+$quick = isset($options['quick']);
+$repeats = isset($options['repeats']) ? max(1, (int)$options['repeats']) : 5;
+$filter = isset($options['filter']) ? $options['filter'] : '';
+
+mt_srand(42);
+
+function matrix($m, $n, $diagonal = 0.0) {
+    $a = array();
+    for ($i = 0; $i < $m; $i++) {
+        for ($j = 0; $j < $n; $j++) {
+            $a[$i][$j] = mt_rand() / mt_getrandmax() - 0.5;
+        }
+        if ($i < $n) {
+            $a[$i][$i] += $diagonal;
+        }
+    }
+    return $a;
+}
+
+function spd($n) {
+    $a = matrix($n, $n);
+    $s = Lapack::multiply($a, $a, true);
+    for ($i = 0; $i < $n; $i++) {
+        $s[$i][$i] += $n;
+    }
+    return $s;
+}
+
+function batch($count, $m, $n, $diagonal = 0.0) {
+    $as = array();
+    for ($i = 0; $i < $count; $i++) {
+        $as[] = matrix($m, $n, $diagonal);
+    }
+    return $as;
+}
+
+function is_matrix($op) {
+    if (!is_array($op) || !is_array($row = reset($op))) {
+        return false;
+    }
+    return !is_array(reset($row)) && !(reset($row) instanceof LapackMatrix);
+}
+
+/* Operands as LapackMatrix objects, including the matrices of a batch */
+function to_matrices($ops) {
+    foreach ($ops as $k => $op) {
+        if (is_matrix($op)) {
+            $ops[$k] = new LapackMatrix($op);
+        } else if (is_array($op) && is_matrix(reset($op))) {
+            $ops[$k] = array_map(function ($a) { return new LapackMatrix($a); }, $op);
+        }
+    }
+    return $ops;
+}
+
+function to_arrays($result) {
+    if ($result instanceof LapackMatrix) {
+        return $result->toArray();
+    }
+    if (is_array($result)) {
+        foreach ($result as $k => $r) {
+            if ($r instanceof LapackMatrix) {
+                $result[$k] = $r->toArray();
+            }
+        }
+    }
+    return $result;
+}
+
+function best($repeats, $fn) {
+    $best = INF;
+    for ($r = 0; $r < $repeats; $r++) {
+        $start = hrtime(true);
+        $fn();
+        $best = min($best, hrtime(true) - $start);
+    }
+    return round($best / 1e6, 4);
+}
+
+/* name, shape, operands, call */
+$n = $quick ? 100 : 500;
+$tall = $quick ? array(2000, 10) : array(20000, 20);
+$wide = $quick ? array(10, 500) : array(20, 4000);
+$count = $quick ? 100 : 2000;
+
+$cases = array();
+foreach (array('small' => 8, 'square' => $n) as $label => $s) {
+    $a = matrix($s, $s, $s);
+    $b = matrix($s, 1);
+    $p = spd($s);
+    $shape = "{$s}x{$s}";
+    $cases[] = array("solveLinearEquation", $label, $shape, array($a, $b), function ($a, $b) { return Lapack::solveLinearEquation($a, $b); });
+    $cases[] = array("solveLinearEquation positive definite", $label, $shape, array($p, $b), function ($a, $b) { return Lapack::solveLinearEquation($a, $b); });
+    $cases[] = array("leastSquaresByFactorisation", $label, $shape, array($a, $b), function ($a, $b) { return Lapack::leastSquaresByFactorisation($a, $b); });
+    $cases[] = array("leastSquaresBySVD", $label, $shape, array($a, $b), function ($a, $b) { return Lapack::leastSquaresBySVD($a, $b); });
+    $cases[] = array("eigenValues", $label, $shape, array($a), function ($a) { return Lapack::eigenValues($a); });
+    $cases[] = array("topEigen", $label, $shape, array($p), function ($a) { return Lapack::topEigen($a, 5); });
+    $cases[] = array("singularValues", $label, $shape, array($a), function ($a) { return Lapack::singularValues($a); });
+    $cases[] = array("truncatedSVD", $label, $shape, array($a), function ($a) { return Lapack::truncatedSVD($a, 5); });
+    $cases[] = array("inverse", $label, $shape, array($a), function ($a) { return Lapack::inverse($a); });
+    $cases[] = array("pseudoInverse", $label, $shape, array($a), function ($a) { return Lapack::pseudoInverse($a); });
+    $cases[] = array("multiply", $label, $shape, array($a, $a), function ($a, $b) { return Lapack::multiply($a, $b); });
+    $cases[] = array("multiplyChain", $label, $shape, array($a, $b, $b), function ($a, $b, $c) { return Lapack::multiplyChain(array($a, $b, $c), array(false, false, true)); });
+    $cases[] = array("luFactor solve", $label, $shape, array($a, $b), function ($a, $b) { return Lapack::luFactor($a)->solve($b); });
+    $cases[] = array("choleskyFactor solve", $label, $shape, array($p, $b), function ($a, $b) { return Lapack::choleskyFactor($a)->solve($b); });
+    $cases[] = array("identity", $label, $shape, array($s), function ($s) { return Lapack::identity($s); });
+}
+
+list($tm, $tn) = $tall;
+$a = matrix($tm, $tn);
+$b = matrix($tm, 1);
+$shape = "{$tm}x{$tn}";
+$cases[] = array("leastSquaresByFactorisation", "tall", $shape, array($a, $b), function ($a, $b) { return Lapack::leastSquaresByFactorisation($a, $b); });
+$cases[] = array("leastSquaresBySVD", "tall", $shape, array($a, $b), function ($a, $b) { return Lapack::leastSquaresBySVD($a, $b); });
+$cases[] = array("leastSquaresStream", "tall", $shape, array($a, $b), function ($a, $b) {
+    $ls = Lapack::leastSquaresStream(is_array($a) ? count($a[0]) : $a->columns());
+    $ls->addRows($a, $b);
+    return $ls->solve();
+});
+$cases[] = array("qrFactor solve", "tall", $shape, array($a, $b), function ($a, $b) { return Lapack::qrFactor($a)->solve($b); });
+$cases[] = array("singularValues", "tall", $shape, array($a), function ($a) { return Lapack::singularValues($a); });
+$cases[] = array("pinvSolve", "tall", $shape, array($a, $b), function ($a, $b) { return Lapack::pinvSolve($a, $b); });
+$cases[] = array("truncatedSVD randomized", "tall", $shape, array($a), function ($a) { return Lapack::truncatedSVD($a, 3, Lapack::SVD_RANDOMIZED); });
+$cases[] = array("multiply transposed", "tall", $shape, array($a, $a), function ($a, $b) { return Lapack::multiply($a, $b, true); });
+
+$m = matrix(intdiv($tm, 10), $tn);
+$w = matrix(intdiv($tm, 10), $tn);
+$pb = matrix($tm, $tn);
+$x = matrix(100, $tn);
+$cases[] = array("shapeRegressionModel", "tall", "P {$tm}x{$tn}", array($m, $pb, $w), function ($m, $p, $w) { return Lapack::shapeRegressionModel($m, $p, $w); });
+$cases[] = array("shapeModel predict", "tall", "P {$tm}x{$tn}", array($m, $pb, $w, $x), function ($m, $p, $w, $x) { return Lapack::shapeModel($m, $p, $w)->predict($x); });
+
+list($wm, $wn) = $wide;
+$a = matrix($wm, $wn);
+$b = matrix($wm, 1);
+$shape = "{$wm}x{$wn}";
+$cases[] = array("leastSquaresByFactorisation", "wide", $shape, array($a, $b), function ($a, $b) { return Lapack::leastSquaresByFactorisation($a, $b); });
+$cases[] = array("leastSquaresBySVD", "wide", $shape, array($a, $b), function ($a, $b) { return Lapack::leastSquaresBySVD($a, $b); });
+$cases[] = array("singularValues", "wide", $shape, array($a), function ($a) { return Lapack::singularValues($a); });
+$cases[] = array("pseudoInverse", "wide", $shape, array($a), function ($a) { return Lapack::pseudoInverse($a); });
+
+$as = batch($count, 8, 8, 8);
+$bs = batch($count, 8, 1);
+$shape = "{$count} x 8x8";
+$cases[] = array("solveLinearEquationBatch", "batched", $shape, array($as, $bs), function ($as, $bs) { return Lapack::solveLinearEquationBatch($as, $bs); });
+$cases[] = array("leastSquaresByFactorisationBatch", "batched", $shape, array($as, $bs), function ($as, $bs) { return Lapack::leastSquaresByFactorisationBatch($as, $bs); });
+$cases[] = array("singularValuesBatch", "batched", $shape, array($as), function ($as) { return Lapack::singularValuesBatch($as); });
+
+$results = array();
+foreach ($cases as $case) {
+    list($method, $kind, $shape, $ops, $call) = $case;
+    if ($filter !== '' && stripos("$method $kind", $filter) === false) {
+        continue;
+    }
+
+    if (function_exists('memory_reset_peak_usage')) {
+        memory_reset_peak_usage();
+    }
+
+    $total = best($repeats, function () use ($call, $ops) {
+        to_arrays($call(...$ops));
+    });
+    $linearize = best($repeats, function () use ($ops) {
+        to_matrices($ops);
+    });
+    $mops = to_matrices($ops);
+    $compute = best($repeats, function () use ($call, $mops) {
+        $call(...$mops);
+    });
+    $result = $call(...$mops);
+    $reassemble = best($repeats, function () use ($result) {
+        to_arrays($result);
+    });
+
+    $results[] = array(
+        'method' => $method,
+        'kind' => $kind,
+        'shape' => $shape,
+        'total_ms' => $total,
+        'linearize_ms' => $linearize,
+        'compute_ms' => $compute,
+        'reassemble_ms' => $reassemble,
+        'peak_memory_bytes' => memory_get_peak_usage(),
+    );
+    unset($mops, $result);
+}
+
+echo json_encode(array(
+    'php' => PHP_VERSION,
+    'extension' => phpversion('lapack'),
+    'precision' => ini_get('lapack.precision'),
+    'max_threads' => ini_get('lapack.max_threads'),
+    'repeats' => $repeats,
+    'quick' => $quick,
+    'peak_memory_per_case' => function_exists('memory_reset_peak_usage'),
+    'results' => $results,
+), JSON_PRETTY_PRINT), "\n";
@@ -0,0 +1,85 @@
+<?php
+/*
+ * Throughput of the conversion between nested PHP arrays and column-major
+ * buffers, in GB/s of doubles, over square matrices from 1000 x 1000 up:
+ *
+ *   linearize    new LapackMatrix() on an array of arrays of floats
+ *   mixed        the same with every row starting with an int, which takes
+ *                the scalar path for part of each strip
+ *   reassemble   LapackMatrix::toArray()
+ *
+ * Each figure is from the best of the repeats. The largest size needs
+ * around 4GB at once, so memory_limit is lifted. The report is JSON on stdout:
+ *
+ *   php -d extension=modules/lapack.so bench/throughput.php [--sizes=1000,2000] [--repeats=N]
+ */
+
+if (!extension_loaded('lapack')) {
+    fwrite(STDERR, "lapack extension not loaded\n");
+    exit(1);
+}
+
+ini_set('memory_limit', '-1');
+
+$options = getopt('', array('sizes:', 'repeats:'));
+$sizes = isset($options['sizes']) ? array_map('intval', explode(',', $options['sizes'])) : array(1000, 2000, 5000, 10000);
+$repeats = isset($options['repeats']) ? max(1, (int)$options['repeats']) : 3;
+
+/* Every row is written to, so none of them share storage */
+function matrix($size, $first) {
+    $row = array_fill(0, $size, 0.5);
+    $a = array();
+    for ($i = 0; $i < $size; $i++) {
+        $row[0] = $first === 'int' ? $i : $i + 0.5;
+        $a[] = $row;
+    }
+    return $a;
+}
+
+function best($repeats, $fn) {
+    $best = INF;
+    for ($r = 0; $r < $repeats; $r++) {
+        $start = hrtime(true);
+        $fn();
+        $best = min($best, hrtime(true) - $start);
+    }
+    return $best / 1e9;
+}
+
+$results = array();
+foreach ($sizes as $size) {
+    $bytes = $size * $size * 8;
+
+    $a = matrix($size, 'float');
+    $linearize = best($repeats, function () use ($a) {
+        new LapackMatrix($a);
+    });
+    $m = new LapackMatrix($a);
+    unset($a);
+
+    $reassemble = best($repeats, function () use ($m) {
+        $m->toArray();
+    });
+    unset($m);
+
+    $a = matrix($size, 'int');
+    $mixed = best($repeats, function () use ($a) {
+        new LapackMatrix($a);
+    });
+    unset($a);
+
+    $results[] = array(
+        'size' => "{$size}x{$size}",
+        'bytes' => $bytes,
+        'linearize_gbps' => round($bytes / $linearize / 1e9, 3),
+        'mixed_gbps' => round($bytes / $mixed / 1e9, 3),
+        'reassemble_gbps' => round($bytes / $reassemble / 1e9, 3),
+    );
+}
+
+echo json_encode(array(
+    'php' => PHP_VERSION,
+    'extension' => phpversion('lapack'),
+    'repeats' => $repeats,
+    'results' => $results,
+), JSON_PRETTY_PRINT), "\n";
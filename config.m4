@@ -1,12 +1,15 @@
 PHP_ARG_WITH(lapack, whether to enable lapack support,
 [  --with-lapack[=DIR]       Enable lapack support. DIR is the prefix to the library installation directory.], yes)
 
+PHP_ARG_WITH(lapack-ilp64, whether to build against an ILP64 LAPACK,
+[  --with-lapack-ilp64       lapack: Use an ILP64 OpenBLAS (64-bit lapack_int) when one is found. Default: auto], auto, no)
+
 if test "$PHP_LAPACK" != "no"; then
 
 
 dnl Get PHP version depending on shared/static build
 
-  AC_MSG_CHECKING([PHP version is at least 5.2.0])
+  AC_MSG_CHECKING([PHP version is at least 7.4.0])
 
   if test -z "${PHP_VERSION_ID}"; then
     if test -z "${PHP_CONFIG}"; then
@@ -19,53 +22,170 @@ dnl Get PHP version depending on shared/static build
     PHP_LAPACK_FOUND_VERSION="${PHP_VERSION}"
   fi
 
-  if test "$PHP_LAPACK_FOUND_VERNUM" -ge "50200"; then
+  if test "$PHP_LAPACK_FOUND_VERNUM" -ge "70400"; then
     AC_MSG_RESULT(yes. found $PHP_LAPACK_FOUND_VERSION)
   else 
     AC_MSG_ERROR(no. found $PHP_LAPACK_FOUND_VERSION)
   fi
 
-  AC_MSG_CHECKING([for lapacke.h header])
-  for i in $PHP_LAPACK /usr/local /usr;
-  do
-    test -r $i/include/lapacke.h && LAPACK_PREFIX=$i && LAPACK_INC_DIR=$i/include && LAPACK_OK=1
-  done
-  	
-  if test "$LAPACK_OK" != "1"; then
-    AC_MSG_ERROR([Unable to find lapacke.h])
+  dnl An ILP64 build passes dimensions, leading dimensions and workspace sizes
+  dnl as 64-bit integers, which problems past 2^31 elements need. OpenBLAS ships
+  dnl one as libopenblas64 with LAPACKE and CBLAS in the same library, next to
+  dnl headers of its own. Prefer it unless --without-lapack-ilp64 is given
+  LAPACK_ILP64=no
+  if test "$PHP_LAPACK_ILP64" != "no"; then
+    AC_MSG_CHECKING([for an ILP64 OpenBLAS])
+    for i in $PHP_LAPACK /usr/local /usr;
+    do
+      for j in $i/lib64 $i/lib $i/lib/*-linux-gnu $i/lib/*-linux-gnu/openblas64-*;
+      do
+        test "$LAPACK_ILP64" = "yes" && break
+        test -r $j/libopenblas64.so || test -r $j/libopenblas64.a || continue
+        for k in $i/include/openblas64 $i/include/*-linux-gnu/openblas64-* $i/include/openblas $i/include;
+        do
+          if test -r $k/lapacke.h && test -r $k/cblas.h; then
+            LAPACK_PREFIX=$i
+            LAPACK_LIB_DIR=$j
+            LAPACK_INC_DIR=$k
+            LAPACK_ILP64=yes
+            break
+          fi
+        done
+      done
+    done
+    AC_MSG_RESULT([$LAPACK_ILP64])
+
+    if test "$LAPACK_ILP64" = "yes"; then
+      dnl The headers only switch lapack_int to int64_t when asked to, so make
+      dnl sure they do before linking anything against them
+      AC_MSG_CHECKING([whether lapacke.h in $LAPACK_INC_DIR has a 64-bit lapack_int])
+      old_CPPFLAGS=$CPPFLAGS
+      CPPFLAGS="$CPPFLAGS -I$LAPACK_INC_DIR -DLAPACK_ILP64"
+      AC_COMPILE_IFELSE([AC_LANG_PROGRAM([[#include <lapacke.h>]],
+        [[static int check[sizeof(lapack_int) == 8 ? 1 : -1]; (void)check;]])],
+        [], [LAPACK_ILP64=no])
+      CPPFLAGS=$old_CPPFLAGS
+      AC_MSG_RESULT([$LAPACK_ILP64])
+    fi
+
+    if test "$LAPACK_ILP64" = "yes"; then
+      PHP_CHECK_LIBRARY(openblas64, LAPACKE_dgesv, [], [
+        LAPACK_ILP64=no
+      ],[
+        -L$LAPACK_LIB_DIR
+      ])
+    fi
+
+    if test "$LAPACK_ILP64" = "no" && test "$PHP_LAPACK_ILP64" = "yes"; then
+      AC_MSG_ERROR([--with-lapack-ilp64 given but no ILP64 OpenBLAS with LAPACKE was found])
+    fi
   fi
-  
-  AC_MSG_RESULT([found in $LAPACK_INC_DIR])
-  
-  AC_MSG_CHECKING([for lapacke shared libraries])
-  PHP_CHECK_LIBRARY(lapacke, LAPACKE_dgesv, [
-    PHP_ADD_LIBRARY_WITH_PATH(lapacke, $LAPACK_PREFIX/lib, LAPACK_SHARED_LIBADD)
+
+  if test "$LAPACK_ILP64" = "yes"; then
+    AC_DEFINE(LAPACK_ILP64, 1, [Whether lapack_int is 64 bits wide])
+    PHP_ADD_LIBRARY_WITH_PATH(openblas64, $LAPACK_LIB_DIR, LAPACK_SHARED_LIBADD)
     PHP_ADD_INCLUDE($LAPACK_INC_DIR)
-  ],[
-    AC_MSG_ERROR([not found. Make sure that lapacke is installed])
-  ],[
-    LAPACK_SHARED_LIBADD -llapacke
+    LAPACK_LAPACKE_LIB=openblas64
+    LAPACK_BLAS_LIB=openblas64
+  else
+    AC_MSG_CHECKING([for lapacke.h header])
+    for i in $PHP_LAPACK /usr/local /usr;
+    do
+      test -r $i/include/lapacke.h && LAPACK_PREFIX=$i && LAPACK_INC_DIR=$i/include && LAPACK_OK=1
+    done
+
+    if test "$LAPACK_OK" != "1"; then
+      AC_MSG_ERROR([Unable to find lapacke.h])
+    fi
+
+    AC_MSG_RESULT([found in $LAPACK_INC_DIR])
+    LAPACK_LIB_DIR=$LAPACK_PREFIX/lib
+
+    AC_MSG_CHECKING([for lapacke shared libraries])
+    PHP_CHECK_LIBRARY(lapacke, LAPACKE_dgesv, [
+      PHP_ADD_LIBRARY_WITH_PATH(lapacke, $LAPACK_LIB_DIR, LAPACK_SHARED_LIBADD)
+      PHP_ADD_INCLUDE($LAPACK_INC_DIR)
+    ],[
+      AC_MSG_ERROR([not found. Make sure that lapacke is installed])
+    ],[
+      LAPACK_SHARED_LIBADD -llapacke
+    ])
+    LAPACK_LAPACKE_LIB=lapacke
+
+    AC_MSG_CHECKING([for cblas shared libraries])
+    PHP_CHECK_LIBRARY(blas,cblas_dgemm,
+    [
+      PHP_ADD_LIBRARY_WITH_PATH(blas, $LAPACK_LIB_DIR, LAPACK_SHARED_LIBADD)
+      LAPACK_BLAS_LIB=blas
+    ],[
+      PHP_CHECK_LIBRARY(openblas,cblas_dgemm,
+      [
+        PHP_ADD_LIBRARY_WITH_PATH(openblas, $LAPACK_LIB_DIR, LAPACK_SHARED_LIBADD)
+        LAPACK_BLAS_LIB=openblas
+      ],[
+        AC_MSG_ERROR([wrong openblas/blas version or library not found])
+      ],[
+        LAPACK_SHARED_LIBADD -lopenblas
+      ])
+    ],[
+      LAPACK_SHARED_LIBADD -lblas
+    ])
+  fi
+
+  dnl dgesvdx (LAPACK 3.6) selects singular values by index for
+  dnl Lapack::truncatedSVD, older libraries fall back to a full dgesdd
+  PHP_CHECK_LIBRARY($LAPACK_LAPACKE_LIB, LAPACKE_dgesvdx_work,
+  [
+    AC_DEFINE(HAVE_LAPACKE_DGESVDX, 1, [Whether LAPACKE_dgesvdx_work is available])
+  ],[],[
+    -L$LAPACK_LIB_DIR
   ])
 
-  AC_MSG_CHECKING([for cblas shared libraries])
-  PHP_CHECK_LIBRARY(blas,cblas_dgemm,
+  dnl Threading hook of the BLAS backend, used to size its thread count per
+  dnl call and to keep it single threaded inside the batched drivers. OpenBLAS
+  dnl and BLIS can both be installed as libblas, so look in whichever was linked
+  LAPACK_THREAD_BACKEND=none
+  PHP_CHECK_LIBRARY($LAPACK_BLAS_LIB, openblas_set_num_threads,
   [
-    PHP_ADD_LIBRARY_WITH_PATH(blas, $LAPACK_PREFIX/lib, LAPACK_SHARED_LIBADD)
+    AC_DEFINE(HAVE_OPENBLAS_SET_NUM_THREADS, 1, [Whether openblas_set_num_threads is available])
+    LAPACK_THREAD_BACKEND=openblas
   ],[
-    PHP_CHECK_LIBRARY(openblas,cblas_dgemm,
+    PHP_CHECK_LIBRARY($LAPACK_BLAS_LIB, bli_thread_set_num_threads,
     [
-      PHP_ADD_LIBRARY_WITH_PATH(openblas, $LAPACK_PREFIX/lib, LAPACK_SHARED_LIBADD)
-    ],[
-      AC_MSG_ERROR([wrong openblas/blas version or library not found])
-    ],[
-      LAPACK_SHARED_LIBADD -lopenblas
+      AC_DEFINE(HAVE_BLI_THREAD_SET_NUM_THREADS, 1, [Whether bli_thread_set_num_threads is available])
+      LAPACK_THREAD_BACKEND=blis
+    ],[],[
+      -L$LAPACK_LIB_DIR
     ])
   ],[
-    LAPACK_SHARED_LIBADD -lblas
-  ])  
+    -L$LAPACK_LIB_DIR
+  ])
+  AC_MSG_CHECKING([for a BLAS threading hook])
+  AC_MSG_RESULT([$LAPACK_THREAD_BACKEND])
+
+  AC_MSG_CHECKING([for pthreads])
+  PHP_CHECK_LIBRARY(pthread, pthread_create,
+  [
+    PHP_ADD_LIBRARY(pthread, 1, LAPACK_SHARED_LIBADD)
+  ],[
+    AC_MSG_ERROR([pthreads are required for the batched drivers])
+  ])
+
+  dnl Robust mutexes keep the shared matrix cache usable after a worker dies
+  dnl holding its lock
+  PHP_CHECK_LIBRARY(pthread, pthread_mutex_consistent,
+  [
+    AC_DEFINE(HAVE_PTHREAD_MUTEX_CONSISTENT, 1, [Whether pthread_mutex_consistent is available])
+  ])
   
-  PHP_NEW_EXTENSION(lapack, lapack.c, $ext_shared)
+  dnl Lapack::load() maps matrix files instead of reading them when it can,
+  dnl and the shared matrix cache needs anonymous shared mappings
+  AC_CHECK_HEADERS([sys/mman.h])
+  AC_CHECK_FUNCS([mmap])
+
+  PHP_NEW_EXTENSION(lapack, lapack.c lapack_matrix.c lapack_pool.c lapack_batch.c lapack_factor.c lapack_structure.c lapack_single.c lapack_arena.c lapack_svd.c lapack_shape.c lapack_multiply.c lapack_npy.c lapack_lsq.c lapack_stats.c lapack_async.c lapack_sparse.c lapack_cache.c, $ext_shared)
   AC_DEFINE(HAVE_LAPACK,1,[ ])
+  PHP_ADD_MAKEFILE_FRAGMENT
 
   PHP_SUBST(LAPACK_SHARED_LIBADD)
 fi
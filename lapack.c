@@ -24,111 +24,312 @@
 
 #include "cblas.h"
 
+/* The AVX2 gather kernel is built when the compiler targets AVX2, or can
+   build functions for it and pick them at run time as PHP itself does */
+#if (defined(ZEND_INTRIN_AVX2_NATIVE) || defined(ZEND_INTRIN_AVX2_RESOLVER)) && (defined(__x86_64__) || defined(_M_X64))
+# include <immintrin.h>
+# define PHP_LAPACK_HAVE_AVX2 1
+# ifdef ZEND_INTRIN_AVX2_NATIVE
+#  define PHP_LAPACK_AVX2_FUNC
+#  define php_lapack_avx2() 1
+# else
+#  include "Zend/zend_cpuinfo.h"
+#  define PHP_LAPACK_AVX2_FUNC __attribute__((target("avx2")))
+#  define php_lapack_avx2() zend_cpu_supports_avx2()
+# endif
+#endif
+
+/* Packed arrays keep their values in a plain zval array from PHP 8.2, and in
+   Buckets, which start with the zval, before that */
+#if PHP_VERSION_ID >= 80200
+# define PHP_LAPACK_PACKED_DATA(ht) ((char *)(ht)->arPacked)
+# define PHP_LAPACK_PACKED_STRIDE sizeof(zval)
+#else
+# define PHP_LAPACK_PACKED_DATA(ht) ((char *)(ht)->arData)
+# define PHP_LAPACK_PACKED_STRIDE sizeof(Bucket)
+#endif
+
 static zend_class_entry *php_lapack_sc_entry;
-static zend_class_entry *php_lapack_exception_sc_entry;
+zend_class_entry *php_lapack_exception_sc_entry;
 static zend_object_handlers lapack_object_handlers;
 
-#define LAPACK_THROW(message, code) \
-		zend_throw_exception(php_lapack_exception_sc_entry, message, (long)code TSRMLS_CC); \
-		return;
+ZEND_DECLARE_MODULE_GLOBALS(lapack)
 
 
 /* --- Helper Functions --- */
 
-/* {{{ static long* php_lapack_linearize_array(zval *inarray, int *m, int *n)
-Transform a PHP array into linear array of longs, and return dimensions 
+/* {{{ int php_lapack_array_shape(zval *inarray, int *m, int *n)
+Read the dimensions of a PHP array of arrays from its row count and the
+length of its first row, without touching the values.
 */
-static double* php_lapack_linearize_array(zval *inarray, int *m, int *n) 
+int php_lapack_array_shape(zval *inarray, int *m, int *n)
 {
-	double *outarray; 
-	zval **ppzval;
-	zval **ppinnerval;
-	int i, j;
-	
-	/* Set rows num */
+	zval *row;
+
 	*m = zend_hash_num_elements(Z_ARRVAL_P(inarray));
 	*n = 0;
-	outarray = NULL;
-	j = 0;
-	i = 0;
 
-	if (*m > 0) {
-		for (zend_hash_internal_pointer_reset(Z_ARRVAL_P(inarray));
-			 zend_hash_get_current_data(Z_ARRVAL_P(inarray), (void **) &ppzval) == SUCCESS;
-			 zend_hash_move_forward(Z_ARRVAL_P(inarray))) {
-		
-			if (Z_TYPE_PP(ppzval) == IS_ARRAY) {
-			
-				if (outarray == NULL) {
-					/* Set columns num and alloc memory for value */
-					*n = zend_hash_num_elements(Z_ARRVAL_PP(ppzval));
-					if(*n == 0) {
-						return outarray;
-					}
-					outarray = safe_emalloc(*m * *n, sizeof(double), 0);
-				} else if (zend_hash_num_elements(Z_ARRVAL_PP(ppzval)) != *n) {
-					/* The matrix is not valid */
-					efree(outarray);
-					return NULL;
-				}
-			
-				j = 0;
-				for (zend_hash_internal_pointer_reset(Z_ARRVAL_PP(ppzval));
-					 zend_hash_get_current_data(Z_ARRVAL_PP(ppzval), (void **) &ppinnerval) == SUCCESS;
-					 zend_hash_move_forward(Z_ARRVAL_PP(ppzval))) {
-						convert_to_double(*ppinnerval);
-						outarray[(j * *m) + i] = Z_DVAL_PP(ppinnerval);
-						j++;
-				}
-			
+	if (*m == 0) {
+		return FAILURE;
+	}
+
+	ZEND_HASH_FOREACH_VAL(Z_ARRVAL_P(inarray), row) {
+		ZVAL_DEREF(row);
+		if (Z_TYPE_P(row) != IS_ARRAY) {
+			return FAILURE;
+		}
+		*n = zend_hash_num_elements(Z_ARRVAL_P(row));
+		break;
+	} ZEND_HASH_FOREACH_END();
+
+	return *n > 0 ? SUCCESS : FAILURE;
+}
+/* }}} */
+
+/* {{{ static zend_always_inline double php_lapack_zval_double(zval *val)
+*/
+static zend_always_inline double php_lapack_zval_double(zval *val)
+{
+	return EXPECTED(Z_TYPE_P(val) == IS_DOUBLE) ? Z_DVAL_P(val) : zval_get_double(val);
+}
+/* }}} */
+
+/* {{{ static zend_always_inline char* php_lapack_packed_row(HashTable *ht, int n)
+The storage of a row of n values when it is a packed array without holes,
+so that value j sits at j * PHP_LAPACK_PACKED_STRIDE. NULL otherwise.
+*/
+static zend_always_inline char* php_lapack_packed_row(HashTable *ht, int n)
+{
+	return HT_IS_PACKED(ht) && ht->nNumUsed == (uint32_t)n ? PHP_LAPACK_PACKED_DATA(ht) : NULL;
+}
+/* }}} */
+
+#ifdef PHP_LAPACK_HAVE_AVX2
+/* {{{ static void php_lapack_gather_rows_avx2(char **rows, int count, int n, double *out, int ld)
+php_lapack_gather_rows four rows at a time. The type words and values of
+four rows are fetched with one gather each, and stored with a single write
+when all four are doubles. Anything else takes the zval_get_double path.
+*/
+static PHP_LAPACK_AVX2_FUNC void php_lapack_gather_rows_avx2(char **rows, int count, int n, double *out, int ld)
+{
+	const __m128i is_double = _mm_set1_epi32(IS_DOUBLE);
+	const __m256i type_offset = _mm256_set1_epi64x(XtOffsetOf(zval, u1.type_info));
+	__m256i addr, offset;
+	__m128i types;
+	double *col;
+	int i, j, k;
+
+	for (j = 0; j < n; j++) {
+		col = out + (size_t)j * ld;
+		offset = _mm256_set1_epi64x((long long)j * PHP_LAPACK_PACKED_STRIDE);
+
+		for (i = 0; i + 4 <= count; i += 4) {
+			addr = _mm256_add_epi64(_mm256_loadu_si256((const __m256i *)(rows + i)), offset);
+			types = _mm256_i64gather_epi32(NULL, _mm256_add_epi64(addr, type_offset), 1);
+			if (_mm_movemask_epi8(_mm_cmpeq_epi32(types, is_double)) == 0xFFFF) {
+				_mm256_storeu_pd(col + i, _mm256_i64gather_pd(NULL, addr, 1));
+				continue;
+			}
+			for (k = i; k < i + 4; k++) {
+				col[k] = php_lapack_zval_double((zval *)(rows[k] + (size_t)j * PHP_LAPACK_PACKED_STRIDE));
 			}
-			
-			i++;
 		}
+
+		for (; i < count; i++) {
+			col[i] = php_lapack_zval_double((zval *)(rows[i] + (size_t)j * PHP_LAPACK_PACKED_STRIDE));
+		}
+	}
+}
+/* }}} */
+#endif
+
+/* {{{ static void php_lapack_gather_rows(char **rows, int count, int n, double *out, int ld)
+Write count packed rows of n values, as found by php_lapack_packed_row, to
+the first count rows of the column-major out. Each pass reads the next value
+of every row and writes count consecutive doubles of one column, so with at
+most PHP_LAPACK_BLOCK rows both sides stay within a few cache lines per row
+instead of striding across the whole buffer.
+*/
+static void php_lapack_gather_rows(char **rows, int count, int n, double *out, int ld)
+{
+	double *col;
+	int i, j;
+
+	if (count == 0) {
+		return;
+	}
+
+#ifdef PHP_LAPACK_HAVE_AVX2
+	if (php_lapack_avx2()) {
+		php_lapack_gather_rows_avx2(rows, count, n, out, ld);
+		return;
+	}
+#endif
+
+	for (j = 0; j < n; j++) {
+		col = out + (size_t)j * ld;
+		for (i = 0; i < count; i++) {
+			col[i] = php_lapack_zval_double((zval *)(rows[i] + (size_t)j * PHP_LAPACK_PACKED_STRIDE));
+		}
+	}
+}
+/* }}} */
+
+/* {{{ int php_lapack_linearize_array_into(zval *inarray, double *outarray, int m, int n, int ld)
+Write an m x n PHP array of arrays into outarray in column-major order with
+leading dimension ld. The rows are walked directly and values are read with
+zval_get_double, so the caller's arrays are never separated or changed.
+Packed rows are collected into strips of PHP_LAPACK_BLOCK and transposed
+together by php_lapack_gather_rows; a row with keys or holes is written on
+its own. Fails if any row is not an array of n values.
+*/
+int php_lapack_linearize_array_into(zval *inarray, double *outarray, int m, int n, int ld)
+{
+	zval *row, *val;
+	char *strip[PHP_LAPACK_BLOCK];
+	uint64_t start;
+	int i, j, count;
+
+	if (zend_hash_num_elements(Z_ARRVAL_P(inarray)) != m) {
+		return FAILURE;
+	}
+
+	start = php_lapack_stats_clock();
+
+	i = 0;
+	count = 0;
+	ZEND_HASH_FOREACH_VAL(Z_ARRVAL_P(inarray), row) {
+		ZVAL_DEREF(row);
+		if (Z_TYPE_P(row) != IS_ARRAY || zend_hash_num_elements(Z_ARRVAL_P(row)) != n) {
+			/* The matrix is not valid */
+			return FAILURE;
+		}
+
+		strip[count] = php_lapack_packed_row(Z_ARRVAL_P(row), n);
+		if (strip[count] == NULL) {
+			php_lapack_gather_rows(strip, count, n, outarray + i - count, ld);
+			count = 0;
+
+			j = 0;
+			ZEND_HASH_FOREACH_VAL(Z_ARRVAL_P(row), val) {
+				outarray[((size_t)j * ld) + i] = php_lapack_zval_double(val);
+				j++;
+			} ZEND_HASH_FOREACH_END();
+		} else if (++count == PHP_LAPACK_BLOCK) {
+			php_lapack_gather_rows(strip, count, n, outarray + i + 1 - count, ld);
+			count = 0;
+		}
+
+		i++;
+	} ZEND_HASH_FOREACH_END();
+
+	php_lapack_gather_rows(strip, count, n, outarray + m - count, ld);
+
+	php_lapack_stats_phase(PHP_LAPACK_STATS_CONVERT, start, (size_t)m * n * sizeof(double));
+
+	return SUCCESS;
+}
+/* }}} */
+
+/* {{{ double* php_lapack_linearize_array(zval *inarray, int *m, int *n)
+Transform a PHP array into linear array of doubles, and return dimensions 
+*/
+double* php_lapack_linearize_array(zval *inarray, int *m, int *n) 
+{
+	double *outarray; 
+	
+	if (php_lapack_array_shape(inarray, m, n) == FAILURE) {
+		return NULL;
+	}
+
+	outarray = php_lapack_alloc((size_t)*m * *n);
+
+	if (php_lapack_linearize_array_into(inarray, outarray, *m, *n, *m) == FAILURE) {
+		php_lapack_free(outarray);
+		return NULL;
 	}
 	
 	return outarray;
 }
 /* }}} */
 
-/* {{{ static zval* php_lapack_reassemble_array(zval *return_value, double *inarray, int m, int n)
+/* {{{ void php_lapack_reassemble_row(zval *row, double *inarray, int n, int stride)
+Fill row with a pre-sized packed array of the n values inarray[k * stride]
+*/
+void php_lapack_reassemble_row(zval *row, double *inarray, int n, int stride)
+{
+	int width;
+
+	ZVAL_ARR(row, zend_new_array(n));
+	zend_hash_real_init_packed(Z_ARRVAL_P(row));
+
+	ZEND_HASH_FILL_PACKED(Z_ARRVAL_P(row)) {
+		for( width = 0; width < n; width++ ) {
+			ZEND_HASH_FILL_SET_DOUBLE(inarray[(size_t)width * stride]);
+			ZEND_HASH_FILL_NEXT();
+		}
+	} ZEND_HASH_FILL_END();
+}
+/* }}} */
+
+/* {{{ void php_lapack_reassemble_array(zval *return_value, double *inarray, int m, int n, int stride)
 Loop through a long array and reassemble into a square php 2d array based on
-the height and width supplied
+the height and width supplied. Past a single tile, each strip of
+PHP_LAPACK_BLOCK rows is first transposed into a row-major scratch buffer,
+so the rows are filled from contiguous memory rather than one element per
+column of inarray.
 */
-static void php_lapack_reassemble_array(zval *return_value, double *inarray, int m, int n, int stride) 
+void php_lapack_reassemble_array(zval *return_value, double *inarray, int m, int n, int stride) 
 {
-	zval *inner;
-	int height, width;
-	height = width = 0;
+	zval inner;
+	uint64_t start = php_lapack_stats_clock();
+	double *strip = NULL;
+	int height, first = 0, rows = 0;
 	
-	array_init(return_value);
+	if (n > 1 && (size_t)m * n > PHP_LAPACK_BLOCK * PHP_LAPACK_BLOCK) {
+		strip = php_lapack_alloc((size_t)PHP_LAPACK_BLOCK * n);
+	}
 	
-	for( height = 0; height < m; height++ ) {
-		MAKE_STD_ZVAL(inner);
-		array_init(inner);
-		for( width = 0; width < n; width++ ) {
-			add_next_index_double(inner, inarray[height+(width*stride)]);
+	ZVAL_ARR(return_value, zend_new_array(m));
+	zend_hash_real_init_packed(Z_ARRVAL_P(return_value));
+	
+	ZEND_HASH_FILL_PACKED(Z_ARRVAL_P(return_value)) {
+		for( height = 0; height < m; height++ ) {
+			if (strip == NULL) {
+				php_lapack_reassemble_row(&inner, inarray + height, n, stride);
+			} else {
+				if (height % PHP_LAPACK_BLOCK == 0) {
+					first = height;
+					rows = m - first < PHP_LAPACK_BLOCK ? m - first : PHP_LAPACK_BLOCK;
+					php_lapack_transpose(inarray + first, rows, n, stride, strip, n);
+				}
+				php_lapack_reassemble_row(&inner, strip + (size_t)(height - first) * n, n, 1);
+			}
+			ZEND_HASH_FILL_ADD(&inner);
 		}
-		add_next_index_zval(return_value, inner);
-	}
+	} ZEND_HASH_FILL_END();
+
+	php_lapack_free(strip);
+
+	php_lapack_stats_phase(PHP_LAPACK_STATS_ASSEMBLE, start, (size_t)m * n * sizeof(double));
 	
 	return;
 }
 /* }}} */
 
-/* {{{ static double* php_lapack_identity( long m )
+/* {{{ static double* php_lapack_identity( zend_long m )
 Generate an identity linear identity matrix
 */
-static double* php_lapack_identity( long m ) 
+static double* php_lapack_identity( zend_long m ) 
 {
-	int i, j;
+	size_t i, j;
 	double *outarray;
 	
-	outarray = safe_emalloc(m * m, sizeof(double), 0);
+	outarray = safe_emalloc(zend_safe_address_guarded(m, m, 0), sizeof(double), 0);
 	
-	for ( i = 0; i < m; i++ ) {
-		for ( j = 0; j < m; j++ ) {
-			outarray[(j*m)+i] = j == i ? 1.0 : 0.0;
+	for ( j = 0; j < (size_t)m; j++ ) {
+		for ( i = 0; i < (size_t)m; i++ ) {
+			outarray[j * m + i] = j == i ? 1.0 : 0.0;
 		}
 	}
 	
@@ -139,45 +340,178 @@ static double* php_lapack_identity( long m )
 
 /* --- Lapack Matrix Utility Functions --- */
 
-/* {{{ array Lapack::pseudoInverse(array A);
-Find the pseudoinverse of a matrix A. 
+/* {{{ static lapack_int php_lapack_dsytri(double *a, lapack_int n, lapack_int lda, lapack_int *ipiv, char uplo)
+Invert the symmetric matrix a in place with dsytrf and dsytri, working from
+its uplo triangle, and fill in the other triangle.
+*/
+static lapack_int php_lapack_dsytri(double *a, lapack_int n, lapack_int lda, lapack_int *ipiv, char uplo)
+{
+	double *work, query = 0.0;
+	size_t lwork;
+	lapack_int info;
+	
+	if (php_lapack_lwork_get(PHP_LAPACK_WORK_DSYTRF, n, 0, uplo, &lwork, NULL) == FAILURE) {
+		LAPACKE_dsytrf_work( LAPACK_COL_MAJOR, uplo, n, a, lda, ipiv, &query, -1 );
+		php_lapack_lwork_set(PHP_LAPACK_WORK_DSYTRF, n, 0, uplo, query, 0, &lwork, NULL);
+	}
+	
+	/* dsytri wants n elements of work, the same buffer will do */
+	work = php_lapack_arena_alloc(lwork > (size_t)n ? lwork : (size_t)n, sizeof(double));
+	
+	info = LAPACKE_dsytrf_work( LAPACK_COL_MAJOR, uplo, n, a, lda, ipiv, work, (lapack_int)lwork );
+	if (info == 0) {
+		info = LAPACKE_dsytri_work( LAPACK_COL_MAJOR, uplo, n, a, lda, ipiv, work );
+	}
+	if (info == 0) {
+		php_lapack_symmetrize(a, n, lda, uplo);
+	}
+	
+	return info;
+}
+/* }}} */
+
+/* {{{ static lapack_int php_lapack_dsysv(char uplo, lapack_int n, lapack_int nrhs, double *a, lapack_int lda, lapack_int *ipiv, double *b, lapack_int ldb)
+dsysv with its workspace from the arena.
 */
-PHP_METHOD(Lapack, pseudoInverse)
+static lapack_int php_lapack_dsysv(char uplo, lapack_int n, lapack_int nrhs, double *a, lapack_int lda, lapack_int *ipiv, double *b, lapack_int ldb)
+{
+	double *work, query = 0.0;
+	size_t lwork;
+	
+	if (php_lapack_lwork_get(PHP_LAPACK_WORK_DSYSV, n, nrhs, uplo, &lwork, NULL) == FAILURE) {
+		LAPACKE_dsysv_work( LAPACK_COL_MAJOR, uplo, n, nrhs, a, lda, ipiv, b, ldb, &query, -1 );
+		php_lapack_lwork_set(PHP_LAPACK_WORK_DSYSV, n, nrhs, uplo, query, 0, &lwork, NULL);
+	}
+	work = php_lapack_arena_alloc(lwork, sizeof(double));
+	
+	return LAPACKE_dsysv_work( LAPACK_COL_MAJOR, uplo, n, nrhs, a, lda, ipiv, b, ldb, work, (lapack_int)lwork );
+}
+/* }}} */
+
+/* {{{ static lapack_int php_lapack_mixed_solve(zend_bool spd, lapack_int n, lapack_int nrhs, double *a, lapack_int lda, lapack_int *ipiv, double **b, lapack_int ldb, lapack_int *iter)
+Solve with dsgesv, or dsposv on the lower triangle when spd is set: factor
+in single precision and refine the solution in double, with LAPACK falling
+back to a double factorisation by itself when refinement does not converge.
+iter is the number of refinement steps, or negative after a fallback. On
+success *b is replaced with the solution. Otherwise it is left alone, and
+dsposv only touches the lower triangle of A, as dposv does.
+*/
+static lapack_int php_lapack_mixed_solve(zend_bool spd, lapack_int n, lapack_int nrhs, double *a, lapack_int lda, lapack_int *ipiv, double **b, lapack_int ldb, lapack_int *iter)
+{
+	double *x, *work;
+	float *swork;
+	lapack_int info;
+
+	x = php_lapack_alloc((size_t)n * nrhs);
+	work = php_lapack_arena_alloc((size_t)n * nrhs, sizeof(double));
+	swork = php_lapack_arena_alloc((size_t)n * (n + nrhs), sizeof(float));
+
+	if (spd) {
+		info = LAPACKE_dsposv_work( LAPACK_COL_MAJOR, 'L', n, nrhs, a, lda, *b, ldb, x, n, work, swork, iter );
+	} else {
+		info = LAPACKE_dsgesv_work( LAPACK_COL_MAJOR, n, nrhs, a, lda, ipiv, *b, ldb, x, n, work, swork, iter );
+	}
+	php_lapack_stats_refinement(*iter);
+
+	if (info == 0) {
+		php_lapack_free(*b);
+		*b = x;
+	} else {
+		php_lapack_free(x);
+	}
+
+	return info;
+}
+/* }}} */
+
+/* {{{ array Lapack::inverse(array|LapackMatrix A [, int structure]);
+Find the inverse of a square matrix A. The structure hint (Lapack::AUTO by
+default) selects a Cholesky, symmetric indefinite or triangular inverse in
+place of the general LU one.
+*/
+PHP_METHOD(Lapack, inverse)
 {
 	zval *a;
-	double *al;
-	lapack_int info,m,n,lda,ldb,nrhs;
+	double *al, *work, query = 0.0;
+	lapack_int info,lda;
 	lapack_int *ipiv;
+	int m,n;
+	size_t lwork;
+	zend_long structure = PHP_LAPACK_AUTO;
+	php_lapack_structure_info shape;
+	zend_bool as_matrix = 0;
 
-	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "a", &a) == FAILURE) {
+	if (zend_parse_parameters(ZEND_NUM_ARGS(), "z|l", &a, &structure) == FAILURE) {
 		return;
 	}
 	
-	al = php_lapack_linearize_array(a, &m, &n);
+	php_lapack_arena_begin();
+	
+	al = php_lapack_linearize_operand(a, &m, &n, &as_matrix);
 	if (al == NULL) {
 		LAPACK_THROW("Invalid input matrix - argument 1", 102);
+	} else if ( m != n ) { 
+		php_lapack_free(al);
+		LAPACK_THROW("Matrix must be square", 103);
 	}
 	
-	ipiv = safe_emalloc(m, sizeof(lapack_int), 0);
-	lda = m;
-	ldb = m;
-	nrhs = m;
+	ipiv = php_lapack_arena_alloc(n, sizeof(lapack_int));
+	lda = n;
+	php_lapack_blas_threads_for((double)n * n * n);
 	
-	info = LAPACKE_dgetrf( LAPACK_COL_MAJOR, m, n, al, lda, ipiv);
-	if ( info == LAPACK_WORK_MEMORY_ERROR || info == LAPACK_TRANSPOSE_MEMORY_ERROR ) {
-		LAPACK_THROW("Not enough memory to calculate result", 101);
+	switch (php_lapack_structure(structure, al, n, lda, &shape)) {
+		case PHP_LAPACK_UPPER_TRIANGULAR:
+			info = LAPACKE_dtrtri_work( LAPACK_COL_MAJOR, 'U', 'N', n, al, lda );
+			break;
+			
+		case PHP_LAPACK_LOWER_TRIANGULAR:
+			info = LAPACKE_dtrtri_work( LAPACK_COL_MAJOR, 'L', 'N', n, al, lda );
+			break;
+			
+		case PHP_LAPACK_POSITIVE_DEFINITE:
+			info = LAPACKE_dpotrf_work( LAPACK_COL_MAJOR, 'L', n, al, lda );
+			if (info == 0) {
+				info = LAPACKE_dpotri_work( LAPACK_COL_MAJOR, 'L', n, al, lda );
+				if (info == 0) {
+					php_lapack_symmetrize(al, n, lda, 'L');
+				}
+				break;
+			} else if (info < 0) {
+				break;
+			}
+			php_lapack_stats_info(info);
+			/* Not positive definite after all: the upper triangle is untouched,
+			   so carry on with the symmetric indefinite inverse from there */
+			info = php_lapack_dsytri(al, n, lda, ipiv, 'U');
+			break;
+			
+		case PHP_LAPACK_SYMMETRIC:
+			info = php_lapack_dsytri(al, n, lda, ipiv, 'L');
+			break;
+			
+		default:
+			info = LAPACKE_dgetrf_work( LAPACK_COL_MAJOR, m, n, al, lda, ipiv );
+			if (info != 0) {
+				break;
+			}
+			if (php_lapack_lwork_get(PHP_LAPACK_WORK_DGETRI, n, 0, 0, &lwork, NULL) == FAILURE) {
+				LAPACKE_dgetri_work( LAPACK_COL_MAJOR, n, al, lda, ipiv, &query, -1 );
+				php_lapack_lwork_set(PHP_LAPACK_WORK_DGETRI, n, 0, 0, query, 0, &lwork, NULL);
+			}
+			work = php_lapack_arena_alloc(lwork, sizeof(double));
+			info = LAPACKE_dgetri_work( LAPACK_COL_MAJOR, n, al, lda, ipiv, work, (lapack_int)lwork );
+			break;
 	}
+	php_lapack_stats_info(info);
 	
-	info = LAPACKE_dgetri( LAPACK_COL_MAJOR, n, al, lda, ipiv);	
-	if ( info == LAPACK_WORK_MEMORY_ERROR || info == LAPACK_TRANSPOSE_MEMORY_ERROR ) {
-		LAPACK_THROW("Not enough memory to calculate result", 101);
-	} else if (info == 0) {
+	if (info == 0) {
 		/* If success, fill the data. If not, there is an error so we return empty array */
-		php_lapack_reassemble_array(return_value, al, m, n, lda);
+		php_lapack_return_matrix(return_value, &al, m, n, lda, as_matrix);
+	} else {
+		array_init(return_value);
 	}
 	
-	efree(al);
-	efree(ipiv);
+	php_lapack_free(al);
 	
 	return;
 }
@@ -189,14 +523,14 @@ Return an identity matrix size i.
 PHP_METHOD(Lapack, identity)
 {
 	double *al;
-	long m;
+	zend_long m;
 
-	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "l", &m) == FAILURE) {
+	if (zend_parse_parameters(ZEND_NUM_ARGS(), "l", &m) == FAILURE) {
 		return;
 	}
 	
-	if ( m < 1 ) {
-		LAPACK_THROW("Invalid input size - must be 1 or greater", 102);
+	if ( m < 1 || m > INT_MAX ) {
+		LAPACK_THROW("Invalid input size - must be between 1 and INT_MAX", 102);
 	}
 	
 	al = php_lapack_identity(m);
@@ -211,49 +545,131 @@ PHP_METHOD(Lapack, identity)
 
 /* --- Lapack Linear Equation Functions --- */
 
-/* {{{ array Lapack::solveLinearEquation(array A, array B);
+/* {{{ array Lapack::solveLinearEquation(array|LapackMatrix A, array|LapackMatrix B [, int structure [, int &iterations]]);
 This function computes the solution to the system of linear
 equations with a square matrix A and multiple
-right-hand sides B 
+right-hand sides B. The structure of A is detected unless a
+hint is given, and the matching driver is used: dtrtrs for
+triangular, dposv or dsysv for symmetric, dpbsv or dgbsv for
+banded and dgesv for anything else. When lapack.precision is
+"mixed", dsposv and dsgesv replace dposv and dgesv, and
+iterations is set to the number of refinement steps they took,
+or to a negative number when they fell back to double precision
+(0 when neither was used).
 */
 PHP_METHOD(Lapack, solveLinearEquation)
 {
-	zval *a, *b;
-	double *al, *bl;
-	lapack_int info,m,n,lda,ldb,nrhs;
+	zval *a, *b, *iterations = NULL;
+	double *al, *bl, *ab;
+	lapack_int info,lda,ldb,ldab,iter = 0;
+	int m,n,nrhs,mb;
 	lapack_int *ipiv;
+	zend_long structure = PHP_LAPACK_AUTO;
+	php_lapack_structure_info shape;
+	zend_bool as_matrix = 0, mixed = LAPACK_G(precision) == PHP_LAPACK_MIXED;
 
-	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "aa", &a, &b) == FAILURE) {
+	if (zend_parse_parameters(ZEND_NUM_ARGS(), "zz|lz", &a, &b, &structure, &iterations) == FAILURE) {
+		return;
+	}
+	
+	php_lapack_arena_begin();
+	
+	if (LAPACK_G(precision) == PHP_LAPACK_SINGLE) {
+		if (iterations != NULL) {
+			ZEND_TRY_ASSIGN_REF_LONG(iterations, 0);
+		}
+		php_lapack_single_solve(return_value, a, b, structure);
 		return;
 	}
 	
-	al = php_lapack_linearize_array(a, &m, &n);
+	al = php_lapack_linearize_operand(a, &m, &n, &as_matrix);
 	if (al == NULL) {
 		LAPACK_THROW("Invalid input matrix - argument 1", 102);
+	} else if ( m != n ) { 
+		php_lapack_free(al);
+		LAPACK_THROW("Matrix must be square", 103);
 	}
 	
-	bl = php_lapack_linearize_array(b, &m, &nrhs);
-	if (bl == NULL) {
-		efree(al);
+	bl = php_lapack_linearize_operand(b, &mb, &nrhs, &as_matrix);
+	if (bl == NULL || mb != n) {
+		php_lapack_free(al);
+		php_lapack_free(bl);
 		LAPACK_THROW("Invalid input matrix - argument 2", 102);
 	}
 	
-	ipiv = safe_emalloc(m, sizeof(lapack_int), 0);
+	ipiv = php_lapack_arena_alloc(n, sizeof(lapack_int));
 	lda = n;
 	ldb = n;
+	php_lapack_blas_threads_for((double)n * n * (n + nrhs));
 	
-	info = LAPACKE_dgesv( LAPACK_COL_MAJOR, n, nrhs, al, lda, ipiv, bl, ldb);
-		
-	if ( info == LAPACK_WORK_MEMORY_ERROR || info == LAPACK_TRANSPOSE_MEMORY_ERROR ) {
-		LAPACK_THROW("Not enough memory to calculate result", 101);
-	} else if (info == 0) {
+	switch (php_lapack_structure(structure, al, n, lda, &shape)) {
+		case PHP_LAPACK_UPPER_TRIANGULAR:
+			info = LAPACKE_dtrtrs_work( LAPACK_COL_MAJOR, 'U', 'N', 'N', n, nrhs, al, lda, bl, ldb );
+			break;
+			
+		case PHP_LAPACK_LOWER_TRIANGULAR:
+			info = LAPACKE_dtrtrs_work( LAPACK_COL_MAJOR, 'L', 'N', 'N', n, nrhs, al, lda, bl, ldb );
+			break;
+			
+		case PHP_LAPACK_POSITIVE_DEFINITE:
+			if (mixed) {
+				info = php_lapack_mixed_solve(1, n, nrhs, al, lda, ipiv, &bl, ldb, &iter);
+			} else {
+				info = LAPACKE_dposv_work( LAPACK_COL_MAJOR, 'L', n, nrhs, al, lda, bl, ldb );
+			}
+			if (info <= 0) {
+				break;
+			}
+			php_lapack_stats_info(info);
+			/* Not positive definite after all. dpotrf has only touched the
+			   lower triangle and B is left as it was, so retry from the upper */
+			info = php_lapack_dsysv( 'U', n, nrhs, al, lda, ipiv, bl, ldb );
+			break;
+			
+		case PHP_LAPACK_SYMMETRIC:
+			info = php_lapack_dsysv( 'L', n, nrhs, al, lda, ipiv, bl, ldb );
+			break;
+			
+		case PHP_LAPACK_BANDED:
+			info = 1;
+			if (shape.symmetric && shape.positive_diagonal) {
+				ldab = shape.ku + 1;
+				ab = php_lapack_band_pack(al, n, lda, 0, shape.ku, ldab);
+				info = LAPACKE_dpbsv_work( LAPACK_COL_MAJOR, 'U', n, shape.ku, nrhs, ab, ldab, bl, ldb );
+				php_lapack_free(ab);
+				php_lapack_stats_info(info);
+			}
+			if (info > 0) {
+				ldab = 2 * shape.kl + shape.ku + 1;
+				ab = php_lapack_band_pack(al, n, lda, shape.kl, shape.ku, ldab);
+				info = LAPACKE_dgbsv_work( LAPACK_COL_MAJOR, n, shape.kl, shape.ku, nrhs, ab, ldab, ipiv, bl, ldb );
+				php_lapack_free(ab);
+			}
+			break;
+			
+		default:
+			if (mixed) {
+				info = php_lapack_mixed_solve(0, n, nrhs, al, lda, ipiv, &bl, ldb, &iter);
+			} else {
+				info = LAPACKE_dgesv_work( LAPACK_COL_MAJOR, n, nrhs, al, lda, ipiv, bl, ldb );
+			}
+			break;
+	}
+	php_lapack_stats_info(info);
+	
+	if (iterations != NULL) {
+		ZEND_TRY_ASSIGN_REF_LONG(iterations, iter);
+	}
+	
+	if (info == 0) {
 		/* If success, fill the data. If not, there is an error so we return empty array */
-		php_lapack_reassemble_array(return_value, bl, n, nrhs, ldb);
+		php_lapack_return_matrix(return_value, &bl, n, nrhs, ldb, as_matrix);
+	} else {
+		array_init(return_value);
 	}
 	
-	efree(al);
-	efree(bl);
-	efree(ipiv);
+	php_lapack_free(al);
+	php_lapack_free(bl);
 	
 	return;
 }
@@ -261,7 +677,32 @@ PHP_METHOD(Lapack, solveLinearEquation)
 
 /* --- Lapack Linear Least Squares Functions --- */
 
-/* {{{ array Lapack::leastSquaresByFactorisation(array A, array B);
+/* {{{ static double* php_lapack_lls_rhs(zval *b, int m, int n, int *nrhs, lapack_int *ldb, zend_bool *as_matrix)
+Copy the right-hand sides B of a least squares problem with an m x n A into
+a buffer with ldb = max(m, n) rows, as dgels and dgelsd return the n rows of
+the solution in B's place. NULL when B is not a matrix with m rows.
+*/
+static double* php_lapack_lls_rhs(zval *b, int m, int n, int *nrhs, lapack_int *ldb, zend_bool *as_matrix)
+{
+	double *bl;
+	int mb;
+
+	if (php_lapack_operand_shape(b, &mb, nrhs, as_matrix) == FAILURE || mb != m) {
+		return NULL;
+	}
+
+	*ldb = m > n ? m : n;
+	bl = php_lapack_alloc((size_t)*ldb * *nrhs);
+	if (php_lapack_linearize_operand_into(b, bl, m, *nrhs, *ldb) == FAILURE) {
+		php_lapack_free(bl);
+		return NULL;
+	}
+
+	return bl;
+}
+/* }}} */
+
+/* {{{ array Lapack::leastSquaresByFactorisation(array|LapackMatrix A, array|LapackMatrix B);
 Solve the linear least squares problem, find min x in || B - Ax || 
 Returns an array representing x. Expects arrays of arrays, and will 
 return an array of arrays in the dimension B num cols x A num cols. 
@@ -270,46 +711,59 @@ Uses QR or LQ factorisation on matrix A.
 PHP_METHOD(Lapack, leastSquaresByFactorisation)
 {
 	zval *a, *b;
-	double *al, *bl;
-	lapack_int info,m,n,lda,ldb,nrhs;
+	double *al, *bl, *work, query = 0.0;
+	lapack_int info,lda,ldb;
+	int m,n,nrhs;
+	size_t lwork;
+	zend_bool as_matrix = 0;
 
-	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "aa", &a, &b) == FAILURE) {
+	if (zend_parse_parameters(ZEND_NUM_ARGS(), "zz", &a, &b) == FAILURE) {
 		return;
 	}
 	
-	al = php_lapack_linearize_array(a, &m, &n);
+	php_lapack_arena_begin();
+	
+	if (LAPACK_G(precision) == PHP_LAPACK_SINGLE) {
+		php_lapack_single_least_squares(return_value, a, b, 0);
+		return;
+	}
+	
+	al = php_lapack_linearize_operand(a, &m, &n, &as_matrix);
 	if (al == NULL) {
 		LAPACK_THROW("Invalid input matrix - argument 1", 102);
 	}
 	
-	bl = php_lapack_linearize_array(b, &m, &nrhs);
+	bl = php_lapack_lls_rhs(b, m, n, &nrhs, &ldb, &as_matrix);
 	if (bl == NULL) {
-		efree(al);
+		php_lapack_free(al);
 		LAPACK_THROW("Invalid input matrix - argument 2", 102);
 	}
 	
-	/* For rowmajor it would be: */
-	/* lda = n; ldb = nrhs; */
 	lda = m;
-	ldb = m;
+	php_lapack_blas_threads_for((double)m * n * (n + nrhs));
+	
+	if (php_lapack_lwork_get(PHP_LAPACK_WORK_DGELS, m, n, nrhs, &lwork, NULL) == FAILURE) {
+		LAPACKE_dgels_work( LAPACK_COL_MAJOR, 'N', m, n, nrhs, al, lda, bl, ldb, &query, -1 );
+		php_lapack_lwork_set(PHP_LAPACK_WORK_DGELS, m, n, nrhs, query, 0, &lwork, NULL);
+	}
+	work = php_lapack_arena_alloc(lwork, sizeof(double));
 	
-	info = LAPACKE_dgels( LAPACK_COL_MAJOR, 'N', m, n, nrhs, al, lda, bl, ldb);
+	info = LAPACKE_dgels_work( LAPACK_COL_MAJOR, 'N', m, n, nrhs, al, lda, bl, ldb, work, (lapack_int)lwork );
+	php_lapack_stats_info(info);
 		
-	if ( info == LAPACK_WORK_MEMORY_ERROR || info == LAPACK_TRANSPOSE_MEMORY_ERROR ) {
-		LAPACK_THROW("Not enough memory to calculate result", 101);
-	} else if (info == 0) {
+	if (info == 0) {
 		/* If success, fill the data. If not, there is an error so we return empty array */
-		php_lapack_reassemble_array(return_value, bl, n, nrhs, ldb);
+		php_lapack_return_matrix(return_value, &bl, n, nrhs, ldb, as_matrix);
 	}
 	
-	efree(al);
-	efree(bl);
+	php_lapack_free(al);
+	php_lapack_free(bl);
 	
 	return;
 }
 /* }}} */
 
-/* {{{ array Lapack::leastSquaresBySVD(array A, array B);
+/* {{{ array Lapack::leastSquaresBySVD(array|LapackMatrix A, array|LapackMatrix B);
 Solve the linear least squares problem, find min x in || B - Ax || 
 Returns an array representing x. Expects arrays of arrays, and will 
 return an array of arrays in the dimension B num cols x A num cols. 
@@ -318,49 +772,62 @@ Uses SVD with a divide and conquer algorithm.
 PHP_METHOD(Lapack, leastSquaresBySVD)
 {
 	zval *a, *b;
-	double *al, *bl, *s;
-	lapack_int info,m,n,lda,ldb,nrhs,rank;
+	double *al, *bl, *s, *work, query = 0.0;
+	lapack_int info,lda,ldb,rank,iquery = 0;
+	int m,n,nrhs;
+	lapack_int *iwork;
+	size_t lwork, liwork;
 	/* Negative rcond means using default (machine precision) value */
 	double rcond = -1.0;
+	zend_bool as_matrix = 0;
 
-	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "aa", &a, &b) == FAILURE) {
+	if (zend_parse_parameters(ZEND_NUM_ARGS(), "zz", &a, &b) == FAILURE) {
+		return;
+	}
+	
+	php_lapack_arena_begin();
+	
+	if (LAPACK_G(precision) == PHP_LAPACK_SINGLE) {
+		php_lapack_single_least_squares(return_value, a, b, 1);
 		return;
 	}
 	
-	al = php_lapack_linearize_array(a, &m, &n);
+	al = php_lapack_linearize_operand(a, &m, &n, &as_matrix);
 	if (al == NULL) {
 		LAPACK_THROW("Invalid input matrix - argument 1", 102);
 	}
 	
-	bl = php_lapack_linearize_array(b, &m, &nrhs);
+	bl = php_lapack_lls_rhs(b, m, n, &nrhs, &ldb, &as_matrix);
 	if (bl == NULL) {
-		efree(al);
+		php_lapack_free(al);
 		LAPACK_THROW("Invalid input matrix - argument 2", 102);
 	}
 	
-	/* For rowmajor it would be: */
-	/* lda = n; ldb = nrhs; */
-	/* Maybe m n*/
 	lda = m;
-	ldb = m;
-	s = safe_emalloc(m, sizeof(double), 0);
+	s = php_lapack_arena_alloc(m, sizeof(double));
+	php_lapack_blas_threads_for((double)m * n * (n + nrhs));
+	
+	if (php_lapack_lwork_get(PHP_LAPACK_WORK_DGELSD, m, n, nrhs, &lwork, &liwork) == FAILURE) {
+		LAPACKE_dgelsd_work( LAPACK_COL_MAJOR, m, n, nrhs, al, lda, bl, ldb, s, rcond, &rank, &query, -1, &iquery );
+		php_lapack_lwork_set(PHP_LAPACK_WORK_DGELSD, m, n, nrhs, query, iquery, &lwork, &liwork);
+	}
+	work = php_lapack_arena_alloc(lwork, sizeof(double));
+	iwork = php_lapack_arena_alloc(liwork, sizeof(lapack_int));
 	
-	info = LAPACKE_dgelsd ( LAPACK_COL_MAJOR, m, n, nrhs, al, lda, bl, ldb, s, rcond, &rank );
+	info = LAPACKE_dgelsd_work( LAPACK_COL_MAJOR, m, n, nrhs, al, lda, bl, ldb, s, rcond, &rank, work, (lapack_int)lwork, iwork );
+	php_lapack_stats_info(info);
 		
-	if ( info == LAPACK_WORK_MEMORY_ERROR || info == LAPACK_TRANSPOSE_MEMORY_ERROR ) {
-		LAPACK_THROW("Not enough memory to calculate result", 101);
-	} else if (info == 0) {
+	if (info == 0) {
 		/* 
 			can assemble the singular values if we want:  
 			php_lapack_reassemble_array(return_value, s, 1, (n < m ? n : m), ldb);
 			for now we are just getting the LLS solution
 		*/
-		php_lapack_reassemble_array(return_value, bl, n, nrhs, ldb);
+		php_lapack_return_matrix(return_value, &bl, n, nrhs, ldb, as_matrix);
 	}
 	
-	efree(al);
-	efree(bl);
-	efree(s);
+	php_lapack_free(al);
+	php_lapack_free(bl);
 	
 	return;
 }
@@ -368,332 +835,553 @@ PHP_METHOD(Lapack, leastSquaresBySVD)
 
 /* --- Lapack Eigenvalues and SVD Functions --- */
 
-/* {{{ array Lapack::eigenValues(array A, [array &leftEigenvectors, array &rightEigenvectors]);
+/* {{{ static void php_lapack_eigenvectors_split(zval *out, const double *v, lapack_int n, lapack_int ldv, const double *wi, zend_bool as_matrix)
+Set out to array('real' => Re, 'imag' => Im), two n x n matrices holding the
+eigenvectors in v as their columns. dgeev stores a complex conjugate pair as
+the real and imaginary parts of the first vector in columns j and j + 1,
+which is expanded here into both vectors of the pair.
+*/
+static void php_lapack_eigenvectors_split(zval *out, const double *v, lapack_int n, lapack_int ldv, const double *wi, zend_bool as_matrix)
+{
+	double *re, *im;
+	zval part;
+	int i, j;
+
+	re = php_lapack_alloc((size_t)n * n);
+	im = php_lapack_alloc((size_t)n * n);
+
+	for (j = 0; j < n; j++) {
+		if (wi[j] != 0.0 && j + 1 < n) {
+			for (i = 0; i < n; i++) {
+				re[i + (size_t)j * n] = re[i + (size_t)(j + 1) * n] = v[i + (size_t)j * ldv];
+				im[i + (size_t)j * n] = v[i + (size_t)(j + 1) * ldv];
+				im[i + (size_t)(j + 1) * n] = -v[i + (size_t)(j + 1) * ldv];
+			}
+			j++;
+		} else {
+			for (i = 0; i < n; i++) {
+				re[i + (size_t)j * n] = v[i + (size_t)j * ldv];
+				im[i + (size_t)j * n] = 0.0;
+			}
+		}
+	}
+
+	array_init_size(out, 2);
+	php_lapack_return_matrix(&part, &re, n, n, n, as_matrix);
+	add_assoc_zval(out, "real", &part);
+	php_lapack_return_matrix(&part, &im, n, n, n, as_matrix);
+	add_assoc_zval(out, "imag", &part);
+
+	php_lapack_free(re);
+	php_lapack_free(im);
+}
+/* }}} */
+
+/* {{{ void php_lapack_eigen_results(zval *return_value, zval *leig, zval *reig, lapack_int n, double *wr, double *wi, double *vl, double *vr, lapack_int ldv, zend_bool as_matrix)
+Return the eigenvalues in wr and wi, and replace leig and reig with the left
+and right eigenvectors when php_lapack_output_wanted says so.
+*/
+void php_lapack_eigen_results(zval *return_value, zval *leig, zval *reig, lapack_int n,
+	double *wr, double *wi, double *vl, double *vr, lapack_int ldv, zend_bool as_matrix)
+{
+	zval inner;
+	int idx;
+	
+	array_init_size(return_value, n);
+	
+	/* Returning the eigenvalues alone */
+	for( idx = 0; idx < n; idx++ ) {
+		array_init_size(&inner, 2);
+		add_next_index_double(&inner, wr[idx]);
+		if( wi[idx] != (float)0.0 ) {
+			add_next_index_double(&inner, wi[idx]);
+		}
+		add_next_index_zval(return_value, &inner);
+	}
+	
+	/* Return left eigenvectors */
+	if (php_lapack_output_wanted(leig)) {
+		php_lapack_eigenvectors_split(&inner, vl, n, ldv, wi, as_matrix);
+		ZEND_TRY_ASSIGN_REF_TMP(leig, &inner);
+	}
+	
+	/* Return right eigenvector */
+	if (php_lapack_output_wanted(reig)) {
+		php_lapack_eigenvectors_split(&inner, vr, n, ldv, wi, as_matrix);
+		ZEND_TRY_ASSIGN_REF_TMP(reig, &inner);
+	}
+}
+/* }}} */
+
+/* {{{ array Lapack::eigenValues(array|LapackMatrix A, [array &leftEigenvectors, array &rightEigenvectors [, int structure]]);
 Calculate the eigenvalues for the given matrix. Can optionaly return the eigenvectors for the 
-matrix. 
+matrix, which are only computed for the arguments that are arrays. Each is replaced with
+array('real' => Re, 'imag' => Im), eigenvector j being column j of both. Symmetric matrices
+(detected, or hinted with Lapack::SYMMETRIC) go through dsyevd, which returns real eigenvalues
+in ascending order and identical left and right eigenvectors.
 */
 PHP_METHOD(Lapack, eigenValues) 
 {
-	zval *a, *inner, *row, *col, *leig, *reig;
-	double *al, *wr, *wi, *vl, *vr;
-	lapack_int info, m, n, lda, ldvl, ldvr;
-	int idx, j;
+	zval *a, *leig, *reig;
+	double *al, *wr, *wi, *vl, *vr, *work, query = 0.0, dummy = 0.0;
+	lapack_int info, lda, ldvl, ldvr, iquery = 0;
+	int m, n;
+	lapack_int *iwork;
+	size_t lwork, liwork;
+	zend_long structure = PHP_LAPACK_AUTO;
+	php_lapack_structure_info shape;
+	zend_bool as_matrix = 0;
+	char jobvl, jobvr;
+	int kind;
 	
 	leig = reig = NULL;
 	
-	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "a|a!a!", &a, &leig, &reig) == FAILURE) {
+	if (zend_parse_parameters(ZEND_NUM_ARGS(), "z|z!z!l", &a, &leig, &reig, &structure) == FAILURE) {
 		return;
 	}
 	
-	al = php_lapack_linearize_array(a, &m, &n);
+	php_lapack_arena_begin();
+	
+	if (LAPACK_G(precision) == PHP_LAPACK_SINGLE) {
+		php_lapack_single_eigen(return_value, a, leig, reig, structure);
+		return;
+	}
+	
+	al = php_lapack_linearize_operand(a, &m, &n, &as_matrix);
 	if (al == NULL) {
 		LAPACK_THROW("Invalid input matrix", 102);
 	} else if ( m != n ) { 
+		php_lapack_free(al);
 		LAPACK_THROW("Matrix must be square", 103);
 	}
 	
-	lda = n;
-	ldvl = n;
-	ldvr = n;
-	
-	wr = safe_emalloc((n < m ? n : m), sizeof(double), 0);
-	wi = safe_emalloc(ldvl * n, sizeof(double), 0);
-	vr = safe_emalloc(ldvl * n, sizeof(double), 0);
-	vl = safe_emalloc(ldvr * n, sizeof(double), 0);
+	/* Only the eigenvectors that were asked for are computed */
+	jobvl = php_lapack_output_wanted(leig) ? 'V' : 'N';
+	jobvr = php_lapack_output_wanted(reig) ? 'V' : 'N';
 	
-	info = LAPACKE_dgeev( LAPACK_COL_MAJOR, 'V', 'V', n, al, lda, wr, wi, vl, ldvl, vr, ldvr );
+	lda = n;
 	
-	array_init(return_value);	
+	php_lapack_blas_threads_for((double)n * n * n);
+	wr = php_lapack_arena_alloc(n, sizeof(double));
+	wi = php_lapack_arena_alloc(n, sizeof(double));
+	memset(wi, 0, n * sizeof(double));
 	
-	if ( info == LAPACK_WORK_MEMORY_ERROR || info == LAPACK_TRANSPOSE_MEMORY_ERROR ) {
-		LAPACK_THROW("Not enough memory to calculate result", 101);
-	} else if (info == 0) {
+	kind = php_lapack_structure(structure, al, n, lda, &shape);
+	if (kind == PHP_LAPACK_SYMMETRIC || kind == PHP_LAPACK_POSITIVE_DEFINITE || shape.symmetric) {
+		char jobz = (jobvl == 'V' || jobvr == 'V') ? 'V' : 'N';
 		
-		/* Returning the eigenvalues alone */
-		for( idx = 0; idx < n; idx++ ) {
-			MAKE_STD_ZVAL(inner);
-			array_init(inner);
-			add_next_index_double(inner, wr[idx]);
-			if( wi[idx] != (float)0.0 ) {
-				add_next_index_double(inner, wi[idx]);
-			}
-			add_next_index_zval(return_value, inner);
+		if (php_lapack_lwork_get(PHP_LAPACK_WORK_DSYEVD, n, 0, jobz, &lwork, &liwork) == FAILURE) {
+			LAPACKE_dsyevd_work( LAPACK_COL_MAJOR, jobz, 'L', n, al, lda, wr, &query, -1, &iquery, -1 );
+			php_lapack_lwork_set(PHP_LAPACK_WORK_DSYEVD, n, 0, jobz, query, iquery, &lwork, &liwork);
 		}
+		work = php_lapack_arena_alloc(lwork, sizeof(double));
+		iwork = php_lapack_arena_alloc(liwork, sizeof(lapack_int));
 		
-		/* Return left eigenvectors */
-		if (leig != NULL && Z_TYPE_P(leig) == IS_ARRAY) { 
-			for( idx = 0; idx < n; idx++ ) {
-				MAKE_STD_ZVAL(row);
-				array_init(row);
-				j = 0;
-				while( j < n ) {
-					if( wi[j] != (float)0.0 ) {
-						MAKE_STD_ZVAL(col);
-						array_init(col);
-						add_next_index_double(col, vl[idx+j*ldvl]);
-						add_next_index_double(col, vl[idx+(j+1)*ldvl]);
-						add_next_index_zval(row, col);
-						MAKE_STD_ZVAL(col);
-						array_init(col);
-						add_next_index_double(col, vl[idx+j*ldvl]);
-						add_next_index_double(col, -vl[idx+(j+1)*ldvl]);
-						add_next_index_zval(row, col);
-						j += 2;
-					} else {
-						MAKE_STD_ZVAL(col);
-						array_init(col);
-						add_next_index_double(col, vl[idx+j*ldvl]);
-						add_next_index_zval(row, col);
-						j++;
-					}
-				}
-				add_next_index_zval(leig, row);
-			}
+		/* The eigenvectors overwrite A, and serve as both left and right */
+		info = LAPACKE_dsyevd_work( LAPACK_COL_MAJOR, jobz, 'L', n, al, lda, wr,
+									work, (lapack_int)lwork, iwork, (lapack_int)liwork );
+		vl = vr = al;
+		ldvl = lda;
+	} else {
+		ldvl = jobvl == 'V' ? n : 1;
+		ldvr = jobvr == 'V' ? n : 1;
+		vl = jobvl == 'V' ? php_lapack_arena_alloc((size_t)n * n, sizeof(double)) : &dummy;
+		vr = jobvr == 'V' ? php_lapack_arena_alloc((size_t)n * n, sizeof(double)) : &dummy;
+		
+		if (php_lapack_lwork_get(PHP_LAPACK_WORK_DGEEV, n, 0, (jobvl << 8) | jobvr, &lwork, NULL) == FAILURE) {
+			LAPACKE_dgeev_work( LAPACK_COL_MAJOR, jobvl, jobvr, n, al, lda, wr, wi, vl, ldvl, vr, ldvr, &query, -1 );
+			php_lapack_lwork_set(PHP_LAPACK_WORK_DGEEV, n, 0, (jobvl << 8) | jobvr, query, 0, &lwork, NULL);
 		}
+		work = php_lapack_arena_alloc(lwork, sizeof(double));
 		
-		/* Return right eigenvector */
-		if (reig != NULL && Z_TYPE_P(reig) == IS_ARRAY) {
-			for( idx = 0; idx < n; idx++ ) {
-				MAKE_STD_ZVAL(row);
-				array_init(row);
-				j = 0;
-				while( j < n ) {
-					if( wi[j] != (float)0.0 ) {
-						MAKE_STD_ZVAL(col);
-						array_init(col);
-						add_next_index_double(col, vr[idx+j*ldvr]);
-						add_next_index_double(col, vr[idx+(j+1)*ldvr]);
-						add_next_index_zval(row, col);
-						MAKE_STD_ZVAL(col);
-						array_init(col);
-						add_next_index_double(col, vr[idx+j*ldvr]);
-						add_next_index_double(col, -vr[idx+(j+1)*ldvr]);
-						add_next_index_zval(row, col);
-						j += 2;
-					} else {
-						MAKE_STD_ZVAL(col);
-						array_init(col);
-						add_next_index_double(col, vr[idx+j*ldvr]);
-						add_next_index_zval(row, col);
-						j++;
-					}
+		info = LAPACKE_dgeev_work( LAPACK_COL_MAJOR, jobvl, jobvr, n, al, lda, wr, wi, vl, ldvl, vr, ldvr,
+								   work, (lapack_int)lwork );
+		/* Both sets, when present, have leading dimension n */
+		ldvl = n;
+	}
+	php_lapack_stats_info(info);
+	
+	if (info == 0) {
+		php_lapack_eigen_results(return_value, leig, reig, n, wr, wi, vl, vr, ldvl, as_matrix);
+	} else {
+		array_init(return_value);
+	}
+	
+	php_lapack_free(al);
+	
+	return;
+}
+/* }}} */
+
+/* {{{ static void php_lapack_eigen_selected(zval *return_value, zval *a, char range, double lo, double hi, zend_long k, zval *vectors)
+Eigenvalues of the symmetric matrix A with dsyevr, either those in (lo, hi]
+in ascending order (range 'V') or the k largest in descending order (range
+'I'), returned as a 1 x count matrix. Only the lower triangle of A is read.
+When vectors is wanted it is replaced with the n x count eigenvectors.
+*/
+static void php_lapack_eigen_selected(zval *return_value, zval *a, char range, double lo, double hi, zend_long k, zval *vectors)
+{
+	double *al, *w, *z = NULL, *work, query = 0.0, dummy = 0.0, t;
+	lapack_int info, il, found = 0, iquery = 0;
+	int m, n;
+	lapack_int *isuppz, *iwork;
+	size_t lwork, liwork;
+	zend_bool as_matrix = 0;
+	char jobz;
+	int i, j;
+	
+	al = php_lapack_linearize_operand(a, &m, &n, &as_matrix);
+	if (al == NULL) {
+		LAPACK_THROW("Invalid input matrix", 102);
+	} else if ( m != n ) { 
+		php_lapack_free(al);
+		LAPACK_THROW("Matrix must be square", 103);
+	} else if ( range == 'I' && (k < 1 || k > n) ) {
+		php_lapack_free(al);
+		LAPACK_THROW("Invalid number of eigenvalues - must be between 1 and the size of A", 102);
+	}
+	
+	jobz = php_lapack_output_wanted(vectors) ? 'V' : 'N';
+	il = range == 'I' ? n - (lapack_int)k + 1 : 1;
+	
+	php_lapack_blas_threads_for((double)n * n * n);
+	w = php_lapack_arena_alloc(n, sizeof(double));
+	isuppz = php_lapack_arena_alloc(2 * (size_t)n, sizeof(lapack_int));
+	if (jobz == 'V') {
+		/* An index range says how many vectors there will be, a value range does not */
+		z = php_lapack_alloc((size_t)n * (range == 'I' ? k : n));
+	}
+	
+	if (php_lapack_lwork_get(PHP_LAPACK_WORK_DSYEVR, n, 0, jobz, &lwork, &liwork) == FAILURE) {
+		LAPACKE_dsyevr_work( LAPACK_COL_MAJOR, jobz, range, 'L', n, al, n, lo, hi, il, n, 0.0, &found, w,
+							 z != NULL ? z : &dummy, n, isuppz, &query, -1, &iquery, -1 );
+		php_lapack_lwork_set(PHP_LAPACK_WORK_DSYEVR, n, 0, jobz, query, iquery, &lwork, &liwork);
+	}
+	work = php_lapack_arena_alloc(lwork, sizeof(double));
+	iwork = php_lapack_arena_alloc(liwork, sizeof(lapack_int));
+	
+	info = LAPACKE_dsyevr_work( LAPACK_COL_MAJOR, jobz, range, 'L', n, al, n, lo, hi, il, n, 0.0, &found, w,
+								z != NULL ? z : &dummy, n, isuppz, work, (lapack_int)lwork, iwork, (lapack_int)liwork );
+	php_lapack_stats_info(info);
+	
+	if (info == 0 && found > 0) {
+		/* dsyevr returns ascending order, the top k are wanted largest first */
+		if (range == 'I') {
+			for (j = 0; j < found / 2; j++) {
+				t = w[j];
+				w[j] = w[found - 1 - j];
+				w[found - 1 - j] = t;
+				for (i = 0; z != NULL && i < n; i++) {
+					t = z[i + (size_t)j * n];
+					z[i + (size_t)j * n] = z[i + (size_t)(found - 1 - j) * n];
+					z[i + (size_t)(found - 1 - j) * n] = t;
 				}
-				add_next_index_zval(reig, row);
 			}
 		}
+		
+		if (z != NULL) {
+			php_lapack_assign_matrix(vectors, &z, n, found, n, as_matrix);
+		}
+		
+		/* w is in the arena, so the result needs a buffer of its own */
+		work = php_lapack_alloc(found);
+		memcpy(work, w, found * sizeof(double));
+		php_lapack_return_matrix(return_value, &work, 1, found, 1, as_matrix);
+		php_lapack_free(work);
+	} else {
+		array_init(return_value);
 	}
 	
-	efree(al);
-	efree(wr);
-	efree(wi);
-	efree(vl);
-	efree(vr);	
+	php_lapack_free(al);
+	php_lapack_free(z);
+}
+/* }}} */
+
+/* {{{ array Lapack::eigenRange(array|LapackMatrix A, float lo, float hi [, array &eigenvectors]);
+Calculate the eigenvalues of the symmetric matrix A that lie in (lo, hi], in
+ascending order, with dsyevr. Only the lower triangle of A is used. When an
+array is passed for eigenvectors it is replaced with the matching
+eigenvectors, one per column. Returns an empty array when there are none.
+*/
+PHP_METHOD(Lapack, eigenRange)
+{
+	zval *a, *vectors = NULL;
+	double lo, hi;
+	
+	if (zend_parse_parameters(ZEND_NUM_ARGS(), "zdd|z!", &a, &lo, &hi, &vectors) == FAILURE) {
+		return;
+	}
+	
+	php_lapack_arena_begin();
+	
+	if ( !(lo < hi) ) {
+		LAPACK_THROW("Invalid range - lo must be less than hi", 102);
+	}
+	
+	php_lapack_eigen_selected(return_value, a, 'V', lo, hi, 0, vectors);
+	
+	return;
+}
+/* }}} */
+
+/* {{{ array Lapack::topEigen(array|LapackMatrix A, int k [, array &eigenvectors]);
+Calculate the k largest eigenvalues of the symmetric matrix A, largest first,
+with dsyevr. Only the lower triangle of A is used. When an array is passed
+for eigenvectors it is replaced with the n x k matching eigenvectors.
+*/
+PHP_METHOD(Lapack, topEigen)
+{
+	zval *a, *vectors = NULL;
+	zend_long k;
+	
+	if (zend_parse_parameters(ZEND_NUM_ARGS(), "zl|z!", &a, &k, &vectors) == FAILURE) {
+		return;
+	}
+	
+	php_lapack_arena_begin();
+	
+	php_lapack_eigen_selected(return_value, a, 'I', 0.0, 0.0, k, vectors);
 	
 	return;
 }
 /* }}} */
 
-/* {{{ array Lapack::singularValues(array A);
+/* {{{ array Lapack::singularValues(array|LapackMatrix A);
 Calculate the singular values of the matrix A. 
 */
 PHP_METHOD(Lapack, singularValues) 
 {
 	zval *a;
-	double *al, *s, *u, *vt;
-	lapack_int info, m, n, lda, ldu, ldvt;
+	double *al, *s, *work, u, vt, query = 0.0;
+	lapack_int info, lda, ldu, ldvt;
+	int m, n;
+	lapack_int *iwork;
+	size_t lwork;
+	zend_bool as_matrix = 0;
+	
+	if (zend_parse_parameters(ZEND_NUM_ARGS(), "z", &a) == FAILURE) {
+		return;
+	}
+	
+	php_lapack_arena_begin();
 	
-	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "a", &a) == FAILURE) {
+	if (LAPACK_G(precision) == PHP_LAPACK_SINGLE) {
+		php_lapack_single_singular_values(return_value, a);
 		return;
 	}
 	
-	al = php_lapack_linearize_array(a, &m, &n);
+	al = php_lapack_linearize_operand(a, &m, &n, &as_matrix);
 	if (al == NULL) {
 		LAPACK_THROW("Invalid input matrix", 102);
 	}
 	
+	/* Values only, so U and VT are never referenced */
 	lda = m;
-	ldu = m;
-	ldvt = n;
-	s = safe_emalloc((n < m ? n : m), sizeof(double), 0);
-	u = safe_emalloc(ldu * m, sizeof(double), 0);
-	vt = safe_emalloc(ldvt*n, sizeof(double), 0);
+	ldu = 1;
+	ldvt = 1;
+	s = php_lapack_alloc(n < m ? n : m);
+	iwork = php_lapack_arena_alloc(8 * (size_t)(n < m ? n : m), sizeof(lapack_int));
+	php_lapack_blas_threads_for((double)m * n * (n < m ? n : m));
+	
+	if (php_lapack_lwork_get(PHP_LAPACK_WORK_DGESDD, m, n, 'N', &lwork, NULL) == FAILURE) {
+		LAPACKE_dgesdd_work( LAPACK_COL_MAJOR, 'N', m, n, al, lda, s, &u, ldu, &vt, ldvt, &query, -1, iwork );
+		php_lapack_lwork_set(PHP_LAPACK_WORK_DGESDD, m, n, 'N', query, 0, &lwork, NULL);
+	}
+	work = php_lapack_arena_alloc(lwork, sizeof(double));
 	
-	info = LAPACKE_dgesdd( LAPACK_COL_MAJOR, 'S', m, n, al, lda, s, u, ldu, vt, ldvt );
+	info = LAPACKE_dgesdd_work( LAPACK_COL_MAJOR, 'N', m, n, al, lda, s, &u, ldu, &vt, ldvt, work, (lapack_int)lwork, iwork );
+	php_lapack_stats_info(info);
 	
-	if ( info == LAPACK_WORK_MEMORY_ERROR || info == LAPACK_TRANSPOSE_MEMORY_ERROR ) {
-		LAPACK_THROW("Not enough memory to calculate result", 101);
-	} else if (info == 0) {
-		php_lapack_reassemble_array(return_value, s, 1, n, 1);
+	if (info == 0) {
+		php_lapack_return_matrix(return_value, &s, 1, (n < m ? n : m), 1, as_matrix);
 	}
 	
-	efree(al);
-	efree(s);
-	efree(u);
-	efree(vt);
+	php_lapack_free(al);
+	php_lapack_free(s);
 	
 	return;	
 }
 /* }}} */
 
-/* {{{ array Lapack::shapeRegressionModel(array M, array P, array W);
-Calculate a regression model between the measurements M and the 3D shapes
-represented by the Principal Components (PCs) in P and the PC weights in W.
-Returns an array representing the regression equations/model in matrix form. 
-Expects arrays of arrays, with M number of subjects by number of measures, 
-P 3 times number of vertices by number of PCs, W number of subjects by number 
-of PCs, and will return an array of arrays in the dimension three times number 
-of vertices by number of measures plus 1. Uses SVD of M internally. 
+/* --- Lapack Configuration Functions --- */
+
+/* {{{ int Lapack::setThreads(int threads);
+Set the most threads the BLAS backend may use for the rest of the request,
+0 meaning the backend default, as ini_set('lapack.max_threads') would.
+Problems smaller than lapack.parallel_threshold still run on one thread.
+Returns the previous setting.
 */
-PHP_METHOD(Lapack, shapeRegressionModel)
+PHP_METHOD(Lapack, setThreads)
 {
-	zval *M, *P, *W;
-	double *Ml, *Pl, *Wl, *Fl, *S, *U, *VT, *superb, *Sinv, *T1, *T2, *T3, *R;
-	int i, j, k;
-
-	// ns = number of subjects, nf = number of features/measurements, 
-	// np = number of principal components, nc = number of coordinate values
-	lapack_int info,n,m,ns,nf,np,nc,ldM,ldP,ldW,ldF,ldU,ldVT;
-
-	/* Negative rcond means using default (machine precision) value */
-	double rcond = -1.0;
-
-	// parse paremeters
-	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "aaa", &M, &P, &W) == FAILURE) {
+	zend_long threads;
+	zend_string *name, *value;
+	
+	if (zend_parse_parameters(ZEND_NUM_ARGS(), "l", &threads) == FAILURE) {
 		return;
 	}
 	
-	Ml = php_lapack_linearize_array(M, &ns, &nf);
-	if (Ml == NULL) {
-		LAPACK_THROW("Invalid input matrix - argument 1 (M)", 102);
+	if ( threads < 0 ) {
+		LAPACK_THROW("Invalid thread count - must be 0 or greater", 102);
 	}
 	
-	Pl = php_lapack_linearize_array(P, &nc, &np);
-	if (Pl == NULL) {
-		efree(Ml);
-		LAPACK_THROW("Invalid input matrix - argument 2 (P)", 102);
-	}
+	RETVAL_LONG(LAPACK_G(max_threads));
 	
-	Wl = php_lapack_linearize_array(W, &m, &n);
-	if (Wl == NULL) {
-		efree(Ml);
-		efree(Pl);
-		LAPACK_THROW("Invalid input matrix - argument 3 (W)", 102);
-	}
-	if( m != ns )
-	{
-		LAPACK_THROW("Invalid input matrix - argument 3 (W), wrong number of rows", 102);	
-	}
-	if( n != np )
-	{
-		LAPACK_THROW("Invalid input matrix - argument 3 (W), wrong number of columns", 102);	
-	}
+	name = zend_string_init("lapack.max_threads", sizeof("lapack.max_threads") - 1, 0);
+	value = zend_long_to_str(threads);
+	zend_alter_ini_entry(name, value, PHP_INI_USER, PHP_INI_STAGE_RUNTIME);
+	zend_string_release(value);
+	zend_string_release(name);
+	
+	return;
+}
+/* }}} */
 
-	// create matrix F which is M transposed with additional row of ones.
-	Fl = safe_emalloc((nf + 1) * ns, sizeof(double), 0);
+/* --- ARGUMENTS AND INIT --- */
 
-	for ( i = 0; i < nf+1; i++ ) 
-	{
-		for ( j = 0; j < ns; j++ ) 
-		{
-			k = (j * (nf+1)) + i;
-			Fl[k] = (i < nf) ? Ml[(i * ns) + j] : 1.0;
-		}
-	}
+ZEND_BEGIN_ARG_INFO_EX(lapack_empty_args, 0, 0, 0)
+ZEND_END_ARG_INFO()
 
-	// do svd of F
-	ldF = nf+1;
-	
-	S = safe_emalloc(nf+1, sizeof(double), 0);
+ZEND_BEGIN_ARG_INFO_EX(lapack_lls_args, 0, 0, 2)
+	ZEND_ARG_INFO(0, a)
+	ZEND_ARG_INFO(0, b)
+ZEND_END_ARG_INFO()
 
-	ldU = nf+1;
-	U = safe_emalloc((nf + 1) * (nf + 1), sizeof(double), 0);
+ZEND_BEGIN_ARG_INFO_EX(lapack_values_args, 0, 0, 1)
+	ZEND_ARG_INFO(0, a)
+ZEND_END_ARG_INFO()
 
-	ldVT = nf + 1;
-	VT = safe_emalloc((nf + 1) * ns , sizeof(double), 0);
+ZEND_BEGIN_ARG_INFO_EX(lapack_solve_args, 0, 0, 2)
+	ZEND_ARG_INFO(0, a)
+	ZEND_ARG_INFO(0, b)
+	ZEND_ARG_INFO(0, structure)
+	ZEND_ARG_INFO(1, iterations)
+ZEND_END_ARG_INFO()
 
-	superb = safe_emalloc(nf , sizeof(double), 0);
+ZEND_BEGIN_ARG_INFO_EX(lapack_inverse_args, 0, 0, 1)
+	ZEND_ARG_INFO(0, a)
+	ZEND_ARG_INFO(0, structure)
+ZEND_END_ARG_INFO()
 
-	info = LAPACKE_dgesvd ( LAPACK_COL_MAJOR, 'S', 'S', nf + 1, ns, Fl, ldF, S, U, ldU,
-              				VT, ldVT, superb );
-	if ( info == LAPACK_WORK_MEMORY_ERROR || info == LAPACK_TRANSPOSE_MEMORY_ERROR ) 
-	{
-		LAPACK_THROW("Not enough memory to calculate result", 101);
-	} 
-	else if (info > 0) 
-	{
-		LAPACK_THROW("SVD failed", 101);
-	}
+ZEND_BEGIN_ARG_INFO_EX(lapack_pinv_args, 0, 0, 1)
+	ZEND_ARG_INFO(0, a)
+	ZEND_ARG_INFO(0, rcond)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(lapack_pinv_solve_args, 0, 0, 2)
+	ZEND_ARG_INFO(0, a)
+	ZEND_ARG_INFO(0, b)
+	ZEND_ARG_INFO(0, rcond)
+ZEND_END_ARG_INFO()
+
+/* Prefer-ref so that null can still be passed to skip the left eigenvectors */
+ZEND_BEGIN_ARG_INFO_EX(lapack_eigen_args, 0, 0, 1)
+	ZEND_ARG_INFO(0, a)
+	ZEND_ARG_INFO(ZEND_SEND_PREFER_REF, left)
+	ZEND_ARG_INFO(ZEND_SEND_PREFER_REF, right)
+	ZEND_ARG_INFO(0, structure)
+ZEND_END_ARG_INFO()
 
-	// Step by step mulitiplication of R = P . W^T . V . S^-1 . U^T
+ZEND_BEGIN_ARG_INFO_EX(lapack_eigen_range_args, 0, 0, 3)
+	ZEND_ARG_INFO(0, a)
+	ZEND_ARG_INFO(0, lo)
+	ZEND_ARG_INFO(0, hi)
+	ZEND_ARG_INFO(ZEND_SEND_PREFER_REF, eigenvectors)
+ZEND_END_ARG_INFO()
 
-	// T1 = S^-1 . U^T
-	T1 = safe_emalloc( (nf+1) * (nf+1), sizeof(double), 0);
+ZEND_BEGIN_ARG_INFO_EX(lapack_top_eigen_args, 0, 0, 2)
+	ZEND_ARG_INFO(0, a)
+	ZEND_ARG_INFO(0, k)
+	ZEND_ARG_INFO(ZEND_SEND_PREFER_REF, eigenvectors)
+ZEND_END_ARG_INFO()
 
-	Sinv = safe_emalloc( (nf+1) * (nf+1), sizeof(double), 0);
-	for ( i = 0; i < nf+1; i++ ) 
-	{
-		Sinv[ i * (nf + 1) + i ] = 1.0 / S[i];
-	}
+ZEND_BEGIN_ARG_INFO_EX(lapack_batch_args, 0, 0, 2)
+	ZEND_ARG_INFO(0, as)
+	ZEND_ARG_INFO(0, bs)
+	ZEND_ARG_INFO(0, threads)
+ZEND_END_ARG_INFO()
 
-    cblas_dgemm( CblasColMajor,  CblasNoTrans, CblasTrans, (nf + 1), (nf + 1), (nf + 1),
-                   1.0, Sinv, (nf + 1), U, (nf + 1), 0.0, T1, (nf + 1) );
+ZEND_BEGIN_ARG_INFO_EX(lapack_values_batch_args, 0, 0, 1)
+	ZEND_ARG_INFO(0, as)
+	ZEND_ARG_INFO(0, threads)
+ZEND_END_ARG_INFO()
 
-	// T2 = V . T1 = VT^T . T1
-    T2 = safe_emalloc( ns * (nf+1), sizeof(double), 0);
+ZEND_BEGIN_ARG_INFO_EX(lapack_truncated_svd_args, 0, 0, 2)
+	ZEND_ARG_INFO(0, a)
+	ZEND_ARG_INFO(0, k)
+	ZEND_ARG_INFO(0, method)
+	ZEND_ARG_INFO(ZEND_SEND_PREFER_REF, u)
+	ZEND_ARG_INFO(ZEND_SEND_PREFER_REF, v)
+ZEND_END_ARG_INFO()
 
-    cblas_dgemm( CblasColMajor,  CblasTrans, CblasNoTrans, ns, (nf + 1), (nf + 1),
-                   1.0, VT, (nf + 1), T1, (nf + 1), 0.0, T2, ns );
+ZEND_BEGIN_ARG_INFO_EX(lapack_multiply_args, 0, 0, 2)
+	ZEND_ARG_INFO(0, A)
+	ZEND_ARG_INFO(0, B)
+	ZEND_ARG_INFO(0, transA)
+	ZEND_ARG_INFO(0, transB)
+	ZEND_ARG_INFO(0, alpha)
+	ZEND_ARG_INFO(0, beta)
+	ZEND_ARG_INFO(0, C)
+ZEND_END_ARG_INFO()
 
-	// T3 = W^T . T2
-    T3 = safe_emalloc( np * (nf+1), sizeof(double), 0);
+ZEND_BEGIN_ARG_INFO_EX(lapack_multiply_chain_args, 0, 0, 1)
+	ZEND_ARG_INFO(0, matrices)
+	ZEND_ARG_INFO(0, transpose)
+ZEND_END_ARG_INFO()
 
-    cblas_dgemm( CblasColMajor,  CblasTrans, CblasNoTrans, np, (nf + 1), ns,
-                   1.0, Wl, ns, T2, ns, 0.0, T3, np );
+ZEND_BEGIN_ARG_INFO_EX(lapack_lsq_stream_args, 0, 0, 1)
+	ZEND_ARG_INFO(0, n)
+	ZEND_ARG_INFO(0, ridge)
+	ZEND_ARG_INFO(0, forgetting)
+ZEND_END_ARG_INFO()
 
-	// R = P . T3
- 	R = safe_emalloc( nc * (nf+1), sizeof(double), 0);
+ZEND_BEGIN_ARG_INFO_EX(lapack_load_args, 0, 0, 1)
+	ZEND_ARG_INFO(0, path)
+ZEND_END_ARG_INFO()
 
-    cblas_dgemm( CblasColMajor,  CblasNoTrans, CblasNoTrans, nc, (nf + 1), np,
-                   1.0, Pl, nc, T3, np, 0.0, R, nc );
+ZEND_BEGIN_ARG_INFO_EX(lapack_save_args, 0, 0, 2)
+	ZEND_ARG_INFO(0, path)
+	ZEND_ARG_INFO(0, a)
+	ZEND_ARG_INFO(0, single)
+ZEND_END_ARG_INFO()
 
-	// assemble matrices for output
-	php_lapack_reassemble_array(return_value, R, nc, nf+1, nc);
-	
-	efree(Ml);
-	efree(Pl);
-	efree(Wl);
-	efree(S);
-	efree(U);
-	efree(VT);
-	efree(superb);
-	efree(Sinv);
-	efree(T1);
-	efree(T2);
-	efree(T3);
-	efree(R);
+ZEND_BEGIN_ARG_INFO_EX(lapack_solve_sparse_args, 0, 0, 2)
+	ZEND_ARG_OBJ_INFO(0, A, LapackSparse, 0)
+	ZEND_ARG_INFO(0, B)
+	ZEND_ARG_INFO(0, structure)
+	ZEND_ARG_INFO(0, preconditioner)
+	ZEND_ARG_INFO(0, tolerance)
+	ZEND_ARG_INFO(0, maxIterations)
+	ZEND_ARG_INFO(ZEND_SEND_PREFER_REF, status)
+ZEND_END_ARG_INFO()
 
-	return;
-}
-/* }}} */
+ZEND_BEGIN_ARG_INFO_EX(lapack_lls_sparse_args, 0, 0, 2)
+	ZEND_ARG_OBJ_INFO(0, A, LapackSparse, 0)
+	ZEND_ARG_INFO(0, B)
+	ZEND_ARG_INFO(0, preconditioner)
+	ZEND_ARG_INFO(0, tolerance)
+	ZEND_ARG_INFO(0, maxIterations)
+	ZEND_ARG_INFO(ZEND_SEND_PREFER_REF, status)
+ZEND_END_ARG_INFO()
 
-/* --- ARGUMENTS AND INIT --- */
+ZEND_BEGIN_ARG_INFO_EX(lapack_async_args, 0, 0, 1)
+	ZEND_ARG_INFO(0, method)
+	ZEND_ARG_VARIADIC_INFO(0, args)
+ZEND_END_ARG_INFO()
 
-ZEND_BEGIN_ARG_INFO_EX(lapack_empty_args, 0, 0, 0)
+ZEND_BEGIN_ARG_INFO_EX(lapack_cache_store_args, 0, 0, 2)
+	ZEND_ARG_INFO(0, key)
+	ZEND_ARG_INFO(0, value)
 ZEND_END_ARG_INFO()
 
-ZEND_BEGIN_ARG_INFO_EX(lapack_lls_args, 0, 0, 2)
-	ZEND_ARG_INFO(0, a)
-	ZEND_ARG_INFO(0, b)
+ZEND_BEGIN_ARG_INFO_EX(lapack_cache_fetch_args, 0, 0, 1)
+	ZEND_ARG_INFO(0, key)
 ZEND_END_ARG_INFO()
 
-ZEND_BEGIN_ARG_INFO_EX(lapack_values_args, 0, 0, 2)
-	ZEND_ARG_INFO(0, a)
+ZEND_BEGIN_ARG_INFO_EX(lapack_no_args, 0, 0, 0)
 ZEND_END_ARG_INFO()
 
-ZEND_BEGIN_ARG_INFO_EX(lapack_eigen_args, 0, 0, 1)
-	ZEND_ARG_INFO(0, a)
-	ZEND_ARG_INFO(0, left)
-	ZEND_ARG_INFO(0, right)
+ZEND_BEGIN_ARG_INFO_EX(lapack_threads_args, 0, 0, 1)
+	ZEND_ARG_INFO(0, threads)
 ZEND_END_ARG_INFO()
 
 ZEND_BEGIN_ARG_INFO_EX(lapack_srm_args, 0, 0, 3)
@@ -702,55 +1390,178 @@ ZEND_BEGIN_ARG_INFO_EX(lapack_srm_args, 0, 0, 3)
 	ZEND_ARG_INFO(0, W)
 ZEND_END_ARG_INFO()
 
-static zend_function_entry php_lapack_class_methods[] =
+ZEND_BEGIN_ARG_INFO_EX(lapack_shape_model_args, 0, 0, 3)
+	ZEND_ARG_INFO(0, M)
+	ZEND_ARG_INFO(0, P)
+	ZEND_ARG_INFO(0, W)
+	ZEND_ARG_INFO(0, keepFactors)
+ZEND_END_ARG_INFO()
+
+static const zend_function_entry php_lapack_class_methods[] =
 {
-	PHP_ME(Lapack, solveLinearEquation,			lapack_lls_args, ZEND_ACC_PUBLIC | ZEND_ACC_STATIC)
+	PHP_ME(Lapack, solveLinearEquation,			lapack_solve_args, ZEND_ACC_PUBLIC | ZEND_ACC_STATIC)
 	PHP_ME(Lapack, leastSquaresByFactorisation,	lapack_lls_args, ZEND_ACC_PUBLIC | ZEND_ACC_STATIC)
 	PHP_ME(Lapack, leastSquaresBySVD,			lapack_lls_args, ZEND_ACC_PUBLIC | ZEND_ACC_STATIC)
+	PHP_ME(Lapack, leastSquaresStream,			lapack_lsq_stream_args, ZEND_ACC_PUBLIC | ZEND_ACC_STATIC)
+	PHP_ME(Lapack, solveSparse,					lapack_solve_sparse_args, ZEND_ACC_PUBLIC | ZEND_ACC_STATIC)
+	PHP_ME(Lapack, leastSquaresSparse,			lapack_lls_sparse_args, ZEND_ACC_PUBLIC | ZEND_ACC_STATIC)
 	PHP_ME(Lapack, eigenValues,					lapack_eigen_args, ZEND_ACC_PUBLIC | ZEND_ACC_STATIC)
+	PHP_ME(Lapack, eigenRange,					lapack_eigen_range_args, ZEND_ACC_PUBLIC | ZEND_ACC_STATIC)
+	PHP_ME(Lapack, topEigen,					lapack_top_eigen_args, ZEND_ACC_PUBLIC | ZEND_ACC_STATIC)
 	PHP_ME(Lapack, singularValues,				lapack_values_args, ZEND_ACC_PUBLIC | ZEND_ACC_STATIC)
+	PHP_ME(Lapack, truncatedSVD,				lapack_truncated_svd_args, ZEND_ACC_PUBLIC | ZEND_ACC_STATIC)
+	PHP_ME(Lapack, multiply,					lapack_multiply_args, ZEND_ACC_PUBLIC | ZEND_ACC_STATIC)
+	PHP_ME(Lapack, multiplyChain,				lapack_multiply_chain_args, ZEND_ACC_PUBLIC | ZEND_ACC_STATIC)
+	PHP_ME(Lapack, load,						lapack_load_args, ZEND_ACC_PUBLIC | ZEND_ACC_STATIC)
+	PHP_ME(Lapack, save,						lapack_save_args, ZEND_ACC_PUBLIC | ZEND_ACC_STATIC)
 	PHP_ME(Lapack, identity,					lapack_values_args, ZEND_ACC_PUBLIC | ZEND_ACC_STATIC)
-	PHP_ME(Lapack, pseudoInverse,				lapack_values_args, ZEND_ACC_PUBLIC | ZEND_ACC_STATIC)
+	PHP_ME(Lapack, inverse,						lapack_inverse_args, ZEND_ACC_PUBLIC | ZEND_ACC_STATIC)
+	PHP_ME(Lapack, pseudoInverse,				lapack_pinv_args, ZEND_ACC_PUBLIC | ZEND_ACC_STATIC)
+	PHP_ME(Lapack, pinvSolve,					lapack_pinv_solve_args, ZEND_ACC_PUBLIC | ZEND_ACC_STATIC)
 	PHP_ME(Lapack, shapeRegressionModel,		lapack_srm_args, ZEND_ACC_PUBLIC | ZEND_ACC_STATIC)
-	{ NULL, NULL, NULL }
+	PHP_ME(Lapack, shapeModel,					lapack_shape_model_args, ZEND_ACC_PUBLIC | ZEND_ACC_STATIC)
+	PHP_ME(Lapack, solveLinearEquationBatch,	lapack_batch_args, ZEND_ACC_PUBLIC | ZEND_ACC_STATIC)
+	PHP_ME(Lapack, leastSquaresByFactorisationBatch,	lapack_batch_args, ZEND_ACC_PUBLIC | ZEND_ACC_STATIC)
+	PHP_ME(Lapack, singularValuesBatch,			lapack_values_batch_args, ZEND_ACC_PUBLIC | ZEND_ACC_STATIC)
+	PHP_ME(Lapack, luFactor,					lapack_values_args, ZEND_ACC_PUBLIC | ZEND_ACC_STATIC)
+	PHP_ME(Lapack, qrFactor,					lapack_values_args, ZEND_ACC_PUBLIC | ZEND_ACC_STATIC)
+	PHP_ME(Lapack, choleskyFactor,				lapack_values_args, ZEND_ACC_PUBLIC | ZEND_ACC_STATIC)
+	PHP_ME(Lapack, async,						lapack_async_args, ZEND_ACC_PUBLIC | ZEND_ACC_STATIC)
+	PHP_ME(Lapack, cacheStore,					lapack_cache_store_args, ZEND_ACC_PUBLIC | ZEND_ACC_STATIC)
+	PHP_ME(Lapack, cacheFetch,					lapack_cache_fetch_args, ZEND_ACC_PUBLIC | ZEND_ACC_STATIC)
+	PHP_ME(Lapack, setThreads,					lapack_threads_args, ZEND_ACC_PUBLIC | ZEND_ACC_STATIC)
+	PHP_ME(Lapack, stats,						lapack_no_args, ZEND_ACC_PUBLIC | ZEND_ACC_STATIC)
+	PHP_ME(Lapack, resetStats,					lapack_no_args, ZEND_ACC_PUBLIC | ZEND_ACC_STATIC)
+	PHP_FE_END
 };
 
+/* {{{ static ZEND_INI_MH(OnUpdateLapackPrecision)
+Accept "double", "single" or "mixed" for lapack.precision.
+*/
+static ZEND_INI_MH(OnUpdateLapackPrecision)
+{
+	if (zend_string_equals_literal_ci(new_value, "double")) {
+		LAPACK_G(precision) = PHP_LAPACK_DOUBLE;
+	} else if (zend_string_equals_literal_ci(new_value, "single")) {
+		LAPACK_G(precision) = PHP_LAPACK_SINGLE;
+	} else if (zend_string_equals_literal_ci(new_value, "mixed")) {
+		LAPACK_G(precision) = PHP_LAPACK_MIXED;
+	} else {
+		return FAILURE;
+	}
+	
+	return SUCCESS;
+}
+/* }}} */
+
+PHP_INI_BEGIN()
+	PHP_INI_ENTRY("lapack.precision", "double", PHP_INI_ALL, OnUpdateLapackPrecision)
+	STD_PHP_INI_ENTRY("lapack.max_threads", "0", PHP_INI_ALL, OnUpdateLong, max_threads, zend_lapack_globals, lapack_globals)
+	STD_PHP_INI_ENTRY("lapack.parallel_threshold", "1000000", PHP_INI_ALL, OnUpdateLong, parallel_threshold, zend_lapack_globals, lapack_globals)
+	STD_PHP_INI_ENTRY("lapack.trace_threshold", "0", PHP_INI_ALL, OnUpdateLong, trace_threshold, zend_lapack_globals, lapack_globals)
+	STD_PHP_INI_ENTRY("lapack.cache_size", "0", PHP_INI_SYSTEM, OnUpdateLong, cache_size, zend_lapack_globals, lapack_globals)
+PHP_INI_END()
+
+static PHP_GINIT_FUNCTION(lapack)
+{
+#if defined(COMPILE_DL_LAPACK) && defined(ZTS)
+	ZEND_TSRMLS_CACHE_UPDATE();
+#endif
+	lapack_globals->precision = PHP_LAPACK_DOUBLE;
+	lapack_globals->max_threads = 0;
+	lapack_globals->parallel_threshold = 1000000;
+	lapack_globals->blas_threads = 0;
+	lapack_globals->stats = NULL;
+	lapack_globals->stats_depth = 0;
+	lapack_globals->trace_threshold = 0;
+	lapack_globals->cache_size = 0;
+}
+
 PHP_MINIT_FUNCTION(lapack)
 {
 	zend_class_entry ce;
+	REGISTER_INI_ENTRIES();
+	php_lapack_blas_threads_init();
+	
 	memcpy(&lapack_object_handlers, zend_get_std_object_handlers(), sizeof(zend_object_handlers));
 
 	INIT_CLASS_ENTRY(ce, "Lapack", php_lapack_class_methods);
 	ce.create_object = NULL;
 	lapack_object_handlers.clone_obj = NULL;
-	php_lapack_sc_entry = zend_register_internal_class(&ce TSRMLS_CC);
+	php_lapack_sc_entry = zend_register_internal_class(&ce);
+	
+	/* Structure hints for solveLinearEquation, inverse and eigenValues */
+	zend_declare_class_constant_long(php_lapack_sc_entry, "AUTO", sizeof("AUTO")-1, PHP_LAPACK_AUTO);
+	zend_declare_class_constant_long(php_lapack_sc_entry, "GENERAL", sizeof("GENERAL")-1, PHP_LAPACK_GENERAL);
+	zend_declare_class_constant_long(php_lapack_sc_entry, "SYMMETRIC", sizeof("SYMMETRIC")-1, PHP_LAPACK_SYMMETRIC);
+	zend_declare_class_constant_long(php_lapack_sc_entry, "POSITIVE_DEFINITE", sizeof("POSITIVE_DEFINITE")-1, PHP_LAPACK_POSITIVE_DEFINITE);
+	zend_declare_class_constant_long(php_lapack_sc_entry, "UPPER_TRIANGULAR", sizeof("UPPER_TRIANGULAR")-1, PHP_LAPACK_UPPER_TRIANGULAR);
+	zend_declare_class_constant_long(php_lapack_sc_entry, "LOWER_TRIANGULAR", sizeof("LOWER_TRIANGULAR")-1, PHP_LAPACK_LOWER_TRIANGULAR);
+	zend_declare_class_constant_long(php_lapack_sc_entry, "BANDED", sizeof("BANDED")-1, PHP_LAPACK_BANDED);
+	zend_declare_class_constant_long(php_lapack_sc_entry, "SVD_EXACT", sizeof("SVD_EXACT")-1, PHP_LAPACK_SVD_EXACT);
+	zend_declare_class_constant_long(php_lapack_sc_entry, "SVD_RANDOMIZED", sizeof("SVD_RANDOMIZED")-1, PHP_LAPACK_SVD_RANDOMIZED);
+	zend_declare_class_constant_long(php_lapack_sc_entry, "PRECONDITION_NONE", sizeof("PRECONDITION_NONE")-1, PHP_LAPACK_PRECONDITION_NONE);
+	zend_declare_class_constant_long(php_lapack_sc_entry, "PRECONDITION_JACOBI", sizeof("PRECONDITION_JACOBI")-1, PHP_LAPACK_PRECONDITION_JACOBI);
+	zend_declare_class_constant_long(php_lapack_sc_entry, "PRECONDITION_ILU0", sizeof("PRECONDITION_ILU0")-1, PHP_LAPACK_PRECONDITION_ILU0);
+	
+	PHP_MINIT(lapack_matrix)(INIT_FUNC_ARGS_PASSTHRU);
+	PHP_MINIT(lapack_factor)(INIT_FUNC_ARGS_PASSTHRU);
+	PHP_MINIT(lapack_shape)(INIT_FUNC_ARGS_PASSTHRU);
+	PHP_MINIT(lapack_lsq)(INIT_FUNC_ARGS_PASSTHRU);
+	PHP_MINIT(lapack_async)(INIT_FUNC_ARGS_PASSTHRU);
+	PHP_MINIT(lapack_sparse)(INIT_FUNC_ARGS_PASSTHRU);
+	PHP_MINIT(lapack_cache)(INIT_FUNC_ARGS_PASSTHRU);
 	
 	INIT_CLASS_ENTRY(ce, "Lapackexception", NULL);
-	php_lapack_exception_sc_entry = zend_register_internal_class_ex(&ce, zend_exception_get_default(TSRMLS_C), NULL TSRMLS_CC);
+	php_lapack_exception_sc_entry = zend_register_internal_class_ex(&ce, zend_ce_exception);
 	php_lapack_exception_sc_entry->ce_flags |= ZEND_ACC_FINAL;
 
+	/* Once every class is registered, count calls to their methods */
+	php_lapack_stats_startup();
+
 	return SUCCESS;
 }
 
 PHP_MSHUTDOWN_FUNCTION(lapack)
 {
 	UNREGISTER_INI_ENTRIES();
+	php_lapack_stats_shutdown();
+	php_lapack_cache_shutdown();
+	return SUCCESS;
+}
+
+PHP_RSHUTDOWN_FUNCTION(lapack)
+{
+	php_lapack_arena_release();
+	php_lapack_stats_request_end();
+	LAPACK_G(stats_depth) = 0;
 	return SUCCESS;
 }
 
 PHP_MINFO_FUNCTION(lapack)
 {
+	char threads[32];
+	
 	php_info_print_table_start();
 		php_info_print_table_header(2, "LAPACK extension", "enabled");
 		php_info_print_table_row(2, "LAPACK extension version", PHP_LAPACK_EXTVER);
+		php_info_print_table_row(2, "LAPACK integer width", sizeof(lapack_int) == 8 ? "64-bit (ILP64)" : "32-bit (LP64)");
+		php_info_print_table_row(2, "BLAS threading backend", php_lapack_blas_backend());
+		if (php_lapack_blas_threads() > 0) {
+			snprintf(threads, sizeof(threads), "%d", php_lapack_blas_threads());
+			php_info_print_table_row(2, "BLAS threads", threads);
+		}
 	php_info_print_table_end();
 
+	php_lapack_stats_info_table();
+	php_lapack_cache_info_table();
+
 	DISPLAY_INI_ENTRIES();
 }
 
 /* No global functions */
-zend_function_entry lapack_functions[] = {
-	{NULL, NULL, NULL} 
+static const zend_function_entry lapack_functions[] = {
+	PHP_FE_END
 };
 
 zend_module_entry lapack_module_entry =
@@ -761,13 +1572,20 @@ zend_module_entry lapack_module_entry =
 	PHP_MINIT(lapack),				/* MINIT */
 	PHP_MSHUTDOWN(lapack),			/* MSHUTDOWN */
 	NULL,						/* RINIT */
-	NULL,						/* RSHUTDOWN */
+	PHP_RSHUTDOWN(lapack),			/* RSHUTDOWN */
 	PHP_MINFO(lapack),				/* MINFO */
 	PHP_LAPACK_EXTVER,				/* version */
-	STANDARD_MODULE_PROPERTIES
+	PHP_MODULE_GLOBALS(lapack),		/* globals */
+	PHP_GINIT(lapack),				/* GINIT */
+	NULL,						/* GSHUTDOWN */
+	NULL,						/* post deactivate */
+	STANDARD_MODULE_PROPERTIES_EX
 };
 
 
 #ifdef COMPILE_DL_LAPACK
+# ifdef ZTS
+ZEND_TSRMLS_CACHE_DEFINE()
+# endif
 ZEND_GET_MODULE(lapack)
 #endif /* COMPILE_DL_LAPACK */
@@ -0,0 +1,206 @@
+/*
+  +----------------------------------------------------------------------+
+  | PHP Version 5 / lapack                                               |
+  +----------------------------------------------------------------------+
+  | Copyright (c) 2012 Ian Barber                                        |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 3.0 of the PHP license,       |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.php.net/license/3_0.txt.                                  |
+  | If you did not receive a copy of the PHP license and are unable to   |
+  | obtain it through the world-wide-web, please send a note to          |
+  | license@php.net so we can mail you a copy immediately.               |
+  +----------------------------------------------------------------------+
+  | Authors: Ian Barber <ian.barber@gmail.com>                           |
+  +----------------------------------------------------------------------+
+*/
+
+#include "php_lapack.h"
+#include "php_lapack_internal.h"
+
+#include <float.h>
+
+/*
+ * Workspace for the temporaries of a single Lapack call.
+ *
+ * Every method starts with php_lapack_arena_begin(), which forgets whatever
+ * the previous call took, and then carves its pivots, singular values,
+ * LAPACK work arrays and so on out of one block with
+ * php_lapack_arena_alloc(). Nothing taken from the arena is ever freed on
+ * its own, so an exception thrown half way through a method cannot leak it.
+ * When a call needs more than the block holds, the rest comes from overflow
+ * allocations and the block is grown to the high-water mark at the next
+ * begin, so after the first few calls a method allocates nothing at all.
+ *
+ * The arena lives in the module globals, so it is per thread under ZTS, and
+ * is released at the end of each request.
+ *
+ * The optimal LAPACK workspace sizes (the lwork = -1 queries) depend only on
+ * the routine and the problem shape, and are kept across requests in a small
+ * direct mapped cache.
+ */
+
+typedef struct _php_lapack_arena_chunk {
+	struct _php_lapack_arena_chunk *next;
+} php_lapack_arena_chunk;
+
+#define PHP_LAPACK_ARENA_ROUND(size) \
+	(((size) + PHP_LAPACK_ALIGNMENT - 1) & ~((size_t)PHP_LAPACK_ALIGNMENT - 1))
+
+#define PHP_LAPACK_ARENA_ALIGN(ptr) \
+	((char *)(((zend_uintptr_t)(ptr) + PHP_LAPACK_ALIGNMENT - 1) & ~((zend_uintptr_t)PHP_LAPACK_ALIGNMENT - 1)))
+
+/* {{{ static void php_lapack_arena_free_overflow(void)
+Release the overflow chunks of the last call.
+*/
+static void php_lapack_arena_free_overflow(void)
+{
+	php_lapack_arena_chunk *chunk, *next;
+
+	for (chunk = LAPACK_G(arena_overflow); chunk != NULL; chunk = next) {
+		next = chunk->next;
+		efree(chunk);
+	}
+	LAPACK_G(arena_overflow) = NULL;
+}
+/* }}} */
+
+/* {{{ void php_lapack_arena_begin(void)
+Start a new call, dropping everything allocated by the previous one. If the
+previous call overflowed the block, the block is regrown to fit it whole.
+*/
+void php_lapack_arena_begin(void)
+{
+	php_lapack_arena_free_overflow();
+
+	if (LAPACK_G(arena_peak) > LAPACK_G(arena_size)) {
+		if (LAPACK_G(arena) != NULL) {
+			efree(LAPACK_G(arena));
+		}
+		LAPACK_G(arena_size) = LAPACK_G(arena_peak);
+		LAPACK_G(arena) = emalloc(LAPACK_G(arena_size) + PHP_LAPACK_ALIGNMENT);
+	}
+
+	LAPACK_G(arena_used) = 0;
+	LAPACK_G(arena_peak) = 0;
+}
+/* }}} */
+
+/* {{{ void* php_lapack_arena_alloc(size_t count, size_t size)
+Return uninitialised, PHP_LAPACK_ALIGNMENT aligned room for count elements
+of size bytes, valid until the next php_lapack_arena_begin().
+*/
+void* php_lapack_arena_alloc(size_t count, size_t size)
+{
+	php_lapack_arena_chunk *chunk;
+	size_t bytes;
+	char *base;
+
+	bytes = PHP_LAPACK_ARENA_ROUND(zend_safe_address_guarded(count, size, 0));
+	if (bytes == 0) {
+		bytes = PHP_LAPACK_ALIGNMENT;
+	}
+	LAPACK_G(arena_peak) += bytes;
+	if (LAPACK_G(arena_peak) > LAPACK_G(stats_workspace)) {
+		LAPACK_G(stats_workspace) = LAPACK_G(arena_peak);
+	}
+
+	if (LAPACK_G(arena) != NULL && LAPACK_G(arena_used) + bytes <= LAPACK_G(arena_size)) {
+		base = PHP_LAPACK_ARENA_ALIGN(LAPACK_G(arena)) + LAPACK_G(arena_used);
+		LAPACK_G(arena_used) += bytes;
+		return base;
+	}
+
+	chunk = emalloc(sizeof(php_lapack_arena_chunk) + PHP_LAPACK_ALIGNMENT + bytes);
+	chunk->next = LAPACK_G(arena_overflow);
+	LAPACK_G(arena_overflow) = chunk;
+
+	return PHP_LAPACK_ARENA_ALIGN((char *)(chunk + 1));
+}
+/* }}} */
+
+/* {{{ void php_lapack_arena_release(void)
+Free the arena entirely, at the end of the request.
+*/
+void php_lapack_arena_release(void)
+{
+	php_lapack_arena_free_overflow();
+
+	if (LAPACK_G(arena) != NULL) {
+		efree(LAPACK_G(arena));
+	}
+	LAPACK_G(arena) = NULL;
+	LAPACK_G(arena_size) = 0;
+	LAPACK_G(arena_used) = 0;
+	LAPACK_G(arena_peak) = 0;
+}
+/* }}} */
+
+/* {{{ static php_lapack_lwork_entry* php_lapack_lwork_slot(int routine, int m, int n, int k)
+The cache slot for a routine and problem shape.
+*/
+static php_lapack_lwork_entry* php_lapack_lwork_slot(int routine, int m, int n, int k)
+{
+	zend_ulong h;
+
+	h = (zend_ulong)routine * 0x9E3779B1u;
+	h = (h ^ (zend_ulong)m) * 0x85EBCA6Bu;
+	h = (h ^ (zend_ulong)n) * 0xC2B2AE35u;
+	h = (h ^ (zend_ulong)k) * 0x27D4EB2Fu;
+
+	return &LAPACK_G(lwork_cache)[(h >> 7) & (PHP_LAPACK_LWORK_CACHE - 1)];
+}
+/* }}} */
+
+/* {{{ int php_lapack_lwork_get(int routine, int m, int n, int k, size_t *lwork, size_t *liwork)
+Look up the workspace sizes stored for routine on an m, n, k problem.
+Returns SUCCESS when they were found. liwork may be NULL.
+*/
+int php_lapack_lwork_get(int routine, int m, int n, int k, size_t *lwork, size_t *liwork)
+{
+	php_lapack_lwork_entry *entry = php_lapack_lwork_slot(routine, m, n, k);
+
+	if (entry->routine != routine || entry->m != m || entry->n != n || entry->k != k) {
+		return FAILURE;
+	}
+
+	*lwork = entry->lwork;
+	if (liwork != NULL) {
+		*liwork = entry->liwork;
+	}
+
+	return SUCCESS;
+}
+/* }}} */
+
+/* {{{ void php_lapack_lwork_set(int routine, int m, int n, int k, double query, lapack_int iquery, size_t *lwork, size_t *liwork)
+Store the result of a workspace query, as LAPACK returns it in the first
+element of work and iwork, and hand back the sizes to allocate as
+php_lapack_lwork_get would. liwork may be NULL.
+*/
+void php_lapack_lwork_set(int routine, int m, int n, int k, double query, lapack_int iquery, size_t *lwork, size_t *liwork)
+{
+	php_lapack_lwork_entry *entry = php_lapack_lwork_slot(routine, m, n, k);
+
+	entry->routine = routine;
+	entry->m = m;
+	entry->n = n;
+	entry->k = k;
+	/* The size comes back as a floating point value and may have been
+	   rounded down on the way, so allow a little extra */
+	entry->lwork = query > 1.0 ? (size_t)(query * (1.0 + DBL_EPSILON)) + 1 : 1;
+	entry->liwork = iquery > 1 ? (size_t)iquery : 1;
+	/* Callers pass lwork on as a lapack_int. With a 32-bit lapack_int the
+	   optimum for a very large problem does not fit, so ask for the most that
+	   does: the routines either make do with it or reject it with info < 0 */
+	if (entry->lwork > PHP_LAPACK_INT_MAX) {
+		entry->lwork = PHP_LAPACK_INT_MAX;
+	}
+
+	*lwork = entry->lwork;
+	if (liwork != NULL) {
+		*liwork = entry->liwork;
+	}
+}
+/* }}} */
@@ -0,0 +1,401 @@
+/*
+  +----------------------------------------------------------------------+
+  | PHP Version 5 / lapack                                               |
+  +----------------------------------------------------------------------+
+  | Copyright (c) 2012 Ian Barber                                        |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 3.0 of the PHP license,       |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.php.net/license/3_0.txt.                                  |
+  | If you did not receive a copy of the PHP license and are unable to   |
+  | obtain it through the world-wide-web, please send a note to          |
+  | license@php.net so we can mail you a copy immediately.               |
+  +----------------------------------------------------------------------+
+  | Authors: Ian Barber <ian.barber@gmail.com>                           |
+  +----------------------------------------------------------------------+
+*/
+
+#include "php_lapack.h"
+#include "php_lapack_internal.h"
+#include "Zend/zend_exceptions.h"
+
+#include <pthread.h>
+
+/*
+ * Asynchronous calls. Lapack::async() converts the operands on the calling
+ * thread, starts the LAPACK driver on a native thread of its own and returns
+ * a LapackFuture straight away, so the request can get on with other work.
+ * As in the batched drivers, the thread never touches the engine: it only
+ * sees the plain buffers filled in before it started, and uses the LAPACKE
+ * drivers that allocate their own workspace with malloc. The result is
+ * converted back on the calling thread by LapackFuture::wait().
+ *
+ * A future that is destroyed while its thread is still running waits for it
+ * first, as the thread writes into buffers the future owns. The BLAS thread
+ * count is sized for the call before the thread starts and pinned until it
+ * is joined, so nothing resizes the backend while the thread may be in it.
+ */
+
+#define PHP_LAPACK_FUTURE_SOLVE		1
+#define PHP_LAPACK_FUTURE_LLS		2
+#define PHP_LAPACK_FUTURE_LLS_SVD	3
+#define PHP_LAPACK_FUTURE_SVD		4
+
+typedef struct _php_lapack_future_object {
+	int kind;				/* 0 until the future is started */
+	double *a;				/* m x n, overwritten by the driver */
+	double *b;				/* ldb x nrhs right hand sides and solution */
+	double *s;				/* singular values */
+	lapack_int *ipiv;
+	lapack_int m;
+	lapack_int n;
+	lapack_int nrhs;
+	lapack_int ldb;
+	lapack_int info;
+	zend_bool as_matrix;
+	zend_bool running;		/* the thread has been started and not joined */
+	int done;				/* set by the thread once info is written */
+	pthread_t thread;
+	zval result;			/* UNDEF until collected by wait() */
+	zend_object std;
+} php_lapack_future_object;
+
+static inline php_lapack_future_object *php_lapack_future_from_obj(zend_object *obj) {
+	return (php_lapack_future_object *)((char *)(obj) - XtOffsetOf(php_lapack_future_object, std));
+}
+
+#define Z_LAPACK_FUTURE_P(zv) php_lapack_future_from_obj(Z_OBJ_P(zv))
+
+static zend_class_entry *php_lapack_future_sc_entry;
+static zend_object_handlers lapack_future_object_handlers;
+
+/* --- Helper Functions --- */
+
+/* {{{ static php_lapack_future_object* php_lapack_future_fetch(zval *object)
+Return the future behind object, or throw if it was never started.
+*/
+static php_lapack_future_object* php_lapack_future_fetch(zval *object)
+{
+	php_lapack_future_object *intern = Z_LAPACK_FUTURE_P(object);
+
+	if (intern->kind == 0) {
+		zend_throw_exception(php_lapack_exception_sc_entry, "Future is not initialised", 104);
+		return NULL;
+	}
+
+	return intern;
+}
+/* }}} */
+
+/* {{{ static int php_lapack_future_kind(zend_string *method)
+The driver for a method name, or 0 if it cannot be run asynchronously.
+*/
+static int php_lapack_future_kind(zend_string *method)
+{
+	if (zend_string_equals_literal_ci(method, "solveLinearEquation")) {
+		return PHP_LAPACK_FUTURE_SOLVE;
+	} else if (zend_string_equals_literal_ci(method, "leastSquaresByFactorisation")) {
+		return PHP_LAPACK_FUTURE_LLS;
+	} else if (zend_string_equals_literal_ci(method, "leastSquaresBySVD")) {
+		return PHP_LAPACK_FUTURE_LLS_SVD;
+	} else if (zend_string_equals_literal_ci(method, "singularValues")) {
+		return PHP_LAPACK_FUTURE_SVD;
+	}
+
+	return 0;
+}
+/* }}} */
+
+/* {{{ static void* php_lapack_future_run(void *arg)
+Run the driver of a future. This is the body of the future's thread.
+*/
+static void* php_lapack_future_run(void *arg)
+{
+	php_lapack_future_object *intern = (php_lapack_future_object *)arg;
+	lapack_int rank;
+	double u, vt;
+
+	switch (intern->kind) {
+		case PHP_LAPACK_FUTURE_SOLVE:
+			intern->info = LAPACKE_dgesv( LAPACK_COL_MAJOR, intern->n, intern->nrhs, intern->a, intern->n,
+										  intern->ipiv, intern->b, intern->ldb );
+			break;
+
+		case PHP_LAPACK_FUTURE_LLS:
+			intern->info = LAPACKE_dgels( LAPACK_COL_MAJOR, 'N', intern->m, intern->n, intern->nrhs,
+										  intern->a, intern->m, intern->b, intern->ldb );
+			break;
+
+		case PHP_LAPACK_FUTURE_LLS_SVD:
+			/* Negative rcond means using default (machine precision) value */
+			intern->info = LAPACKE_dgelsd( LAPACK_COL_MAJOR, intern->m, intern->n, intern->nrhs,
+										   intern->a, intern->m, intern->b, intern->ldb, intern->s, -1.0, &rank );
+			break;
+
+		default:
+			intern->info = LAPACKE_dgesdd( LAPACK_COL_MAJOR, 'N', intern->m, intern->n, intern->a, intern->m,
+										   intern->s, &u, 1, &vt, 1 );
+			break;
+	}
+
+	__sync_lock_test_and_set(&intern->done, 1);
+
+	return NULL;
+}
+/* }}} */
+
+/* {{{ static void php_lapack_future_join(php_lapack_future_object *intern)
+Wait for the thread of a future to finish, if it is still running, and
+release its pin on the BLAS thread count.
+*/
+static void php_lapack_future_join(php_lapack_future_object *intern)
+{
+	if (intern->running) {
+		pthread_join(intern->thread, NULL);
+		intern->running = 0;
+		php_lapack_blas_unpin();
+	}
+}
+/* }}} */
+
+/* {{{ static void php_lapack_future_release(php_lapack_future_object *intern)
+Free the working buffers of a future whose thread has finished.
+*/
+static void php_lapack_future_release(php_lapack_future_object *intern)
+{
+	php_lapack_free(intern->a);
+	php_lapack_free(intern->b);
+	php_lapack_free(intern->s);
+	if (intern->ipiv != NULL) {
+		efree(intern->ipiv);
+	}
+	intern->a = intern->b = intern->s = NULL;
+	intern->ipiv = NULL;
+}
+/* }}} */
+
+/* {{{ static void php_lapack_future_collect(php_lapack_future_object *intern)
+Convert the output of a finished future into its result, which is what the
+synchronous method would have returned.
+*/
+static void php_lapack_future_collect(php_lapack_future_object *intern)
+{
+	php_lapack_stats_info(intern->info);
+
+	if (intern->info != 0) {
+		/* solveLinearEquation returns an empty array, the others nothing */
+		if (intern->kind == PHP_LAPACK_FUTURE_SOLVE) {
+			array_init(&intern->result);
+		} else {
+			ZVAL_NULL(&intern->result);
+		}
+	} else if (intern->kind == PHP_LAPACK_FUTURE_SVD) {
+		php_lapack_return_matrix(&intern->result, &intern->s, 1, (intern->n < intern->m ? intern->n : intern->m), 1, intern->as_matrix);
+	} else {
+		php_lapack_return_matrix(&intern->result, &intern->b, intern->n, intern->nrhs, intern->ldb, intern->as_matrix);
+	}
+
+	php_lapack_future_release(intern);
+}
+/* }}} */
+
+/* --- Object Handlers --- */
+
+static void php_lapack_future_object_free(zend_object *object)
+{
+	php_lapack_future_object *intern = php_lapack_future_from_obj(object);
+
+	php_lapack_future_join(intern);
+	php_lapack_future_release(intern);
+	zval_ptr_dtor(&intern->result);
+	zend_object_std_dtor(&intern->std);
+}
+
+static zend_object *php_lapack_future_object_new(zend_class_entry *class_type)
+{
+	php_lapack_future_object *intern;
+
+	intern = zend_object_alloc(sizeof(php_lapack_future_object), class_type);
+	intern->kind = 0;
+	intern->a = intern->b = intern->s = NULL;
+	intern->ipiv = NULL;
+	intern->m = intern->n = intern->nrhs = intern->ldb = 0;
+	intern->info = 0;
+	intern->as_matrix = 0;
+	intern->running = 0;
+	intern->done = 0;
+	ZVAL_UNDEF(&intern->result);
+
+	zend_object_std_init(&intern->std, class_type);
+	object_properties_init(&intern->std, class_type);
+	intern->std.handlers = &lapack_future_object_handlers;
+
+	return &intern->std;
+}
+
+/* --- Lapack Methods --- */
+
+/* {{{ LapackFuture Lapack::async(string method, mixed ...args);
+Start method with args on a background thread and return a LapackFuture for
+its result. The method can be solveLinearEquation (with no structure hint,
+A is always solved with dgesv), leastSquaresByFactorisation,
+leastSquaresBySVD or singularValues, and the arguments are the ones the
+method takes. Invalid operands throw here, with the method's own messages.
+Asynchronous calls always run in double precision.
+*/
+PHP_METHOD(Lapack, async)
+{
+	zend_string *method;
+	zval *args = NULL;
+	int argc = 0, kind, m, n, mb = 0, nrhs = 0;
+	zend_bool as_matrix = 0;
+	php_lapack_future_object *intern;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS(), "S*", &method, &args, &argc) == FAILURE) {
+		return;
+	}
+
+	kind = php_lapack_future_kind(method);
+	if (kind == 0) {
+		LAPACK_THROW("Invalid method - must be solveLinearEquation, leastSquaresByFactorisation, leastSquaresBySVD or singularValues", 102);
+	}
+	if (argc != (kind == PHP_LAPACK_FUTURE_SVD ? 1 : 2)) {
+		LAPACK_THROW("Invalid arguments - wrong number of arguments for the method", 102);
+	}
+
+	if (php_lapack_operand_shape(&args[0], &m, &n, &as_matrix) == FAILURE) {
+		LAPACK_THROW(kind == PHP_LAPACK_FUTURE_SVD ? "Invalid input matrix" : "Invalid input matrix - argument 1", 102);
+	}
+	if (kind == PHP_LAPACK_FUTURE_SOLVE && m != n) {
+		LAPACK_THROW("Matrix must be square", 103);
+	}
+	if (kind != PHP_LAPACK_FUTURE_SVD
+			&& (php_lapack_operand_shape(&args[1], &mb, &nrhs, &as_matrix) == FAILURE || mb != m)) {
+		LAPACK_THROW("Invalid input matrix - argument 2", 102);
+	}
+
+	object_init_ex(return_value, php_lapack_future_sc_entry);
+	intern = Z_LAPACK_FUTURE_P(return_value);
+	intern->kind = kind;
+	intern->m = m;
+	intern->n = n;
+	intern->nrhs = nrhs;
+	intern->as_matrix = as_matrix;
+
+	/* Arrays have been checked by their shape, but a row can still be short */
+	intern->a = php_lapack_alloc((size_t)m * n);
+	if (php_lapack_linearize_operand_into(&args[0], intern->a, m, n, m) == FAILURE) {
+		zval_ptr_dtor(return_value);
+		ZVAL_NULL(return_value);
+		LAPACK_THROW(kind == PHP_LAPACK_FUTURE_SVD ? "Invalid input matrix" : "Invalid input matrix - argument 1", 102);
+	}
+
+	if (kind == PHP_LAPACK_FUTURE_SVD) {
+		intern->s = php_lapack_alloc(m < n ? m : n);
+	} else {
+		/* The solution of a least squares problem is n rows, in B's place */
+		intern->ldb = m > n ? m : n;
+		intern->b = php_lapack_alloc((size_t)intern->ldb * nrhs);
+		if (php_lapack_linearize_operand_into(&args[1], intern->b, m, nrhs, intern->ldb) == FAILURE) {
+			zval_ptr_dtor(return_value);
+			ZVAL_NULL(return_value);
+			LAPACK_THROW("Invalid input matrix - argument 2", 102);
+		}
+		if (kind == PHP_LAPACK_FUTURE_SOLVE) {
+			intern->ipiv = safe_emalloc(n, sizeof(lapack_int), 0);
+		} else if (kind == PHP_LAPACK_FUTURE_LLS_SVD) {
+			intern->s = php_lapack_alloc(m < n ? m : n);
+		}
+	}
+
+	php_lapack_blas_threads_for((double)m * n * (kind == PHP_LAPACK_FUTURE_SVD ? (m < n ? m : n) : n + nrhs));
+
+	php_lapack_blas_pin();
+	if (pthread_create(&intern->thread, NULL, php_lapack_future_run, intern) == 0) {
+		intern->running = 1;
+	} else {
+		/* No thread to be had, so the future is ready when returned */
+		php_lapack_blas_unpin();
+		php_lapack_future_run(intern);
+	}
+
+	return;
+}
+/* }}} */
+
+/* --- LapackFuture Methods --- */
+
+/* {{{ bool LapackFuture::isReady();
+Whether the result is available, so that wait() will not block.
+*/
+PHP_METHOD(LapackFuture, isReady)
+{
+	php_lapack_future_object *intern;
+
+	if (zend_parse_parameters_none() == FAILURE) {
+		return;
+	}
+
+	if ((intern = php_lapack_future_fetch(getThis())) == NULL) {
+		return;
+	}
+
+	RETURN_BOOL(__sync_fetch_and_add(&intern->done, 0));
+}
+/* }}} */
+
+/* {{{ mixed LapackFuture::wait();
+Block until the call has finished and return its result, exactly as the
+synchronous method would have. Later calls return the same result.
+*/
+PHP_METHOD(LapackFuture, wait)
+{
+	php_lapack_future_object *intern;
+
+	if (zend_parse_parameters_none() == FAILURE) {
+		return;
+	}
+
+	if ((intern = php_lapack_future_fetch(getThis())) == NULL) {
+		return;
+	}
+
+	if (Z_TYPE(intern->result) == IS_UNDEF) {
+		php_lapack_future_join(intern);
+		php_lapack_future_collect(intern);
+	}
+
+	ZVAL_COPY(return_value, &intern->result);
+
+	return;
+}
+/* }}} */
+
+/* --- ARGUMENTS AND INIT --- */
+
+ZEND_BEGIN_ARG_INFO_EX(lapack_future_empty_args, 0, 0, 0)
+ZEND_END_ARG_INFO()
+
+static const zend_function_entry php_lapack_future_class_methods[] =
+{
+	PHP_ME(LapackFuture, isReady,	lapack_future_empty_args, ZEND_ACC_PUBLIC)
+	PHP_ME(LapackFuture, wait,		lapack_future_empty_args, ZEND_ACC_PUBLIC)
+	PHP_FE_END
+};
+
+PHP_MINIT_FUNCTION(lapack_async)
+{
+	zend_class_entry ce;
+	memcpy(&lapack_future_object_handlers, zend_get_std_object_handlers(), sizeof(zend_object_handlers));
+	lapack_future_object_handlers.offset = XtOffsetOf(php_lapack_future_object, std);
+	lapack_future_object_handlers.free_obj = php_lapack_future_object_free;
+	lapack_future_object_handlers.clone_obj = NULL;
+
+	INIT_CLASS_ENTRY(ce, "LapackFuture", php_lapack_future_class_methods);
+	ce.create_object = php_lapack_future_object_new;
+	php_lapack_future_sc_entry = zend_register_internal_class(&ce);
+	php_lapack_future_sc_entry->ce_flags |= ZEND_ACC_FINAL;
+
+	return SUCCESS;
+}
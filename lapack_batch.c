@@ -0,0 +1,343 @@
+/*
+  +----------------------------------------------------------------------+
+  | PHP Version 5 / lapack                                               |
+  +----------------------------------------------------------------------+
+  | Copyright (c) 2012 Ian Barber                                        |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 3.0 of the PHP license,       |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.php.net/license/3_0.txt.                                  |
+  | If you did not receive a copy of the PHP license and are unable to   |
+  | obtain it through the world-wide-web, please send a note to          |
+  | license@php.net so we can mail you a copy immediately.               |
+  +----------------------------------------------------------------------+
+  | Authors: Ian Barber <ian.barber@gmail.com>                           |
+  +----------------------------------------------------------------------+
+*/
+
+#include "php_lapack.h"
+#include "php_lapack_internal.h"
+#include "Zend/zend_exceptions.h"
+
+/*
+ * Batched drivers: many small independent problems are linearized into one
+ * contiguous arena on the calling thread, solved in parallel on the native
+ * thread pool, then reassembled in the order they were given.
+ */
+
+#define PHP_LAPACK_BATCH_SOLVE	1
+#define PHP_LAPACK_BATCH_LLS	2
+#define PHP_LAPACK_BATCH_SVD	3
+
+/* Problems start on a fresh cache line so threads do not share lines */
+#define PHP_LAPACK_BATCH_ROUND(count) (((count) + 7) & ~(size_t)7)
+
+typedef struct _php_lapack_batch_problem {
+	double *a;
+	double *b;			/* right hand sides, or the singular values */
+	lapack_int *ipiv;
+	lapack_int m, n, nrhs, ldb;
+	lapack_int info;
+	zend_bool as_matrix;
+} php_lapack_batch_problem;
+
+/* --- Tasks, run on the pool threads --- */
+
+static void php_lapack_batch_solve_task(void *ctx, size_t task)
+{
+	php_lapack_batch_problem *p = (php_lapack_batch_problem *)ctx + task;
+
+	p->info = LAPACKE_dgesv_work( LAPACK_COL_MAJOR, p->n, p->nrhs, p->a, p->n, p->ipiv, p->b, p->ldb );
+}
+
+static void php_lapack_batch_lls_task(void *ctx, size_t task)
+{
+	php_lapack_batch_problem *p = (php_lapack_batch_problem *)ctx + task;
+
+	p->info = LAPACKE_dgels( LAPACK_COL_MAJOR, 'N', p->m, p->n, p->nrhs, p->a, p->m, p->b, p->ldb );
+}
+
+static void php_lapack_batch_svd_task(void *ctx, size_t task)
+{
+	php_lapack_batch_problem *p = (php_lapack_batch_problem *)ctx + task;
+	double u, vt;
+
+	/* Values only, so U and VT are never referenced */
+	p->info = LAPACKE_dgesdd( LAPACK_COL_MAJOR, 'N', p->m, p->n, p->a, p->m, p->b, &u, 1, &vt, 1 );
+}
+
+/* --- Helper Functions --- */
+
+/* {{{ static zval** php_lapack_batch_values(HashTable *ht)
+Collect the values of a batch argument so that two of them can be walked
+side by side.
+*/
+static zval** php_lapack_batch_values(HashTable *ht)
+{
+	zval **values, *val;
+	size_t k = 0;
+
+	values = safe_emalloc(zend_hash_num_elements(ht), sizeof(zval *), 0);
+	ZEND_HASH_FOREACH_VAL(ht, val) {
+		ZVAL_DEREF(val);
+		values[k++] = val;
+	} ZEND_HASH_FOREACH_END();
+
+	return values;
+}
+/* }}} */
+
+/* {{{ static void php_lapack_batch_result(zval *out, double *data, int m, int n, int ld, zend_bool as_matrix)
+Return one result from the arena, copying it out if it becomes a LapackMatrix
+as the arena is released at the end of the call.
+*/
+static void php_lapack_batch_result(zval *out, double *data, int m, int n, int ld, zend_bool as_matrix)
+{
+	double *copy;
+	int j;
+
+	if (!as_matrix) {
+		php_lapack_reassemble_array(out, data, m, n, ld);
+		return;
+	}
+
+	copy = php_lapack_alloc((size_t)m * n);
+	for (j = 0; j < n; j++) {
+		memcpy(copy + (size_t)j * m, data + (size_t)j * ld, m * sizeof(double));
+	}
+	php_lapack_matrix_wrap(out, copy, m, n, m);
+}
+/* }}} */
+
+/* {{{ static void php_lapack_batch(INTERNAL_FUNCTION_PARAMETERS, int kind)
+Shared implementation of the batched drivers.
+*/
+static void php_lapack_batch(INTERNAL_FUNCTION_PARAMETERS, int kind)
+{
+	HashTable *as, *bs = NULL;
+	zval **avals, **bvals = NULL, *val, result;
+	zend_string *key;
+	zend_ulong h;
+	zend_long threads = 0;
+	php_lapack_batch_problem *problems, *p;
+	double *arena;
+	lapack_int *ipiv_arena;
+	size_t count, k, size, pivots;
+	int m, n, mb, nrhs, failed;
+	php_lapack_task_func task;
+
+	if (kind == PHP_LAPACK_BATCH_SVD) {
+		if (zend_parse_parameters(ZEND_NUM_ARGS(), "h|l", &as, &threads) == FAILURE) {
+			return;
+		}
+	} else {
+		if (zend_parse_parameters(ZEND_NUM_ARGS(), "hh|l", &as, &bs, &threads) == FAILURE) {
+			return;
+		}
+		if (zend_hash_num_elements(as) != zend_hash_num_elements(bs)) {
+			LAPACK_THROW("Invalid input - argument 1 and argument 2 must hold the same number of matrices", 102);
+		}
+	}
+
+	count = zend_hash_num_elements(as);
+	if (count == 0) {
+		array_init(return_value);
+		return;
+	}
+
+	avals = php_lapack_batch_values(as);
+	if (bs != NULL) {
+		bvals = php_lapack_batch_values(bs);
+	}
+	problems = ecalloc(count, sizeof(php_lapack_batch_problem));
+
+	/* First pass: shapes, and the size of the arena */
+	size = 0;
+	pivots = 0;
+	failed = 0;
+	for (k = 0; k < count && !failed; k++) {
+		p = &problems[k];
+
+		if (php_lapack_operand_shape(avals[k], &m, &n, &p->as_matrix) == FAILURE) {
+			zend_throw_exception_ex(php_lapack_exception_sc_entry, 102, "Invalid input matrix - argument 1, entry %zu", k);
+			failed = 1;
+			break;
+		}
+		p->m = m;
+		p->n = n;
+		size += PHP_LAPACK_BATCH_ROUND((size_t)m * n);
+
+		switch (kind) {
+			case PHP_LAPACK_BATCH_SOLVE:
+				if (m != n) {
+					zend_throw_exception_ex(php_lapack_exception_sc_entry, 103, "Matrix must be square - argument 1, entry %zu", k);
+					failed = 1;
+					break;
+				}
+				if (php_lapack_operand_shape(bvals[k], &mb, &nrhs, &p->as_matrix) == FAILURE || mb != n) {
+					zend_throw_exception_ex(php_lapack_exception_sc_entry, 102, "Invalid input matrix - argument 2, entry %zu", k);
+					failed = 1;
+					break;
+				}
+				p->nrhs = nrhs;
+				p->ldb = n;
+				size += PHP_LAPACK_BATCH_ROUND((size_t)n * nrhs);
+				pivots += n;
+				break;
+
+			case PHP_LAPACK_BATCH_LLS:
+				if (php_lapack_operand_shape(bvals[k], &mb, &nrhs, &p->as_matrix) == FAILURE || mb != m) {
+					zend_throw_exception_ex(php_lapack_exception_sc_entry, 102, "Invalid input matrix - argument 2, entry %zu", k);
+					failed = 1;
+					break;
+				}
+				p->nrhs = nrhs;
+				/* B also holds the n x nrhs solution */
+				p->ldb = m > n ? m : n;
+				size += PHP_LAPACK_BATCH_ROUND((size_t)p->ldb * nrhs);
+				break;
+
+			case PHP_LAPACK_BATCH_SVD:
+				size += PHP_LAPACK_BATCH_ROUND(m < n ? m : n);
+				break;
+		}
+	}
+
+	if (failed) {
+		efree(problems);
+		efree(avals);
+		if (bvals != NULL) {
+			efree(bvals);
+		}
+		return;
+	}
+
+	/* Second pass: linearize every problem into its slice of the arena */
+	arena = php_lapack_alloc(size);
+	ipiv_arena = pivots > 0 ? safe_emalloc(pivots, sizeof(lapack_int), 0) : NULL;
+	size = 0;
+	pivots = 0;
+	for (k = 0; k < count; k++) {
+		p = &problems[k];
+
+		p->a = arena + size;
+		size += PHP_LAPACK_BATCH_ROUND((size_t)p->m * p->n);
+		if (php_lapack_linearize_operand_into(avals[k], p->a, p->m, p->n, p->m) == FAILURE) {
+			zend_throw_exception_ex(php_lapack_exception_sc_entry, 102, "Invalid input matrix - argument 1, entry %zu", k);
+			failed = 1;
+			break;
+		}
+
+		p->b = arena + size;
+		if (kind == PHP_LAPACK_BATCH_SVD) {
+			size += PHP_LAPACK_BATCH_ROUND(p->m < p->n ? p->m : p->n);
+			continue;
+		}
+
+		size += PHP_LAPACK_BATCH_ROUND((size_t)p->ldb * p->nrhs);
+		if (php_lapack_linearize_operand_into(bvals[k], p->b, (kind == PHP_LAPACK_BATCH_SOLVE ? p->n : p->m), p->nrhs, p->ldb) == FAILURE) {
+			zend_throw_exception_ex(php_lapack_exception_sc_entry, 102, "Invalid input matrix - argument 2, entry %zu", k);
+			failed = 1;
+			break;
+		}
+
+		if (kind == PHP_LAPACK_BATCH_SOLVE) {
+			p->ipiv = ipiv_arena + pivots;
+			pivots += p->n;
+		}
+	}
+
+	efree(avals);
+	if (bvals != NULL) {
+		efree(bvals);
+	}
+
+	if (!failed) {
+		switch (kind) {
+			case PHP_LAPACK_BATCH_SOLVE:
+				task = php_lapack_batch_solve_task;
+				break;
+			case PHP_LAPACK_BATCH_LLS:
+				task = php_lapack_batch_lls_task;
+				break;
+			default:
+				task = php_lapack_batch_svd_task;
+				break;
+		}
+
+		php_lapack_pool_run(count, task, problems, php_lapack_pool_threads(threads, count));
+
+		for (k = 0; k < count; k++) {
+			if (problems[k].info == LAPACK_WORK_MEMORY_ERROR || problems[k].info == LAPACK_TRANSPOSE_MEMORY_ERROR) {
+				zend_throw_exception(php_lapack_exception_sc_entry, "Not enough memory to calculate result", 101);
+				failed = 1;
+				break;
+			}
+		}
+	}
+
+	if (!failed) {
+		/* Results keep the keys of argument 1. A problem that LAPACK could
+		   not solve gives an empty array, as for the single versions. */
+		array_init_size(return_value, count);
+		k = 0;
+		ZEND_HASH_FOREACH_KEY_VAL(as, h, key, val) {
+			p = &problems[k++];
+			php_lapack_stats_info(p->info);
+
+			if (p->info != 0) {
+				array_init(&result);
+			} else if (kind == PHP_LAPACK_BATCH_SVD) {
+				php_lapack_batch_result(&result, p->b, 1, (p->m < p->n ? p->m : p->n), 1, p->as_matrix);
+			} else {
+				php_lapack_batch_result(&result, p->b, p->n, p->nrhs, p->ldb, p->as_matrix);
+			}
+
+			if (key != NULL) {
+				zend_hash_update(Z_ARRVAL_P(return_value), key, &result);
+			} else {
+				zend_hash_index_update(Z_ARRVAL_P(return_value), h, &result);
+			}
+		} ZEND_HASH_FOREACH_END();
+	}
+
+	php_lapack_free(arena);
+	if (ipiv_arena != NULL) {
+		efree(ipiv_arena);
+	}
+	efree(problems);
+}
+/* }}} */
+
+/* --- Lapack Batch Functions --- */
+
+/* {{{ array Lapack::solveLinearEquationBatch(array As, array Bs [, int threads]);
+Solve each square system As[k] X = Bs[k]. Returns the solutions under the
+keys of As. threads defaults to one per CPU.
+*/
+PHP_METHOD(Lapack, solveLinearEquationBatch)
+{
+	php_lapack_batch(INTERNAL_FUNCTION_PARAM_PASSTHRU, PHP_LAPACK_BATCH_SOLVE);
+}
+/* }}} */
+
+/* {{{ array Lapack::leastSquaresByFactorisationBatch(array As, array Bs [, int threads]);
+Solve each linear least squares problem min || Bs[k] - As[k] x || using QR or
+LQ factorisation. Returns the solutions under the keys of As.
+*/
+PHP_METHOD(Lapack, leastSquaresByFactorisationBatch)
+{
+	php_lapack_batch(INTERNAL_FUNCTION_PARAM_PASSTHRU, PHP_LAPACK_BATCH_LLS);
+}
+/* }}} */
+
+/* {{{ array Lapack::singularValuesBatch(array As [, int threads]);
+Calculate the singular values of each matrix in As. Returns them under the
+keys of As.
+*/
+PHP_METHOD(Lapack, singularValuesBatch)
+{
+	php_lapack_batch(INTERNAL_FUNCTION_PARAM_PASSTHRU, PHP_LAPACK_BATCH_SVD);
+}
+/* }}} */
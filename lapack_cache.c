@@ -0,0 +1,581 @@
+/*
+  +----------------------------------------------------------------------+
+  | PHP Version 5 / lapack                                               |
+  +----------------------------------------------------------------------+
+  | Copyright (c) 2012 Ian Barber                                        |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 3.0 of the PHP license,       |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.php.net/license/3_0.txt.                                  |
+  | If you did not receive a copy of the PHP license and are unable to   |
+  | obtain it through the world-wide-web, please send a note to          |
+  | license@php.net so we can mail you a copy immediately.               |
+  +----------------------------------------------------------------------+
+  | Authors: Ian Barber <ian.barber@gmail.com>                           |
+  +----------------------------------------------------------------------+
+*/
+
+#include "php_lapack.h"
+#include "php_lapack_internal.h"
+#include "Zend/zend_exceptions.h"
+#include "ext/standard/info.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#ifdef HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+#endif
+
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+# define MAP_ANONYMOUS MAP_ANON
+#endif
+
+#if defined(HAVE_MMAP) && defined(MAP_ANONYMOUS)
+# define PHP_LAPACK_HAVE_CACHE 1
+#endif
+
+/*
+ * Shared matrix cache. When lapack.cache_size is set, MINIT maps a shared
+ * anonymous segment of that size, before php-fpm (or any other forking SAPI)
+ * starts its workers, so every worker sees the same entries.
+ * Lapack::cacheStore() copies a matrix or factorisation into the segment
+ * once, and Lapack::cacheFetch() returns an object that reads straight from
+ * it, without copying or converting anything.
+ *
+ * The segment is a header followed by a run of blocks, each free or holding
+ * one entry: its key, then the column-major data at PHP_LAPACK_ALIGNMENT,
+ * then the Householder scalars or pivots of a factorisation. Blocks are
+ * taken first fit and merged with their free neighbours when released, and
+ * when nothing fits the least recently used entries are evicted. An entry
+ * that fetched objects still read from is never evicted; when it is
+ * replaced it is only unlinked, and released with its last reference.
+ * Lookups walk the blocks, which suits the intended handful of large
+ * matrices rather than many small ones.
+ *
+ * A worker killed part way through, typically by request_terminate_timeout,
+ * cannot clean up after itself. A block it was filling records its pid and
+ * is freed once that process is gone. References it held are not tracked
+ * per process, so an entry it had fetched stays in the cache until restart.
+ */
+
+#ifdef PHP_LAPACK_HAVE_CACHE
+
+#define PHP_LAPACK_CACHE_FREE		0
+#define PHP_LAPACK_CACHE_FILLING	1	/* being copied in, not visible yet */
+#define PHP_LAPACK_CACHE_LIVE		2
+#define PHP_LAPACK_CACHE_DEAD		3	/* replaced, released with its last reference */
+
+/* Every block is a multiple of the alignment, which keeps the data aligned */
+#define PHP_LAPACK_CACHE_ALIGN(size) (((size) + PHP_LAPACK_ALIGNMENT - 1) & ~((size_t)PHP_LAPACK_ALIGNMENT - 1))
+
+typedef struct _php_lapack_cache_block {
+	size_t size;			/* bytes, this header included */
+	size_t prev;			/* size of the block before, 0 for the first */
+	uint64_t used;			/* clock of the last store or fetch */
+	uint32_t refs;			/* objects reading from the entry */
+	pid_t owner;			/* process filling the block */
+	int state;
+	int kind;				/* 0 for a matrix, else the factorisation kind */
+	int m;
+	int n;
+	lapack_int info;
+	zend_bool as_matrix;
+	int ntau;
+	int nipiv;
+	size_t key_len;			/* the key follows this header */
+} php_lapack_cache_block;
+
+typedef struct _php_lapack_cache_segment {
+	pthread_mutex_t lock;
+	size_t size;			/* bytes of blocks */
+	size_t used;			/* bytes of blocks not free */
+	uint64_t clock;
+	zend_long entries;
+	zend_long hits;
+	zend_long misses;
+	zend_long evictions;
+} php_lapack_cache_segment;
+
+static php_lapack_cache_segment *php_lapack_cache = NULL;
+static size_t php_lapack_cache_len = 0;
+
+#define PHP_LAPACK_CACHE_BLOCKS() ((char *)php_lapack_cache + PHP_LAPACK_CACHE_ALIGN(sizeof(php_lapack_cache_segment)))
+#define PHP_LAPACK_CACHE_HEAD(key_len) PHP_LAPACK_CACHE_ALIGN(sizeof(php_lapack_cache_block) + (key_len))
+#define PHP_LAPACK_CACHE_KEY(b) ((char *)((b) + 1))
+#define PHP_LAPACK_CACHE_DATA(b) ((double *)((char *)(b) + PHP_LAPACK_CACHE_HEAD((b)->key_len)))
+
+/* --- Helper Functions --- */
+
+#define php_lapack_cache_unlock() pthread_mutex_unlock(&php_lapack_cache->lock)
+
+/* {{{ static php_lapack_cache_block* php_lapack_cache_next(php_lapack_cache_block *b)
+The block after b, or the first one when b is NULL. NULL at the end.
+*/
+static php_lapack_cache_block* php_lapack_cache_next(php_lapack_cache_block *b)
+{
+	char *blocks = PHP_LAPACK_CACHE_BLOCKS();
+	size_t offset = b == NULL ? 0 : (size_t)((char *)b - blocks) + b->size;
+
+	return offset < php_lapack_cache->size ? (php_lapack_cache_block *)(blocks + offset) : NULL;
+}
+/* }}} */
+
+/* {{{ static void php_lapack_cache_free_block(php_lapack_cache_block *b)
+Release a block and merge it with whichever of its neighbours are free.
+*/
+static void php_lapack_cache_free_block(php_lapack_cache_block *b)
+{
+	php_lapack_cache_block *next, *prev;
+
+	php_lapack_cache->used -= b->size;
+	b->state = PHP_LAPACK_CACHE_FREE;
+	b->refs = 0;
+
+	next = php_lapack_cache_next(b);
+	if (next != NULL && next->state == PHP_LAPACK_CACHE_FREE) {
+		b->size += next->size;
+	}
+
+	if (b->prev != 0) {
+		prev = (php_lapack_cache_block *)((char *)b - b->prev);
+		if (prev->state == PHP_LAPACK_CACHE_FREE) {
+			prev->size += b->size;
+			b = prev;
+		}
+	}
+
+	next = php_lapack_cache_next(b);
+	if (next != NULL) {
+		next->prev = b->size;
+	}
+}
+/* }}} */
+
+/* {{{ static int php_lapack_cache_reclaim(void)
+Free the blocks left filling by processes that have since exited. Returns
+0 when there were none.
+*/
+static int php_lapack_cache_reclaim(void)
+{
+	php_lapack_cache_block *b, *next;
+	int freed = 0;
+
+	for (b = php_lapack_cache_next(NULL); b != NULL; b = next) {
+		next = php_lapack_cache_next(b);
+		if (b->state == PHP_LAPACK_CACHE_FILLING && kill(b->owner, 0) == -1 && errno == ESRCH) {
+			/* Merging may swallow the next block too, so restart from here */
+			php_lapack_cache_free_block(b);
+			next = b->prev != 0 ? (php_lapack_cache_block *)((char *)b - b->prev) : php_lapack_cache_next(NULL);
+			freed = 1;
+		}
+	}
+
+	return freed;
+}
+/* }}} */
+
+/* {{{ static void php_lapack_cache_lock(void)
+*/
+static void php_lapack_cache_lock(void)
+{
+	int err = pthread_mutex_lock(&php_lapack_cache->lock);
+
+#ifdef HAVE_PTHREAD_MUTEX_CONSISTENT
+	/* The owner died holding the lock, typically a worker killed by
+	   request_terminate_timeout. Carry on rather than hang every worker,
+	   and give back whatever it was in the middle of storing */
+	if (err == EOWNERDEAD) {
+		pthread_mutex_consistent(&php_lapack_cache->lock);
+		php_lapack_cache_reclaim();
+	}
+#else
+	(void)err;
+#endif
+}
+/* }}} */
+
+/* {{{ static php_lapack_cache_block* php_lapack_cache_alloc(size_t size)
+Take the first free block of at least size bytes, splitting off the rest.
+*/
+static php_lapack_cache_block* php_lapack_cache_alloc(size_t size)
+{
+	php_lapack_cache_block *b, *rest, *next;
+
+	for (b = php_lapack_cache_next(NULL); b != NULL; b = php_lapack_cache_next(b)) {
+		if (b->state != PHP_LAPACK_CACHE_FREE || b->size < size) {
+			continue;
+		}
+
+		if (b->size - size >= PHP_LAPACK_CACHE_HEAD(0)) {
+			rest = (php_lapack_cache_block *)((char *)b + size);
+			rest->size = b->size - size;
+			rest->prev = size;
+			rest->state = PHP_LAPACK_CACHE_FREE;
+			rest->refs = 0;
+			b->size = size;
+
+			next = php_lapack_cache_next(rest);
+			if (next != NULL) {
+				next->prev = rest->size;
+			}
+		}
+
+		php_lapack_cache->used += b->size;
+		return b;
+	}
+
+	return NULL;
+}
+/* }}} */
+
+/* {{{ static int php_lapack_cache_evict(void)
+Free the least recently used entry that nothing reads from. Returns 0 when
+there is none.
+*/
+static int php_lapack_cache_evict(void)
+{
+	php_lapack_cache_block *b, *lru = NULL;
+
+	for (b = php_lapack_cache_next(NULL); b != NULL; b = php_lapack_cache_next(b)) {
+		if (b->state == PHP_LAPACK_CACHE_LIVE && b->refs == 0 && (lru == NULL || b->used < lru->used)) {
+			lru = b;
+		}
+	}
+
+	if (lru == NULL) {
+		return 0;
+	}
+
+	php_lapack_cache_free_block(lru);
+	php_lapack_cache->entries--;
+	php_lapack_cache->evictions++;
+
+	return 1;
+}
+/* }}} */
+
+/* {{{ static php_lapack_cache_block* php_lapack_cache_find(zend_string *key)
+*/
+static php_lapack_cache_block* php_lapack_cache_find(zend_string *key)
+{
+	php_lapack_cache_block *b;
+
+	for (b = php_lapack_cache_next(NULL); b != NULL; b = php_lapack_cache_next(b)) {
+		if (b->state == PHP_LAPACK_CACHE_LIVE && b->key_len == ZSTR_LEN(key) &&
+			memcmp(PHP_LAPACK_CACHE_KEY(b), ZSTR_VAL(key), ZSTR_LEN(key)) == 0) {
+			return b;
+		}
+	}
+
+	return NULL;
+}
+/* }}} */
+
+#endif /* PHP_LAPACK_HAVE_CACHE */
+
+/* {{{ void php_lapack_cache_release(void *entry)
+Drop a reference taken by Lapack::cacheFetch(), when the object is freed.
+*/
+void php_lapack_cache_release(void *entry)
+{
+#ifdef PHP_LAPACK_HAVE_CACHE
+	php_lapack_cache_block *b = entry;
+
+	php_lapack_cache_lock();
+	if (--b->refs == 0 && b->state == PHP_LAPACK_CACHE_DEAD) {
+		php_lapack_cache_free_block(b);
+	}
+	php_lapack_cache_unlock();
+#endif
+}
+/* }}} */
+
+/* {{{ void php_lapack_cache_shutdown(void)
+*/
+void php_lapack_cache_shutdown(void)
+{
+#ifdef PHP_LAPACK_HAVE_CACHE
+	if (php_lapack_cache != NULL) {
+		munmap(php_lapack_cache, php_lapack_cache_len);
+		php_lapack_cache = NULL;
+	}
+#endif
+}
+/* }}} */
+
+/* {{{ void php_lapack_cache_info_table(void)
+The cache counters, for phpinfo().
+*/
+void php_lapack_cache_info_table(void)
+{
+#ifdef PHP_LAPACK_HAVE_CACHE
+	size_t used;
+	zend_long entries, hits, misses, evictions;
+	char value[64];
+
+	php_info_print_table_start();
+	if (php_lapack_cache == NULL) {
+		php_info_print_table_row(2, "Matrix cache", "disabled");
+		php_info_print_table_end();
+		return;
+	}
+
+	php_lapack_cache_lock();
+	used = php_lapack_cache->used;
+	entries = php_lapack_cache->entries;
+	hits = php_lapack_cache->hits;
+	misses = php_lapack_cache->misses;
+	evictions = php_lapack_cache->evictions;
+	php_lapack_cache_unlock();
+
+	php_info_print_table_row(2, "Matrix cache", "enabled");
+	snprintf(value, sizeof(value), "%zu of %zu", used, php_lapack_cache->size);
+	php_info_print_table_row(2, "Cache bytes used", value);
+	snprintf(value, sizeof(value), ZEND_LONG_FMT, entries);
+	php_info_print_table_row(2, "Cache entries", value);
+	snprintf(value, sizeof(value), ZEND_LONG_FMT " / " ZEND_LONG_FMT, hits, misses);
+	php_info_print_table_row(2, "Cache hits / misses", value);
+	snprintf(value, sizeof(value), ZEND_LONG_FMT, evictions);
+	php_info_print_table_row(2, "Cache evictions", value);
+	php_info_print_table_end();
+#else
+	php_info_print_table_start();
+	php_info_print_table_row(2, "Matrix cache", "not available");
+	php_info_print_table_end();
+#endif
+}
+/* }}} */
+
+/* --- Lapack Methods --- */
+
+/* {{{ bool Lapack::cacheStore(string key, array|LapackMatrix|LapackFactorization value);
+Copy a matrix, or the factorisation returned by luFactor(), qrFactor() or
+choleskyFactor(), into the shared cache under key, replacing whatever was
+stored there. Least recently used entries are evicted to make room. Returns
+false when the cache is disabled, or the value does not fit even once every
+entry not currently fetched has been evicted.
+*/
+PHP_METHOD(Lapack, cacheStore)
+{
+	zend_string *key;
+	zval *value;
+	php_lapack_factor_parts parts;
+#ifdef PHP_LAPACK_HAVE_CACHE
+	php_lapack_cache_block *b, *old;
+	size_t head, bytes;
+	double *data;
+	int result = SUCCESS;
+#endif
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS(), "Sz", &key, &value) == FAILURE) {
+		return;
+	}
+
+	if (ZSTR_LEN(key) == 0) {
+		LAPACK_THROW("Invalid key - must not be empty", 102);
+	}
+
+	memset(&parts, 0, sizeof(parts));
+	if (php_lapack_factor_export(value, &parts) == FAILURE &&
+		php_lapack_operand_shape(value, &parts.m, &parts.n, NULL) == FAILURE) {
+		LAPACK_THROW("Invalid input matrix - argument 2", 102);
+	}
+
+#ifdef PHP_LAPACK_HAVE_CACHE
+	if (php_lapack_cache == NULL) {
+		RETURN_FALSE;
+	}
+
+	head = PHP_LAPACK_CACHE_HEAD(ZSTR_LEN(key));
+	bytes = (size_t)parts.m * parts.n * sizeof(double) + (size_t)parts.ntau * sizeof(double) +
+		(size_t)parts.nipiv * sizeof(lapack_int);
+	if (bytes > php_lapack_cache->size || head > php_lapack_cache->size - PHP_LAPACK_CACHE_ALIGN(bytes)) {
+		RETURN_FALSE;
+	}
+	bytes = head + PHP_LAPACK_CACHE_ALIGN(bytes);
+
+	php_lapack_cache_lock();
+	while ((b = php_lapack_cache_alloc(bytes)) == NULL && (php_lapack_cache_reclaim() || php_lapack_cache_evict())) {
+	}
+	if (b != NULL) {
+		b->state = PHP_LAPACK_CACHE_FILLING;
+		b->refs = 0;
+		b->owner = getpid();
+		b->kind = parts.kind;
+		b->m = parts.m;
+		b->n = parts.n;
+		b->info = parts.info;
+		b->as_matrix = parts.as_matrix;
+		b->ntau = parts.ntau;
+		b->nipiv = parts.nipiv;
+		b->key_len = ZSTR_LEN(key);
+		memcpy(PHP_LAPACK_CACHE_KEY(b), ZSTR_VAL(key), ZSTR_LEN(key));
+	}
+	php_lapack_cache_unlock();
+
+	if (b == NULL) {
+		RETURN_FALSE;
+	}
+
+	/* The block is not visible to anyone else yet, so the copy, which can
+	   take a while for a large array, is made without holding the lock */
+	data = PHP_LAPACK_CACHE_DATA(b);
+	if (parts.kind == 0) {
+		result = php_lapack_linearize_operand_into(value, data, parts.m, parts.n, parts.m);
+	} else {
+		memcpy(data, parts.data, (size_t)parts.m * parts.n * sizeof(double));
+		data += (size_t)parts.m * parts.n;
+		if (parts.ntau > 0) {
+			memcpy(data, parts.tau, parts.ntau * sizeof(double));
+		}
+		if (parts.nipiv > 0) {
+			memcpy(data + parts.ntau, parts.ipiv, parts.nipiv * sizeof(lapack_int));
+		}
+	}
+
+	php_lapack_cache_lock();
+	if (result == FAILURE) {
+		php_lapack_cache_free_block(b);
+	} else {
+		old = php_lapack_cache_find(key);
+		if (old != NULL) {
+			php_lapack_cache->entries--;
+			if (old->refs == 0) {
+				php_lapack_cache_free_block(old);
+			} else {
+				old->state = PHP_LAPACK_CACHE_DEAD;
+			}
+		}
+		b->state = PHP_LAPACK_CACHE_LIVE;
+		b->used = ++php_lapack_cache->clock;
+		php_lapack_cache->entries++;
+	}
+	php_lapack_cache_unlock();
+
+	if (result == FAILURE) {
+		LAPACK_THROW("Invalid input matrix - argument 2", 102);
+	}
+
+	RETURN_TRUE;
+#else
+	RETURN_FALSE;
+#endif
+}
+/* }}} */
+
+/* {{{ LapackMatrix|LapackFactorization|null Lapack::cacheFetch(string key);
+Return what was stored under key, or null if there is nothing. The object
+reads from the shared segment directly, and the entry is kept from being
+evicted or replaced in place until the object is freed.
+*/
+PHP_METHOD(Lapack, cacheFetch)
+{
+	zend_string *key;
+#ifdef PHP_LAPACK_HAVE_CACHE
+	php_lapack_cache_block *b;
+	php_lapack_matrix_object *intern;
+	php_lapack_factor_parts parts;
+#endif
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS(), "S", &key) == FAILURE) {
+		return;
+	}
+
+#ifdef PHP_LAPACK_HAVE_CACHE
+	if (php_lapack_cache == NULL) {
+		RETURN_NULL();
+	}
+
+	php_lapack_cache_lock();
+	b = php_lapack_cache_find(key);
+	if (b != NULL) {
+		b->refs++;
+		b->used = ++php_lapack_cache->clock;
+		php_lapack_cache->hits++;
+	} else {
+		php_lapack_cache->misses++;
+	}
+	php_lapack_cache_unlock();
+
+	if (b == NULL) {
+		RETURN_NULL();
+	}
+
+	if (b->kind == 0) {
+		object_init_ex(return_value, php_lapack_matrix_sc_entry);
+		intern = Z_LAPACK_MATRIX_P(return_value);
+		intern->data = PHP_LAPACK_CACHE_DATA(b);
+		intern->m = b->m;
+		intern->n = b->n;
+		intern->ld = b->m;
+		intern->cache = b;
+		return;
+	}
+
+	parts.kind = b->kind;
+	parts.m = b->m;
+	parts.n = b->n;
+	parts.info = b->info;
+	parts.as_matrix = b->as_matrix;
+	parts.data = PHP_LAPACK_CACHE_DATA(b);
+	parts.ntau = b->ntau;
+	parts.tau = b->ntau > 0 ? parts.data + (size_t)b->m * b->n : NULL;
+	parts.nipiv = b->nipiv;
+	parts.ipiv = b->nipiv > 0 ? (lapack_int *)(parts.data + (size_t)b->m * b->n + b->ntau) : NULL;
+	php_lapack_factor_cached(return_value, &parts, b);
+#else
+	RETURN_NULL();
+#endif
+}
+/* }}} */
+
+/* --- INIT --- */
+
+PHP_MINIT_FUNCTION(lapack_cache)
+{
+#ifdef PHP_LAPACK_HAVE_CACHE
+	pthread_mutexattr_t attr;
+	php_lapack_cache_block *b;
+	size_t head = PHP_LAPACK_CACHE_ALIGN(sizeof(php_lapack_cache_segment));
+	void *map;
+
+	if (LAPACK_G(cache_size) <= 0) {
+		return SUCCESS;
+	}
+
+	php_lapack_cache_len = head + PHP_LAPACK_CACHE_ALIGN((size_t)LAPACK_G(cache_size));
+	map = mmap(NULL, php_lapack_cache_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (map == MAP_FAILED) {
+		php_error_docref(NULL, E_WARNING, "Unable to map %zu bytes for lapack.cache_size, the matrix cache is disabled", php_lapack_cache_len);
+		return SUCCESS;
+	}
+
+	php_lapack_cache = map;
+	php_lapack_cache->size = php_lapack_cache_len - head;
+	php_lapack_cache->used = 0;
+	php_lapack_cache->clock = 0;
+	php_lapack_cache->entries = 0;
+	php_lapack_cache->hits = 0;
+	php_lapack_cache->misses = 0;
+	php_lapack_cache->evictions = 0;
+
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+#ifdef HAVE_PTHREAD_MUTEX_CONSISTENT
+	pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+#endif
+	pthread_mutex_init(&php_lapack_cache->lock, &attr);
+	pthread_mutexattr_destroy(&attr);
+
+	b = php_lapack_cache_next(NULL);
+	b->size = php_lapack_cache->size;
+	b->prev = 0;
+	b->state = PHP_LAPACK_CACHE_FREE;
+	b->refs = 0;
+#endif
+
+	return SUCCESS;
+}
@@ -0,0 +1,541 @@
+/*
+  +----------------------------------------------------------------------+
+  | PHP Version 5 / lapack                                               |
+  +----------------------------------------------------------------------+
+  | Copyright (c) 2012 Ian Barber                                        |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 3.0 of the PHP license,       |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.php.net/license/3_0.txt.                                  |
+  | If you did not receive a copy of the PHP license and are unable to   |
+  | obtain it through the world-wide-web, please send a note to          |
+  | license@php.net so we can mail you a copy immediately.               |
+  +----------------------------------------------------------------------+
+  | Authors: Ian Barber <ian.barber@gmail.com>                           |
+  +----------------------------------------------------------------------+
+*/
+
+#include "php_lapack.h"
+#include "php_lapack_internal.h"
+#include "Zend/zend_exceptions.h"
+
+/*
+ * Factorisation objects. Lapack::luFactor(), qrFactor() and choleskyFactor()
+ * factor A once, and the returned object then solves against as many
+ * right-hand sides as needed at O(n^2) each.
+ */
+
+#define PHP_LAPACK_FACTOR_LU		1
+#define PHP_LAPACK_FACTOR_QR		2
+#define PHP_LAPACK_FACTOR_CHOLESKY	3
+
+typedef struct _php_lapack_factor_object {
+	int kind;
+	double *data;			/* the factored matrix, column-major with ld m */
+	double *tau;			/* QR: the Householder scalars */
+	lapack_int *ipiv;		/* LU: the row interchanges */
+	int m;
+	int n;
+	lapack_int info;		/* LU: > 0 if U is exactly singular */
+	zend_bool as_matrix;
+	void *cache;			/* when set, the buffers belong to this cache entry */
+	zend_object std;
+} php_lapack_factor_object;
+
+static inline php_lapack_factor_object *php_lapack_factor_from_obj(zend_object *obj) {
+	return (php_lapack_factor_object *)((char *)(obj) - XtOffsetOf(php_lapack_factor_object, std));
+}
+
+#define Z_LAPACK_FACTOR_P(zv) php_lapack_factor_from_obj(Z_OBJ_P(zv))
+
+static zend_class_entry *php_lapack_factor_sc_entry;
+static zend_class_entry *php_lapack_lu_sc_entry;
+static zend_class_entry *php_lapack_qr_sc_entry;
+static zend_class_entry *php_lapack_cholesky_sc_entry;
+static zend_object_handlers lapack_factor_object_handlers;
+
+/* --- Helper Functions --- */
+
+/* {{{ static lapack_int php_lapack_factor_apply(php_lapack_factor_object *intern, double *b, lapack_int nrhs, lapack_int ldb)
+Overwrite the m x nrhs matrix b with the solution of A X = b (in the least
+squares sense for QR), held in its first n rows.
+*/
+static lapack_int php_lapack_factor_apply(php_lapack_factor_object *intern, double *b, lapack_int nrhs, lapack_int ldb)
+{
+	double *work, query = 0.0;
+	size_t lwork;
+	lapack_int info;
+
+	switch (intern->kind) {
+		case PHP_LAPACK_FACTOR_LU:
+			if (intern->info > 0) {
+				return intern->info;
+			}
+			return LAPACKE_dgetrs_work( LAPACK_COL_MAJOR, 'N', intern->n, nrhs, intern->data, intern->m, intern->ipiv, b, ldb );
+
+		case PHP_LAPACK_FACTOR_QR:
+			/* x = R^-1 Q^T b */
+			if (php_lapack_lwork_get(PHP_LAPACK_WORK_DORMQR, intern->m, nrhs, intern->n, &lwork, NULL) == FAILURE) {
+				LAPACKE_dormqr_work( LAPACK_COL_MAJOR, 'L', 'T', intern->m, nrhs, intern->n, intern->data, intern->m,
+									 intern->tau, b, ldb, &query, -1 );
+				php_lapack_lwork_set(PHP_LAPACK_WORK_DORMQR, intern->m, nrhs, intern->n, query, 0, &lwork, NULL);
+			}
+			work = php_lapack_arena_alloc(lwork, sizeof(double));
+			info = LAPACKE_dormqr_work( LAPACK_COL_MAJOR, 'L', 'T', intern->m, nrhs, intern->n, intern->data, intern->m,
+										intern->tau, b, ldb, work, (lapack_int)lwork );
+			if (info != 0) {
+				return info;
+			}
+			return LAPACKE_dtrtrs_work( LAPACK_COL_MAJOR, 'U', 'N', 'N', intern->n, nrhs, intern->data, intern->m, b, ldb );
+
+		case PHP_LAPACK_FACTOR_CHOLESKY:
+			return LAPACKE_dpotrs_work( LAPACK_COL_MAJOR, 'L', intern->n, nrhs, intern->data, intern->m, b, ldb );
+	}
+
+	return -1;
+}
+/* }}} */
+
+/* {{{ static php_lapack_factor_object* php_lapack_factor_fetch(zval *object)
+Return the factorisation behind object, or throw if it was never filled in.
+*/
+static php_lapack_factor_object* php_lapack_factor_fetch(zval *object)
+{
+	php_lapack_factor_object *intern = Z_LAPACK_FACTOR_P(object);
+
+	if (intern->data == NULL) {
+		zend_throw_exception(php_lapack_exception_sc_entry, "Factorisation is not initialised", 104);
+		return NULL;
+	}
+
+	return intern;
+}
+/* }}} */
+
+/* {{{ static void php_lapack_factor(INTERNAL_FUNCTION_PARAMETERS, int kind)
+Shared implementation of the factorisation constructors.
+*/
+static void php_lapack_factor(INTERNAL_FUNCTION_PARAMETERS, int kind)
+{
+	zval *a;
+	double *al, *tau = NULL, *work, query = 0.0;
+	lapack_int info, *ipiv = NULL;
+	int m, n;
+	size_t lwork;
+	php_lapack_factor_object *intern;
+	zend_class_entry *ce;
+	zend_bool as_matrix = 0;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS(), "z", &a) == FAILURE) {
+		return;
+	}
+
+	php_lapack_arena_begin();
+
+	al = php_lapack_linearize_operand(a, &m, &n, &as_matrix);
+	if (al == NULL) {
+		LAPACK_THROW("Invalid input matrix", 102);
+	}
+
+	if (kind == PHP_LAPACK_FACTOR_QR) {
+		if (m < n) {
+			php_lapack_free(al);
+			LAPACK_THROW("Matrix must have at least as many rows as columns", 103);
+		}
+	} else if (m != n) {
+		php_lapack_free(al);
+		LAPACK_THROW("Matrix must be square", 103);
+	}
+
+	php_lapack_blas_threads_for((double)m * n * n);
+
+	switch (kind) {
+		case PHP_LAPACK_FACTOR_LU:
+			ce = php_lapack_lu_sc_entry;
+			ipiv = safe_emalloc(n, sizeof(lapack_int), 0);
+			info = LAPACKE_dgetrf_work( LAPACK_COL_MAJOR, m, n, al, m, ipiv );
+			break;
+
+		case PHP_LAPACK_FACTOR_QR:
+			ce = php_lapack_qr_sc_entry;
+			tau = php_lapack_alloc(n);
+			if (php_lapack_lwork_get(PHP_LAPACK_WORK_DGEQRF, m, n, 0, &lwork, NULL) == FAILURE) {
+				LAPACKE_dgeqrf_work( LAPACK_COL_MAJOR, m, n, al, m, tau, &query, -1 );
+				php_lapack_lwork_set(PHP_LAPACK_WORK_DGEQRF, m, n, 0, query, 0, &lwork, NULL);
+			}
+			work = php_lapack_arena_alloc(lwork, sizeof(double));
+			info = LAPACKE_dgeqrf_work( LAPACK_COL_MAJOR, m, n, al, m, tau, work, (lapack_int)lwork );
+			break;
+
+		default:
+			ce = php_lapack_cholesky_sc_entry;
+			info = LAPACKE_dpotrf_work( LAPACK_COL_MAJOR, 'L', n, al, m );
+			break;
+	}
+
+	php_lapack_stats_info(info);
+
+	if (info > 0 && kind == PHP_LAPACK_FACTOR_CHOLESKY) {
+		php_lapack_free(al);
+		LAPACK_THROW("Matrix is not positive definite", 105);
+	}
+
+	object_init_ex(return_value, ce);
+	intern = Z_LAPACK_FACTOR_P(return_value);
+	intern->kind = kind;
+	intern->data = al;
+	intern->tau = tau;
+	intern->ipiv = ipiv;
+	intern->m = m;
+	intern->n = n;
+	intern->info = info;
+	intern->as_matrix = as_matrix;
+
+	return;
+}
+/* }}} */
+
+/* --- Object Handlers --- */
+
+static void php_lapack_factor_object_free(zend_object *object)
+{
+	php_lapack_factor_object *intern = php_lapack_factor_from_obj(object);
+
+	if (intern->cache != NULL) {
+		php_lapack_cache_release(intern->cache);
+	} else {
+		php_lapack_free(intern->data);
+		php_lapack_free(intern->tau);
+		if (intern->ipiv != NULL) {
+			efree(intern->ipiv);
+		}
+	}
+	zend_object_std_dtor(&intern->std);
+}
+
+static zend_object *php_lapack_factor_object_new(zend_class_entry *class_type)
+{
+	php_lapack_factor_object *intern;
+
+	intern = zend_object_alloc(sizeof(php_lapack_factor_object), class_type);
+	intern->kind = 0;
+	intern->data = NULL;
+	intern->tau = NULL;
+	intern->ipiv = NULL;
+	intern->m = intern->n = 0;
+	intern->info = 0;
+	intern->as_matrix = 0;
+	intern->cache = NULL;
+
+	zend_object_std_init(&intern->std, class_type);
+	object_properties_init(&intern->std, class_type);
+	intern->std.handlers = &lapack_factor_object_handlers;
+
+	return &intern->std;
+}
+
+/* --- Cache Support --- */
+
+/* {{{ int php_lapack_factor_export(zval *object, php_lapack_factor_parts *parts)
+Describe the buffers of a factorisation, so that Lapack::cacheStore() can
+copy them. Returns FAILURE if object is not an initialised factorisation.
+*/
+int php_lapack_factor_export(zval *object, php_lapack_factor_parts *parts)
+{
+	php_lapack_factor_object *intern;
+
+	if (Z_TYPE_P(object) != IS_OBJECT || !instanceof_function(Z_OBJCE_P(object), php_lapack_factor_sc_entry)) {
+		return FAILURE;
+	}
+
+	intern = Z_LAPACK_FACTOR_P(object);
+	if (intern->data == NULL) {
+		return FAILURE;
+	}
+
+	parts->kind = intern->kind;
+	parts->m = intern->m;
+	parts->n = intern->n;
+	parts->info = intern->info;
+	parts->as_matrix = intern->as_matrix;
+	parts->data = intern->data;
+	parts->tau = intern->tau;
+	parts->ntau = intern->tau != NULL ? intern->n : 0;
+	parts->ipiv = intern->ipiv;
+	parts->nipiv = intern->ipiv != NULL ? intern->n : 0;
+
+	return SUCCESS;
+}
+/* }}} */
+
+/* {{{ void php_lapack_factor_cached(zval *object, const php_lapack_factor_parts *parts, void *entry)
+Create a factorisation in object that reads its buffers from the cache
+entry, and hands the entry back to the cache instead of freeing them.
+*/
+void php_lapack_factor_cached(zval *object, const php_lapack_factor_parts *parts, void *entry)
+{
+	php_lapack_factor_object *intern;
+	zend_class_entry *ce;
+
+	switch (parts->kind) {
+		case PHP_LAPACK_FACTOR_LU:
+			ce = php_lapack_lu_sc_entry;
+			break;
+
+		case PHP_LAPACK_FACTOR_QR:
+			ce = php_lapack_qr_sc_entry;
+			break;
+
+		default:
+			ce = php_lapack_cholesky_sc_entry;
+			break;
+	}
+
+	object_init_ex(object, ce);
+	intern = Z_LAPACK_FACTOR_P(object);
+	intern->kind = parts->kind;
+	intern->data = parts->data;
+	intern->tau = parts->tau;
+	intern->ipiv = parts->ipiv;
+	intern->m = parts->m;
+	intern->n = parts->n;
+	intern->info = parts->info;
+	intern->as_matrix = parts->as_matrix;
+	intern->cache = entry;
+}
+/* }}} */
+
+/* --- Lapack Factorisation Functions --- */
+
+/* {{{ LapackLU Lapack::luFactor(array|LapackMatrix A);
+Compute the LU factorisation of the square matrix A with partial pivoting.
+*/
+PHP_METHOD(Lapack, luFactor)
+{
+	php_lapack_factor(INTERNAL_FUNCTION_PARAM_PASSTHRU, PHP_LAPACK_FACTOR_LU);
+}
+/* }}} */
+
+/* {{{ LapackQR Lapack::qrFactor(array|LapackMatrix A);
+Compute the QR factorisation of the matrix A, which must have at least as
+many rows as columns. solve() then gives least squares solutions.
+*/
+PHP_METHOD(Lapack, qrFactor)
+{
+	php_lapack_factor(INTERNAL_FUNCTION_PARAM_PASSTHRU, PHP_LAPACK_FACTOR_QR);
+}
+/* }}} */
+
+/* {{{ LapackCholesky Lapack::choleskyFactor(array|LapackMatrix A);
+Compute the Cholesky factorisation of the symmetric positive definite matrix
+A. Only the lower triangle of A is read.
+*/
+PHP_METHOD(Lapack, choleskyFactor)
+{
+	php_lapack_factor(INTERNAL_FUNCTION_PARAM_PASSTHRU, PHP_LAPACK_FACTOR_CHOLESKY);
+}
+/* }}} */
+
+/* --- LapackFactorization Methods --- */
+
+/* {{{ array LapackFactorization::solve(array|LapackMatrix B);
+Solve A X = B using the stored factorisation. Returns an empty array if A
+is singular.
+*/
+PHP_METHOD(LapackFactorization, solve)
+{
+	zval *b;
+	double *bl;
+	php_lapack_factor_object *intern;
+	lapack_int info;
+	int m, nrhs;
+	zend_bool as_matrix;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS(), "z", &b) == FAILURE) {
+		return;
+	}
+
+	intern = php_lapack_factor_fetch(ZEND_THIS);
+	if (intern == NULL) {
+		return;
+	}
+
+	as_matrix = intern->as_matrix;
+	if (php_lapack_operand_shape(b, &m, &nrhs, &as_matrix) == FAILURE || m != intern->m) {
+		LAPACK_THROW("Invalid input matrix - argument 1", 102);
+	}
+
+	bl = php_lapack_alloc((size_t)m * nrhs);
+	if (php_lapack_linearize_operand_into(b, bl, m, nrhs, m) == FAILURE) {
+		php_lapack_free(bl);
+		LAPACK_THROW("Invalid input matrix - argument 1", 102);
+	}
+
+	php_lapack_arena_begin();
+	php_lapack_blas_threads_for((double)m * intern->n * nrhs);
+	info = php_lapack_factor_apply(intern, bl, nrhs, m);
+	php_lapack_stats_info(info);
+
+	if (info == 0) {
+		php_lapack_return_matrix(return_value, &bl, intern->n, nrhs, m, as_matrix);
+	} else {
+		array_init(return_value);
+	}
+
+	php_lapack_free(bl);
+
+	return;
+}
+/* }}} */
+
+/* {{{ float LapackFactorization::determinant();
+Return the determinant of A from the diagonal of the factorisation.
+*/
+PHP_METHOD(LapackFactorization, determinant)
+{
+	php_lapack_factor_object *intern;
+	double det = 1.0;
+	int i;
+
+	if (zend_parse_parameters_none() == FAILURE) {
+		return;
+	}
+
+	intern = php_lapack_factor_fetch(ZEND_THIS);
+	if (intern == NULL) {
+		return;
+	}
+
+	if (intern->m != intern->n) {
+		LAPACK_THROW("Matrix must be square", 103);
+	}
+
+	for (i = 0; i < intern->n; i++) {
+		det *= intern->data[i + (size_t)i * intern->m];
+	}
+
+	switch (intern->kind) {
+		case PHP_LAPACK_FACTOR_LU:
+			/* Each row interchange flips the sign */
+			for (i = 0; i < intern->n; i++) {
+				if (intern->ipiv[i] != i + 1) {
+					det = -det;
+				}
+			}
+			break;
+
+		case PHP_LAPACK_FACTOR_QR:
+			/* Each non-trivial Householder reflector has determinant -1 */
+			for (i = 0; i < intern->n; i++) {
+				if (intern->tau[i] != 0.0) {
+					det = -det;
+				}
+			}
+			break;
+
+		case PHP_LAPACK_FACTOR_CHOLESKY:
+			/* det(A) = det(L)^2 */
+			det = det * det;
+			break;
+	}
+
+	RETURN_DOUBLE(det);
+}
+/* }}} */
+
+/* {{{ array LapackFactorization::inverse();
+Return the inverse of A, found by solving against the identity. Returns an
+empty array if A is singular.
+*/
+PHP_METHOD(LapackFactorization, inverse)
+{
+	php_lapack_factor_object *intern;
+	double *x;
+	lapack_int info;
+	int i, n;
+
+	if (zend_parse_parameters_none() == FAILURE) {
+		return;
+	}
+
+	intern = php_lapack_factor_fetch(ZEND_THIS);
+	if (intern == NULL) {
+		return;
+	}
+
+	if (intern->m != intern->n) {
+		LAPACK_THROW("Matrix must be square", 103);
+	}
+
+	n = intern->n;
+	x = php_lapack_alloc((size_t)n * n);
+	memset(x, 0, (size_t)n * n * sizeof(double));
+	for (i = 0; i < n; i++) {
+		x[i + (size_t)i * n] = 1.0;
+	}
+
+	php_lapack_arena_begin();
+	php_lapack_blas_threads_for((double)n * n * n);
+	info = php_lapack_factor_apply(intern, x, n, n);
+	php_lapack_stats_info(info);
+
+	if (info == 0) {
+		php_lapack_return_matrix(return_value, &x, n, n, n, intern->as_matrix);
+	} else {
+		array_init(return_value);
+	}
+
+	php_lapack_free(x);
+
+	return;
+}
+/* }}} */
+
+/* --- ARGUMENTS AND INIT --- */
+
+ZEND_BEGIN_ARG_INFO_EX(lapack_factor_empty_args, 0, 0, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(lapack_factor_solve_args, 0, 0, 1)
+	ZEND_ARG_INFO(0, b)
+ZEND_END_ARG_INFO()
+
+static const zend_function_entry php_lapack_factor_class_methods[] =
+{
+	PHP_ME(LapackFactorization, solve,			lapack_factor_solve_args, ZEND_ACC_PUBLIC)
+	PHP_ME(LapackFactorization, determinant,	lapack_factor_empty_args, ZEND_ACC_PUBLIC)
+	PHP_ME(LapackFactorization, inverse,		lapack_factor_empty_args, ZEND_ACC_PUBLIC)
+	PHP_FE_END
+};
+
+PHP_MINIT_FUNCTION(lapack_factor)
+{
+	zend_class_entry ce;
+	memcpy(&lapack_factor_object_handlers, zend_get_std_object_handlers(), sizeof(zend_object_handlers));
+	lapack_factor_object_handlers.offset = XtOffsetOf(php_lapack_factor_object, std);
+	lapack_factor_object_handlers.free_obj = php_lapack_factor_object_free;
+	lapack_factor_object_handlers.clone_obj = NULL;
+
+	INIT_CLASS_ENTRY(ce, "LapackFactorization", php_lapack_factor_class_methods);
+	ce.create_object = php_lapack_factor_object_new;
+	php_lapack_factor_sc_entry = zend_register_internal_class(&ce);
+	php_lapack_factor_sc_entry->ce_flags |= ZEND_ACC_EXPLICIT_ABSTRACT_CLASS;
+
+	INIT_CLASS_ENTRY(ce, "LapackLU", NULL);
+	ce.create_object = php_lapack_factor_object_new;
+	php_lapack_lu_sc_entry = zend_register_internal_class_ex(&ce, php_lapack_factor_sc_entry);
+	php_lapack_lu_sc_entry->ce_flags |= ZEND_ACC_FINAL;
+
+	INIT_CLASS_ENTRY(ce, "LapackQR", NULL);
+	ce.create_object = php_lapack_factor_object_new;
+	php_lapack_qr_sc_entry = zend_register_internal_class_ex(&ce, php_lapack_factor_sc_entry);
+	php_lapack_qr_sc_entry->ce_flags |= ZEND_ACC_FINAL;
+
+	INIT_CLASS_ENTRY(ce, "LapackCholesky", NULL);
+	ce.create_object = php_lapack_factor_object_new;
+	php_lapack_cholesky_sc_entry = zend_register_internal_class_ex(&ce, php_lapack_factor_sc_entry);
+	php_lapack_cholesky_sc_entry->ce_flags |= ZEND_ACC_FINAL;
+
+	return SUCCESS;
+}
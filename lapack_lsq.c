@@ -0,0 +1,342 @@
+/*
+  +----------------------------------------------------------------------+
+  | PHP Version 5 / lapack                                               |
+  +----------------------------------------------------------------------+
+  | Copyright (c) 2012 Ian Barber                                        |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 3.0 of the PHP license,       |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.php.net/license/3_0.txt.                                  |
+  | If you did not receive a copy of the PHP license and are unable to   |
+  | obtain it through the world-wide-web, please send a note to          |
+  | license@php.net so we can mail you a copy immediately.               |
+  +----------------------------------------------------------------------+
+  | Authors: Ian Barber <ian.barber@gmail.com>                           |
+  +----------------------------------------------------------------------+
+*/
+
+#include "php_lapack.h"
+#include "php_lapack_internal.h"
+#include "Zend/zend_exceptions.h"
+
+#include <math.h>
+
+/*
+ * Streaming least squares. Lapack::leastSquaresStream() returns a
+ * LapackLeastSquares accumulator for min ||A . X - B|| over rows that arrive
+ * a chunk at a time. It keeps only the n x n triangular factor R of the rows
+ * seen so far and the matching n x nrhs block Q^T . B. Each chunk is merged
+ * into them with one triangular-pentagonal QR (dtpqrt, with dtpmqrt applying
+ * the same reflectors to B), so memory stays O(n^2) however many rows come
+ * in, and solve() is a single triangular solve.
+ *
+ * A ridge penalty is the same as starting from sqrt(ridge) . I rows with a
+ * zero right hand side, so R starts out as that. A forgetting factor scales
+ * every older row by sqrt(forgetting) as each new row arrives.
+ */
+
+/* Block size of the compact WY representation used by dtpqrt */
+#define PHP_LAPACK_LSQ_NB 32
+
+typedef struct _php_lapack_lsq_object {
+	double *r;				/* R, n x n upper triangular */
+	double *qtb;			/* Q^T . B, n x nrhs, NULL until the first rows */
+	int n;
+	int nrhs;
+	zend_long rows;
+	double forgetting;
+	zend_bool as_matrix;
+	zend_object std;
+} php_lapack_lsq_object;
+
+static inline php_lapack_lsq_object *php_lapack_lsq_from_obj(zend_object *obj) {
+	return (php_lapack_lsq_object *)((char *)(obj) - XtOffsetOf(php_lapack_lsq_object, std));
+}
+
+#define Z_LAPACK_LSQ_P(zv) php_lapack_lsq_from_obj(Z_OBJ_P(zv))
+
+static zend_class_entry *php_lapack_lsq_sc_entry;
+static zend_object_handlers lapack_lsq_object_handlers;
+
+/* --- Helper Functions --- */
+
+/* {{{ static php_lapack_lsq_object* php_lapack_lsq_fetch(zval *object)
+Return the accumulator behind object, or throw if it was never filled in.
+*/
+static php_lapack_lsq_object* php_lapack_lsq_fetch(zval *object)
+{
+	php_lapack_lsq_object *intern = Z_LAPACK_LSQ_P(object);
+
+	if (intern->r == NULL) {
+		zend_throw_exception(php_lapack_exception_sc_entry, "Accumulator is not initialised", 104);
+		return NULL;
+	}
+
+	return intern;
+}
+/* }}} */
+
+/* {{{ static void php_lapack_lsq_forget(php_lapack_lsq_object *intern, double *al, double *bl, int k)
+Weight a chunk of k rows and the rows already merged, so that every row is
+scaled by sqrt(forgetting) once for each row that arrived after it.
+*/
+static void php_lapack_lsq_forget(php_lapack_lsq_object *intern, double *al, double *bl, int k)
+{
+	double w;
+	size_t i, j;
+
+	w = sqrt(pow(intern->forgetting, k));
+	for (i = 0; i < (size_t)intern->n * intern->n; i++) {
+		intern->r[i] *= w;
+	}
+	for (i = 0; i < (size_t)intern->n * intern->nrhs; i++) {
+		intern->qtb[i] *= w;
+	}
+
+	for (i = 0; i < (size_t)k; i++) {
+		w = sqrt(pow(intern->forgetting, k - 1 - (int)i));
+		for (j = 0; j < (size_t)intern->n; j++) {
+			al[i + j * k] *= w;
+		}
+		for (j = 0; j < (size_t)intern->nrhs; j++) {
+			bl[i + j * k] *= w;
+		}
+	}
+}
+/* }}} */
+
+/* --- Object Handlers --- */
+
+static void php_lapack_lsq_object_free(zend_object *object)
+{
+	php_lapack_lsq_object *intern = php_lapack_lsq_from_obj(object);
+
+	php_lapack_free(intern->r);
+	php_lapack_free(intern->qtb);
+	zend_object_std_dtor(&intern->std);
+}
+
+static zend_object *php_lapack_lsq_object_new(zend_class_entry *class_type)
+{
+	php_lapack_lsq_object *intern;
+
+	intern = zend_object_alloc(sizeof(php_lapack_lsq_object), class_type);
+	intern->r = NULL;
+	intern->qtb = NULL;
+	intern->n = intern->nrhs = 0;
+	intern->rows = 0;
+	intern->forgetting = 1.0;
+	intern->as_matrix = 0;
+
+	zend_object_std_init(&intern->std, class_type);
+	object_properties_init(&intern->std, class_type);
+	intern->std.handlers = &lapack_lsq_object_handlers;
+
+	return &intern->std;
+}
+
+/* --- Lapack Methods --- */
+
+/* {{{ LapackLeastSquares Lapack::leastSquaresStream(int n [, float ridge [, float forgetting]]);
+Start a least squares problem in n unknowns whose rows will be added a chunk
+at a time. ridge adds ridge . ||X||^2 to the objective. With forgetting
+below 1, each row counts forgetting times less than the row after it.
+*/
+PHP_METHOD(Lapack, leastSquaresStream)
+{
+	php_lapack_lsq_object *intern;
+	zend_long n;
+	double ridge = 0.0, forgetting = 1.0;
+	int i;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS(), "l|dd", &n, &ridge, &forgetting) == FAILURE) {
+		return;
+	}
+
+	if (n < 1 || n > INT_MAX) {
+		LAPACK_THROW("Invalid input size - must be 1 or greater", 102);
+	}
+
+	if (!(ridge >= 0.0)) {
+		LAPACK_THROW("Invalid ridge - must be 0 or greater", 102);
+	}
+
+	if (!(forgetting > 0.0 && forgetting <= 1.0)) {
+		LAPACK_THROW("Invalid forgetting factor - must be greater than 0 and at most 1", 102);
+	}
+
+	object_init_ex(return_value, php_lapack_lsq_sc_entry);
+	intern = Z_LAPACK_LSQ_P(return_value);
+	intern->n = n;
+	intern->forgetting = forgetting;
+	intern->r = php_lapack_alloc((size_t)n * n);
+	memset(intern->r, 0, (size_t)n * n * sizeof(double));
+	for (i = 0; i < n; i++) {
+		intern->r[i + (size_t)i * n] = sqrt(ridge);
+	}
+
+	return;
+}
+/* }}} */
+
+/* --- LapackLeastSquares Methods --- */
+
+/* {{{ int LapackLeastSquares::addRows(array|LapackMatrix A, array|LapackMatrix B);
+Merge a chunk of rows of A (n columns) and the matching rows of B into the
+accumulator. B must have the same number of columns in every chunk. Returns
+the number of rows added so far.
+*/
+PHP_METHOD(LapackLeastSquares, addRows)
+{
+	zval *A, *B;
+	php_lapack_lsq_object *intern;
+	double *al, *bl, *t, *work;
+	lapack_int info, nb;
+	int k, m, n, nrhs;
+	zend_bool as_matrix = 0;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS(), "zz", &A, &B) == FAILURE) {
+		return;
+	}
+
+	intern = php_lapack_lsq_fetch(ZEND_THIS);
+	if (intern == NULL) {
+		return;
+	}
+
+	if (php_lapack_operand_shape(A, &k, &n, &as_matrix) == FAILURE) {
+		LAPACK_THROW("Invalid input matrix - argument 1", 102);
+	} else if (n != intern->n) {
+		LAPACK_THROW("Invalid input matrix - argument 1, wrong number of columns", 102);
+	}
+
+	if (php_lapack_operand_shape(B, &m, &nrhs, &as_matrix) == FAILURE) {
+		LAPACK_THROW("Invalid input matrix - argument 2", 102);
+	} else if (m != k) {
+		LAPACK_THROW("Invalid input matrix - argument 2, wrong number of rows", 102);
+	} else if (intern->qtb != NULL && nrhs != intern->nrhs) {
+		LAPACK_THROW("Invalid input matrix - argument 2, wrong number of columns", 102);
+	}
+
+	php_lapack_arena_begin();
+
+	al = php_lapack_arena_alloc((size_t)k * n, sizeof(double));
+	bl = php_lapack_arena_alloc((size_t)k * nrhs, sizeof(double));
+	if (php_lapack_linearize_operand_into(A, al, k, n, k) == FAILURE) {
+		LAPACK_THROW("Invalid input matrix - argument 1", 102);
+	}
+	if (php_lapack_linearize_operand_into(B, bl, k, nrhs, k) == FAILURE) {
+		LAPACK_THROW("Invalid input matrix - argument 2", 102);
+	}
+
+	if (intern->qtb == NULL) {
+		intern->nrhs = nrhs;
+		intern->qtb = php_lapack_alloc((size_t)n * nrhs);
+		memset(intern->qtb, 0, (size_t)n * nrhs * sizeof(double));
+	}
+	intern->as_matrix |= as_matrix;
+
+	if (intern->forgetting < 1.0) {
+		php_lapack_lsq_forget(intern, al, bl, k);
+	}
+
+	/* QR of [R; A] into the new R, with the same reflectors taking
+	   [Q^T . B; B] to the new Q^T . B */
+	nb = n < PHP_LAPACK_LSQ_NB ? n : PHP_LAPACK_LSQ_NB;
+	t = php_lapack_arena_alloc((size_t)nb * n, sizeof(double));
+	work = php_lapack_arena_alloc((size_t)nb * (n > nrhs ? n : nrhs), sizeof(double));
+
+	php_lapack_blas_threads_for((double)k * n * (n + nrhs));
+	info = LAPACKE_dtpqrt_work( LAPACK_COL_MAJOR, k, n, 0, nb, intern->r, n, al, k, t, nb, work );
+	if (info == 0) {
+		info = LAPACKE_dtpmqrt_work( LAPACK_COL_MAJOR, 'L', 'T', k, nrhs, n, 0, nb, al, k, t, nb,
+									 intern->qtb, n, bl, k, work );
+	}
+	php_lapack_stats_info(info);
+	if (info != 0) {
+		LAPACK_THROW("Invalid input matrix", 102);
+	}
+
+	intern->rows += k;
+
+	RETURN_LONG(intern->rows);
+}
+/* }}} */
+
+/* {{{ array LapackLeastSquares::solve();
+Return the n x nrhs least squares solution X for the rows added so far. The
+accumulator is left as it was, so more rows can be added and solved again.
+Returns an empty array before any rows are added or when R is singular.
+*/
+PHP_METHOD(LapackLeastSquares, solve)
+{
+	php_lapack_lsq_object *intern;
+	double *x;
+	lapack_int info;
+
+	if (zend_parse_parameters_none() == FAILURE) {
+		return;
+	}
+
+	intern = php_lapack_lsq_fetch(ZEND_THIS);
+	if (intern == NULL) {
+		return;
+	}
+
+	if (intern->qtb == NULL) {
+		array_init(return_value);
+		return;
+	}
+
+	x = php_lapack_alloc((size_t)intern->n * intern->nrhs);
+	memcpy(x, intern->qtb, (size_t)intern->n * intern->nrhs * sizeof(double));
+
+	info = LAPACKE_dtrtrs_work( LAPACK_COL_MAJOR, 'U', 'N', 'N', intern->n, intern->nrhs,
+								intern->r, intern->n, x, intern->n );
+	php_lapack_stats_info(info);
+	if (info != 0) {
+		php_lapack_free(x);
+		array_init(return_value);
+		return;
+	}
+
+	php_lapack_return_matrix(return_value, &x, intern->n, intern->nrhs, intern->n, intern->as_matrix);
+	php_lapack_free(x);
+
+	return;
+}
+/* }}} */
+
+/* --- ARGUMENTS AND INIT --- */
+
+ZEND_BEGIN_ARG_INFO_EX(lapack_lsq_empty_args, 0, 0, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(lapack_lsq_add_rows_args, 0, 0, 2)
+	ZEND_ARG_INFO(0, A)
+	ZEND_ARG_INFO(0, B)
+ZEND_END_ARG_INFO()
+
+static const zend_function_entry php_lapack_lsq_class_methods[] =
+{
+	PHP_ME(LapackLeastSquares, addRows,	lapack_lsq_add_rows_args, ZEND_ACC_PUBLIC)
+	PHP_ME(LapackLeastSquares, solve,	lapack_lsq_empty_args, ZEND_ACC_PUBLIC)
+	PHP_FE_END
+};
+
+PHP_MINIT_FUNCTION(lapack_lsq)
+{
+	zend_class_entry ce;
+	memcpy(&lapack_lsq_object_handlers, zend_get_std_object_handlers(), sizeof(zend_object_handlers));
+	lapack_lsq_object_handlers.offset = XtOffsetOf(php_lapack_lsq_object, std);
+	lapack_lsq_object_handlers.free_obj = php_lapack_lsq_object_free;
+	lapack_lsq_object_handlers.clone_obj = NULL;
+
+	INIT_CLASS_ENTRY(ce, "LapackLeastSquares", php_lapack_lsq_class_methods);
+	ce.create_object = php_lapack_lsq_object_new;
+	php_lapack_lsq_sc_entry = zend_register_internal_class(&ce);
+	php_lapack_lsq_sc_entry->ce_flags |= ZEND_ACC_FINAL;
+
+	return SUCCESS;
+}
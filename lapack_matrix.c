@@ -0,0 +1,522 @@
+/*
+  +----------------------------------------------------------------------+
+  | PHP Version 5 / lapack                                               |
+  +----------------------------------------------------------------------+
+  | Copyright (c) 2012 Ian Barber                                        |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 3.0 of the PHP license,       |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.php.net/license/3_0.txt.                                  |
+  | If you did not receive a copy of the PHP license and are unable to   |
+  | obtain it through the world-wide-web, please send a note to          |
+  | license@php.net so we can mail you a copy immediately.               |
+  +----------------------------------------------------------------------+
+  | Authors: Ian Barber <ian.barber@gmail.com>                           |
+  +----------------------------------------------------------------------+
+*/
+
+#include "php_lapack.h"
+#include "php_lapack_internal.h"
+#include "Zend/zend_exceptions.h"
+
+#ifdef HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+#endif
+
+zend_class_entry *php_lapack_matrix_sc_entry;
+static zend_object_handlers lapack_matrix_object_handlers;
+
+/* --- Helper Functions --- */
+
+/* {{{ double* php_lapack_alloc(size_t count)
+Allocate a buffer of count doubles aligned to PHP_LAPACK_ALIGNMENT. The
+original pointer is kept just in front of the aligned block.
+*/
+double* php_lapack_alloc(size_t count)
+{
+	char *raw, *aligned;
+
+	raw = safe_emalloc(count, sizeof(double), PHP_LAPACK_ALIGNMENT);
+	aligned = (char *)(((zend_uintptr_t)raw + PHP_LAPACK_ALIGNMENT) & ~((zend_uintptr_t)PHP_LAPACK_ALIGNMENT - 1));
+	((void **)aligned)[-1] = raw;
+
+	return (double *)aligned;
+}
+/* }}} */
+
+/* {{{ void php_lapack_free(double *ptr)
+Release a buffer allocated by php_lapack_alloc. NULL is ignored.
+*/
+void php_lapack_free(double *ptr)
+{
+	if (ptr != NULL) {
+		efree(((void **)ptr)[-1]);
+	}
+}
+/* }}} */
+
+/* {{{ void php_lapack_transpose(const double *in, int m, int n, int ldin, double *out, int ldout)
+Transpose the m x n column-major matrix in into the n x m column-major
+matrix out, one PHP_LAPACK_BLOCK square tile at a time so that both the
+reads and the writes stay within a few cache lines.
+*/
+void php_lapack_transpose(const double *in, int m, int n, int ldin, double *out, int ldout)
+{
+	int ib, jb, i, j, imax, jmax;
+
+	for (jb = 0; jb < n; jb += PHP_LAPACK_BLOCK) {
+		jmax = (jb + PHP_LAPACK_BLOCK < n) ? jb + PHP_LAPACK_BLOCK : n;
+		for (ib = 0; ib < m; ib += PHP_LAPACK_BLOCK) {
+			imax = (ib + PHP_LAPACK_BLOCK < m) ? ib + PHP_LAPACK_BLOCK : m;
+			for (i = ib; i < imax; i++) {
+				for (j = jb; j < jmax; j++) {
+					out[j + (size_t)i * ldout] = in[i + (size_t)j * ldin];
+				}
+			}
+		}
+	}
+}
+/* }}} */
+
+/* {{{ static php_lapack_matrix_object* php_lapack_operand_matrix(zval *operand)
+Return the LapackMatrix behind operand, or NULL if it is not an initialised
+LapackMatrix.
+*/
+static php_lapack_matrix_object* php_lapack_operand_matrix(zval *operand)
+{
+	php_lapack_matrix_object *intern;
+
+	if (Z_TYPE_P(operand) != IS_OBJECT || !instanceof_function(Z_OBJCE_P(operand), php_lapack_matrix_sc_entry)) {
+		return NULL;
+	}
+
+	intern = Z_LAPACK_MATRIX_P(operand);
+
+	return intern->data != NULL ? intern : NULL;
+}
+/* }}} */
+
+/* {{{ int php_lapack_operand_shape(zval *operand, int *m, int *n, zend_bool *is_matrix)
+Read the dimensions of a PHP array of arrays or a LapackMatrix. is_matrix is
+set when the operand was a LapackMatrix and left alone otherwise, so it can
+be accumulated over several arguments.
+*/
+int php_lapack_operand_shape(zval *operand, int *m, int *n, zend_bool *is_matrix)
+{
+	php_lapack_matrix_object *intern;
+
+	if (Z_TYPE_P(operand) == IS_ARRAY) {
+		return php_lapack_array_shape(operand, m, n);
+	}
+
+	intern = php_lapack_operand_matrix(operand);
+	if (intern == NULL) {
+		return FAILURE;
+	}
+
+	*m = intern->m;
+	*n = intern->n;
+
+	if (is_matrix != NULL) {
+		*is_matrix = 1;
+	}
+
+	return SUCCESS;
+}
+/* }}} */
+
+/* {{{ int php_lapack_linearize_operand_into(zval *operand, double *outarray, int m, int n, int ld)
+Write an m x n PHP array of arrays or LapackMatrix into outarray in
+column-major order with leading dimension ld.
+*/
+int php_lapack_linearize_operand_into(zval *operand, double *outarray, int m, int n, int ld)
+{
+	php_lapack_matrix_object *intern;
+	uint64_t start;
+	int j;
+
+	if (Z_TYPE_P(operand) == IS_ARRAY) {
+		return php_lapack_linearize_array_into(operand, outarray, m, n, ld);
+	}
+
+	intern = php_lapack_operand_matrix(operand);
+	if (intern == NULL || intern->m != m || intern->n != n) {
+		return FAILURE;
+	}
+
+	start = php_lapack_stats_clock();
+
+	if (intern->ld == m && ld == m) {
+		memcpy(outarray, intern->data, (size_t)m * n * sizeof(double));
+	} else {
+		for (j = 0; j < n; j++) {
+			memcpy(outarray + (size_t)j * ld, intern->data + (size_t)j * intern->ld, m * sizeof(double));
+		}
+	}
+
+	php_lapack_stats_phase(PHP_LAPACK_STATS_CONVERT, start, (size_t)m * n * sizeof(double));
+
+	return SUCCESS;
+}
+/* }}} */
+
+/* {{{ double* php_lapack_linearize_operand(zval *operand, int *m, int *n, zend_bool *is_matrix)
+Return a fresh column-major copy of either a PHP array of arrays or a
+LapackMatrix, suitable for passing to LAPACK routines that overwrite their
+input. is_matrix is set as for php_lapack_operand_shape.
+*/
+double* php_lapack_linearize_operand(zval *operand, int *m, int *n, zend_bool *is_matrix)
+{
+	double *outarray;
+
+	if (Z_TYPE_P(operand) == IS_ARRAY) {
+		return php_lapack_linearize_array(operand, m, n);
+	}
+
+	if (php_lapack_operand_shape(operand, m, n, is_matrix) == FAILURE) {
+		return NULL;
+	}
+
+	outarray = php_lapack_alloc((size_t)*m * *n);
+	php_lapack_linearize_operand_into(operand, outarray, *m, *n, *m);
+
+	return outarray;
+}
+/* }}} */
+
+/* {{{ void php_lapack_matrix_wrap(zval *object, double *data, int m, int n, int ld)
+Create a LapackMatrix in object which takes ownership of data. data must
+come from php_lapack_alloc.
+*/
+void php_lapack_matrix_wrap(zval *object, double *data, int m, int n, int ld)
+{
+	php_lapack_matrix_object *intern;
+
+	object_init_ex(object, php_lapack_matrix_sc_entry);
+	intern = Z_LAPACK_MATRIX_P(object);
+	intern->data = data;
+	intern->m = m;
+	intern->n = n;
+	intern->ld = ld;
+}
+/* }}} */
+
+/* {{{ void php_lapack_return_matrix(zval *return_value, double **data, int m, int n, int ld, zend_bool as_matrix)
+Return a result either as a LapackMatrix (taking ownership of the buffer
+and clearing *data) or as a PHP array of arrays.
+*/
+void php_lapack_return_matrix(zval *return_value, double **data, int m, int n, int ld, zend_bool as_matrix)
+{
+	if (as_matrix) {
+		php_lapack_matrix_wrap(return_value, *data, m, n, ld);
+		*data = NULL;
+	} else {
+		php_lapack_reassemble_array(return_value, *data, m, n, ld);
+	}
+}
+/* }}} */
+
+/* {{{ zend_bool php_lapack_output_wanted(zval *output)
+Whether an optional by-reference output argument was asked for, which as
+with the eigenvectors of Lapack::eigenValues means an array was passed.
+*/
+zend_bool php_lapack_output_wanted(zval *output)
+{
+	return output != NULL && Z_ISREF_P(output) && Z_TYPE_P(Z_REFVAL_P(output)) == IS_ARRAY;
+}
+/* }}} */
+
+/* {{{ void php_lapack_assign_matrix(zval *output, double **data, int m, int n, int ld, zend_bool as_matrix)
+Replace the by-reference output with a result, as php_lapack_return_matrix
+would return it.
+*/
+void php_lapack_assign_matrix(zval *output, double **data, int m, int n, int ld, zend_bool as_matrix)
+{
+	zval result;
+
+	php_lapack_return_matrix(&result, data, m, n, ld, as_matrix);
+	ZEND_TRY_ASSIGN_REF_TMP(output, &result);
+}
+/* }}} */
+
+/* {{{ static void php_lapack_matrix_release(php_lapack_matrix_object *intern)
+Drop whatever storage currently backs the matrix.
+*/
+static void php_lapack_matrix_release(php_lapack_matrix_object *intern)
+{
+	if (intern->buffer != NULL) {
+		zend_string_release(intern->buffer);
+		intern->buffer = NULL;
+	} else if (intern->cache != NULL) {
+		php_lapack_cache_release(intern->cache);
+		intern->cache = NULL;
+#ifdef HAVE_MMAP
+	} else if (intern->map != NULL) {
+		munmap(intern->map, intern->map_len);
+		intern->map = NULL;
+#endif
+	} else {
+		php_lapack_free(intern->data);
+	}
+	intern->data = NULL;
+}
+/* }}} */
+
+/* --- Object Handlers --- */
+
+static void php_lapack_matrix_object_free(zend_object *object)
+{
+	php_lapack_matrix_object *intern = php_lapack_matrix_from_obj(object);
+
+	php_lapack_matrix_release(intern);
+	zend_object_std_dtor(&intern->std);
+}
+
+static zend_object *php_lapack_matrix_object_new(zend_class_entry *class_type)
+{
+	php_lapack_matrix_object *intern;
+
+	intern = zend_object_alloc(sizeof(php_lapack_matrix_object), class_type);
+	intern->data = NULL;
+	intern->m = intern->n = intern->ld = 0;
+	intern->buffer = NULL;
+	intern->map = NULL;
+	intern->map_len = 0;
+	intern->cache = NULL;
+
+	zend_object_std_init(&intern->std, class_type);
+	object_properties_init(&intern->std, class_type);
+	intern->std.handlers = &lapack_matrix_object_handlers;
+
+	return &intern->std;
+}
+
+/* --- LapackMatrix Methods --- */
+
+/* {{{ LapackMatrix::__construct(array A);
+Convert a PHP array of arrays into a column-major matrix.
+*/
+PHP_METHOD(LapackMatrix, __construct)
+{
+	zval *a;
+	php_lapack_matrix_object *intern;
+	double *al;
+	int m, n;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS(), "a", &a) == FAILURE) {
+		return;
+	}
+
+	al = php_lapack_linearize_array(a, &m, &n);
+	if (al == NULL) {
+		LAPACK_THROW("Invalid input matrix", 102);
+	}
+
+	intern = Z_LAPACK_MATRIX_P(ZEND_THIS);
+	php_lapack_matrix_release(intern);
+	intern->data = al;
+	intern->m = m;
+	intern->n = n;
+	intern->ld = m;
+
+	return;
+}
+/* }}} */
+
+/* {{{ LapackMatrix LapackMatrix::fromString(string data, int rows, int columns [, int layout]);
+Create a matrix from a binary string of doubles in machine byte order, as
+produced by pack('d*'). A column-major string is used in place without
+being copied; a row-major one is transposed once into an aligned buffer.
+*/
+PHP_METHOD(LapackMatrix, fromString)
+{
+	zend_string *str;
+	php_lapack_matrix_object *intern;
+	zend_long rows, cols, layout = PHP_LAPACK_COL_MAJOR;
+	double *al;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS(), "Sll|l", &str, &rows, &cols, &layout) == FAILURE) {
+		return;
+	}
+
+	if (rows < 1 || cols < 1 || rows > INT_MAX || cols > INT_MAX) {
+		LAPACK_THROW("Invalid input size - must be 1 or greater", 102);
+	}
+
+	if (layout != PHP_LAPACK_ROW_MAJOR && layout != PHP_LAPACK_COL_MAJOR) {
+		LAPACK_THROW("Invalid layout - must be LapackMatrix::ROW_MAJOR or LapackMatrix::COL_MAJOR", 102);
+	}
+
+	if (ZSTR_LEN(str) / sizeof(double) / (size_t)cols != (size_t)rows ||
+		ZSTR_LEN(str) != (size_t)rows * (size_t)cols * sizeof(double)) {
+		LAPACK_THROW("Invalid input buffer - length does not match rows x columns doubles", 102);
+	}
+
+	object_init_ex(return_value, php_lapack_matrix_sc_entry);
+	intern = Z_LAPACK_MATRIX_P(return_value);
+	intern->m = rows;
+	intern->n = cols;
+	intern->ld = rows;
+
+	if (layout == PHP_LAPACK_COL_MAJOR) {
+		intern->buffer = zend_string_copy(str);
+		intern->data = (double *)ZSTR_VAL(str);
+	} else {
+		/* A row-major rows x cols matrix is a column-major cols x rows one */
+		al = php_lapack_alloc((size_t)rows * cols);
+		php_lapack_transpose((const double *)ZSTR_VAL(str), cols, rows, cols, al, rows);
+		intern->data = al;
+	}
+
+	return;
+}
+/* }}} */
+
+/* {{{ string LapackMatrix::toString([int layout]);
+Return the matrix as a binary string of doubles in machine byte order,
+suitable for unpack('d*') or writing straight to a file.
+*/
+PHP_METHOD(LapackMatrix, toString)
+{
+	php_lapack_matrix_object *intern;
+	zend_long layout = PHP_LAPACK_COL_MAJOR;
+	zend_string *result;
+	double *out;
+	size_t len;
+	int j;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS(), "|l", &layout) == FAILURE) {
+		return;
+	}
+
+	if (layout != PHP_LAPACK_ROW_MAJOR && layout != PHP_LAPACK_COL_MAJOR) {
+		LAPACK_THROW("Invalid layout - must be LapackMatrix::ROW_MAJOR or LapackMatrix::COL_MAJOR", 102);
+	}
+
+	intern = Z_LAPACK_MATRIX_P(ZEND_THIS);
+	if (intern->data == NULL) {
+		LAPACK_THROW("Matrix is not initialised", 104);
+	}
+
+	len = (size_t)intern->m * intern->n * sizeof(double);
+	result = zend_string_safe_alloc((size_t)intern->m * intern->n, sizeof(double), 0, 0);
+	out = (double *)ZSTR_VAL(result);
+
+	if (layout == PHP_LAPACK_ROW_MAJOR) {
+		php_lapack_transpose(intern->data, intern->m, intern->n, intern->ld, out, intern->n);
+	} else if (intern->ld == intern->m) {
+		memcpy(out, intern->data, len);
+	} else {
+		for (j = 0; j < intern->n; j++) {
+			memcpy(out + (size_t)j * intern->m, intern->data + (size_t)j * intern->ld, intern->m * sizeof(double));
+		}
+	}
+	ZSTR_VAL(result)[len] = '\0';
+
+	RETURN_NEW_STR(result);
+}
+/* }}} */
+
+/* {{{ array LapackMatrix::toArray();
+Return the matrix as a PHP array of arrays.
+*/
+PHP_METHOD(LapackMatrix, toArray)
+{
+	php_lapack_matrix_object *intern;
+
+	if (zend_parse_parameters_none() == FAILURE) {
+		return;
+	}
+
+	intern = Z_LAPACK_MATRIX_P(ZEND_THIS);
+	if (intern->data == NULL) {
+		LAPACK_THROW("Matrix is not initialised", 104);
+	}
+
+	php_lapack_reassemble_array(return_value, intern->data, intern->m, intern->n, intern->ld);
+
+	return;
+}
+/* }}} */
+
+/* {{{ int LapackMatrix::rows();
+Return the number of rows in the matrix.
+*/
+PHP_METHOD(LapackMatrix, rows)
+{
+	php_lapack_matrix_object *intern;
+
+	if (zend_parse_parameters_none() == FAILURE) {
+		return;
+	}
+
+	intern = Z_LAPACK_MATRIX_P(ZEND_THIS);
+	RETURN_LONG(intern->m);
+}
+/* }}} */
+
+/* {{{ int LapackMatrix::columns();
+Return the number of columns in the matrix.
+*/
+PHP_METHOD(LapackMatrix, columns)
+{
+	php_lapack_matrix_object *intern;
+
+	if (zend_parse_parameters_none() == FAILURE) {
+		return;
+	}
+
+	intern = Z_LAPACK_MATRIX_P(ZEND_THIS);
+	RETURN_LONG(intern->n);
+}
+/* }}} */
+
+/* --- ARGUMENTS AND INIT --- */
+
+ZEND_BEGIN_ARG_INFO_EX(lapack_matrix_empty_args, 0, 0, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(lapack_matrix_construct_args, 0, 0, 1)
+	ZEND_ARG_INFO(0, a)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(lapack_matrix_from_string_args, 0, 0, 3)
+	ZEND_ARG_INFO(0, data)
+	ZEND_ARG_INFO(0, rows)
+	ZEND_ARG_INFO(0, columns)
+	ZEND_ARG_INFO(0, layout)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(lapack_matrix_to_string_args, 0, 0, 0)
+	ZEND_ARG_INFO(0, layout)
+ZEND_END_ARG_INFO()
+
+static const zend_function_entry php_lapack_matrix_class_methods[] =
+{
+	PHP_ME(LapackMatrix, __construct,	lapack_matrix_construct_args, ZEND_ACC_PUBLIC)
+	PHP_ME(LapackMatrix, fromString,	lapack_matrix_from_string_args, ZEND_ACC_PUBLIC | ZEND_ACC_STATIC)
+	PHP_ME(LapackMatrix, toString,		lapack_matrix_to_string_args, ZEND_ACC_PUBLIC)
+	PHP_ME(LapackMatrix, toArray,		lapack_matrix_empty_args, ZEND_ACC_PUBLIC)
+	PHP_ME(LapackMatrix, rows,			lapack_matrix_empty_args, ZEND_ACC_PUBLIC)
+	PHP_ME(LapackMatrix, columns,		lapack_matrix_empty_args, ZEND_ACC_PUBLIC)
+	PHP_FE_END
+};
+
+PHP_MINIT_FUNCTION(lapack_matrix)
+{
+	zend_class_entry ce;
+	memcpy(&lapack_matrix_object_handlers, zend_get_std_object_handlers(), sizeof(zend_object_handlers));
+
+	INIT_CLASS_ENTRY(ce, "LapackMatrix", php_lapack_matrix_class_methods);
+	ce.create_object = php_lapack_matrix_object_new;
+	lapack_matrix_object_handlers.offset = XtOffsetOf(php_lapack_matrix_object, std);
+	lapack_matrix_object_handlers.free_obj = php_lapack_matrix_object_free;
+	lapack_matrix_object_handlers.clone_obj = NULL;
+	php_lapack_matrix_sc_entry = zend_register_internal_class(&ce);
+
+	zend_declare_class_constant_long(php_lapack_matrix_sc_entry, "ROW_MAJOR", sizeof("ROW_MAJOR")-1, PHP_LAPACK_ROW_MAJOR);
+	zend_declare_class_constant_long(php_lapack_matrix_sc_entry, "COL_MAJOR", sizeof("COL_MAJOR")-1, PHP_LAPACK_COL_MAJOR);
+
+	return SUCCESS;
+}
@@ -0,0 +1,344 @@
+/*
+  +----------------------------------------------------------------------+
+  | PHP Version 5 / lapack                                               |
+  +----------------------------------------------------------------------+
+  | Copyright (c) 2012 Ian Barber                                        |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 3.0 of the PHP license,       |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.php.net/license/3_0.txt.                                  |
+  | If you did not receive a copy of the PHP license and are unable to   |
+  | obtain it through the world-wide-web, please send a note to          |
+  | license@php.net so we can mail you a copy immediately.               |
+  +----------------------------------------------------------------------+
+  | Authors: Ian Barber <ian.barber@gmail.com>                           |
+  +----------------------------------------------------------------------+
+*/
+
+#include "php_lapack.h"
+#include "php_lapack_internal.h"
+#include "Zend/zend_exceptions.h"
+
+#include "cblas.h"
+
+/*
+ * Matrix multiplication. Lapack::multiply() is a direct wrapper of dgemm.
+ * Lapack::multiplyChain() multiplies a list of matrices in the order that
+ * needs the fewest flops, found by the textbook dynamic programme over the
+ * dimensions. In both, a LapackMatrix operand is read in place and a
+ * transposed operand is handled by the BLAS transpose flag, so neither is
+ * ever copied.
+ */
+
+/* One factor of a product: op(A) is m x n, where A is stored with leading
+   dimension ld and op is a transpose when trans is set. slot is the
+   intermediate buffer the factor lives in, or -1 for an input. */
+typedef struct _php_lapack_factor_view {
+	double *data;
+	int m;
+	int n;
+	int ld;
+	zend_bool trans;
+	int slot;
+} php_lapack_factor_view;
+
+/* Intermediate products of a chain. A buffer is handed back as soon as the
+   product that reads it is formed, and reused for a later product that fits
+   in it. */
+typedef struct _php_lapack_chain_buffer {
+	double *data;
+	size_t size;
+	zend_bool busy;
+} php_lapack_chain_buffer;
+
+typedef struct _php_lapack_chain {
+	php_lapack_factor_view *views;
+	php_lapack_chain_buffer *buffers;
+	int *split;
+	int count;
+} php_lapack_chain;
+
+/* --- Helper Functions --- */
+
+/* {{{ static int php_lapack_factor_operand(zval *operand, zend_bool trans, php_lapack_factor_view *view, zend_bool *as_matrix)
+Describe operand as a factor. A LapackMatrix is used in place, an array is
+converted into an arena buffer.
+*/
+static int php_lapack_factor_operand(zval *operand, zend_bool trans, php_lapack_factor_view *view, zend_bool *as_matrix)
+{
+	php_lapack_matrix_object *intern;
+	int m, n;
+
+	if (php_lapack_operand_shape(operand, &m, &n, as_matrix) == FAILURE) {
+		return FAILURE;
+	}
+
+	if (Z_TYPE_P(operand) == IS_ARRAY) {
+		view->data = php_lapack_arena_alloc((size_t)m * n, sizeof(double));
+		if (php_lapack_linearize_operand_into(operand, view->data, m, n, m) == FAILURE) {
+			return FAILURE;
+		}
+		view->ld = m;
+	} else {
+		intern = Z_LAPACK_MATRIX_P(operand);
+		view->data = intern->data;
+		view->ld = intern->ld;
+	}
+
+	view->m = trans ? n : m;
+	view->n = trans ? m : n;
+	view->trans = trans;
+	view->slot = -1;
+
+	return SUCCESS;
+}
+/* }}} */
+
+/* {{{ static void php_lapack_factor_gemm(const php_lapack_factor_view *a, const php_lapack_factor_view *b, double alpha, double beta, double *c, int ldc)
+c = alpha . op(A) . op(B) + beta . c
+*/
+static void php_lapack_factor_gemm(const php_lapack_factor_view *a, const php_lapack_factor_view *b, double alpha, double beta, double *c, int ldc)
+{
+	php_lapack_blas_threads_for((double)a->m * b->n * a->n);
+	cblas_dgemm( CblasColMajor, a->trans ? CblasTrans : CblasNoTrans, b->trans ? CblasTrans : CblasNoTrans,
+				 a->m, b->n, a->n, alpha, a->data, a->ld, b->data, b->ld, beta, c, ldc );
+}
+/* }}} */
+
+/* {{{ static void php_lapack_chain_order(php_lapack_chain *ch)
+Fill ch->split so that split[i + j * count] is the k at which the product
+of factors i .. j is cheapest divided into (i .. k) . (k + 1 .. j).
+*/
+static void php_lapack_chain_order(php_lapack_chain *ch)
+{
+	double *cost, c;
+	int n = ch->count, len, i, j, k;
+
+	cost = php_lapack_arena_alloc((size_t)n * n, sizeof(double));
+	for (i = 0; i < n; i++) {
+		cost[i + (size_t)i * n] = 0.0;
+	}
+
+	for (len = 2; len <= n; len++) {
+		for (i = 0; i + len <= n; i++) {
+			j = i + len - 1;
+			cost[i + (size_t)j * n] = -1.0;
+			for (k = i; k < j; k++) {
+				c = cost[i + (size_t)k * n] + cost[(k + 1) + (size_t)j * n]
+					+ (double)ch->views[i].m * ch->views[k].n * ch->views[j].n;
+				if (cost[i + (size_t)j * n] < 0 || c < cost[i + (size_t)j * n]) {
+					cost[i + (size_t)j * n] = c;
+					ch->split[i + (size_t)j * n] = k;
+				}
+			}
+		}
+	}
+}
+/* }}} */
+
+/* {{{ static int php_lapack_chain_acquire(php_lapack_chain *ch, size_t size)
+Return a free intermediate buffer with room for size doubles, reusing the
+smallest free one that fits, and otherwise growing a free one.
+*/
+static int php_lapack_chain_acquire(php_lapack_chain *ch, size_t size)
+{
+	int i, best = -1, spare = -1;
+
+	for (i = 0; i < ch->count; i++) {
+		if (ch->buffers[i].busy) {
+			continue;
+		}
+		if (ch->buffers[i].size >= size) {
+			if (best < 0 || ch->buffers[i].size < ch->buffers[best].size) {
+				best = i;
+			}
+		} else if (spare < 0 || ch->buffers[spare].data == NULL) {
+			spare = i;
+		}
+	}
+
+	if (best < 0) {
+		best = spare;
+		php_lapack_free(ch->buffers[best].data);
+		ch->buffers[best].data = php_lapack_alloc(size);
+		ch->buffers[best].size = size;
+	}
+
+	ch->buffers[best].busy = 1;
+
+	return best;
+}
+/* }}} */
+
+/* {{{ static void php_lapack_chain_eval(php_lapack_chain *ch, int i, int j, php_lapack_factor_view *out)
+Multiply out factors i .. j in the order found by php_lapack_chain_order.
+*/
+static void php_lapack_chain_eval(php_lapack_chain *ch, int i, int j, php_lapack_factor_view *out)
+{
+	php_lapack_factor_view left, right;
+	int k;
+
+	if (i == j) {
+		*out = ch->views[i];
+		return;
+	}
+
+	k = ch->split[i + (size_t)j * ch->count];
+	php_lapack_chain_eval(ch, i, k, &left);
+	php_lapack_chain_eval(ch, k + 1, j, &right);
+
+	out->m = left.m;
+	out->n = right.n;
+	out->ld = left.m;
+	out->trans = 0;
+	out->slot = php_lapack_chain_acquire(ch, (size_t)out->m * out->n);
+	out->data = ch->buffers[out->slot].data;
+
+	php_lapack_factor_gemm(&left, &right, 1.0, 0.0, out->data, out->ld);
+
+	if (left.slot >= 0) {
+		ch->buffers[left.slot].busy = 0;
+	}
+	if (right.slot >= 0) {
+		ch->buffers[right.slot].busy = 0;
+	}
+}
+/* }}} */
+
+/* --- Lapack Methods --- */
+
+/* {{{ array Lapack::multiply(array|LapackMatrix A, array|LapackMatrix B [, bool transA [, bool transB [, float alpha [, float beta [, array|LapackMatrix C]]]]]);
+Return alpha . op(A) . op(B) + beta . C, where op transposes its argument
+when the matching flag is set. C defaults to zero, and otherwise must have
+the shape of the product.
+*/
+PHP_METHOD(Lapack, multiply)
+{
+	zval *A, *B, *C = NULL;
+	php_lapack_factor_view a, b;
+	double *r, alpha = 1.0, beta = 0.0;
+	zend_bool trans_a = 0, trans_b = 0, as_matrix = 0;
+	int m, n;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS(), "zz|bbddz!", &A, &B, &trans_a, &trans_b, &alpha, &beta, &C) == FAILURE) {
+		return;
+	}
+
+	php_lapack_arena_begin();
+
+	if (php_lapack_factor_operand(A, trans_a, &a, &as_matrix) == FAILURE) {
+		LAPACK_THROW("Invalid input matrix - argument 1", 102);
+	}
+	if (php_lapack_factor_operand(B, trans_b, &b, &as_matrix) == FAILURE) {
+		LAPACK_THROW("Invalid input matrix - argument 2", 102);
+	} else if (b.m != a.n) {
+		LAPACK_THROW("Invalid input matrix - argument 2, wrong number of rows", 102);
+	}
+
+	r = php_lapack_alloc((size_t)a.m * b.n);
+
+	if (C != NULL) {
+		if (php_lapack_operand_shape(C, &m, &n, &as_matrix) == FAILURE
+				|| m != a.m || n != b.n
+				|| php_lapack_linearize_operand_into(C, r, m, n, m) == FAILURE) {
+			php_lapack_free(r);
+			LAPACK_THROW("Invalid input matrix - argument 7 (C)", 102);
+		}
+	} else {
+		beta = 0.0;
+	}
+
+	php_lapack_factor_gemm(&a, &b, alpha, beta, r, a.m);
+
+	php_lapack_return_matrix(return_value, &r, a.m, b.n, a.m, as_matrix);
+	php_lapack_free(r);
+
+	return;
+}
+/* }}} */
+
+/* {{{ array Lapack::multiplyChain(array matrices [, array transpose]);
+Return the product of a list of matrices, multiplied in the order that takes
+the fewest flops. transpose is a list of flags, one per matrix in the same
+order, and a matrix whose flag is set is transposed.
+*/
+PHP_METHOD(Lapack, multiplyChain)
+{
+	zval *matrices, *transpose = NULL, *operand, *flag;
+	php_lapack_chain ch;
+	php_lapack_factor_view out;
+	zend_bool as_matrix = 0;
+	double *r;
+	int i, n;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS(), "a|a!", &matrices, &transpose) == FAILURE) {
+		return;
+	}
+
+	n = zend_hash_num_elements(Z_ARRVAL_P(matrices));
+	if (n == 0) {
+		LAPACK_THROW("Invalid input matrix - argument 1", 102);
+	}
+
+	php_lapack_arena_begin();
+
+	ch.count = n;
+	ch.views = php_lapack_arena_alloc(n, sizeof(php_lapack_factor_view));
+	ch.split = php_lapack_arena_alloc((size_t)n * n, sizeof(int));
+	ch.buffers = php_lapack_arena_alloc(n, sizeof(php_lapack_chain_buffer));
+	memset(ch.buffers, 0, (size_t)n * sizeof(php_lapack_chain_buffer));
+	memset(ch.views, 0, (size_t)n * sizeof(php_lapack_factor_view));
+
+	if (transpose != NULL) {
+		i = 0;
+		ZEND_HASH_FOREACH_VAL(Z_ARRVAL_P(transpose), flag) {
+			if (i == n) {
+				break;
+			}
+			ch.views[i++].trans = zend_is_true(flag);
+		} ZEND_HASH_FOREACH_END();
+	}
+
+	i = 0;
+	ZEND_HASH_FOREACH_VAL(Z_ARRVAL_P(matrices), operand) {
+		ZVAL_DEREF(operand);
+		if (php_lapack_factor_operand(operand, ch.views[i].trans, &ch.views[i], &as_matrix) == FAILURE) {
+			LAPACK_THROW("Invalid input matrix - argument 1", 102);
+		} else if (i > 0 && ch.views[i].m != ch.views[i - 1].n) {
+			LAPACK_THROW("Invalid input matrix - argument 1, matrices do not chain", 102);
+		}
+		i++;
+	} ZEND_HASH_FOREACH_END();
+
+	if (n == 1) {
+		r = php_lapack_alloc((size_t)ch.views[0].m * ch.views[0].n);
+		if (ch.views[0].trans) {
+			php_lapack_transpose(ch.views[0].data, ch.views[0].n, ch.views[0].m, ch.views[0].ld, r, ch.views[0].m);
+		} else {
+			for (i = 0; i < ch.views[0].n; i++) {
+				memcpy(r + (size_t)i * ch.views[0].m, ch.views[0].data + (size_t)i * ch.views[0].ld,
+					(size_t)ch.views[0].m * sizeof(double));
+			}
+		}
+		php_lapack_return_matrix(return_value, &r, ch.views[0].m, ch.views[0].n, ch.views[0].m, as_matrix);
+		php_lapack_free(r);
+		return;
+	}
+
+	php_lapack_chain_order(&ch);
+	php_lapack_chain_eval(&ch, 0, n - 1, &out);
+
+	/* The final product is handed over rather than copied */
+	r = ch.buffers[out.slot].data;
+	ch.buffers[out.slot].data = NULL;
+	for (i = 0; i < n; i++) {
+		php_lapack_free(ch.buffers[i].data);
+	}
+
+	php_lapack_return_matrix(return_value, &r, out.m, out.n, out.ld, as_matrix);
+	php_lapack_free(r);
+
+	return;
+}
+/* }}} */
@@ -0,0 +1,447 @@
+/*
+  +----------------------------------------------------------------------+
+  | PHP Version 5 / lapack                                               |
+  +----------------------------------------------------------------------+
+  | Copyright (c) 2012 Ian Barber                                        |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 3.0 of the PHP license,       |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.php.net/license/3_0.txt.                                  |
+  | If you did not receive a copy of the PHP license and are unable to   |
+  | obtain it through the world-wide-web, please send a note to          |
+  | license@php.net so we can mail you a copy immediately.               |
+  +----------------------------------------------------------------------+
+  | Authors: Ian Barber <ian.barber@gmail.com>                           |
+  +----------------------------------------------------------------------+
+*/
+
+#include "php_lapack.h"
+#include "php_lapack_internal.h"
+#include "Zend/zend_exceptions.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+#ifdef HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+#endif
+
+/*
+ * Matrix files in the NumPy .npy format: a short text header describing the
+ * element type, the ordering and the shape, followed by the raw elements.
+ * Lapack::save() writes float64 (or float32) in column-major ("Fortran")
+ * order, which is exactly the layout of a LapackMatrix. Lapack::load() of
+ * such a float64 file maps it read only and uses the mapping as the matrix
+ * storage, so nothing is copied and the pages are shared through the page
+ * cache between every process that loads the same file. Any other layout
+ * is converted into an ordinary buffer.
+ */
+
+#define PHP_LAPACK_NPY_MAGIC		"\x93NUMPY"
+#define PHP_LAPACK_NPY_MAGIC_LEN	6
+
+/* Upper bound on the header, which in practice is well under 256 bytes */
+#define PHP_LAPACK_NPY_MAX_HEADER	65536
+
+/* The header is padded so that the data starts on this boundary */
+#define PHP_LAPACK_NPY_ALIGN		64
+
+#ifdef WORDS_BIGENDIAN
+# define PHP_LAPACK_NPY_ORDER		'>'
+#else
+# define PHP_LAPACK_NPY_ORDER		'<'
+#endif
+
+/* A parsed header. size is the element size in bytes, 8 or 4. */
+typedef struct _php_lapack_npy_header {
+	size_t offset;
+	size_t size;
+	zend_bool fortran;
+	int m;
+	int n;
+} php_lapack_npy_header;
+
+/* --- Helper Functions --- */
+
+/* {{{ static const char *php_lapack_npy_key(const char *h, const char *key)
+Return the start of the value for key in the header dictionary, or NULL.
+*/
+static const char *php_lapack_npy_key(const char *h, const char *key)
+{
+	const char *p = strstr(h, key);
+
+	if (p == NULL || (p = strchr(p + strlen(key), ':')) == NULL) {
+		return NULL;
+	}
+	for (p++; *p == ' '; p++);
+
+	return p;
+}
+/* }}} */
+
+/* {{{ static int php_lapack_npy_parse(const char *h, php_lapack_npy_header *hdr)
+Read the element type, order and shape from the header dictionary, for
+example {'descr': '<f8', 'fortran_order': True, 'shape': (3, 4), }. Only
+float64 and float32 in machine byte order are accepted. A one dimensional
+array is read as a single row.
+*/
+static int php_lapack_npy_parse(const char *h, php_lapack_npy_header *hdr)
+{
+	const char *p;
+	char *end;
+	zend_long dims[2];
+	int ndims = 0;
+
+	p = php_lapack_npy_key(h, "'descr'");
+	if (p == NULL || (*p != '\'' && *p != '"') || (p[1] != PHP_LAPACK_NPY_ORDER && p[1] != '=') || p[2] != 'f') {
+		return FAILURE;
+	}
+	if (p[3] == '8' && p[4] == *p) {
+		hdr->size = sizeof(double);
+	} else if (p[3] == '4' && p[4] == *p) {
+		hdr->size = sizeof(float);
+	} else {
+		return FAILURE;
+	}
+
+	p = php_lapack_npy_key(h, "'fortran_order'");
+	if (p == NULL) {
+		return FAILURE;
+	}
+	hdr->fortran = strncmp(p, "True", 4) == 0;
+
+	p = php_lapack_npy_key(h, "'shape'");
+	if (p == NULL || *p != '(') {
+		return FAILURE;
+	}
+	for (p++; ; ) {
+		for (; *p == ' '; p++);
+		if (*p == ')') {
+			break;
+		}
+		if (ndims == 2) {
+			return FAILURE;
+		}
+		dims[ndims] = ZEND_STRTOL(p, &end, 10);
+		if (end == p || dims[ndims] < 1 || dims[ndims] > INT_MAX) {
+			return FAILURE;
+		}
+		ndims++;
+		for (p = end; *p == ' '; p++);
+		if (*p == ',') {
+			p++;
+		} else if (*p != ')') {
+			return FAILURE;
+		}
+	}
+
+	if (ndims == 0) {
+		return FAILURE;
+	}
+
+	hdr->m = ndims == 2 ? (int)dims[0] : 1;
+	hdr->n = ndims == 2 ? (int)dims[1] : (int)dims[0];
+
+	return SUCCESS;
+}
+/* }}} */
+
+/* {{{ static int php_lapack_npy_read_header(int fd, php_lapack_npy_header *hdr)
+Read and parse the magic string, version and header of an open file.
+*/
+static int php_lapack_npy_read_header(int fd, php_lapack_npy_header *hdr)
+{
+	unsigned char pre[PHP_LAPACK_NPY_MAGIC_LEN + 6];
+	size_t hlen, plen;
+	char *h;
+	int result;
+
+	if (read(fd, pre, sizeof(pre)) != sizeof(pre) || memcmp(pre, PHP_LAPACK_NPY_MAGIC, PHP_LAPACK_NPY_MAGIC_LEN) != 0) {
+		return FAILURE;
+	}
+
+	/* Version 1 has a two byte header length, versions 2 and 3 four */
+	if (pre[6] == 1) {
+		hlen = pre[8] | (pre[9] << 8);
+		plen = 10;
+	} else if (pre[6] == 2 || pre[6] == 3) {
+		hlen = pre[8] | (pre[9] << 8) | ((size_t)pre[10] << 16) | ((size_t)pre[11] << 24);
+		plen = 12;
+	} else {
+		return FAILURE;
+	}
+
+	if (hlen > PHP_LAPACK_NPY_MAX_HEADER) {
+		return FAILURE;
+	}
+
+	h = emalloc(hlen + 1);
+	if (lseek(fd, plen, SEEK_SET) != (off_t)plen || read(fd, h, hlen) != (ssize_t)hlen) {
+		efree(h);
+		return FAILURE;
+	}
+	h[hlen] = '\0';
+
+	hdr->offset = plen + hlen;
+	result = php_lapack_npy_parse(h, hdr);
+	efree(h);
+
+	return result;
+}
+/* }}} */
+
+#ifndef HAVE_MMAP
+/* {{{ static int php_lapack_npy_read(int fd, void *buf, size_t len, size_t offset)
+Read len bytes starting at offset.
+*/
+static int php_lapack_npy_read(int fd, void *buf, size_t len, size_t offset)
+{
+	ssize_t got;
+	char *p = buf;
+
+	if (lseek(fd, offset, SEEK_SET) != (off_t)offset) {
+		return FAILURE;
+	}
+
+	while (len > 0) {
+		got = read(fd, p, len > INT_MAX ? INT_MAX : len);
+		if (got <= 0) {
+			return FAILURE;
+		}
+		p += got;
+		len -= got;
+	}
+
+	return SUCCESS;
+}
+/* }}} */
+#endif
+
+/* {{{ static void php_lapack_npy_convert(const void *src, const php_lapack_npy_header *hdr, double *out)
+Convert the file elements into a column-major m x n buffer of doubles.
+*/
+static void php_lapack_npy_convert(const void *src, const php_lapack_npy_header *hdr, double *out)
+{
+	const float *f = src;
+	size_t i, j, m = hdr->m, n = hdr->n;
+
+	if (hdr->size == sizeof(double)) {
+		if (hdr->fortran) {
+			memcpy(out, src, m * n * sizeof(double));
+		} else {
+			/* A row-major m x n matrix is a column-major n x m one */
+			php_lapack_transpose(src, hdr->n, hdr->m, hdr->n, out, hdr->m);
+		}
+	} else if (hdr->fortran) {
+		for (i = 0; i < m * n; i++) {
+			out[i] = f[i];
+		}
+	} else {
+		for (i = 0; i < m; i++) {
+			for (j = 0; j < n; j++) {
+				out[i + j * m] = f[j + i * n];
+			}
+		}
+	}
+}
+/* }}} */
+
+/* {{{ static int php_lapack_npy_write(php_stream *stream, const void *buf, size_t len)
+Write all of buf, failing on a short write.
+*/
+static int php_lapack_npy_write(php_stream *stream, const void *buf, size_t len)
+{
+	return php_stream_write(stream, buf, len) == (ssize_t)len ? SUCCESS : FAILURE;
+}
+/* }}} */
+
+/* --- Lapack Methods --- */
+
+/* {{{ LapackMatrix Lapack::load(string path);
+Load a matrix from a .npy file. A column-major float64 file is mapped and
+used in place as read only storage; row-major and float32 files are
+converted. One dimensional files load as a single row.
+*/
+PHP_METHOD(Lapack, load)
+{
+	char *path;
+	size_t path_len;
+	php_lapack_npy_header hdr;
+	php_lapack_matrix_object *intern;
+	zend_stat_t st;
+	double *al;
+	void *src;
+	int fd;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS(), "p", &path, &path_len) == FAILURE) {
+		return;
+	}
+
+	if (php_check_open_basedir(path)) {
+		LAPACK_THROW("Unable to open matrix file", 106);
+	}
+
+	fd = VCWD_OPEN(path, O_RDONLY);
+	if (fd < 0) {
+		LAPACK_THROW("Unable to open matrix file", 106);
+	}
+
+	if (php_lapack_npy_read_header(fd, &hdr) == FAILURE) {
+		close(fd);
+		LAPACK_THROW("Invalid matrix file - must be a 1 or 2 dimensional float64 or float32 .npy file in machine byte order", 106);
+	}
+
+	if (zend_fstat(fd, &st) != 0 || (size_t)hdr.m * hdr.n > (SIZE_MAX - hdr.offset) / hdr.size
+			|| (zend_off_t)(hdr.offset + (size_t)hdr.m * hdr.n * hdr.size) > st.st_size) {
+		close(fd);
+		LAPACK_THROW("Invalid matrix file - shorter than its header says", 106);
+	}
+
+	object_init_ex(return_value, php_lapack_matrix_sc_entry);
+	intern = Z_LAPACK_MATRIX_P(return_value);
+	intern->m = hdr.m;
+	intern->n = hdr.n;
+	intern->ld = hdr.m;
+
+#ifdef HAVE_MMAP
+	src = mmap(NULL, hdr.offset + (size_t)hdr.m * hdr.n * hdr.size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (src == MAP_FAILED) {
+		zval_ptr_dtor(return_value);
+		ZVAL_NULL(return_value);
+		LAPACK_THROW("Unable to read matrix file", 106);
+	}
+
+	if (hdr.size == sizeof(double) && hdr.fortran && hdr.offset % sizeof(double) == 0) {
+		intern->map = src;
+		intern->map_len = hdr.offset + (size_t)hdr.m * hdr.n * hdr.size;
+		intern->data = (double *)((char *)src + hdr.offset);
+		return;
+	}
+
+	al = php_lapack_alloc((size_t)hdr.m * hdr.n);
+	php_lapack_npy_convert((char *)src + hdr.offset, &hdr, al);
+	munmap(src, hdr.offset + (size_t)hdr.m * hdr.n * hdr.size);
+	intern->data = al;
+#else
+	al = php_lapack_alloc((size_t)hdr.m * hdr.n);
+	if (hdr.size == sizeof(double) && hdr.fortran) {
+		src = NULL;
+		if (php_lapack_npy_read(fd, al, (size_t)hdr.m * hdr.n * hdr.size, hdr.offset) == FAILURE) {
+			goto read_failed;
+		}
+	} else {
+		src = safe_emalloc((size_t)hdr.m * hdr.n, hdr.size, 0);
+		if (php_lapack_npy_read(fd, src, (size_t)hdr.m * hdr.n * hdr.size, hdr.offset) == FAILURE) {
+			goto read_failed;
+		}
+		php_lapack_npy_convert(src, &hdr, al);
+		efree(src);
+	}
+	close(fd);
+	intern->data = al;
+	return;
+
+read_failed:
+	if (src != NULL) {
+		efree(src);
+	}
+	php_lapack_free(al);
+	close(fd);
+	zval_ptr_dtor(return_value);
+	ZVAL_NULL(return_value);
+	LAPACK_THROW("Unable to read matrix file", 106);
+#endif
+
+	return;
+}
+/* }}} */
+
+/* {{{ bool Lapack::save(string path, array|LapackMatrix A [, bool single]);
+Write A to a .npy file in column-major order, as float64 or, with single
+set, as float32.
+*/
+PHP_METHOD(Lapack, save)
+{
+	char *path, header[256];
+	size_t path_len, hlen, size;
+	zval *A;
+	zend_bool single = 0;
+	php_lapack_matrix_object *intern;
+	php_stream *stream;
+	double *al;
+	float *col;
+	int i, j, m, n, ld, pad, result = SUCCESS;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS(), "pz|b", &path, &path_len, &A, &single) == FAILURE) {
+		return;
+	}
+
+	if (php_lapack_operand_shape(A, &m, &n, NULL) == FAILURE) {
+		LAPACK_THROW("Invalid input matrix - argument 2", 102);
+	}
+
+	php_lapack_arena_begin();
+
+	if (Z_TYPE_P(A) == IS_ARRAY) {
+		al = php_lapack_arena_alloc((size_t)m * n, sizeof(double));
+		if (php_lapack_linearize_operand_into(A, al, m, n, m) == FAILURE) {
+			LAPACK_THROW("Invalid input matrix - argument 2", 102);
+		}
+		ld = m;
+	} else {
+		intern = Z_LAPACK_MATRIX_P(A);
+		al = intern->data;
+		ld = intern->ld;
+	}
+
+	/* Version 1.0 header, padded with spaces and ended by a newline so
+	   that the data starts on a PHP_LAPACK_NPY_ALIGN boundary */
+	size = single ? sizeof(float) : sizeof(double);
+	hlen = snprintf(header + 10, sizeof(header) - 10, "{'descr': '%cf%d', 'fortran_order': True, 'shape': (%d, %d), }",
+		PHP_LAPACK_NPY_ORDER, (int)size, m, n);
+	pad = PHP_LAPACK_NPY_ALIGN - (10 + hlen + 1) % PHP_LAPACK_NPY_ALIGN;
+	if (pad == PHP_LAPACK_NPY_ALIGN) {
+		pad = 0;
+	}
+	memset(header + 10 + hlen, ' ', pad);
+	hlen += pad;
+	header[10 + hlen++] = '\n';
+	memcpy(header, PHP_LAPACK_NPY_MAGIC, PHP_LAPACK_NPY_MAGIC_LEN);
+	header[6] = 1;
+	header[7] = 0;
+	header[8] = hlen & 0xff;
+	header[9] = (hlen >> 8) & 0xff;
+
+	stream = php_stream_open_wrapper(path, "wb", REPORT_ERRORS, NULL);
+	if (stream == NULL) {
+		LAPACK_THROW("Unable to open matrix file", 106);
+	}
+
+	result = php_lapack_npy_write(stream, header, 10 + hlen);
+	if (single) {
+		col = php_lapack_arena_alloc(m, sizeof(float));
+		for (j = 0; j < n && result == SUCCESS; j++) {
+			for (i = 0; i < m; i++) {
+				col[i] = (float)al[i + (size_t)j * ld];
+			}
+			result = php_lapack_npy_write(stream, col, (size_t)m * sizeof(float));
+		}
+	} else if (ld == m) {
+		result = result == SUCCESS ? php_lapack_npy_write(stream, al, (size_t)m * n * sizeof(double)) : FAILURE;
+	} else {
+		for (j = 0; j < n && result == SUCCESS; j++) {
+			result = php_lapack_npy_write(stream, al + (size_t)j * ld, (size_t)m * sizeof(double));
+		}
+	}
+
+	if (php_stream_close(stream) != 0 || result == FAILURE) {
+		LAPACK_THROW("Unable to write matrix file", 106);
+	}
+
+	RETURN_TRUE;
+}
+/* }}} */
@@ -0,0 +1,287 @@
+/*
+  +----------------------------------------------------------------------+
+  | PHP Version 5 / lapack                                               |
+  +----------------------------------------------------------------------+
+  | Copyright (c) 2012 Ian Barber                                        |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 3.0 of the PHP license,       |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.php.net/license/3_0.txt.                                  |
+  | If you did not receive a copy of the PHP license and are unable to   |
+  | obtain it through the world-wide-web, please send a note to          |
+  | license@php.net so we can mail you a copy immediately.               |
+  +----------------------------------------------------------------------+
+  | Authors: Ian Barber <ian.barber@gmail.com>                           |
+  +----------------------------------------------------------------------+
+*/
+
+#include "php_lapack.h"
+#include "php_lapack_internal.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <unistd.h>
+
+/*
+ * Native thread pool for running many independent LAPACK calls at once.
+ *
+ * The worker threads never touch the engine: all zvals are converted on the
+ * calling thread before the pool starts and after it finishes, and the task
+ * functions only see plain buffers. Tasks are handed out in chunks from a
+ * shared atomic cursor, so a thread that finishes its small problems early
+ * simply takes more work rather than waiting on a slower one.
+ */
+
+#ifdef HAVE_OPENBLAS_SET_NUM_THREADS
+void openblas_set_num_threads(int num_threads);
+int openblas_get_num_threads(void);
+#elif defined(HAVE_BLI_THREAD_SET_NUM_THREADS)
+void bli_thread_set_num_threads(int64_t num_threads);
+int64_t bli_thread_get_num_threads(void);
+#endif
+
+/* Thread count of the BLAS backend when the module started */
+static int php_lapack_blas_default_threads = 0;
+
+/* Threads that may be inside a BLAS call on their own, see php_lapack_blas_pin */
+static int php_lapack_blas_pinned = 0;
+
+/* --- BLAS Backend Threading --- */
+
+/* {{{ const char* php_lapack_blas_backend(void)
+Name of the threading hook the extension was built with.
+*/
+const char* php_lapack_blas_backend(void)
+{
+#ifdef HAVE_OPENBLAS_SET_NUM_THREADS
+	return "openblas";
+#elif defined(HAVE_BLI_THREAD_SET_NUM_THREADS)
+	return "blis";
+#else
+	return "none";
+#endif
+}
+/* }}} */
+
+/* {{{ int php_lapack_blas_threads(void)
+The number of threads the BLAS backend currently uses, or 0 if there is no
+way to tell.
+*/
+int php_lapack_blas_threads(void)
+{
+#ifdef HAVE_OPENBLAS_SET_NUM_THREADS
+	return openblas_get_num_threads();
+#elif defined(HAVE_BLI_THREAD_SET_NUM_THREADS)
+	return (int)bli_thread_get_num_threads();
+#else
+	return 0;
+#endif
+}
+/* }}} */
+
+/* {{{ int php_lapack_blas_set_threads(int threads)
+Set the number of threads the BLAS backend uses. The setting is process
+wide. Ignored for 0 or less, when there is no threading hook, or while the
+count is pinned by php_lapack_blas_pin. Returns SUCCESS when the backend was
+told.
+*/
+int php_lapack_blas_set_threads(int threads)
+{
+	if (threads <= 0 || __sync_fetch_and_add(&php_lapack_blas_pinned, 0) > 0) {
+		return FAILURE;
+	}
+#ifdef HAVE_OPENBLAS_SET_NUM_THREADS
+	openblas_set_num_threads(threads);
+	return SUCCESS;
+#elif defined(HAVE_BLI_THREAD_SET_NUM_THREADS)
+	bli_thread_set_num_threads(threads);
+	return SUCCESS;
+#else
+	return FAILURE;
+#endif
+}
+/* }}} */
+
+/* {{{ void php_lapack_blas_pin(void)
+Keep the backend thread count as it is until the matching
+php_lapack_blas_unpin. OpenBLAS cannot resize its thread pool while another
+thread is inside a BLAS call, so Lapack::async pins the count for as long as
+a future's thread runs. Pins are counted across the process, as other
+requests under ZTS share the same backend.
+*/
+void php_lapack_blas_pin(void)
+{
+	__sync_fetch_and_add(&php_lapack_blas_pinned, 1);
+}
+/* }}} */
+
+/* {{{ void php_lapack_blas_unpin(void)
+Release a pin taken with php_lapack_blas_pin.
+*/
+void php_lapack_blas_unpin(void)
+{
+	__sync_fetch_and_sub(&php_lapack_blas_pinned, 1);
+}
+/* }}} */
+
+/* {{{ void php_lapack_blas_threads_init(void)
+Remember the backend's own thread count, used when lapack.max_threads is 0.
+Called from MINIT.
+*/
+void php_lapack_blas_threads_init(void)
+{
+	php_lapack_blas_default_threads = php_lapack_blas_threads();
+	if (php_lapack_blas_default_threads <= 0) {
+		php_lapack_blas_default_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	}
+}
+/* }}} */
+
+/* {{{ void php_lapack_blas_threads_for(double work)
+Size the backend thread count for a call doing about work units of work
+(the product of the problem dimensions, e.g. m * n * nrhs). Problems under
+lapack.parallel_threshold run on one thread, larger ones on
+lapack.max_threads, or the backend default when that is 0. The backend is
+only told when the count changes, except under ZTS where other threads may
+have changed it in between. Nothing changes while a future is running.
+*/
+void php_lapack_blas_threads_for(double work)
+{
+#if defined(HAVE_OPENBLAS_SET_NUM_THREADS) || defined(HAVE_BLI_THREAD_SET_NUM_THREADS)
+	int threads;
+
+	threads = LAPACK_G(max_threads) > 0 ? (int)LAPACK_G(max_threads) : php_lapack_blas_default_threads;
+	if (work < (double)LAPACK_G(parallel_threshold)) {
+		threads = 1;
+	}
+
+# ifndef ZTS
+	if (threads == LAPACK_G(blas_threads)) {
+		return;
+	}
+# endif
+	if (php_lapack_blas_set_threads(threads) == SUCCESS) {
+		LAPACK_G(blas_threads) = threads;
+	}
+#else
+	(void)work;
+#endif
+}
+/* }}} */
+
+/* --- Thread Pool --- */
+
+typedef struct _php_lapack_pool_job {
+	php_lapack_task_func func;
+	void *ctx;
+	size_t ntasks;
+	size_t chunk;
+	size_t next;
+} php_lapack_pool_job;
+
+/* {{{ static void* php_lapack_pool_worker(void *arg)
+Take chunks of tasks until none are left.
+*/
+static void* php_lapack_pool_worker(void *arg)
+{
+	php_lapack_pool_job *job = (php_lapack_pool_job *)arg;
+	size_t begin, end, task;
+
+	for (;;) {
+		begin = __sync_fetch_and_add(&job->next, job->chunk);
+		if (begin >= job->ntasks) {
+			break;
+		}
+		end = begin + job->chunk < job->ntasks ? begin + job->chunk : job->ntasks;
+		for (task = begin; task < end; task++) {
+			job->func(job->ctx, task);
+		}
+	}
+
+	return NULL;
+}
+/* }}} */
+
+/* {{{ int php_lapack_pool_threads(zend_long requested, size_t ntasks)
+Work out how many threads to use for ntasks tasks. A requested count of 0
+or less means one per online CPU.
+*/
+int php_lapack_pool_threads(zend_long requested, size_t ntasks)
+{
+	long threads = requested;
+
+	if (threads <= 0) {
+		threads = sysconf(_SC_NPROCESSORS_ONLN);
+	}
+	if (threads < 1) {
+		threads = 1;
+	}
+	if ((size_t)threads > ntasks) {
+		threads = ntasks > 0 ? (long)ntasks : 1;
+	}
+
+	return (int)threads;
+}
+/* }}} */
+
+/* {{{ void php_lapack_pool_run(size_t ntasks, php_lapack_task_func func, void *ctx, int nthreads)
+Run func(ctx, task) for every task in [0, ntasks) on nthreads threads, the
+calling thread included, and return once all of them have finished. The
+BLAS backend is kept single threaded while the pool runs, as each task is
+too small to be worth splitting further, unless a future has the count
+pinned.
+*/
+void php_lapack_pool_run(size_t ntasks, php_lapack_task_func func, void *ctx, int nthreads)
+{
+	php_lapack_pool_job job;
+	pthread_t *threads;
+	int i, started;
+	int blas_threads;
+
+	if (ntasks == 0) {
+		return;
+	}
+
+	job.func = func;
+	job.ctx = ctx;
+	job.ntasks = ntasks;
+	job.next = 0;
+
+	if (nthreads <= 1) {
+		job.chunk = ntasks;
+		php_lapack_pool_worker(&job);
+		return;
+	}
+
+	/* Several chunks per thread keeps the threads busy to the end */
+	job.chunk = ntasks / ((size_t)nthreads * 8);
+	if (job.chunk == 0) {
+		job.chunk = 1;
+	}
+
+	blas_threads = php_lapack_blas_threads();
+	if (php_lapack_blas_set_threads(1) == FAILURE) {
+		blas_threads = 0;
+	}
+
+	threads = safe_emalloc(nthreads - 1, sizeof(pthread_t), 0);
+	started = 0;
+	for (i = 0; i < nthreads - 1; i++) {
+		if (pthread_create(&threads[i], NULL, php_lapack_pool_worker, &job) != 0) {
+			/* Carry on with however many threads we did get */
+			break;
+		}
+		started++;
+	}
+
+	php_lapack_pool_worker(&job);
+
+	for (i = 0; i < started; i++) {
+		pthread_join(threads[i], NULL);
+	}
+	efree(threads);
+
+	php_lapack_blas_set_threads(blas_threads);
+}
+/* }}} */
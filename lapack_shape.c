@@ -0,0 +1,771 @@
+/*
+  +----------------------------------------------------------------------+
+  | PHP Version 5 / lapack                                               |
+  +----------------------------------------------------------------------+
+  | Copyright (c) 2012 Ian Barber                                        |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 3.0 of the PHP license,       |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.php.net/license/3_0.txt.                                  |
+  | If you did not receive a copy of the PHP license and are unable to   |
+  | obtain it through the world-wide-web, please send a note to          |
+  | license@php.net so we can mail you a copy immediately.               |
+  +----------------------------------------------------------------------+
+  | Authors: Ian Barber <ian.barber@gmail.com>                           |
+  +----------------------------------------------------------------------+
+*/
+
+#include "php_lapack.h"
+#include "php_lapack_internal.h"
+#include "Zend/zend_exceptions.h"
+
+#include "cblas.h"
+
+/*
+ * Shape regression. Lapack::shapeRegressionModel() returns the regression
+ * matrix R = P . W^T . pinv(F) between measurements and shapes, and
+ * Lapack::shapeModel() keeps it in a LapackShapeModel object that predicts
+ * shapes for whole batches of measurements with one dgemm. The model also
+ * keeps G = W^T . pinv(F), and optionally H = pinv(F) itself, so that a new
+ * P basis (or new weights W) can be refit without another SVD.
+ */
+
+/* Rows of P, and of the result, handled at a time when forming R */
+#define PHP_LAPACK_SRM_BLOCK 1024
+
+/* How R = P . G is formed for each block of rows of P. With g set, G was
+   formed up front; otherwise each block is (P . W^T) . H. Results go into
+   r, when returning a LapackMatrix, or are emitted as rows of out. */
+typedef struct _php_lapack_srm_stream {
+	const double *g;	/* np x ld */
+	const double *w;	/* ns x np */
+	const double *h;	/* ns x ld */
+	double *q;			/* block x ns scratch */
+	double *r;			/* nc x ld, or NULL */
+	double *rb;			/* block x ld scratch */
+	zval *out;
+	lapack_int nc, np, ns, ld;
+} php_lapack_srm_stream;
+
+typedef struct _php_lapack_shape_object {
+	double *r;				/* R, nc x ld */
+	double *g;				/* G = W^T . pinv(F), np x ld */
+	double *h;				/* pinv(F), ns x ld, or NULL if not kept */
+	int nc;
+	int np;
+	int ns;
+	int ld;					/* measurements + 1 */
+	zend_bool as_matrix;
+	zend_object std;
+} php_lapack_shape_object;
+
+static inline php_lapack_shape_object *php_lapack_shape_from_obj(zend_object *obj) {
+	return (php_lapack_shape_object *)((char *)(obj) - XtOffsetOf(php_lapack_shape_object, std));
+}
+
+#define Z_LAPACK_SHAPE_P(zv) php_lapack_shape_from_obj(Z_OBJ_P(zv))
+
+static zend_class_entry *php_lapack_shape_sc_entry;
+static zend_object_handlers lapack_shape_object_handlers;
+
+/* --- Helper Functions --- */
+
+/* {{{ static int php_lapack_srm_rows_valid(zval *inarray, int n)
+Check every row of a PHP array of arrays has n values, so that it can be
+streamed in blocks without failing part way.
+*/
+static int php_lapack_srm_rows_valid(zval *inarray, int n)
+{
+	zval *row;
+
+	ZEND_HASH_FOREACH_VAL(Z_ARRVAL_P(inarray), row) {
+		ZVAL_DEREF(row);
+		if (Z_TYPE_P(row) != IS_ARRAY || zend_hash_num_elements(Z_ARRVAL_P(row)) != n) {
+			return FAILURE;
+		}
+	} ZEND_HASH_FOREACH_END();
+
+	return SUCCESS;
+}
+/* }}} */
+
+/* {{{ static int php_lapack_srm_shape_p(zval *P, int *nc, int *np, zend_bool *as_matrix)
+Read the shape of P, which is only ever read a block of rows at a time.
+*/
+static int php_lapack_srm_shape_p(zval *P, int *nc, int *np, zend_bool *as_matrix)
+{
+	if (php_lapack_operand_shape(P, nc, np, as_matrix) == FAILURE) {
+		return FAILURE;
+	}
+
+	return Z_TYPE_P(P) == IS_ARRAY ? php_lapack_srm_rows_valid(P, *np) : SUCCESS;
+}
+/* }}} */
+
+/* {{{ static void php_lapack_srm_block(php_lapack_srm_stream *st, const double *pb, int b, int ldp, int row0)
+Compute rows row0 .. row0 + b - 1 of R from the same rows of P in pb.
+*/
+static void php_lapack_srm_block(php_lapack_srm_stream *st, const double *pb, int b, int ldp, int row0)
+{
+	double *rb = st->r != NULL ? st->r + row0 : st->rb;
+	int ldr = st->r != NULL ? st->nc : b;
+	zval inner;
+	int i;
+
+	if (st->g != NULL) {
+		cblas_dgemm( CblasColMajor, CblasNoTrans, CblasNoTrans, b, st->ld, st->np,
+					 1.0, pb, ldp, st->g, st->np, 0.0, rb, ldr );
+	} else {
+		cblas_dgemm( CblasColMajor, CblasNoTrans, CblasTrans, b, st->ns, st->np,
+					 1.0, pb, ldp, st->w, st->ns, 0.0, st->q, b );
+		cblas_dgemm( CblasColMajor, CblasNoTrans, CblasNoTrans, b, st->ld, st->ns,
+					 1.0, st->q, b, st->h, st->ns, 0.0, rb, ldr );
+	}
+
+	if (st->r == NULL) {
+		for (i = 0; i < b; i++) {
+			php_lapack_reassemble_row(&inner, rb + i, st->ld, b);
+			add_next_index_zval(st->out, &inner);
+		}
+	}
+}
+/* }}} */
+
+/* {{{ static void php_lapack_srm_stream_p(php_lapack_srm_stream *st, zval *P)
+Run every row of P through php_lapack_srm_block, PHP_LAPACK_SRM_BLOCK rows at
+a time. A LapackMatrix is used in place, array rows are copied into a block
+buffer.
+*/
+static void php_lapack_srm_stream_p(php_lapack_srm_stream *st, zval *P)
+{
+	php_lapack_matrix_object *intern;
+	zval *row, *val;
+	double *pb;
+	int i, j, row0;
+
+	if (Z_TYPE_P(P) != IS_ARRAY) {
+		intern = Z_LAPACK_MATRIX_P(P);
+		for (row0 = 0; row0 < st->nc; row0 += PHP_LAPACK_SRM_BLOCK) {
+			php_lapack_srm_block(st, intern->data + row0,
+				st->nc - row0 < PHP_LAPACK_SRM_BLOCK ? st->nc - row0 : PHP_LAPACK_SRM_BLOCK, intern->ld, row0);
+		}
+		return;
+	}
+
+	pb = php_lapack_arena_alloc((size_t)PHP_LAPACK_SRM_BLOCK * st->np, sizeof(double));
+	i = 0;
+	row0 = 0;
+	ZEND_HASH_FOREACH_VAL(Z_ARRVAL_P(P), row) {
+		ZVAL_DEREF(row);
+		j = 0;
+		ZEND_HASH_FOREACH_VAL(Z_ARRVAL_P(row), val) {
+			pb[(size_t)j * PHP_LAPACK_SRM_BLOCK + i] = EXPECTED(Z_TYPE_P(val) == IS_DOUBLE) ? Z_DVAL_P(val) : zval_get_double(val);
+			j++;
+		} ZEND_HASH_FOREACH_END();
+
+		if (++i == PHP_LAPACK_SRM_BLOCK) {
+			php_lapack_srm_block(st, pb, i, PHP_LAPACK_SRM_BLOCK, row0);
+			row0 += i;
+			i = 0;
+		}
+	} ZEND_HASH_FOREACH_END();
+
+	if (i > 0) {
+		php_lapack_srm_block(st, pb, i, PHP_LAPACK_SRM_BLOCK, row0);
+	}
+}
+/* }}} */
+
+/* {{{ static lapack_int php_lapack_srm_svd(const double *Ml, lapack_int ns, lapack_int nf, lapack_int *r, double **S, double **U, double **VT)
+Form F, which is M (ns x nf) transposed with an additional row of ones, and
+its SVD F = U . S . VT with U ld x r and VT r x ns, where ld = nf + 1 and
+r = min(ld, ns). S comes back already inverted, leaving out zero singular
+values as a pseudo-inverse would. All buffers are from the arena.
+*/
+static lapack_int php_lapack_srm_svd(const double *Ml, lapack_int ns, lapack_int nf, lapack_int *r, double **S, double **U, double **VT)
+{
+	double *Fl, *work, query = 0.0;
+	lapack_int *iwork;
+	lapack_int info, ld = nf + 1;
+	size_t lwork;
+	int i, j;
+
+	*r = ns < ld ? ns : ld;
+
+	Fl = php_lapack_arena_alloc((size_t)ld * ns, sizeof(double));
+	for ( j = 0; j < ns; j++ ) {
+		for ( i = 0; i < nf; i++ ) {
+			Fl[(size_t)j * ld + i] = Ml[(size_t)i * ns + j];
+		}
+		Fl[(size_t)j * ld + nf] = 1.0;
+	}
+
+	*S = php_lapack_arena_alloc(*r, sizeof(double));
+	*U = php_lapack_arena_alloc((size_t)ld * *r, sizeof(double));
+	*VT = php_lapack_arena_alloc((size_t)*r * ns, sizeof(double));
+	iwork = php_lapack_arena_alloc(8 * (size_t)*r, sizeof(lapack_int));
+
+	if (php_lapack_lwork_get(PHP_LAPACK_WORK_DGESDD, ld, ns, 'S', &lwork, NULL) == FAILURE) {
+		LAPACKE_dgesdd_work( LAPACK_COL_MAJOR, 'S', ld, ns, Fl, ld, *S, *U, ld, *VT, *r, &query, -1, iwork );
+		php_lapack_lwork_set(PHP_LAPACK_WORK_DGESDD, ld, ns, 'S', query, 0, &lwork, NULL);
+	}
+	work = php_lapack_arena_alloc(lwork, sizeof(double));
+
+	info = LAPACKE_dgesdd_work( LAPACK_COL_MAJOR, 'S', ld, ns, Fl, ld, *S, *U, ld, *VT, *r, work, (lapack_int)lwork, iwork );
+	php_lapack_stats_info(info);
+	if (info != 0) {
+		return info;
+	}
+
+	for ( i = 0; i < *r; i++ ) {
+		(*S)[i] = (*S)[i] != 0.0 ? 1.0 / (*S)[i] : 0.0;
+	}
+
+	return 0;
+}
+/* }}} */
+
+/* {{{ static void php_lapack_srm_pinv(double *H, lapack_int ns, lapack_int ld, lapack_int r, const double *S, const double *U, const double *VT)
+H = pinv(F) = V . S^-1 . U^T (ns x ld), scaling the rows of U^T by S^-1
+rather than multiplying by a diagonal matrix.
+*/
+static void php_lapack_srm_pinv(double *H, lapack_int ns, lapack_int ld, lapack_int r, const double *S, const double *U, const double *VT)
+{
+	double *T;
+	int i, j;
+
+	T = php_lapack_arena_alloc((size_t)r * ld, sizeof(double));
+	for ( j = 0; j < ld; j++ ) {
+		for ( i = 0; i < r; i++ ) {
+			T[(size_t)j * r + i] = U[(size_t)i * ld + j] * S[i];
+		}
+	}
+
+	cblas_dgemm( CblasColMajor, CblasTrans, CblasNoTrans, ns, ld, r,
+				 1.0, VT, r, T, r, 0.0, H, ns );
+}
+/* }}} */
+
+/* {{{ static void php_lapack_shape_create(zval *object, double *r, double *g, double *h, int nc, int np, int ns, int ld, zend_bool as_matrix)
+Create a LapackShapeModel in object, taking ownership of the buffers.
+*/
+static void php_lapack_shape_create(zval *object, double *r, double *g, double *h, int nc, int np, int ns, int ld, zend_bool as_matrix)
+{
+	php_lapack_shape_object *intern;
+
+	object_init_ex(object, php_lapack_shape_sc_entry);
+	intern = Z_LAPACK_SHAPE_P(object);
+	intern->r = r;
+	intern->g = g;
+	intern->h = h;
+	intern->nc = nc;
+	intern->np = np;
+	intern->ns = ns;
+	intern->ld = ld;
+	intern->as_matrix = as_matrix;
+}
+/* }}} */
+
+/* {{{ static php_lapack_shape_object* php_lapack_shape_fetch(zval *object)
+Return the model behind object, or throw if it was never filled in.
+*/
+static php_lapack_shape_object* php_lapack_shape_fetch(zval *object)
+{
+	php_lapack_shape_object *intern = Z_LAPACK_SHAPE_P(object);
+
+	if (intern->r == NULL) {
+		zend_throw_exception(php_lapack_exception_sc_entry, "Model is not initialised", 104);
+		return NULL;
+	}
+
+	return intern;
+}
+/* }}} */
+
+/* --- Object Handlers --- */
+
+static void php_lapack_shape_object_free(zend_object *object)
+{
+	php_lapack_shape_object *intern = php_lapack_shape_from_obj(object);
+
+	php_lapack_free(intern->r);
+	php_lapack_free(intern->g);
+	php_lapack_free(intern->h);
+	zend_object_std_dtor(&intern->std);
+}
+
+static zend_object *php_lapack_shape_object_new(zend_class_entry *class_type)
+{
+	php_lapack_shape_object *intern;
+
+	intern = zend_object_alloc(sizeof(php_lapack_shape_object), class_type);
+	intern->r = NULL;
+	intern->g = NULL;
+	intern->h = NULL;
+	intern->nc = intern->np = intern->ns = intern->ld = 0;
+	intern->as_matrix = 0;
+
+	zend_object_std_init(&intern->std, class_type);
+	object_properties_init(&intern->std, class_type);
+	intern->std.handlers = &lapack_shape_object_handlers;
+
+	return &intern->std;
+}
+
+/* --- Lapack Shape Regression Functions --- */
+
+/* {{{ array Lapack::shapeRegressionModel(array|LapackMatrix M, array|LapackMatrix P, array|LapackMatrix W);
+Calculate a regression model between the measurements M and the 3D shapes
+represented by the Principal Components (PCs) in P and the PC weights in W.
+Returns an array representing the regression equations/model in matrix form.
+Expects arrays of arrays, with M number of subjects by number of measures,
+P 3 times number of vertices by number of PCs, W number of subjects by number
+of PCs, and will return an array of arrays in the dimension three times number
+of vertices by number of measures plus 1. Uses SVD of M internally.
+
+R = P . W^T . V . S^-1 . U^T is evaluated in whichever order needs the fewest
+flops, with S^-1 applied as a scaling, and P is taken PHP_LAPACK_SRM_BLOCK
+rows at a time so that neither a copy of P nor (for array results) all of R
+is ever held in C.
+*/
+PHP_METHOD(Lapack, shapeRegressionModel)
+{
+	zval *M, *P, *W;
+	double *Ml, *Wl, *S, *U, *VT, *T, *H, *G, *R = NULL;
+	double cost_g1, cost_g2, cost_h;
+	php_lapack_srm_stream st;
+	int i, j;
+
+	// ns = number of subjects, nf = number of features/measurements,
+	// np = number of principal components, nc = number of coordinate values
+	lapack_int info,ld,r;
+	int n,m,ns,nf,np,nc;
+
+	zend_bool as_matrix = 0;
+
+	// parse paremeters
+	if (zend_parse_parameters(ZEND_NUM_ARGS(), "zzz", &M, &P, &W) == FAILURE) {
+		return;
+	}
+
+	php_lapack_arena_begin();
+
+	if (LAPACK_G(precision) == PHP_LAPACK_SINGLE) {
+		php_lapack_single_shape_regression(return_value, M, P, W);
+		return;
+	}
+
+	Ml = php_lapack_linearize_operand(M, &ns, &nf, &as_matrix);
+	if (Ml == NULL) {
+		LAPACK_THROW("Invalid input matrix - argument 1 (M)", 102);
+	}
+
+	if (php_lapack_srm_shape_p(P, &nc, &np, &as_matrix) == FAILURE) {
+		php_lapack_free(Ml);
+		LAPACK_THROW("Invalid input matrix - argument 2 (P)", 102);
+	}
+
+	Wl = php_lapack_linearize_operand(W, &m, &n, &as_matrix);
+	if (Wl == NULL || m != ns || n != np) {
+		php_lapack_free(Ml);
+		php_lapack_free(Wl);
+		if (Wl == NULL) {
+			LAPACK_THROW("Invalid input matrix - argument 3 (W)", 102);
+		} else if (m != ns) {
+			LAPACK_THROW("Invalid input matrix - argument 3 (W), wrong number of rows", 102);
+		}
+		LAPACK_THROW("Invalid input matrix - argument 3 (W), wrong number of columns", 102);
+	}
+
+	// do svd of F, which is M transposed with additional row of ones
+	ld = nf + 1;
+	info = php_lapack_srm_svd(Ml, ns, nf, &r, &S, &U, &VT);
+	php_lapack_free(Ml);
+	if (info != 0)
+	{
+		php_lapack_free(Wl);
+		LAPACK_THROW("SVD failed", 101);
+	}
+
+	// Flops for the three sensible orders of R = P . W^T . V . S^-1 . U^T:
+	// G = ((W^T . V) S^-1) . U^T then R = P . G,
+	// G = W^T . H with H = V . (S^-1 U^T) then R = P . G,
+	// or R = (P . W^T) . H, which avoids G when there are few subjects
+	cost_g1 = (double)np * ns * r + (double)np * r * ld + (double)nc * np * ld;
+	cost_g2 = (double)ns * r * ld + (double)np * ns * ld + (double)nc * np * ld;
+	cost_h = (double)ns * r * ld + (double)nc * np * ns + (double)nc * ns * ld;
+
+	memset(&st, 0, sizeof(st));
+	st.nc = nc;
+	st.np = np;
+	st.ns = ns;
+	st.ld = ld;
+	st.w = Wl;
+	st.out = return_value;
+
+	php_lapack_blas_threads_for(cost_g1 < cost_h ? cost_g1 : cost_h);
+
+	if (cost_g1 <= cost_g2 && cost_g1 <= cost_h) {
+		// T = W^T . V with its columns scaled by S^-1, G = T . U^T
+		T = php_lapack_arena_alloc((size_t)np * r, sizeof(double));
+		cblas_dgemm( CblasColMajor, CblasTrans, CblasTrans, np, r, ns,
+					 1.0, Wl, ns, VT, r, 0.0, T, np );
+		for ( j = 0; j < r; j++ )
+		{
+			for ( i = 0; i < np; i++ )
+			{
+				T[(size_t)j * np + i] *= S[j];
+			}
+		}
+
+		G = php_lapack_arena_alloc((size_t)np * ld, sizeof(double));
+		cblas_dgemm( CblasColMajor, CblasNoTrans, CblasTrans, np, ld, r,
+					 1.0, T, np, U, ld, 0.0, G, np );
+		st.g = G;
+	} else {
+		H = php_lapack_arena_alloc((size_t)ns * ld, sizeof(double));
+		php_lapack_srm_pinv(H, ns, ld, r, S, U, VT);
+
+		if (cost_g2 <= cost_h) {
+			// G = W^T . H
+			G = php_lapack_arena_alloc((size_t)np * ld, sizeof(double));
+			cblas_dgemm( CblasColMajor, CblasTrans, CblasNoTrans, np, ld, ns,
+						 1.0, Wl, ns, H, ns, 0.0, G, np );
+			st.g = G;
+		} else {
+			st.h = H;
+			st.q = php_lapack_arena_alloc((size_t)PHP_LAPACK_SRM_BLOCK * ns, sizeof(double));
+		}
+	}
+
+	// R = P . G, or (P . W^T) . H, a block of rows of P at a time
+	if (as_matrix) {
+		R = php_lapack_alloc((size_t)nc * ld);
+		st.r = R;
+	} else {
+		st.rb = php_lapack_arena_alloc((size_t)PHP_LAPACK_SRM_BLOCK * ld, sizeof(double));
+		ZVAL_ARR(return_value, zend_new_array(nc));
+		zend_hash_real_init_packed(Z_ARRVAL_P(return_value));
+	}
+
+	php_lapack_srm_stream_p(&st, P);
+
+	if (as_matrix) {
+		php_lapack_return_matrix(return_value, &R, nc, ld, nc, as_matrix);
+	}
+
+	php_lapack_free(Wl);
+	php_lapack_free(R);
+
+	return;
+}
+/* }}} */
+
+/* {{{ LapackShapeModel Lapack::shapeModel(array|LapackMatrix M, array|LapackMatrix P, array|LapackMatrix W [, bool keepFactors]);
+Fit the same regression model as shapeRegressionModel, and keep it in a
+LapackShapeModel for batched prediction. Unless keepFactors is false the
+model also keeps pinv(F), so refit() can take new weights as well as a new
+basis. Fitting always runs in double precision.
+*/
+PHP_METHOD(Lapack, shapeModel)
+{
+	zval *M, *P, *W;
+	double *Ml, *Wl, *S, *U, *VT, *H, *G, *R;
+	php_lapack_srm_stream st;
+	lapack_int info, ld, r;
+	int n, m, ns, nf, np, nc;
+	zend_bool as_matrix = 0, keep = 1;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS(), "zzz|b", &M, &P, &W, &keep) == FAILURE) {
+		return;
+	}
+
+	php_lapack_arena_begin();
+
+	Ml = php_lapack_linearize_operand(M, &ns, &nf, &as_matrix);
+	if (Ml == NULL) {
+		LAPACK_THROW("Invalid input matrix - argument 1 (M)", 102);
+	}
+
+	if (php_lapack_srm_shape_p(P, &nc, &np, &as_matrix) == FAILURE) {
+		php_lapack_free(Ml);
+		LAPACK_THROW("Invalid input matrix - argument 2 (P)", 102);
+	}
+
+	Wl = php_lapack_linearize_operand(W, &m, &n, &as_matrix);
+	if (Wl == NULL || m != ns || n != np) {
+		php_lapack_free(Ml);
+		php_lapack_free(Wl);
+		if (Wl == NULL) {
+			LAPACK_THROW("Invalid input matrix - argument 3 (W)", 102);
+		} else if (m != ns) {
+			LAPACK_THROW("Invalid input matrix - argument 3 (W), wrong number of rows", 102);
+		}
+		LAPACK_THROW("Invalid input matrix - argument 3 (W), wrong number of columns", 102);
+	}
+
+	ld = nf + 1;
+	php_lapack_blas_threads_for((double)ns * ld * ld + (double)nc * np * ld);
+	info = php_lapack_srm_svd(Ml, ns, nf, &r, &S, &U, &VT);
+	php_lapack_free(Ml);
+	if (info != 0) {
+		php_lapack_free(Wl);
+		LAPACK_THROW("SVD failed", 101);
+	}
+
+	/* H = pinv(F), G = W^T . H, then R = P . G */
+	H = php_lapack_alloc((size_t)ns * ld);
+	php_lapack_srm_pinv(H, ns, ld, r, S, U, VT);
+
+	G = php_lapack_alloc((size_t)np * ld);
+	cblas_dgemm( CblasColMajor, CblasTrans, CblasNoTrans, np, ld, ns,
+				 1.0, Wl, ns, H, ns, 0.0, G, np );
+	php_lapack_free(Wl);
+
+	if (!keep) {
+		php_lapack_free(H);
+		H = NULL;
+	}
+
+	R = php_lapack_alloc((size_t)nc * ld);
+	memset(&st, 0, sizeof(st));
+	st.nc = nc;
+	st.np = np;
+	st.ns = ns;
+	st.ld = ld;
+	st.g = G;
+	st.r = R;
+	php_lapack_srm_stream_p(&st, P);
+
+	php_lapack_shape_create(return_value, R, G, H, nc, np, ns, ld, as_matrix);
+
+	return;
+}
+/* }}} */
+
+/* --- LapackShapeModel Methods --- */
+
+/* {{{ array LapackShapeModel::predict(array|LapackMatrix measurements [, bool packed]);
+Predict one shape per row of measurements, which has as many columns as the
+M the model was fitted on. The rows are extended with the bias column of
+ones and multiplied by R in a single dgemm. Returns one row of 3 times the
+number of vertices coordinates per measurement; with packed set, each row
+is instead a binary string of float32 values in machine byte order, as
+unpack('g*') reads them, ready to be written to a mesh file.
+*/
+PHP_METHOD(LapackShapeModel, predict)
+{
+	zval *x;
+	double *xl, *y;
+	php_lapack_shape_object *intern;
+	zend_string *str;
+	float *f;
+	int i, j, k, nf;
+	zend_bool as_matrix, packed = 0;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS(), "z|b", &x, &packed) == FAILURE) {
+		return;
+	}
+
+	intern = php_lapack_shape_fetch(ZEND_THIS);
+	if (intern == NULL) {
+		return;
+	}
+
+	as_matrix = intern->as_matrix;
+	if (php_lapack_operand_shape(x, &k, &nf, &as_matrix) == FAILURE) {
+		LAPACK_THROW("Invalid input matrix - argument 1", 102);
+	} else if (nf != intern->ld - 1) {
+		LAPACK_THROW("Invalid input matrix - argument 1, wrong number of measurements", 102);
+	}
+
+	php_lapack_arena_begin();
+
+	/* X = [measurements, 1], k x ld */
+	xl = php_lapack_arena_alloc((size_t)k * intern->ld, sizeof(double));
+	if (php_lapack_linearize_operand_into(x, xl, k, nf, k) == FAILURE) {
+		LAPACK_THROW("Invalid input matrix - argument 1", 102);
+	}
+	for (i = 0; i < k; i++) {
+		xl[i + (size_t)nf * k] = 1.0;
+	}
+
+	php_lapack_blas_threads_for((double)k * intern->nc * intern->ld);
+
+	if (!packed) {
+		/* X . R^T, k x nc */
+		y = php_lapack_alloc((size_t)k * intern->nc);
+		cblas_dgemm( CblasColMajor, CblasNoTrans, CblasTrans, k, intern->nc, intern->ld,
+					 1.0, xl, k, intern->r, intern->nc, 0.0, y, k );
+		php_lapack_return_matrix(return_value, &y, k, intern->nc, k, as_matrix);
+		php_lapack_free(y);
+		return;
+	}
+
+	/* R . X^T, nc x k, so that each shape is a contiguous column */
+	y = php_lapack_arena_alloc((size_t)intern->nc * k, sizeof(double));
+	cblas_dgemm( CblasColMajor, CblasNoTrans, CblasTrans, intern->nc, k, intern->ld,
+				 1.0, intern->r, intern->nc, xl, k, 0.0, y, intern->nc );
+
+	array_init_size(return_value, k);
+	for (i = 0; i < k; i++) {
+		str = zend_string_alloc((size_t)intern->nc * sizeof(float), 0);
+		f = (float *)ZSTR_VAL(str);
+		for (j = 0; j < intern->nc; j++) {
+			f[j] = (float)y[j + (size_t)i * intern->nc];
+		}
+		ZSTR_VAL(str)[ZSTR_LEN(str)] = '\0';
+		add_next_index_str(return_value, str);
+	}
+
+	return;
+}
+/* }}} */
+
+/* {{{ LapackShapeModel LapackShapeModel::refit(array|LapackMatrix P [, array|LapackMatrix W]);
+Return a new model for a new basis P, reusing the SVD of the measurements.
+New weights W (one row per subject) can only be given when the model kept
+its factors.
+*/
+PHP_METHOD(LapackShapeModel, refit)
+{
+	zval *P, *W = NULL;
+	double *Wl, *G, *H = NULL, *R;
+	php_lapack_shape_object *intern;
+	php_lapack_srm_stream st;
+	int m, n, nc, np;
+	zend_bool as_matrix;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS(), "z|z!", &P, &W) == FAILURE) {
+		return;
+	}
+
+	intern = php_lapack_shape_fetch(ZEND_THIS);
+	if (intern == NULL) {
+		return;
+	}
+
+	as_matrix = intern->as_matrix;
+	if (php_lapack_srm_shape_p(P, &nc, &np, &as_matrix) == FAILURE) {
+		LAPACK_THROW("Invalid input matrix - argument 1 (P)", 102);
+	}
+
+	php_lapack_arena_begin();
+	php_lapack_blas_threads_for((double)nc * np * intern->ld);
+
+	if (W == NULL) {
+		if (np != intern->np) {
+			LAPACK_THROW("Invalid input matrix - argument 1 (P), wrong number of columns", 102);
+		}
+		G = php_lapack_alloc((size_t)np * intern->ld);
+		memcpy(G, intern->g, (size_t)np * intern->ld * sizeof(double));
+	} else {
+		if (intern->h == NULL) {
+			LAPACK_THROW("Model was fitted without keeping its factors", 104);
+		}
+		Wl = php_lapack_linearize_operand(W, &m, &n, &as_matrix);
+		if (Wl == NULL || m != intern->ns || n != np) {
+			php_lapack_free(Wl);
+			if (Wl == NULL) {
+				LAPACK_THROW("Invalid input matrix - argument 2 (W)", 102);
+			} else if (m != intern->ns) {
+				LAPACK_THROW("Invalid input matrix - argument 2 (W), wrong number of rows", 102);
+			}
+			LAPACK_THROW("Invalid input matrix - argument 2 (W), wrong number of columns", 102);
+		}
+
+		G = php_lapack_alloc((size_t)np * intern->ld);
+		cblas_dgemm( CblasColMajor, CblasTrans, CblasNoTrans, np, intern->ld, intern->ns,
+					 1.0, Wl, intern->ns, intern->h, intern->ns, 0.0, G, np );
+		php_lapack_free(Wl);
+	}
+
+	if (intern->h != NULL) {
+		H = php_lapack_alloc((size_t)intern->ns * intern->ld);
+		memcpy(H, intern->h, (size_t)intern->ns * intern->ld * sizeof(double));
+	}
+
+	R = php_lapack_alloc((size_t)nc * intern->ld);
+	memset(&st, 0, sizeof(st));
+	st.nc = nc;
+	st.np = np;
+	st.ns = intern->ns;
+	st.ld = intern->ld;
+	st.g = G;
+	st.r = R;
+	php_lapack_srm_stream_p(&st, P);
+
+	php_lapack_shape_create(return_value, R, G, H, nc, np, intern->ns, intern->ld, as_matrix);
+
+	return;
+}
+/* }}} */
+
+/* {{{ array LapackShapeModel::matrix();
+Return the regression matrix R, as shapeRegressionModel would.
+*/
+PHP_METHOD(LapackShapeModel, matrix)
+{
+	php_lapack_shape_object *intern;
+	double *r;
+
+	if (zend_parse_parameters_none() == FAILURE) {
+		return;
+	}
+
+	intern = php_lapack_shape_fetch(ZEND_THIS);
+	if (intern == NULL) {
+		return;
+	}
+
+	if (intern->as_matrix) {
+		r = php_lapack_alloc((size_t)intern->nc * intern->ld);
+		memcpy(r, intern->r, (size_t)intern->nc * intern->ld * sizeof(double));
+		php_lapack_return_matrix(return_value, &r, intern->nc, intern->ld, intern->nc, 1);
+	} else {
+		php_lapack_reassemble_array(return_value, intern->r, intern->nc, intern->ld, intern->nc);
+	}
+
+	return;
+}
+/* }}} */
+
+/* --- ARGUMENTS AND INIT --- */
+
+ZEND_BEGIN_ARG_INFO_EX(lapack_shape_empty_args, 0, 0, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(lapack_shape_predict_args, 0, 0, 1)
+	ZEND_ARG_INFO(0, measurements)
+	ZEND_ARG_INFO(0, packed)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(lapack_shape_refit_args, 0, 0, 1)
+	ZEND_ARG_INFO(0, P)
+	ZEND_ARG_INFO(0, W)
+ZEND_END_ARG_INFO()
+
+static const zend_function_entry php_lapack_shape_class_methods[] =
+{
+	PHP_ME(LapackShapeModel, predict,	lapack_shape_predict_args, ZEND_ACC_PUBLIC)
+	PHP_ME(LapackShapeModel, refit,		lapack_shape_refit_args, ZEND_ACC_PUBLIC)
+	PHP_ME(LapackShapeModel, matrix,	lapack_shape_empty_args, ZEND_ACC_PUBLIC)
+	PHP_FE_END
+};
+
+PHP_MINIT_FUNCTION(lapack_shape)
+{
+	zend_class_entry ce;
+	memcpy(&lapack_shape_object_handlers, zend_get_std_object_handlers(), sizeof(zend_object_handlers));
+	lapack_shape_object_handlers.offset = XtOffsetOf(php_lapack_shape_object, std);
+	lapack_shape_object_handlers.free_obj = php_lapack_shape_object_free;
+	lapack_shape_object_handlers.clone_obj = NULL;
+
+	INIT_CLASS_ENTRY(ce, "LapackShapeModel", php_lapack_shape_class_methods);
+	ce.create_object = php_lapack_shape_object_new;
+	php_lapack_shape_sc_entry = zend_register_internal_class(&ce);
+	php_lapack_shape_sc_entry->ce_flags |= ZEND_ACC_FINAL;
+
+	return SUCCESS;
+}
@@ -0,0 +1,551 @@
+/*
+  +----------------------------------------------------------------------+
+  | PHP Version 5 / lapack                                               |
+  +----------------------------------------------------------------------+
+  | Copyright (c) 2012 Ian Barber                                        |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 3.0 of the PHP license,       |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.php.net/license/3_0.txt.                                  |
+  | If you did not receive a copy of the PHP license and are unable to   |
+  | obtain it through the world-wide-web, please send a note to          |
+  | license@php.net so we can mail you a copy immediately.               |
+  +----------------------------------------------------------------------+
+  | Authors: Ian Barber <ian.barber@gmail.com>                           |
+  +----------------------------------------------------------------------+
+*/
+
+#include "php_lapack.h"
+#include "php_lapack_internal.h"
+#include "Zend/zend_exceptions.h"
+
+#include "cblas.h"
+
+/*
+ * Single precision versions of the Lapack methods, used when the
+ * lapack.precision INI setting is "single". Operands are converted straight
+ * into float buffers, the s-prefixed LAPACK and BLAS routines do the work,
+ * and results are widened back to doubles on the way out, so callers still
+ * see PHP floats and LapackMatrix objects as usual.
+ */
+
+/* --- Helper Functions --- */
+
+/* {{{ static float* php_lapack_single_operand(zval *operand, int *m, int *n, zend_bool *is_matrix)
+Return a fresh column-major float copy of a PHP array of arrays or a
+LapackMatrix, or NULL if the operand is not a valid matrix. is_matrix is set
+as for php_lapack_operand_shape.
+*/
+static float* php_lapack_single_operand(zval *operand, int *m, int *n, zend_bool *is_matrix)
+{
+	php_lapack_matrix_object *intern;
+	zval *row, *val;
+	float *outarray;
+	uint64_t start;
+	int i, j;
+
+	if (php_lapack_operand_shape(operand, m, n, is_matrix) == FAILURE) {
+		return NULL;
+	}
+
+	start = php_lapack_stats_clock();
+
+	outarray = php_lapack_alloc_single((size_t)*m * *n);
+
+	if (Z_TYPE_P(operand) != IS_ARRAY) {
+		intern = Z_LAPACK_MATRIX_P(operand);
+		for (j = 0; j < *n; j++) {
+			for (i = 0; i < *m; i++) {
+				outarray[i + (size_t)j * *m] = (float)intern->data[i + (size_t)j * intern->ld];
+			}
+		}
+		php_lapack_stats_phase(PHP_LAPACK_STATS_CONVERT, start, (size_t)*m * *n * sizeof(float));
+		return outarray;
+	}
+
+	i = 0;
+	ZEND_HASH_FOREACH_VAL(Z_ARRVAL_P(operand), row) {
+		ZVAL_DEREF(row);
+		if (Z_TYPE_P(row) != IS_ARRAY || zend_hash_num_elements(Z_ARRVAL_P(row)) != *n) {
+			/* The matrix is not valid */
+			php_lapack_free((double *)outarray);
+			return NULL;
+		}
+
+		j = 0;
+		ZEND_HASH_FOREACH_VAL(Z_ARRVAL_P(row), val) {
+			outarray[((size_t)j * *m) + i] = (float)(EXPECTED(Z_TYPE_P(val) == IS_DOUBLE) ? Z_DVAL_P(val) : zval_get_double(val));
+			j++;
+		} ZEND_HASH_FOREACH_END();
+
+		i++;
+	} ZEND_HASH_FOREACH_END();
+
+	php_lapack_stats_phase(PHP_LAPACK_STATS_CONVERT, start, (size_t)*m * *n * sizeof(float));
+
+	return outarray;
+}
+/* }}} */
+
+/* {{{ static double* php_lapack_single_widen(const float *in, int m, int n, int ld)
+Copy the m x n float matrix in into a new compact double buffer.
+*/
+static double* php_lapack_single_widen(const float *in, int m, int n, int ld)
+{
+	double *out;
+	int i, j;
+
+	out = php_lapack_alloc((size_t)m * n);
+	for (j = 0; j < n; j++) {
+		for (i = 0; i < m; i++) {
+			out[i + (size_t)j * m] = in[i + (size_t)j * ld];
+		}
+	}
+
+	return out;
+}
+/* }}} */
+
+/* {{{ static void php_lapack_single_return(zval *return_value, const float *data, int m, int n, int ld, zend_bool as_matrix)
+Return a float result the way php_lapack_return_matrix does for doubles.
+*/
+static void php_lapack_single_return(zval *return_value, const float *data, int m, int n, int ld, zend_bool as_matrix)
+{
+	double *out = php_lapack_single_widen(data, m, n, ld);
+
+	php_lapack_return_matrix(return_value, &out, m, n, m, as_matrix);
+	php_lapack_free(out);
+}
+/* }}} */
+
+/* {{{ static lapack_int php_lapack_ssysv(char uplo, lapack_int n, lapack_int nrhs, float *a, lapack_int lda, lapack_int *ipiv, float *b, lapack_int ldb)
+ssysv with its workspace from the arena.
+*/
+static lapack_int php_lapack_ssysv(char uplo, lapack_int n, lapack_int nrhs, float *a, lapack_int lda, lapack_int *ipiv, float *b, lapack_int ldb)
+{
+	float *work, query = 0.0f;
+	size_t lwork;
+
+	if (php_lapack_lwork_get(PHP_LAPACK_WORK_SSYSV, n, nrhs, uplo, &lwork, NULL) == FAILURE) {
+		LAPACKE_ssysv_work( LAPACK_COL_MAJOR, uplo, n, nrhs, a, lda, ipiv, b, ldb, &query, -1 );
+		php_lapack_lwork_set(PHP_LAPACK_WORK_SSYSV, n, nrhs, uplo, query, 0, &lwork, NULL);
+	}
+	work = php_lapack_arena_alloc(lwork, sizeof(float));
+
+	return LAPACKE_ssysv_work( LAPACK_COL_MAJOR, uplo, n, nrhs, a, lda, ipiv, b, ldb, work, (lapack_int)lwork );
+}
+/* }}} */
+
+/* --- Single Precision Drivers --- */
+
+/* {{{ void php_lapack_single_solve(zval *return_value, zval *a, zval *b, zend_long structure)
+Lapack::solveLinearEquation in single precision.
+*/
+void php_lapack_single_solve(zval *return_value, zval *a, zval *b, zend_long structure)
+{
+	float *al, *bl, *ab;
+	lapack_int info, lda, ldb, ldab;
+	int m, n, nrhs, mb;
+	lapack_int *ipiv;
+	php_lapack_structure_info shape;
+	zend_bool as_matrix = 0;
+
+	al = php_lapack_single_operand(a, &m, &n, &as_matrix);
+	if (al == NULL) {
+		LAPACK_THROW("Invalid input matrix - argument 1", 102);
+	} else if ( m != n ) {
+		php_lapack_free((double *)al);
+		LAPACK_THROW("Matrix must be square", 103);
+	}
+
+	bl = php_lapack_single_operand(b, &mb, &nrhs, &as_matrix);
+	if (bl == NULL || mb != n) {
+		php_lapack_free((double *)al);
+		php_lapack_free((double *)bl);
+		LAPACK_THROW("Invalid input matrix - argument 2", 102);
+	}
+
+	ipiv = php_lapack_arena_alloc(n, sizeof(lapack_int));
+	lda = n;
+	ldb = n;
+	php_lapack_blas_threads_for((double)n * n * (n + nrhs));
+
+	switch (php_lapack_structure_single(structure, al, n, lda, &shape)) {
+		case PHP_LAPACK_UPPER_TRIANGULAR:
+			info = LAPACKE_strtrs_work( LAPACK_COL_MAJOR, 'U', 'N', 'N', n, nrhs, al, lda, bl, ldb );
+			break;
+
+		case PHP_LAPACK_LOWER_TRIANGULAR:
+			info = LAPACKE_strtrs_work( LAPACK_COL_MAJOR, 'L', 'N', 'N', n, nrhs, al, lda, bl, ldb );
+			break;
+
+		case PHP_LAPACK_POSITIVE_DEFINITE:
+			info = LAPACKE_sposv_work( LAPACK_COL_MAJOR, 'L', n, nrhs, al, lda, bl, ldb );
+			if (info <= 0) {
+				break;
+			}
+			php_lapack_stats_info(info);
+			/* As in the double version, retry from the untouched upper triangle */
+			info = php_lapack_ssysv( 'U', n, nrhs, al, lda, ipiv, bl, ldb );
+			break;
+
+		case PHP_LAPACK_SYMMETRIC:
+			info = php_lapack_ssysv( 'L', n, nrhs, al, lda, ipiv, bl, ldb );
+			break;
+
+		case PHP_LAPACK_BANDED:
+			info = 1;
+			if (shape.symmetric && shape.positive_diagonal) {
+				ldab = shape.ku + 1;
+				ab = php_lapack_band_pack_single(al, n, lda, 0, shape.ku, ldab);
+				info = LAPACKE_spbsv_work( LAPACK_COL_MAJOR, 'U', n, shape.ku, nrhs, ab, ldab, bl, ldb );
+				php_lapack_free((double *)ab);
+				php_lapack_stats_info(info);
+			}
+			if (info > 0) {
+				ldab = 2 * shape.kl + shape.ku + 1;
+				ab = php_lapack_band_pack_single(al, n, lda, shape.kl, shape.ku, ldab);
+				info = LAPACKE_sgbsv_work( LAPACK_COL_MAJOR, n, shape.kl, shape.ku, nrhs, ab, ldab, ipiv, bl, ldb );
+				php_lapack_free((double *)ab);
+			}
+			break;
+
+		default:
+			info = LAPACKE_sgesv_work( LAPACK_COL_MAJOR, n, nrhs, al, lda, ipiv, bl, ldb );
+			break;
+	}
+	php_lapack_stats_info(info);
+
+	if (info == 0) {
+		php_lapack_single_return(return_value, bl, n, nrhs, ldb, as_matrix);
+	} else {
+		array_init(return_value);
+	}
+
+	php_lapack_free((double *)al);
+	php_lapack_free((double *)bl);
+}
+/* }}} */
+
+/* {{{ void php_lapack_single_least_squares(zval *return_value, zval *a, zval *b, zend_bool svd)
+Lapack::leastSquaresByFactorisation (sgels) and, when svd is set,
+Lapack::leastSquaresBySVD (sgelsd) in single precision.
+*/
+void php_lapack_single_least_squares(zval *return_value, zval *a, zval *b, zend_bool svd)
+{
+	float *al, *bl, *wide, *s, *work, query = 0.0f;
+	lapack_int info, lda, ldb, rank, iquery = 0;
+	int m, n, mb, nrhs, j;
+	lapack_int *iwork;
+	size_t lwork, liwork;
+	zend_bool as_matrix = 0;
+
+	al = php_lapack_single_operand(a, &m, &n, &as_matrix);
+	if (al == NULL) {
+		LAPACK_THROW("Invalid input matrix - argument 1", 102);
+	}
+
+	bl = php_lapack_single_operand(b, &mb, &nrhs, &as_matrix);
+	if (bl == NULL) {
+		php_lapack_free((double *)al);
+		LAPACK_THROW("Invalid input matrix - argument 2", 102);
+	} else if (mb != m) {
+		php_lapack_free((double *)al);
+		php_lapack_free((double *)bl);
+		LAPACK_THROW("Invalid input matrix - argument 2", 102);
+	}
+
+	lda = m;
+	ldb = m > n ? m : n;
+	if (ldb > m) {
+		/* The n rows of the solution are returned in B's place */
+		wide = php_lapack_alloc_single((size_t)ldb * nrhs);
+		for (j = 0; j < nrhs; j++) {
+			memcpy(wide + (size_t)j * ldb, bl + (size_t)j * m, m * sizeof(float));
+		}
+		php_lapack_free((double *)bl);
+		bl = wide;
+	}
+	php_lapack_blas_threads_for((double)m * n * (n + nrhs));
+
+	if (svd) {
+		s = php_lapack_arena_alloc(m, sizeof(float));
+		if (php_lapack_lwork_get(PHP_LAPACK_WORK_SGELSD, m, n, nrhs, &lwork, &liwork) == FAILURE) {
+			LAPACKE_sgelsd_work( LAPACK_COL_MAJOR, m, n, nrhs, al, lda, bl, ldb, s, -1.0f, &rank, &query, -1, &iquery );
+			php_lapack_lwork_set(PHP_LAPACK_WORK_SGELSD, m, n, nrhs, query, iquery, &lwork, &liwork);
+		}
+		work = php_lapack_arena_alloc(lwork, sizeof(float));
+		iwork = php_lapack_arena_alloc(liwork, sizeof(lapack_int));
+		/* Negative rcond means using default (machine precision) value */
+		info = LAPACKE_sgelsd_work( LAPACK_COL_MAJOR, m, n, nrhs, al, lda, bl, ldb, s, -1.0f, &rank,
+									work, (lapack_int)lwork, iwork );
+	} else {
+		if (php_lapack_lwork_get(PHP_LAPACK_WORK_SGELS, m, n, nrhs, &lwork, NULL) == FAILURE) {
+			LAPACKE_sgels_work( LAPACK_COL_MAJOR, 'N', m, n, nrhs, al, lda, bl, ldb, &query, -1 );
+			php_lapack_lwork_set(PHP_LAPACK_WORK_SGELS, m, n, nrhs, query, 0, &lwork, NULL);
+		}
+		work = php_lapack_arena_alloc(lwork, sizeof(float));
+		info = LAPACKE_sgels_work( LAPACK_COL_MAJOR, 'N', m, n, nrhs, al, lda, bl, ldb, work, (lapack_int)lwork );
+	}
+	php_lapack_stats_info(info);
+
+	if (info == 0) {
+		php_lapack_single_return(return_value, bl, n, nrhs, ldb, as_matrix);
+	}
+
+	php_lapack_free((double *)al);
+	php_lapack_free((double *)bl);
+}
+/* }}} */
+
+/* {{{ void php_lapack_single_eigen(zval *return_value, zval *a, zval *leig, zval *reig, zend_long structure)
+Lapack::eigenValues in single precision.
+*/
+void php_lapack_single_eigen(zval *return_value, zval *a, zval *leig, zval *reig, zend_long structure)
+{
+	float *al, *wr, *wi, *vl, *vr, *work, query = 0.0f, dummy = 0.0f;
+	double *dwr, *dwi, *dvl, *dvr;
+	lapack_int info, lda, ldvl, ldvr, iquery = 0;
+	int m, n;
+	lapack_int *iwork;
+	size_t lwork, liwork;
+	php_lapack_structure_info shape;
+	zend_bool as_matrix = 0;
+	char jobvl, jobvr;
+	int kind;
+
+	al = php_lapack_single_operand(a, &m, &n, &as_matrix);
+	if (al == NULL) {
+		LAPACK_THROW("Invalid input matrix", 102);
+	} else if ( m != n ) {
+		php_lapack_free((double *)al);
+		LAPACK_THROW("Matrix must be square", 103);
+	}
+
+	jobvl = php_lapack_output_wanted(leig) ? 'V' : 'N';
+	jobvr = php_lapack_output_wanted(reig) ? 'V' : 'N';
+
+	lda = n;
+
+	php_lapack_blas_threads_for((double)n * n * n);
+	wr = php_lapack_arena_alloc(n, sizeof(float));
+	wi = php_lapack_arena_alloc(n, sizeof(float));
+	memset(wi, 0, n * sizeof(float));
+
+	kind = php_lapack_structure_single(structure, al, n, lda, &shape);
+	if (kind == PHP_LAPACK_SYMMETRIC || kind == PHP_LAPACK_POSITIVE_DEFINITE || shape.symmetric) {
+		char jobz = (jobvl == 'V' || jobvr == 'V') ? 'V' : 'N';
+
+		if (php_lapack_lwork_get(PHP_LAPACK_WORK_SSYEVD, n, 0, jobz, &lwork, &liwork) == FAILURE) {
+			LAPACKE_ssyevd_work( LAPACK_COL_MAJOR, jobz, 'L', n, al, lda, wr, &query, -1, &iquery, -1 );
+			php_lapack_lwork_set(PHP_LAPACK_WORK_SSYEVD, n, 0, jobz, query, iquery, &lwork, &liwork);
+		}
+		work = php_lapack_arena_alloc(lwork, sizeof(float));
+		iwork = php_lapack_arena_alloc(liwork, sizeof(lapack_int));
+
+		info = LAPACKE_ssyevd_work( LAPACK_COL_MAJOR, jobz, 'L', n, al, lda, wr,
+									work, (lapack_int)lwork, iwork, (lapack_int)liwork );
+		vl = vr = al;
+	} else {
+		ldvl = jobvl == 'V' ? n : 1;
+		ldvr = jobvr == 'V' ? n : 1;
+		vl = jobvl == 'V' ? php_lapack_arena_alloc((size_t)n * n, sizeof(float)) : &dummy;
+		vr = jobvr == 'V' ? php_lapack_arena_alloc((size_t)n * n, sizeof(float)) : &dummy;
+
+		if (php_lapack_lwork_get(PHP_LAPACK_WORK_SGEEV, n, 0, (jobvl << 8) | jobvr, &lwork, NULL) == FAILURE) {
+			LAPACKE_sgeev_work( LAPACK_COL_MAJOR, jobvl, jobvr, n, al, lda, wr, wi, vl, ldvl, vr, ldvr, &query, -1 );
+			php_lapack_lwork_set(PHP_LAPACK_WORK_SGEEV, n, 0, (jobvl << 8) | jobvr, query, 0, &lwork, NULL);
+		}
+		work = php_lapack_arena_alloc(lwork, sizeof(float));
+
+		info = LAPACKE_sgeev_work( LAPACK_COL_MAJOR, jobvl, jobvr, n, al, lda, wr, wi, vl, ldvl, vr, ldvr,
+								   work, (lapack_int)lwork );
+	}
+	php_lapack_stats_info(info);
+
+	if (info == 0) {
+		dwr = php_lapack_single_widen(wr, n, 1, n);
+		dwi = php_lapack_single_widen(wi, n, 1, n);
+		dvl = dvr = NULL;
+		if (jobvl == 'V' || (vl == al && jobvr == 'V')) {
+			dvl = php_lapack_single_widen(vl, n, n, n);
+		}
+		if (jobvr == 'V') {
+			dvr = vr == vl ? dvl : php_lapack_single_widen(vr, n, n, n);
+		}
+
+		php_lapack_eigen_results(return_value, leig, reig, n, dwr, dwi, dvl, dvr, n, as_matrix);
+
+		if (dvr != dvl) {
+			php_lapack_free(dvr);
+		}
+		php_lapack_free(dvl);
+		php_lapack_free(dwr);
+		php_lapack_free(dwi);
+	} else {
+		array_init(return_value);
+	}
+
+	php_lapack_free((double *)al);
+}
+/* }}} */
+
+/* {{{ void php_lapack_single_singular_values(zval *return_value, zval *a)
+Lapack::singularValues in single precision.
+*/
+void php_lapack_single_singular_values(zval *return_value, zval *a)
+{
+	float *al, *s, *work, u, vt, query = 0.0f;
+	lapack_int info, lda, ldu, ldvt;
+	int m, n;
+	lapack_int *iwork;
+	size_t lwork;
+	zend_bool as_matrix = 0;
+
+	al = php_lapack_single_operand(a, &m, &n, &as_matrix);
+	if (al == NULL) {
+		LAPACK_THROW("Invalid input matrix", 102);
+	}
+
+	/* Values only, so U and VT are never referenced */
+	lda = m;
+	ldu = 1;
+	ldvt = 1;
+	s = php_lapack_arena_alloc((n < m ? n : m), sizeof(float));
+	iwork = php_lapack_arena_alloc(8 * (size_t)(n < m ? n : m), sizeof(lapack_int));
+	php_lapack_blas_threads_for((double)m * n * (n < m ? n : m));
+
+	if (php_lapack_lwork_get(PHP_LAPACK_WORK_SGESDD, m, n, 'N', &lwork, NULL) == FAILURE) {
+		LAPACKE_sgesdd_work( LAPACK_COL_MAJOR, 'N', m, n, al, lda, s, &u, ldu, &vt, ldvt, &query, -1, iwork );
+		php_lapack_lwork_set(PHP_LAPACK_WORK_SGESDD, m, n, 'N', query, 0, &lwork, NULL);
+	}
+	work = php_lapack_arena_alloc(lwork, sizeof(float));
+
+	info = LAPACKE_sgesdd_work( LAPACK_COL_MAJOR, 'N', m, n, al, lda, s, &u, ldu, &vt, ldvt, work, (lapack_int)lwork, iwork );
+	php_lapack_stats_info(info);
+
+	if (info == 0) {
+		php_lapack_single_return(return_value, s, 1, (n < m ? n : m), 1, as_matrix);
+	}
+
+	php_lapack_free((double *)al);
+}
+/* }}} */
+
+/* {{{ void php_lapack_single_shape_regression(zval *return_value, zval *M, zval *P, zval *W)
+Lapack::shapeRegressionModel in single precision. G = W^T . V . S^-1 . U^T is
+formed in the cheaper of its two orders, with S^-1 applied as a scaling, and
+R = P . G in a single sgemm since P is already held as a float copy.
+*/
+void php_lapack_single_shape_regression(zval *return_value, zval *M, zval *P, zval *W)
+{
+	float *Ml, *Pl, *Wl, *Fl, *S, *U, *VT, *T, *H, *G, *R, *work, query = 0.0f;
+	lapack_int *iwork;
+	int i, j;
+	size_t lwork;
+
+	/* ns = number of subjects, nf = number of features/measurements,
+	   np = number of principal components, nc = number of coordinate values */
+	lapack_int info, ld, r;
+	int n, m, ns, nf, np, nc;
+	zend_bool as_matrix = 0;
+
+	Ml = php_lapack_single_operand(M, &ns, &nf, &as_matrix);
+	if (Ml == NULL) {
+		LAPACK_THROW("Invalid input matrix - argument 1 (M)", 102);
+	}
+
+	Pl = php_lapack_single_operand(P, &nc, &np, &as_matrix);
+	if (Pl == NULL) {
+		php_lapack_free((double *)Ml);
+		LAPACK_THROW("Invalid input matrix - argument 2 (P)", 102);
+	}
+
+	Wl = php_lapack_single_operand(W, &m, &n, &as_matrix);
+	if (Wl == NULL || m != ns || n != np) {
+		php_lapack_free((double *)Ml);
+		php_lapack_free((double *)Pl);
+		php_lapack_free((double *)Wl);
+		if (Wl == NULL) {
+			LAPACK_THROW("Invalid input matrix - argument 3 (W)", 102);
+		} else if (m != ns) {
+			LAPACK_THROW("Invalid input matrix - argument 3 (W), wrong number of rows", 102);
+		}
+		LAPACK_THROW("Invalid input matrix - argument 3 (W), wrong number of columns", 102);
+	}
+
+	/* F is M transposed with an additional row of ones */
+	ld = nf + 1;
+	r = ns < ld ? ns : ld;
+	php_lapack_blas_threads_for((double)ns * ld * ld + (double)nc * np * ld);
+	Fl = php_lapack_arena_alloc((size_t)ld * ns, sizeof(float));
+	for ( j = 0; j < ns; j++ ) {
+		for ( i = 0; i < nf; i++ ) {
+			Fl[(size_t)j * ld + i] = Ml[(size_t)i * ns + j];
+		}
+		Fl[(size_t)j * ld + nf] = 1.0f;
+	}
+	php_lapack_free((double *)Ml);
+
+	S = php_lapack_arena_alloc(r, sizeof(float));
+	U = php_lapack_arena_alloc((size_t)ld * r, sizeof(float));
+	VT = php_lapack_arena_alloc((size_t)r * ns, sizeof(float));
+	iwork = php_lapack_arena_alloc(8 * (size_t)r, sizeof(lapack_int));
+
+	if (php_lapack_lwork_get(PHP_LAPACK_WORK_SGESDD, ld, ns, 'S', &lwork, NULL) == FAILURE) {
+		LAPACKE_sgesdd_work( LAPACK_COL_MAJOR, 'S', ld, ns, Fl, ld, S, U, ld, VT, r, &query, -1, iwork );
+		php_lapack_lwork_set(PHP_LAPACK_WORK_SGESDD, ld, ns, 'S', query, 0, &lwork, NULL);
+	}
+	work = php_lapack_arena_alloc(lwork, sizeof(float));
+
+	info = LAPACKE_sgesdd_work( LAPACK_COL_MAJOR, 'S', ld, ns, Fl, ld, S, U, ld, VT, r, work, (lapack_int)lwork, iwork );
+	php_lapack_stats_info(info);
+	if (info != 0) {
+		php_lapack_free((double *)Pl);
+		php_lapack_free((double *)Wl);
+		LAPACK_THROW("SVD failed", 101);
+	}
+
+	for ( i = 0; i < r; i++ ) {
+		S[i] = S[i] != 0.0f ? 1.0f / S[i] : 0.0f;
+	}
+
+	G = php_lapack_arena_alloc((size_t)np * ld, sizeof(float));
+	if ((double)np * r * (ns + ld) <= (double)ns * ld * (r + np)) {
+		/* T = W^T . V with its columns scaled by S^-1, G = T . U^T */
+		T = php_lapack_arena_alloc((size_t)np * r, sizeof(float));
+		cblas_sgemm( CblasColMajor, CblasTrans, CblasTrans, np, r, ns,
+			1.0f, Wl, ns, VT, r, 0.0f, T, np );
+		for ( j = 0; j < r; j++ ) {
+			for ( i = 0; i < np; i++ ) {
+				T[(size_t)j * np + i] *= S[j];
+			}
+		}
+		cblas_sgemm( CblasColMajor, CblasNoTrans, CblasTrans, np, ld, r,
+			1.0f, T, np, U, ld, 0.0f, G, np );
+	} else {
+		/* T = S^-1 . U^T, H = V . T, G = W^T . H */
+		T = php_lapack_arena_alloc((size_t)r * ld, sizeof(float));
+		for ( j = 0; j < ld; j++ ) {
+			for ( i = 0; i < r; i++ ) {
+				T[(size_t)j * r + i] = U[(size_t)i * ld + j] * S[i];
+			}
+		}
+		H = php_lapack_arena_alloc((size_t)ns * ld, sizeof(float));
+		cblas_sgemm( CblasColMajor, CblasTrans, CblasNoTrans, ns, ld, r,
+			1.0f, VT, r, T, r, 0.0f, H, ns );
+		cblas_sgemm( CblasColMajor, CblasTrans, CblasNoTrans, np, ld, ns,
+			1.0f, Wl, ns, H, ns, 0.0f, G, np );
+	}
+	php_lapack_free((double *)Wl);
+
+	/* R = P . G */
+	R = php_lapack_arena_alloc((size_t)nc * ld, sizeof(float));
+	cblas_sgemm( CblasColMajor, CblasNoTrans, CblasNoTrans, nc, ld, np,
+		1.0f, Pl, nc, G, np, 0.0f, R, nc );
+	php_lapack_free((double *)Pl);
+
+	php_lapack_single_return(return_value, R, nc, ld, nc, as_matrix);
+}
+/* }}} */
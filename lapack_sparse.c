@@ -0,0 +1,1204 @@
+/*
+  +----------------------------------------------------------------------+
+  | PHP Version 5 / lapack                                               |
+  +----------------------------------------------------------------------+
+  | Copyright (c) 2012 Ian Barber                                        |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 3.0 of the PHP license,       |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.php.net/license/3_0.txt.                                  |
+  | If you did not receive a copy of the PHP license and are unable to   |
+  | obtain it through the world-wide-web, please send a note to          |
+  | license@php.net so we can mail you a copy immediately.               |
+  +----------------------------------------------------------------------+
+  | Authors: Ian Barber <ian.barber@gmail.com>                           |
+  +----------------------------------------------------------------------+
+*/
+
+#include "php_lapack.h"
+#include "php_lapack_internal.h"
+#include "Zend/zend_exceptions.h"
+
+#include <math.h>
+#include "cblas.h"
+
+/*
+ * Sparse matrices and iterative solvers. LapackSparse holds a matrix in
+ * compressed sparse row (CSR) form, built from coordinate (COO) triplets,
+ * so a 1e6 x 1e6 system with ten nonzeros a row takes about 120MB rather
+ * than the 8TB a dense copy would. The only kernel the solvers need is the
+ * product with a vector, which runs over blocks of rows on the native thread
+ * pool once the matrix has lapack.parallel_threshold nonzeros.
+ *
+ * Lapack::solveSparse() uses preconditioned conjugate gradients for positive
+ * definite systems and restarted GMRES for anything else, and
+ * Lapack::leastSquaresSparse() uses LSQR. Preconditioning is by the
+ * diagonal (Jacobi) or an incomplete LU factorisation with the sparsity
+ * pattern of A (ILU(0)). GMRES is preconditioned on the right, so its
+ * residual, like that of CG, is the true ||B - A . X|| / ||B||.
+ */
+
+/* Rows handed to a pool thread at a time by the matrix-vector product */
+#define PHP_LAPACK_SPARSE_BLOCK		4096
+
+/* Basis vectors kept by GMRES between restarts */
+#define PHP_LAPACK_GMRES_RESTART	30
+
+/* Iterative solvers, reported in the status array */
+#define PHP_LAPACK_SPARSE_CG		1
+#define PHP_LAPACK_SPARSE_GMRES		2
+#define PHP_LAPACK_SPARSE_LSQR		3
+
+/* Solver outcomes, counted as LAPACK info codes in Lapack::stats() */
+#define PHP_LAPACK_SPARSE_CONVERGED		0
+#define PHP_LAPACK_SPARSE_ITERATIONS	1	/* ran out of iterations */
+#define PHP_LAPACK_SPARSE_BREAKDOWN		2	/* A or the preconditioner is unusable */
+
+typedef struct _php_lapack_sparse_object {
+	size_t *rowptr;			/* m + 1 offsets into cols and values, NULL until built */
+	int *cols;				/* ascending within each row, without repeats */
+	double *values;
+	int m;
+	int n;
+	size_t nnz;
+	zend_object std;
+} php_lapack_sparse_object;
+
+static inline php_lapack_sparse_object *php_lapack_sparse_from_obj(zend_object *obj) {
+	return (php_lapack_sparse_object *)((char *)(obj) - XtOffsetOf(php_lapack_sparse_object, std));
+}
+
+#define Z_LAPACK_SPARSE_P(zv) php_lapack_sparse_from_obj(Z_OBJ_P(zv))
+
+/* A preconditioner, applied as z = M^-1 . r */
+typedef struct _php_lapack_precond {
+	zend_long kind;
+	int n;
+	double *diag;			/* Jacobi: the inverse diagonal */
+	double *lu;				/* ILU(0): L and U in the pattern of A, unit L */
+	size_t *udiag;			/* ILU(0): position of each diagonal entry */
+	php_lapack_sparse_object *a;
+} php_lapack_precond;
+
+/* Where an iterative solve ended, over all the right hand sides */
+typedef struct _php_lapack_sparse_status {
+	int method;
+	zend_long iterations;
+	double residual;
+	int info;
+} php_lapack_sparse_status;
+
+typedef struct _php_lapack_sparse_gemv {
+	const php_lapack_sparse_object *a;
+	const double *x;
+	double *y;
+} php_lapack_sparse_gemv;
+
+typedef struct _php_lapack_sparse_entry {
+	int col;
+	double value;
+} php_lapack_sparse_entry;
+
+static zend_class_entry *php_lapack_sparse_sc_entry;
+static zend_object_handlers lapack_sparse_object_handlers;
+
+/* --- Helper Functions --- */
+
+/* {{{ static php_lapack_sparse_object* php_lapack_sparse_fetch(zval *object)
+Return the sparse matrix behind object, or throw if it was never built.
+*/
+static php_lapack_sparse_object* php_lapack_sparse_fetch(zval *object)
+{
+	php_lapack_sparse_object *intern = Z_LAPACK_SPARSE_P(object);
+
+	if (intern->rowptr == NULL) {
+		zend_throw_exception(php_lapack_exception_sc_entry, "Sparse matrix is not initialised", 104);
+		return NULL;
+	}
+
+	return intern;
+}
+/* }}} */
+
+/* {{{ static void php_lapack_sparse_rows(void *ctx, size_t task)
+y = A . x over one block of rows, as a pool task.
+*/
+static void php_lapack_sparse_rows(void *ctx, size_t task)
+{
+	php_lapack_sparse_gemv *job = (php_lapack_sparse_gemv *)ctx;
+	const php_lapack_sparse_object *a = job->a;
+	size_t i, k, begin, end;
+	double sum;
+
+	begin = task * PHP_LAPACK_SPARSE_BLOCK;
+	end = begin + PHP_LAPACK_SPARSE_BLOCK < (size_t)a->m ? begin + PHP_LAPACK_SPARSE_BLOCK : (size_t)a->m;
+
+	for (i = begin; i < end; i++) {
+		sum = 0.0;
+		for (k = a->rowptr[i]; k < a->rowptr[i + 1]; k++) {
+			sum += a->values[k] * job->x[a->cols[k]];
+		}
+		job->y[i] = sum;
+	}
+}
+/* }}} */
+
+/* {{{ static void php_lapack_sparse_gemv_run(const php_lapack_sparse_object *a, const double *x, double *y)
+y = A . x, on the thread pool for large matrices.
+*/
+static void php_lapack_sparse_gemv_run(const php_lapack_sparse_object *a, const double *x, double *y)
+{
+	php_lapack_sparse_gemv job;
+	size_t ntasks = ((size_t)a->m + PHP_LAPACK_SPARSE_BLOCK - 1) / PHP_LAPACK_SPARSE_BLOCK;
+
+	job.a = a;
+	job.x = x;
+	job.y = y;
+
+	php_lapack_pool_run(ntasks, php_lapack_sparse_rows, &job,
+		(double)a->nnz < (double)LAPACK_G(parallel_threshold) ? 1 : php_lapack_pool_threads(LAPACK_G(max_threads), ntasks));
+}
+/* }}} */
+
+/* {{{ static void php_lapack_sparse_gemv_trans(const php_lapack_sparse_object *a, const double *x, double *y)
+y = A^T . x. The rows scatter into y, so this one stays on one thread.
+*/
+static void php_lapack_sparse_gemv_trans(const php_lapack_sparse_object *a, const double *x, double *y)
+{
+	size_t i, k;
+
+	memset(y, 0, (size_t)a->n * sizeof(double));
+	for (i = 0; i < (size_t)a->m; i++) {
+		for (k = a->rowptr[i]; k < a->rowptr[i + 1]; k++) {
+			y[a->cols[k]] += a->values[k] * x[i];
+		}
+	}
+}
+/* }}} */
+
+/* {{{ static double php_lapack_sparse_find(const php_lapack_sparse_object *a, int i, int j)
+Element (i, j) of A, by binary search of row i.
+*/
+static double php_lapack_sparse_find(const php_lapack_sparse_object *a, int i, int j)
+{
+	size_t lo = a->rowptr[i], hi = a->rowptr[i + 1], mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (a->cols[mid] == j) {
+			return a->values[mid];
+		} else if (a->cols[mid] < j) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	return 0.0;
+}
+/* }}} */
+
+/* {{{ static zend_bool php_lapack_sparse_positive_definite(const php_lapack_sparse_object *a)
+Whether A looks positive definite in the sense php_lapack_structure() uses
+for dense matrices: square, symmetric and with a positive diagonal.
+*/
+static zend_bool php_lapack_sparse_positive_definite(const php_lapack_sparse_object *a)
+{
+	size_t i, k;
+	int j;
+
+	if (a->m != a->n) {
+		return 0;
+	}
+
+	for (i = 0; i < (size_t)a->m; i++) {
+		if (php_lapack_sparse_find(a, (int)i, (int)i) <= 0.0) {
+			return 0;
+		}
+		for (k = a->rowptr[i]; k < a->rowptr[i + 1]; k++) {
+			j = a->cols[k];
+			if (j != (int)i && php_lapack_sparse_find(a, j, (int)i) != a->values[k]) {
+				return 0;
+			}
+		}
+	}
+
+	return 1;
+}
+/* }}} */
+
+/* {{{ static int php_lapack_entry_compare(const void *x, const void *y)
+*/
+static int php_lapack_entry_compare(const void *x, const void *y)
+{
+	int a = ((const php_lapack_sparse_entry *)x)->col, b = ((const php_lapack_sparse_entry *)y)->col;
+
+	return a < b ? -1 : (a > b ? 1 : 0);
+}
+/* }}} */
+
+/* --- Preconditioners --- */
+
+/* {{{ static int php_lapack_precond_init(php_lapack_precond *p, php_lapack_sparse_object *a, zend_long kind)
+Set up the preconditioner of the given kind for the square matrix A. Fails
+when ILU(0) meets a missing or zero pivot.
+*/
+static int php_lapack_precond_init(php_lapack_precond *p, php_lapack_sparse_object *a, zend_long kind)
+{
+	size_t i, k, q, r;
+	double d;
+	int j;
+
+	p->kind = kind;
+	p->n = a->n;
+	p->a = a;
+	p->diag = NULL;
+	p->lu = NULL;
+	p->udiag = NULL;
+
+	if (kind == PHP_LAPACK_PRECONDITION_JACOBI) {
+		/* A zero diagonal entry leaves its row unscaled */
+		p->diag = php_lapack_arena_alloc(a->n, sizeof(double));
+		for (i = 0; i < (size_t)a->n; i++) {
+			d = (int)i < a->m ? php_lapack_sparse_find(a, (int)i, (int)i) : 0.0;
+			p->diag[i] = d != 0.0 ? 1.0 / d : 1.0;
+		}
+	} else if (kind == PHP_LAPACK_PRECONDITION_ILU0) {
+		p->lu = php_lapack_arena_alloc(a->nnz, sizeof(double));
+		p->udiag = php_lapack_arena_alloc(a->m, sizeof(size_t));
+		memcpy(p->lu, a->values, a->nnz * sizeof(double));
+
+		for (i = 0; i < (size_t)a->m; i++) {
+			for (k = a->rowptr[i]; k < a->rowptr[i + 1] && a->cols[k] < (int)i; k++);
+			if (k == a->rowptr[i + 1] || a->cols[k] != (int)i) {
+				return FAILURE;
+			}
+			p->udiag[i] = k;
+		}
+
+		/* IKJ elimination, keeping only the entries already in the pattern */
+		for (i = 0; i < (size_t)a->m; i++) {
+			for (k = a->rowptr[i]; k < p->udiag[i]; k++) {
+				j = a->cols[k];
+				if (p->lu[p->udiag[j]] == 0.0) {
+					return FAILURE;
+				}
+				p->lu[k] /= p->lu[p->udiag[j]];
+
+				/* Both rows are sorted, so walk U's row j alongside the rest of row i */
+				q = k + 1;
+				for (r = p->udiag[j] + 1; r < a->rowptr[j + 1]; r++) {
+					while (q < a->rowptr[i + 1] && a->cols[q] < a->cols[r]) {
+						q++;
+					}
+					if (q == a->rowptr[i + 1]) {
+						break;
+					}
+					if (a->cols[q] == a->cols[r]) {
+						p->lu[q] -= p->lu[k] * p->lu[r];
+					}
+				}
+			}
+			if (p->lu[p->udiag[i]] == 0.0) {
+				return FAILURE;
+			}
+		}
+	}
+
+	return SUCCESS;
+}
+/* }}} */
+
+/* {{{ static void php_lapack_precond_apply(const php_lapack_precond *p, const double *r, double *z)
+z = M^-1 . r
+*/
+static void php_lapack_precond_apply(const php_lapack_precond *p, const double *r, double *z)
+{
+	const php_lapack_sparse_object *a = p->a;
+	size_t i, k;
+	double sum;
+
+	switch (p->kind) {
+		case PHP_LAPACK_PRECONDITION_JACOBI:
+			for (i = 0; i < (size_t)p->n; i++) {
+				z[i] = r[i] * p->diag[i];
+			}
+			break;
+
+		case PHP_LAPACK_PRECONDITION_ILU0:
+			/* L . y = r with unit L, then U . z = y */
+			for (i = 0; i < (size_t)p->n; i++) {
+				sum = r[i];
+				for (k = a->rowptr[i]; k < p->udiag[i]; k++) {
+					sum -= p->lu[k] * z[a->cols[k]];
+				}
+				z[i] = sum;
+			}
+			for (i = p->n; i-- > 0; ) {
+				sum = z[i];
+				for (k = p->udiag[i] + 1; k < a->rowptr[i + 1]; k++) {
+					sum -= p->lu[k] * z[a->cols[k]];
+				}
+				z[i] = sum / p->lu[p->udiag[i]];
+			}
+			break;
+
+		default:
+			memcpy(z, r, (size_t)p->n * sizeof(double));
+			break;
+	}
+}
+/* }}} */
+
+/* --- Iterative Solvers --- */
+
+/* {{{ static int php_lapack_sparse_cg(php_lapack_sparse_object *a, const php_lapack_precond *p, const double *b, double *x, double tol, zend_long maxit, zend_long *iterations, double *residual)
+Preconditioned conjugate gradients for A . x = b from x = 0. Breaks down if
+A or M turns out not to be positive definite.
+*/
+static int php_lapack_sparse_cg(php_lapack_sparse_object *a, const php_lapack_precond *p, const double *b, double *x,
+	double tol, zend_long maxit, zend_long *iterations, double *residual)
+{
+	int n = a->n;
+	double *r, *z, *d, *q, bnorm, rz, rz_next, dq, alpha;
+	zend_long it;
+
+	memset(x, 0, (size_t)n * sizeof(double));
+	*iterations = 0;
+	*residual = 0.0;
+
+	bnorm = cblas_dnrm2(n, b, 1);
+	if (bnorm == 0.0) {
+		return PHP_LAPACK_SPARSE_CONVERGED;
+	}
+
+	r = php_lapack_arena_alloc(n, sizeof(double));
+	z = php_lapack_arena_alloc(n, sizeof(double));
+	d = php_lapack_arena_alloc(n, sizeof(double));
+	q = php_lapack_arena_alloc(n, sizeof(double));
+
+	memcpy(r, b, (size_t)n * sizeof(double));
+	php_lapack_precond_apply(p, r, z);
+	memcpy(d, z, (size_t)n * sizeof(double));
+	rz = cblas_ddot(n, r, 1, z, 1);
+	*residual = 1.0;
+
+	for (it = 1; it <= maxit; it++) {
+		php_lapack_sparse_gemv_run(a, d, q);
+		dq = cblas_ddot(n, d, 1, q, 1);
+		if (dq <= 0.0 || rz <= 0.0) {
+			*iterations = it;
+			return PHP_LAPACK_SPARSE_BREAKDOWN;
+		}
+
+		alpha = rz / dq;
+		cblas_daxpy(n, alpha, d, 1, x, 1);
+		cblas_daxpy(n, -alpha, q, 1, r, 1);
+
+		*iterations = it;
+		*residual = cblas_dnrm2(n, r, 1) / bnorm;
+		if (*residual <= tol) {
+			return PHP_LAPACK_SPARSE_CONVERGED;
+		}
+
+		php_lapack_precond_apply(p, r, z);
+		rz_next = cblas_ddot(n, r, 1, z, 1);
+		/* d = z + (rz_next / rz) . d */
+		cblas_dscal(n, rz_next / rz, d, 1);
+		cblas_daxpy(n, 1.0, z, 1, d, 1);
+		rz = rz_next;
+	}
+
+	return PHP_LAPACK_SPARSE_ITERATIONS;
+}
+/* }}} */
+
+/* {{{ static int php_lapack_sparse_gmres(php_lapack_sparse_object *a, const php_lapack_precond *p, const double *b, double *x, double tol, zend_long maxit, zend_long *iterations, double *residual)
+Right preconditioned GMRES, restarted every PHP_LAPACK_GMRES_RESTART steps,
+for A . x = b from x = 0. The Hessenberg matrix is kept triangular with
+Givens rotations as it grows, so the residual norm is known at every step.
+*/
+static int php_lapack_sparse_gmres(php_lapack_sparse_object *a, const php_lapack_precond *p, const double *b, double *x,
+	double tol, zend_long maxit, zend_long *iterations, double *residual)
+{
+	int n = a->n, restart = PHP_LAPACK_GMRES_RESTART < a->n ? PHP_LAPACK_GMRES_RESTART : a->n;
+	int i, j, steps;
+	double *v, *w, *z, *h, *cs, *sn, *g, *y, bnorm, beta, t, hnext;
+	zend_long it = 0;
+
+	memset(x, 0, (size_t)n * sizeof(double));
+	*iterations = 0;
+	*residual = 0.0;
+
+	bnorm = cblas_dnrm2(n, b, 1);
+	if (bnorm == 0.0) {
+		return PHP_LAPACK_SPARSE_CONVERGED;
+	}
+
+	v = php_lapack_arena_alloc((size_t)n * (restart + 1), sizeof(double));
+	w = php_lapack_arena_alloc(n, sizeof(double));
+	z = php_lapack_arena_alloc(n, sizeof(double));
+	/* h is (restart + 1) x restart, column-major */
+	h = php_lapack_arena_alloc((size_t)(restart + 1) * restart, sizeof(double));
+	cs = php_lapack_arena_alloc(restart, sizeof(double));
+	sn = php_lapack_arena_alloc(restart, sizeof(double));
+	g = php_lapack_arena_alloc(restart + 1, sizeof(double));
+	y = php_lapack_arena_alloc(restart, sizeof(double));
+
+	for (;;) {
+		/* r = b - A . x, which is b itself on the first pass */
+		php_lapack_sparse_gemv_run(a, x, w);
+		for (i = 0; i < n; i++) {
+			v[i] = b[i] - w[i];
+		}
+		beta = cblas_dnrm2(n, v, 1);
+		*residual = beta / bnorm;
+		if (*residual <= tol) {
+			return PHP_LAPACK_SPARSE_CONVERGED;
+		}
+		if (it >= maxit) {
+			return PHP_LAPACK_SPARSE_ITERATIONS;
+		}
+
+		cblas_dscal(n, 1.0 / beta, v, 1);
+		memset(g, 0, (size_t)(restart + 1) * sizeof(double));
+		g[0] = beta;
+
+		steps = 0;
+		for (j = 0; j < restart && it < maxit; j++) {
+			php_lapack_precond_apply(p, v + (size_t)j * n, z);
+			php_lapack_sparse_gemv_run(a, z, w);
+
+			/* Modified Gram-Schmidt against the basis so far */
+			for (i = 0; i <= j; i++) {
+				h[i + (size_t)j * (restart + 1)] = cblas_ddot(n, w, 1, v + (size_t)i * n, 1);
+				cblas_daxpy(n, -h[i + (size_t)j * (restart + 1)], v + (size_t)i * n, 1, w, 1);
+			}
+			hnext = cblas_dnrm2(n, w, 1);
+			h[j + 1 + (size_t)j * (restart + 1)] = hnext;
+			if (hnext != 0.0) {
+				memcpy(v + (size_t)(j + 1) * n, w, (size_t)n * sizeof(double));
+				cblas_dscal(n, 1.0 / hnext, v + (size_t)(j + 1) * n, 1);
+			}
+
+			/* Apply the earlier rotations to the new column, then zero its last entry */
+			for (i = 0; i < j; i++) {
+				t = cs[i] * h[i + (size_t)j * (restart + 1)] + sn[i] * h[i + 1 + (size_t)j * (restart + 1)];
+				h[i + 1 + (size_t)j * (restart + 1)] = -sn[i] * h[i + (size_t)j * (restart + 1)] + cs[i] * h[i + 1 + (size_t)j * (restart + 1)];
+				h[i + (size_t)j * (restart + 1)] = t;
+			}
+			t = hypot(h[j + (size_t)j * (restart + 1)], hnext);
+			if (t == 0.0) {
+				/* A . M^-1 is singular on the Krylov space */
+				*iterations = it;
+				return PHP_LAPACK_SPARSE_BREAKDOWN;
+			}
+			cs[j] = h[j + (size_t)j * (restart + 1)] / t;
+			sn[j] = hnext / t;
+			h[j + (size_t)j * (restart + 1)] = t;
+			h[j + 1 + (size_t)j * (restart + 1)] = 0.0;
+			g[j + 1] = -sn[j] * g[j];
+			g[j] = cs[j] * g[j];
+
+			it++;
+			steps = j + 1;
+			*iterations = it;
+			if (fabs(g[j + 1]) / bnorm <= tol || hnext == 0.0) {
+				break;
+			}
+		}
+
+		/* x += M^-1 . V . y with H . y = g */
+		for (i = steps - 1; i >= 0; i--) {
+			t = g[i];
+			for (j = i + 1; j < steps; j++) {
+				t -= h[i + (size_t)j * (restart + 1)] * y[j];
+			}
+			y[i] = t / h[i + (size_t)i * (restart + 1)];
+		}
+		memset(w, 0, (size_t)n * sizeof(double));
+		for (i = 0; i < steps; i++) {
+			cblas_daxpy(n, y[i], v + (size_t)i * n, 1, w, 1);
+		}
+		php_lapack_precond_apply(p, w, z);
+		cblas_daxpy(n, 1.0, z, 1, x, 1);
+	}
+}
+/* }}} */
+
+/* {{{ static int php_lapack_sparse_lsqr(php_lapack_sparse_object *a, const double *scale, const double *b, double *x, double tol, zend_long maxit, zend_long *iterations, double *residual)
+LSQR for min ||A . x - b|| from x = 0, after Paige and Saunders. When scale
+is given the columns of A are scaled by it, and x scaled back at the end.
+Stops when either the residual or the normal equations residual
+||A^T . r|| / (||A|| ||r||) is below tol, the second being the test that
+ends an inconsistent problem.
+*/
+static int php_lapack_sparse_lsqr(php_lapack_sparse_object *a, const double *scale, const double *b, double *x,
+	double tol, zend_long maxit, zend_long *iterations, double *residual)
+{
+	int m = a->m, n = a->n, j;
+	double *u, *v, *w, *t, *s, alpha, beta, bnorm, anorm, rho, rhobar, phi, phibar, c, sn, theta;
+	zend_long it;
+
+	memset(x, 0, (size_t)n * sizeof(double));
+	*iterations = 0;
+	*residual = 0.0;
+
+	u = php_lapack_arena_alloc(m, sizeof(double));
+	v = php_lapack_arena_alloc(n, sizeof(double));
+	w = php_lapack_arena_alloc(n, sizeof(double));
+	t = php_lapack_arena_alloc(m > n ? m : n, sizeof(double));
+	s = php_lapack_arena_alloc(n, sizeof(double));
+
+	memcpy(u, b, (size_t)m * sizeof(double));
+	beta = bnorm = cblas_dnrm2(m, u, 1);
+	if (beta == 0.0) {
+		return PHP_LAPACK_SPARSE_CONVERGED;
+	}
+	cblas_dscal(m, 1.0 / beta, u, 1);
+
+	/* v = D . A^T . u */
+	php_lapack_sparse_gemv_trans(a, u, v);
+	if (scale != NULL) {
+		for (j = 0; j < n; j++) {
+			v[j] *= scale[j];
+		}
+	}
+	alpha = cblas_dnrm2(n, v, 1);
+	*residual = 1.0;
+	if (alpha == 0.0) {
+		/* b is orthogonal to the range of A, so x = 0 is the answer */
+		return PHP_LAPACK_SPARSE_CONVERGED;
+	}
+	cblas_dscal(n, 1.0 / alpha, v, 1);
+
+	memcpy(w, v, (size_t)n * sizeof(double));
+	phibar = beta;
+	rhobar = alpha;
+	anorm = 0.0;
+
+	for (it = 1; it <= maxit; it++) {
+		/* u = A . D . v - alpha . u */
+		for (j = 0; j < n; j++) {
+			s[j] = scale != NULL ? v[j] * scale[j] : v[j];
+		}
+		php_lapack_sparse_gemv_run(a, s, t);
+		cblas_dscal(m, -alpha, u, 1);
+		cblas_daxpy(m, 1.0, t, 1, u, 1);
+		beta = cblas_dnrm2(m, u, 1);
+		anorm = sqrt(anorm * anorm + alpha * alpha + beta * beta);
+
+		if (beta != 0.0) {
+			cblas_dscal(m, 1.0 / beta, u, 1);
+			/* v = D . A^T . u - beta . v */
+			php_lapack_sparse_gemv_trans(a, u, t);
+			for (j = 0; j < n; j++) {
+				v[j] = (scale != NULL ? t[j] * scale[j] : t[j]) - beta * v[j];
+			}
+			alpha = cblas_dnrm2(n, v, 1);
+			if (alpha != 0.0) {
+				cblas_dscal(n, 1.0 / alpha, v, 1);
+			}
+		}
+
+		rho = hypot(rhobar, beta);
+		c = rhobar / rho;
+		sn = beta / rho;
+		theta = sn * alpha;
+		rhobar = -c * alpha;
+		phi = c * phibar;
+		phibar = sn * phibar;
+
+		cblas_daxpy(n, phi / rho, w, 1, x, 1);
+		/* w = v - (theta / rho) . w */
+		cblas_dscal(n, -theta / rho, w, 1);
+		cblas_daxpy(n, 1.0, v, 1, w, 1);
+
+		*iterations = it;
+		*residual = phibar / bnorm;
+		if (*residual <= tol || phibar * alpha * fabs(c) <= tol * anorm * phibar || alpha == 0.0 || beta == 0.0) {
+			break;
+		}
+	}
+
+	if (scale != NULL) {
+		for (j = 0; j < n; j++) {
+			x[j] *= scale[j];
+		}
+	}
+
+	return it <= maxit ? PHP_LAPACK_SPARSE_CONVERGED : PHP_LAPACK_SPARSE_ITERATIONS;
+}
+/* }}} */
+
+/* {{{ static void php_lapack_sparse_status_assign(zval *status, const php_lapack_sparse_status *st)
+Fill the by-reference status argument of the solvers.
+*/
+static void php_lapack_sparse_status_assign(zval *status, const php_lapack_sparse_status *st)
+{
+	zval out;
+
+	array_init_size(&out, 4);
+	add_assoc_string(&out, "method", st->method == PHP_LAPACK_SPARSE_CG ? "cg" : (st->method == PHP_LAPACK_SPARSE_GMRES ? "gmres" : "lsqr"));
+	add_assoc_long(&out, "iterations", st->iterations);
+	add_assoc_double(&out, "residual", st->residual);
+	add_assoc_bool(&out, "converged", st->info == PHP_LAPACK_SPARSE_CONVERGED);
+	ZEND_TRY_ASSIGN_REF_TMP(status, &out);
+}
+/* }}} */
+
+/* {{{ static int php_lapack_sparse_rhs(zval *b, int m, double **bl, int *nrhs, zend_bool *as_matrix)
+Linearize the right hand sides, which must have m rows.
+*/
+static int php_lapack_sparse_rhs(zval *b, int m, double **bl, int *nrhs, zend_bool *as_matrix)
+{
+	int mb;
+
+	if (php_lapack_operand_shape(b, &mb, nrhs, as_matrix) == FAILURE || mb != m) {
+		return FAILURE;
+	}
+
+	*bl = php_lapack_alloc((size_t)m * *nrhs);
+	if (php_lapack_linearize_operand_into(b, *bl, m, *nrhs, m) == FAILURE) {
+		php_lapack_free(*bl);
+		*bl = NULL;
+		return FAILURE;
+	}
+
+	return SUCCESS;
+}
+/* }}} */
+
+/* --- Object Handlers --- */
+
+static void php_lapack_sparse_object_free(zend_object *object)
+{
+	php_lapack_sparse_object *intern = php_lapack_sparse_from_obj(object);
+
+	if (intern->rowptr != NULL) {
+		efree(intern->rowptr);
+		efree(intern->cols);
+		php_lapack_free(intern->values);
+	}
+	zend_object_std_dtor(&intern->std);
+}
+
+static zend_object *php_lapack_sparse_object_new(zend_class_entry *class_type)
+{
+	php_lapack_sparse_object *intern;
+
+	intern = zend_object_alloc(sizeof(php_lapack_sparse_object), class_type);
+	intern->rowptr = NULL;
+	intern->cols = NULL;
+	intern->values = NULL;
+	intern->m = intern->n = 0;
+	intern->nnz = 0;
+
+	zend_object_std_init(&intern->std, class_type);
+	object_properties_init(&intern->std, class_type);
+	intern->std.handlers = &lapack_sparse_object_handlers;
+
+	return &intern->std;
+}
+
+/* --- LapackSparse Methods --- */
+
+/* {{{ LapackSparse LapackSparse::fromTriplets(int m, int n, array rows, array columns, array values);
+Build an m x n sparse matrix from coordinate triplets: element
+(rows[k], columns[k]) is values[k], counting from 0. Repeated coordinates
+are added together, as is usual for the COO format.
+*/
+PHP_METHOD(LapackSparse, fromTriplets)
+{
+	zend_long m, n, i, j;
+	zval *rows, *cols, *vals, *zi, *zj, *zv;
+	php_lapack_sparse_object *intern;
+	php_lapack_sparse_entry *row;
+	size_t count, k, q, len, *next, out;
+	HashPosition pj, pv;
+	int *ri;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS(), "llaaa", &m, &n, &rows, &cols, &vals) == FAILURE) {
+		return;
+	}
+
+	if (m < 1 || n < 1 || m > INT_MAX || n > INT_MAX) {
+		LAPACK_THROW("Invalid dimensions - must be between 1 and INT_MAX", 102);
+	}
+
+	count = zend_hash_num_elements(Z_ARRVAL_P(rows));
+	if (zend_hash_num_elements(Z_ARRVAL_P(cols)) != count || zend_hash_num_elements(Z_ARRVAL_P(vals)) != count) {
+		LAPACK_THROW("Invalid triplets - rows, columns and values must be the same length", 102);
+	}
+
+	object_init_ex(return_value, php_lapack_sparse_sc_entry);
+	intern = Z_LAPACK_SPARSE_P(return_value);
+	intern->m = (int)m;
+	intern->n = (int)n;
+	intern->rowptr = ecalloc((size_t)m + 1, sizeof(size_t));
+	intern->cols = safe_emalloc(count > 0 ? count : 1, sizeof(int), 0);
+	intern->values = php_lapack_alloc(count > 0 ? count : 1);
+
+	/* Count the entries of each row, checking the coordinates on the way */
+	ri = safe_emalloc(count > 0 ? count : 1, sizeof(int), 0);
+	k = 0;
+	zend_hash_internal_pointer_reset_ex(Z_ARRVAL_P(cols), &pj);
+	ZEND_HASH_FOREACH_VAL(Z_ARRVAL_P(rows), zi) {
+		zj = zend_hash_get_current_data_ex(Z_ARRVAL_P(cols), &pj);
+		zend_hash_move_forward_ex(Z_ARRVAL_P(cols), &pj);
+		i = zval_get_long(zi);
+		j = zval_get_long(zj);
+		if (i < 0 || i >= m || j < 0 || j >= n) {
+			efree(ri);
+			zval_ptr_dtor(return_value);
+			ZVAL_NULL(return_value);
+			LAPACK_THROW("Invalid triplets - coordinate out of range", 102);
+		}
+		ri[k++] = (int)i;
+		intern->rowptr[i + 1]++;
+	} ZEND_HASH_FOREACH_END();
+
+	for (k = 0; k < (size_t)m; k++) {
+		intern->rowptr[k + 1] += intern->rowptr[k];
+	}
+
+	/* Scatter into rows */
+	next = safe_emalloc((size_t)m, sizeof(size_t), 0);
+	memcpy(next, intern->rowptr, (size_t)m * sizeof(size_t));
+	k = 0;
+	zend_hash_internal_pointer_reset_ex(Z_ARRVAL_P(vals), &pv);
+	ZEND_HASH_FOREACH_VAL(Z_ARRVAL_P(cols), zj) {
+		zv = zend_hash_get_current_data_ex(Z_ARRVAL_P(vals), &pv);
+		zend_hash_move_forward_ex(Z_ARRVAL_P(vals), &pv);
+		q = next[ri[k++]]++;
+		intern->cols[q] = (int)zval_get_long(zj);
+		intern->values[q] = zval_get_double(zv);
+	} ZEND_HASH_FOREACH_END();
+	efree(ri);
+
+	/* Sort each row by column and add up repeats, compacting as we go */
+	row = NULL;
+	len = 0;
+	out = 0;
+	for (i = 0; i < m; i++) {
+		count = intern->rowptr[i + 1] - intern->rowptr[i];
+		if (count > len) {
+			row = safe_erealloc(row, count, sizeof(php_lapack_sparse_entry), 0);
+			len = count;
+		}
+		for (k = 0; k < count; k++) {
+			row[k].col = intern->cols[intern->rowptr[i] + k];
+			row[k].value = intern->values[intern->rowptr[i] + k];
+		}
+		if (count > 1) {
+			qsort(row, count, sizeof(php_lapack_sparse_entry), php_lapack_entry_compare);
+		}
+
+		intern->rowptr[i] = out;
+		for (k = 0; k < count; k++) {
+			if (k > 0 && row[k].col == intern->cols[out - 1]) {
+				intern->values[out - 1] += row[k].value;
+			} else {
+				intern->cols[out] = row[k].col;
+				intern->values[out] = row[k].value;
+				out++;
+			}
+		}
+	}
+	intern->rowptr[m] = out;
+	intern->nnz = out;
+
+	if (row != NULL) {
+		efree(row);
+	}
+	efree(next);
+
+	return;
+}
+/* }}} */
+
+/* {{{ int LapackSparse::rows();
+*/
+PHP_METHOD(LapackSparse, rows)
+{
+	php_lapack_sparse_object *intern;
+
+	if (zend_parse_parameters_none() == FAILURE) {
+		return;
+	}
+
+	if ((intern = php_lapack_sparse_fetch(getThis())) == NULL) {
+		return;
+	}
+
+	RETURN_LONG(intern->m);
+}
+/* }}} */
+
+/* {{{ int LapackSparse::columns();
+*/
+PHP_METHOD(LapackSparse, columns)
+{
+	php_lapack_sparse_object *intern;
+
+	if (zend_parse_parameters_none() == FAILURE) {
+		return;
+	}
+
+	if ((intern = php_lapack_sparse_fetch(getThis())) == NULL) {
+		return;
+	}
+
+	RETURN_LONG(intern->n);
+}
+/* }}} */
+
+/* {{{ int LapackSparse::nonZeros();
+The number of stored elements, after repeated coordinates were added up.
+*/
+PHP_METHOD(LapackSparse, nonZeros)
+{
+	php_lapack_sparse_object *intern;
+
+	if (zend_parse_parameters_none() == FAILURE) {
+		return;
+	}
+
+	if ((intern = php_lapack_sparse_fetch(getThis())) == NULL) {
+		return;
+	}
+
+	RETURN_LONG((zend_long)intern->nnz);
+}
+/* }}} */
+
+/* {{{ array LapackSparse::multiply(array|LapackMatrix X [, bool transpose]);
+Return A . X, or A^T . X when transpose is true, a column of X at a time.
+*/
+PHP_METHOD(LapackSparse, multiply)
+{
+	zval *x;
+	zend_bool transpose = 0, as_matrix = 0;
+	php_lapack_sparse_object *intern;
+	double *xl, *yl;
+	int rows, cols, nrhs, k;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS(), "z|b", &x, &transpose) == FAILURE) {
+		return;
+	}
+
+	if ((intern = php_lapack_sparse_fetch(getThis())) == NULL) {
+		return;
+	}
+
+	rows = transpose ? intern->m : intern->n;
+	cols = transpose ? intern->n : intern->m;
+	if (php_lapack_sparse_rhs(x, rows, &xl, &nrhs, &as_matrix) == FAILURE) {
+		LAPACK_THROW("Invalid input matrix - wrong number of rows", 102);
+	}
+
+	yl = php_lapack_alloc((size_t)cols * nrhs);
+	for (k = 0; k < nrhs; k++) {
+		if (transpose) {
+			php_lapack_sparse_gemv_trans(intern, xl + (size_t)k * rows, yl + (size_t)k * cols);
+		} else {
+			php_lapack_sparse_gemv_run(intern, xl + (size_t)k * rows, yl + (size_t)k * cols);
+		}
+	}
+
+	php_lapack_return_matrix(return_value, &yl, cols, nrhs, cols, as_matrix);
+	php_lapack_free(xl);
+	php_lapack_free(yl);
+
+	return;
+}
+/* }}} */
+
+/* {{{ array LapackSparse::toArray();
+The matrix as a dense array of arrays, zeros included.
+*/
+PHP_METHOD(LapackSparse, toArray)
+{
+	php_lapack_sparse_object *intern;
+	double *dense;
+	size_t i, k;
+
+	if (zend_parse_parameters_none() == FAILURE) {
+		return;
+	}
+
+	if ((intern = php_lapack_sparse_fetch(getThis())) == NULL) {
+		return;
+	}
+
+	dense = php_lapack_alloc((size_t)intern->m * intern->n);
+	memset(dense, 0, (size_t)intern->m * intern->n * sizeof(double));
+	for (i = 0; i < (size_t)intern->m; i++) {
+		for (k = intern->rowptr[i]; k < intern->rowptr[i + 1]; k++) {
+			dense[i + (size_t)intern->cols[k] * intern->m] = intern->values[k];
+		}
+	}
+
+	php_lapack_reassemble_array(return_value, dense, intern->m, intern->n, intern->m);
+	php_lapack_free(dense);
+
+	return;
+}
+/* }}} */
+
+/* --- Lapack Methods --- */
+
+/* {{{ array Lapack::solveSparse(LapackSparse A, array|LapackMatrix B [, int structure [, int preconditioner [, float tolerance [, int maxIterations [, array &status]]]]]);
+Solve A . X = B iteratively for a square sparse A. With
+Lapack::POSITIVE_DEFINITE conjugate gradients are used, with Lapack::GENERAL
+restarted GMRES, and with Lapack::AUTO (the default) conjugate gradients if A
+is symmetric with a positive diagonal, falling back to GMRES if they break
+down. preconditioner is one of the Lapack::PRECONDITION_ constants.
+Iteration stops when ||B - A . X|| / ||B|| is below tolerance (default
+1e-10) or after maxIterations (default, or 0: the size of A). If status is
+an array it is replaced with the method, iterations, residual and whether
+every column converged. Returns an empty array if the solver or the
+preconditioner broke down.
+*/
+PHP_METHOD(Lapack, solveSparse)
+{
+	zval *a, *b, *status = NULL;
+	zend_long structure = PHP_LAPACK_AUTO, preconditioner = PHP_LAPACK_PRECONDITION_NONE, maxit = 0;
+	double tol = 1e-10, *bl = NULL, *x, residual;
+	php_lapack_sparse_object *intern;
+	php_lapack_sparse_status st;
+	php_lapack_precond p;
+	zend_bool as_matrix = 0;
+	zend_long iterations;
+	int nrhs, k, info, method;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS(), "Oz|lldlz!", &a, php_lapack_sparse_sc_entry, &b,
+			&structure, &preconditioner, &tol, &maxit, &status) == FAILURE) {
+		return;
+	}
+
+	php_lapack_arena_begin();
+
+	if ((intern = php_lapack_sparse_fetch(a)) == NULL) {
+		return;
+	}
+	if (intern->m != intern->n) {
+		LAPACK_THROW("Matrix must be square", 103);
+	}
+	if (structure != PHP_LAPACK_AUTO && structure != PHP_LAPACK_GENERAL && structure != PHP_LAPACK_POSITIVE_DEFINITE) {
+		LAPACK_THROW("Invalid structure - must be Lapack::AUTO, Lapack::GENERAL or Lapack::POSITIVE_DEFINITE", 102);
+	}
+	if (preconditioner < PHP_LAPACK_PRECONDITION_NONE || preconditioner > PHP_LAPACK_PRECONDITION_ILU0) {
+		LAPACK_THROW("Invalid preconditioner - must be one of the Lapack::PRECONDITION_ constants", 102);
+	}
+	if (tol <= 0.0 || maxit < 0) {
+		LAPACK_THROW("Invalid tolerance or iteration limit", 102);
+	}
+	if (php_lapack_sparse_rhs(b, intern->m, &bl, &nrhs, &as_matrix) == FAILURE) {
+		LAPACK_THROW("Invalid input matrix - argument 2", 102);
+	}
+	if (maxit == 0) {
+		maxit = intern->n;
+	}
+
+	method = PHP_LAPACK_SPARSE_GMRES;
+	if (structure == PHP_LAPACK_POSITIVE_DEFINITE
+			|| (structure == PHP_LAPACK_AUTO && php_lapack_sparse_positive_definite(intern))) {
+		method = PHP_LAPACK_SPARSE_CG;
+	}
+
+	st.method = method;
+	st.iterations = 0;
+	st.residual = 0.0;
+	st.info = PHP_LAPACK_SPARSE_CONVERGED;
+
+	x = php_lapack_alloc((size_t)intern->n * nrhs);
+
+	if (php_lapack_precond_init(&p, intern, preconditioner) == FAILURE) {
+		st.info = PHP_LAPACK_SPARSE_BREAKDOWN;
+	}
+
+	for (k = 0; k < nrhs && st.info != PHP_LAPACK_SPARSE_BREAKDOWN; k++) {
+		if (method == PHP_LAPACK_SPARSE_CG) {
+			info = php_lapack_sparse_cg(intern, &p, bl + (size_t)k * intern->m, x + (size_t)k * intern->n,
+				tol, maxit, &iterations, &residual);
+			if (info == PHP_LAPACK_SPARSE_BREAKDOWN && structure == PHP_LAPACK_AUTO) {
+				/* Not positive definite after all, so carry on with GMRES */
+				method = st.method = PHP_LAPACK_SPARSE_GMRES;
+				st.iterations = 0;
+				st.residual = 0.0;
+				st.info = PHP_LAPACK_SPARSE_CONVERGED;
+				k = -1;
+				continue;
+			}
+		} else {
+			info = php_lapack_sparse_gmres(intern, &p, bl + (size_t)k * intern->m, x + (size_t)k * intern->n,
+				tol, maxit, &iterations, &residual);
+		}
+
+		if (iterations > st.iterations) {
+			st.iterations = iterations;
+		}
+		if (residual > st.residual) {
+			st.residual = residual;
+		}
+		if (info > st.info) {
+			st.info = info;
+		}
+	}
+	php_lapack_stats_info(st.info);
+
+	if (st.info == PHP_LAPACK_SPARSE_BREAKDOWN) {
+		array_init(return_value);
+	} else {
+		php_lapack_return_matrix(return_value, &x, intern->n, nrhs, intern->n, as_matrix);
+	}
+
+	if (php_lapack_output_wanted(status)) {
+		php_lapack_sparse_status_assign(status, &st);
+	}
+
+	php_lapack_free(bl);
+	php_lapack_free(x);
+
+	return;
+}
+/* }}} */
+
+/* {{{ array Lapack::leastSquaresSparse(LapackSparse A, array|LapackMatrix B [, int preconditioner [, float tolerance [, int maxIterations [, array &status]]]]);
+Solve min ||B - A . X|| for a sparse A of any shape with LSQR. The only
+preconditioner is Lapack::PRECONDITION_JACOBI, which here scales the columns
+of A to unit length. Iteration stops when the residual or the normal
+equations residual is below tolerance (default 1e-10), or after
+maxIterations (default, or 0: twice the number of columns of A). status is
+filled in as for solveSparse().
+*/
+PHP_METHOD(Lapack, leastSquaresSparse)
+{
+	zval *a, *b, *status = NULL;
+	zend_long preconditioner = PHP_LAPACK_PRECONDITION_NONE, maxit = 0;
+	double tol = 1e-10, *bl = NULL, *x, *scale = NULL, residual, norm;
+	php_lapack_sparse_object *intern;
+	php_lapack_sparse_status st;
+	zend_bool as_matrix = 0;
+	zend_long iterations;
+	size_t i, q;
+	int nrhs, k, info;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS(), "Oz|ldlz!", &a, php_lapack_sparse_sc_entry, &b,
+			&preconditioner, &tol, &maxit, &status) == FAILURE) {
+		return;
+	}
+
+	php_lapack_arena_begin();
+
+	if ((intern = php_lapack_sparse_fetch(a)) == NULL) {
+		return;
+	}
+	if (preconditioner != PHP_LAPACK_PRECONDITION_NONE && preconditioner != PHP_LAPACK_PRECONDITION_JACOBI) {
+		LAPACK_THROW("Invalid preconditioner - must be Lapack::PRECONDITION_NONE or Lapack::PRECONDITION_JACOBI", 102);
+	}
+	if (tol <= 0.0 || maxit < 0) {
+		LAPACK_THROW("Invalid tolerance or iteration limit", 102);
+	}
+	if (php_lapack_sparse_rhs(b, intern->m, &bl, &nrhs, &as_matrix) == FAILURE) {
+		LAPACK_THROW("Invalid input matrix - argument 2", 102);
+	}
+	if (maxit == 0) {
+		maxit = 2 * (zend_long)intern->n;
+	}
+
+	if (preconditioner == PHP_LAPACK_PRECONDITION_JACOBI) {
+		/* The diagonal of A^T . A holds the squared column norms */
+		scale = php_lapack_arena_alloc(intern->n, sizeof(double));
+		memset(scale, 0, (size_t)intern->n * sizeof(double));
+		for (i = 0; i < (size_t)intern->m; i++) {
+			for (q = intern->rowptr[i]; q < intern->rowptr[i + 1]; q++) {
+				scale[intern->cols[q]] += intern->values[q] * intern->values[q];
+			}
+		}
+		for (k = 0; k < intern->n; k++) {
+			norm = sqrt(scale[k]);
+			scale[k] = norm > 0.0 ? 1.0 / norm : 1.0;
+		}
+	}
+
+	st.method = PHP_LAPACK_SPARSE_LSQR;
+	st.iterations = 0;
+	st.residual = 0.0;
+	st.info = PHP_LAPACK_SPARSE_CONVERGED;
+
+	x = php_lapack_alloc((size_t)intern->n * nrhs);
+	for (k = 0; k < nrhs; k++) {
+		info = php_lapack_sparse_lsqr(intern, scale, bl + (size_t)k * intern->m, x + (size_t)k * intern->n,
+			tol, maxit, &iterations, &residual);
+		if (iterations > st.iterations) {
+			st.iterations = iterations;
+		}
+		if (residual > st.residual) {
+			st.residual = residual;
+		}
+		if (info > st.info) {
+			st.info = info;
+		}
+	}
+	php_lapack_stats_info(st.info);
+
+	php_lapack_return_matrix(return_value, &x, intern->n, nrhs, intern->n, as_matrix);
+
+	if (php_lapack_output_wanted(status)) {
+		php_lapack_sparse_status_assign(status, &st);
+	}
+
+	php_lapack_free(bl);
+	php_lapack_free(x);
+
+	return;
+}
+/* }}} */
+
+/* --- ARGUMENTS AND INIT --- */
+
+ZEND_BEGIN_ARG_INFO_EX(lapack_sparse_empty_args, 0, 0, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(lapack_sparse_triplets_args, 0, 0, 5)
+	ZEND_ARG_INFO(0, m)
+	ZEND_ARG_INFO(0, n)
+	ZEND_ARG_INFO(0, rows)
+	ZEND_ARG_INFO(0, columns)
+	ZEND_ARG_INFO(0, values)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(lapack_sparse_multiply_args, 0, 0, 1)
+	ZEND_ARG_INFO(0, X)
+	ZEND_ARG_INFO(0, transpose)
+ZEND_END_ARG_INFO()
+
+static const zend_function_entry php_lapack_sparse_class_methods[] =
+{
+	PHP_ME(LapackSparse, fromTriplets,	lapack_sparse_triplets_args, ZEND_ACC_PUBLIC | ZEND_ACC_STATIC)
+	PHP_ME(LapackSparse, rows,			lapack_sparse_empty_args, ZEND_ACC_PUBLIC)
+	PHP_ME(LapackSparse, columns,		lapack_sparse_empty_args, ZEND_ACC_PUBLIC)
+	PHP_ME(LapackSparse, nonZeros,		lapack_sparse_empty_args, ZEND_ACC_PUBLIC)
+	PHP_ME(LapackSparse, multiply,		lapack_sparse_multiply_args, ZEND_ACC_PUBLIC)
+	PHP_ME(LapackSparse, toArray,		lapack_sparse_empty_args, ZEND_ACC_PUBLIC)
+	PHP_FE_END
+};
+
+PHP_MINIT_FUNCTION(lapack_sparse)
+{
+	zend_class_entry ce;
+	memcpy(&lapack_sparse_object_handlers, zend_get_std_object_handlers(), sizeof(zend_object_handlers));
+	lapack_sparse_object_handlers.offset = XtOffsetOf(php_lapack_sparse_object, std);
+	lapack_sparse_object_handlers.free_obj = php_lapack_sparse_object_free;
+	lapack_sparse_object_handlers.clone_obj = NULL;
+
+	INIT_CLASS_ENTRY(ce, "LapackSparse", php_lapack_sparse_class_methods);
+	ce.create_object = php_lapack_sparse_object_new;
+	php_lapack_sparse_sc_entry = zend_register_internal_class(&ce);
+	php_lapack_sparse_sc_entry->ce_flags |= ZEND_ACC_FINAL;
+
+	return SUCCESS;
+}
@@ -0,0 +1,515 @@
+/*
+  +----------------------------------------------------------------------+
+  | PHP Version 5 / lapack                                               |
+  +----------------------------------------------------------------------+
+  | Copyright (c) 2012 Ian Barber                                        |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 3.0 of the PHP license,       |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.php.net/license/3_0.txt.                                  |
+  | If you did not receive a copy of the PHP license and are unable to   |
+  | obtain it through the world-wide-web, please send a note to          |
+  | license@php.net so we can mail you a copy immediately.               |
+  +----------------------------------------------------------------------+
+  | Authors: Ian Barber <ian.barber@gmail.com>                           |
+  +----------------------------------------------------------------------+
+*/
+
+#include "php_lapack.h"
+#include "php_lapack_internal.h"
+#include "Zend/zend_exceptions.h"
+#include "ext/standard/info.h"
+
+#include <inttypes.h>
+#include <time.h>
+#ifdef ZTS
+# include <pthread.h>
+#endif
+
+/*
+ * Call statistics. At MINIT the handler of every method of the extension's
+ * classes is replaced with php_lapack_stats_handler(), which times the call
+ * and then files it under the method. Inside a call, the array conversion
+ * helpers add their own time and byte counts through
+ * php_lapack_stats_phase(), and the drivers report every nonzero LAPACK info
+ * (including the ones they recover from, such as a positive definite
+ * factorisation falling back to the indefinite one) with
+ * php_lapack_stats_info(). Compute time is what is left of the call. Mixed
+ * precision solves also report their refinement steps, and whether they had
+ * to fall back to double precision, with php_lapack_stats_refinement().
+ *
+ * Counters are kept for the current request in the module globals, and are
+ * added to the process totals at the end of each request. When the
+ * lapack.trace_threshold INI setting is above zero, every call that takes at
+ * least that many milliseconds is written to the error log.
+ */
+
+/* Classes whose methods are counted */
+static const char *php_lapack_stats_classes[] = {
+	"lapack", "lapackmatrix", "lapackfactorization", "lapacklu", "lapackqr",
+	"lapackcholesky", "lapackshapemodel", "lapackleastsquares", "lapackfuture", "lapacksparse", NULL
+};
+
+#define PHP_LAPACK_STATS_SCOPES (sizeof(php_lapack_stats_classes) / sizeof(php_lapack_stats_classes[0]) - 1)
+
+/* A counted method: the handler it was registered with, its display name
+   and its slot in the counter arrays */
+typedef struct _php_lapack_stats_method {
+	zif_handler handler;
+	zend_string *name;
+	int index;
+} php_lapack_stats_method;
+
+/* The methods defined by one class, keyed by method name */
+typedef struct _php_lapack_stats_scope {
+	zend_class_entry *ce;
+	HashTable methods;
+} php_lapack_stats_scope;
+
+typedef struct _php_lapack_stats_entry {
+	zend_long calls;
+	zend_long info;				/* nonzero LAPACK info codes */
+	zend_long refine_iter;		/* mixed precision refinement steps */
+	zend_long refine_fallback;	/* mixed precision solves redone in double */
+	uint64_t convert_ns;
+	uint64_t compute_ns;
+	uint64_t assemble_ns;
+	uint64_t bytes;				/* marshalled in both directions */
+	size_t workspace;			/* largest arena use of a single call */
+} php_lapack_stats_entry;
+
+static php_lapack_stats_scope php_lapack_stats_scopes[PHP_LAPACK_STATS_SCOPES];
+static php_lapack_stats_method **php_lapack_stats_index;
+static int php_lapack_stats_count;
+static php_lapack_stats_entry *php_lapack_stats_process;
+
+#ifdef ZTS
+static pthread_mutex_t php_lapack_stats_lock = PTHREAD_MUTEX_INITIALIZER;
+# define PHP_LAPACK_STATS_LOCK()	pthread_mutex_lock(&php_lapack_stats_lock)
+# define PHP_LAPACK_STATS_UNLOCK()	pthread_mutex_unlock(&php_lapack_stats_lock)
+#else
+# define PHP_LAPACK_STATS_LOCK()
+# define PHP_LAPACK_STATS_UNLOCK()
+#endif
+
+/* --- Helper Functions --- */
+
+/* {{{ uint64_t php_lapack_stats_clock(void)
+Monotonic time in nanoseconds.
+*/
+uint64_t php_lapack_stats_clock(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+/* }}} */
+
+/* {{{ void php_lapack_stats_phase(int phase, uint64_t start, size_t bytes)
+Add the time since start, and bytes converted, to the current call.
+*/
+void php_lapack_stats_phase(int phase, uint64_t start, size_t bytes)
+{
+	uint64_t elapsed = php_lapack_stats_clock() - start;
+
+	if (phase == PHP_LAPACK_STATS_CONVERT) {
+		LAPACK_G(stats_convert_ns) += elapsed;
+	} else {
+		LAPACK_G(stats_assemble_ns) += elapsed;
+	}
+	LAPACK_G(stats_bytes) += bytes;
+}
+/* }}} */
+
+/* {{{ void php_lapack_stats_info(lapack_int info)
+Count a nonzero info returned by a LAPACK driver in the current call.
+*/
+void php_lapack_stats_info(lapack_int info)
+{
+	if (info != 0) {
+		LAPACK_G(stats_info)++;
+	}
+}
+/* }}} */
+
+/* {{{ void php_lapack_stats_refinement(lapack_int iter)
+Count the outcome of a dsgesv or dsposv call in the current call: iter
+refinement steps, or a fallback to double precision when negative.
+*/
+void php_lapack_stats_refinement(lapack_int iter)
+{
+	if (iter < 0) {
+		LAPACK_G(stats_refine_fallback)++;
+	} else {
+		LAPACK_G(stats_refine_iter) += iter;
+	}
+}
+/* }}} */
+
+/* {{{ static php_lapack_stats_method* php_lapack_stats_find(zend_function *func)
+The counted method behind func, which may be an inherited copy.
+*/
+static php_lapack_stats_method* php_lapack_stats_find(zend_function *func)
+{
+	size_t i;
+
+	for (i = 0; i < PHP_LAPACK_STATS_SCOPES; i++) {
+		if (php_lapack_stats_scopes[i].ce == func->common.scope) {
+			return zend_hash_find_ptr(&php_lapack_stats_scopes[i].methods, func->common.function_name);
+		}
+	}
+
+	return NULL;
+}
+/* }}} */
+
+/* {{{ static void php_lapack_stats_trace(php_lapack_stats_method *method, uint64_t total, uint64_t compute)
+Write one line about a slow call to the error log.
+*/
+static void php_lapack_stats_trace(php_lapack_stats_method *method, uint64_t total, uint64_t compute)
+{
+	char *line;
+
+	spprintf(&line, 0, "lapack: %s took %.3f ms (convert %.3f ms, compute %.3f ms, assemble %.3f ms), "
+		"%" PRIu64 " bytes marshalled, %zu bytes workspace, " ZEND_LONG_FMT " nonzero info",
+		ZSTR_VAL(method->name), total / 1e6, LAPACK_G(stats_convert_ns) / 1e6, compute / 1e6,
+		LAPACK_G(stats_assemble_ns) / 1e6, LAPACK_G(stats_bytes), LAPACK_G(stats_workspace),
+		LAPACK_G(stats_info));
+	php_log_err(line);
+	efree(line);
+}
+/* }}} */
+
+/* {{{ static void php_lapack_stats_handler(INTERNAL_FUNCTION_PARAMETERS)
+Stand-in handler for every counted method: run the real one and file the
+call under the method.
+*/
+static void php_lapack_stats_handler(INTERNAL_FUNCTION_PARAMETERS)
+{
+	php_lapack_stats_method *method = php_lapack_stats_find(EX(func));
+	php_lapack_stats_entry *entry;
+	uint64_t start, total, phases;
+
+	if (method == NULL) {
+		zend_throw_error(NULL, "Unknown Lapack method");
+		return;
+	}
+
+	/* Only the outermost call is counted */
+	if (LAPACK_G(stats_depth)++ > 0) {
+		method->handler(INTERNAL_FUNCTION_PARAM_PASSTHRU);
+		LAPACK_G(stats_depth)--;
+		return;
+	}
+
+	LAPACK_G(stats_convert_ns) = 0;
+	LAPACK_G(stats_assemble_ns) = 0;
+	LAPACK_G(stats_bytes) = 0;
+	LAPACK_G(stats_info) = 0;
+	LAPACK_G(stats_refine_iter) = 0;
+	LAPACK_G(stats_refine_fallback) = 0;
+	LAPACK_G(stats_workspace) = 0;
+
+	start = php_lapack_stats_clock();
+	method->handler(INTERNAL_FUNCTION_PARAM_PASSTHRU);
+	total = php_lapack_stats_clock() - start;
+
+	LAPACK_G(stats_depth)--;
+
+	if (LAPACK_G(stats) == NULL) {
+		LAPACK_G(stats) = ecalloc(php_lapack_stats_count, sizeof(php_lapack_stats_entry));
+	}
+	entry = (php_lapack_stats_entry *)LAPACK_G(stats) + method->index;
+
+	phases = LAPACK_G(stats_convert_ns) + LAPACK_G(stats_assemble_ns);
+	entry->calls++;
+	entry->info += LAPACK_G(stats_info);
+	entry->refine_iter += LAPACK_G(stats_refine_iter);
+	entry->refine_fallback += LAPACK_G(stats_refine_fallback);
+	entry->convert_ns += LAPACK_G(stats_convert_ns);
+	entry->assemble_ns += LAPACK_G(stats_assemble_ns);
+	entry->compute_ns += total > phases ? total - phases : 0;
+	entry->bytes += LAPACK_G(stats_bytes);
+	if (LAPACK_G(stats_workspace) > entry->workspace) {
+		entry->workspace = LAPACK_G(stats_workspace);
+	}
+
+	if (LAPACK_G(trace_threshold) > 0 && total >= (uint64_t)LAPACK_G(trace_threshold) * 1000000) {
+		php_lapack_stats_trace(method, total, total > phases ? total - phases : 0);
+	}
+}
+/* }}} */
+
+/* {{{ static void php_lapack_stats_wrap(zend_class_entry *ce)
+Route every method of ce through php_lapack_stats_handler.
+*/
+static void php_lapack_stats_wrap(zend_class_entry *ce)
+{
+	php_lapack_stats_method *method;
+	zend_function *func;
+	HashTable *methods = NULL;
+	size_t i;
+	char *name;
+
+	ZEND_HASH_FOREACH_PTR(&ce->function_table, func) {
+		if (func->type != ZEND_INTERNAL_FUNCTION || func->internal_function.handler == php_lapack_stats_handler
+				|| zend_string_equals_literal_ci(func->common.function_name, "stats")
+				|| zend_string_equals_literal_ci(func->common.function_name, "resetStats")) {
+			continue;
+		}
+
+		/* Methods are filed under the class that defines them */
+		for (i = 0; i < PHP_LAPACK_STATS_SCOPES && php_lapack_stats_scopes[i].ce != NULL; i++) {
+			if (php_lapack_stats_scopes[i].ce == func->common.scope) {
+				break;
+			}
+		}
+		if (i == PHP_LAPACK_STATS_SCOPES) {
+			continue;
+		}
+		if (php_lapack_stats_scopes[i].ce == NULL) {
+			php_lapack_stats_scopes[i].ce = func->common.scope;
+			zend_hash_init(&php_lapack_stats_scopes[i].methods, 8, NULL, NULL, 1);
+		}
+		methods = &php_lapack_stats_scopes[i].methods;
+
+		method = zend_hash_find_ptr(methods, func->common.function_name);
+		if (method == NULL) {
+			method = pemalloc(sizeof(php_lapack_stats_method), 1);
+			method->handler = func->internal_function.handler;
+			spprintf(&name, 0, "%s::%s", ZSTR_VAL(func->common.scope->name), ZSTR_VAL(func->common.function_name));
+			method->name = zend_string_init_interned(name, strlen(name), 1);
+			efree(name);
+			method->index = php_lapack_stats_count++;
+			php_lapack_stats_index = perealloc(php_lapack_stats_index, php_lapack_stats_count * sizeof(php_lapack_stats_method *), 1);
+			php_lapack_stats_index[method->index] = method;
+			zend_hash_add_ptr(methods, func->common.function_name, method);
+		}
+
+		func->internal_function.handler = php_lapack_stats_handler;
+	} ZEND_HASH_FOREACH_END();
+}
+/* }}} */
+
+/* {{{ void php_lapack_stats_startup(void)
+Wrap the methods of every class of the extension, once they are all
+registered.
+*/
+void php_lapack_stats_startup(void)
+{
+	zend_class_entry *ce;
+	int i;
+
+	for (i = 0; php_lapack_stats_classes[i] != NULL; i++) {
+		ce = zend_hash_str_find_ptr(CG(class_table), php_lapack_stats_classes[i], strlen(php_lapack_stats_classes[i]));
+		if (ce != NULL) {
+			php_lapack_stats_wrap(ce);
+		}
+	}
+
+	php_lapack_stats_process = pecalloc(php_lapack_stats_count > 0 ? php_lapack_stats_count : 1, sizeof(php_lapack_stats_entry), 1);
+}
+/* }}} */
+
+/* {{{ void php_lapack_stats_shutdown(void)
+*/
+void php_lapack_stats_shutdown(void)
+{
+	size_t i;
+	int j;
+
+	for (i = 0; i < PHP_LAPACK_STATS_SCOPES; i++) {
+		if (php_lapack_stats_scopes[i].ce != NULL) {
+			zend_hash_destroy(&php_lapack_stats_scopes[i].methods);
+			php_lapack_stats_scopes[i].ce = NULL;
+		}
+	}
+	for (j = 0; j < php_lapack_stats_count; j++) {
+		pefree(php_lapack_stats_index[j], 1);
+	}
+	if (php_lapack_stats_index != NULL) {
+		pefree(php_lapack_stats_index, 1);
+	}
+	pefree(php_lapack_stats_process, 1);
+	php_lapack_stats_index = NULL;
+	php_lapack_stats_process = NULL;
+	php_lapack_stats_count = 0;
+}
+/* }}} */
+
+/* {{{ static void php_lapack_stats_add(php_lapack_stats_entry *to, const php_lapack_stats_entry *from)
+*/
+static void php_lapack_stats_add(php_lapack_stats_entry *to, const php_lapack_stats_entry *from)
+{
+	to->calls += from->calls;
+	to->info += from->info;
+	to->refine_iter += from->refine_iter;
+	to->refine_fallback += from->refine_fallback;
+	to->convert_ns += from->convert_ns;
+	to->compute_ns += from->compute_ns;
+	to->assemble_ns += from->assemble_ns;
+	to->bytes += from->bytes;
+	if (from->workspace > to->workspace) {
+		to->workspace = from->workspace;
+	}
+}
+/* }}} */
+
+/* {{{ void php_lapack_stats_request_end(void)
+Add the counters of the request that is ending to the process totals.
+*/
+void php_lapack_stats_request_end(void)
+{
+	php_lapack_stats_entry *stats = LAPACK_G(stats);
+	int i;
+
+	if (stats == NULL) {
+		return;
+	}
+
+	PHP_LAPACK_STATS_LOCK();
+	for (i = 0; i < php_lapack_stats_count; i++) {
+		php_lapack_stats_add(&php_lapack_stats_process[i], &stats[i]);
+	}
+	PHP_LAPACK_STATS_UNLOCK();
+
+	efree(stats);
+	LAPACK_G(stats) = NULL;
+}
+/* }}} */
+
+/* {{{ static void php_lapack_stats_array(zval *out, const php_lapack_stats_entry *stats, const php_lapack_stats_entry *extra)
+Fill out with the counters of every method that has been called, adding
+extra (which may be NULL) to stats.
+*/
+static void php_lapack_stats_array(zval *out, const php_lapack_stats_entry *stats, const php_lapack_stats_entry *extra)
+{
+	php_lapack_stats_entry e;
+	zval row;
+	int i;
+
+	array_init(out);
+
+	for (i = 0; i < php_lapack_stats_count; i++) {
+		memset(&e, 0, sizeof(e));
+		if (stats != NULL) {
+			php_lapack_stats_add(&e, &stats[i]);
+		}
+		if (extra != NULL) {
+			php_lapack_stats_add(&e, &extra[i]);
+		}
+		if (e.calls == 0) {
+			continue;
+		}
+
+		array_init_size(&row, 9);
+		add_assoc_long(&row, "calls", e.calls);
+		add_assoc_long(&row, "convert_ns", (zend_long)e.convert_ns);
+		add_assoc_long(&row, "compute_ns", (zend_long)e.compute_ns);
+		add_assoc_long(&row, "assemble_ns", (zend_long)e.assemble_ns);
+		add_assoc_long(&row, "bytes", (zend_long)e.bytes);
+		add_assoc_long(&row, "workspace_peak", (zend_long)e.workspace);
+		add_assoc_long(&row, "info_nonzero", e.info);
+		add_assoc_long(&row, "refinement_iterations", e.refine_iter);
+		add_assoc_long(&row, "refinement_fallbacks", e.refine_fallback);
+		zend_hash_update(Z_ARRVAL_P(out), php_lapack_stats_index[i]->name, &row);
+	}
+}
+/* }}} */
+
+/* {{{ void php_lapack_stats_info_table(void)
+The process totals, for phpinfo().
+*/
+void php_lapack_stats_info_table(void)
+{
+	php_lapack_stats_entry *stats = LAPACK_G(stats), e;
+	char calls[32], times[96];
+	int i, shown = 0;
+
+	php_info_print_table_start();
+	php_info_print_table_header(3, "Method", "Calls (nonzero info)", "Convert / compute / assemble ms");
+
+	for (i = 0; i < php_lapack_stats_count; i++) {
+		memset(&e, 0, sizeof(e));
+		PHP_LAPACK_STATS_LOCK();
+		php_lapack_stats_add(&e, &php_lapack_stats_process[i]);
+		PHP_LAPACK_STATS_UNLOCK();
+		if (stats != NULL) {
+			php_lapack_stats_add(&e, &stats[i]);
+		}
+		if (e.calls == 0) {
+			continue;
+		}
+		snprintf(calls, sizeof(calls), ZEND_LONG_FMT " (" ZEND_LONG_FMT ")", e.calls, e.info);
+		snprintf(times, sizeof(times), "%.3f / %.3f / %.3f", e.convert_ns / 1e6, e.compute_ns / 1e6, e.assemble_ns / 1e6);
+		php_info_print_table_row(3, ZSTR_VAL(php_lapack_stats_index[i]->name), calls, times);
+		shown++;
+	}
+
+	if (shown == 0) {
+		php_info_print_table_row(3, "No calls yet", "", "");
+	}
+	php_info_print_table_end();
+}
+/* }}} */
+
+/* --- Lapack Methods --- */
+
+/* {{{ array Lapack::stats();
+Return the call counters, as array('request' => ..., 'process' => ...). Each
+is keyed by method, with the number of calls, nanoseconds spent converting
+operands, computing and assembling results, bytes converted, the largest
+workspace a single call used, the number of nonzero LAPACK info codes, and
+the refinement steps and double precision fallbacks of mixed precision
+solves. The process totals include the current request.
+*/
+PHP_METHOD(Lapack, stats)
+{
+	php_lapack_stats_entry *process;
+	zval request, total;
+
+	if (zend_parse_parameters_none() == FAILURE) {
+		return;
+	}
+
+	process = ecalloc(php_lapack_stats_count > 0 ? php_lapack_stats_count : 1, sizeof(php_lapack_stats_entry));
+	PHP_LAPACK_STATS_LOCK();
+	memcpy(process, php_lapack_stats_process, php_lapack_stats_count * sizeof(php_lapack_stats_entry));
+	PHP_LAPACK_STATS_UNLOCK();
+
+	php_lapack_stats_array(&request, LAPACK_G(stats), NULL);
+	php_lapack_stats_array(&total, process, LAPACK_G(stats));
+	efree(process);
+
+	array_init_size(return_value, 2);
+	add_assoc_zval(return_value, "request", &request);
+	add_assoc_zval(return_value, "process", &total);
+
+	return;
+}
+/* }}} */
+
+/* {{{ void Lapack::resetStats();
+Clear the counters of this request and the totals of this process.
+*/
+PHP_METHOD(Lapack, resetStats)
+{
+	if (zend_parse_parameters_none() == FAILURE) {
+		return;
+	}
+
+	if (LAPACK_G(stats) != NULL) {
+		efree(LAPACK_G(stats));
+		LAPACK_G(stats) = NULL;
+	}
+
+	PHP_LAPACK_STATS_LOCK();
+	memset(php_lapack_stats_process, 0, php_lapack_stats_count * sizeof(php_lapack_stats_entry));
+	PHP_LAPACK_STATS_UNLOCK();
+
+	return;
+}
+/* }}} */
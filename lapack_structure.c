@@ -0,0 +1,247 @@
+/*
+  +----------------------------------------------------------------------+
+  | PHP Version 5 / lapack                                               |
+  +----------------------------------------------------------------------+
+  | Copyright (c) 2012 Ian Barber                                        |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 3.0 of the PHP license,       |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.php.net/license/3_0.txt.                                  |
+  | If you did not receive a copy of the PHP license and are unable to   |
+  | obtain it through the world-wide-web, please send a note to          |
+  | license@php.net so we can mail you a copy immediately.               |
+  +----------------------------------------------------------------------+
+  | Authors: Ian Barber <ian.barber@gmail.com>                           |
+  +----------------------------------------------------------------------+
+*/
+
+#include "php_lapack.h"
+#include "php_lapack_internal.h"
+
+/* --- Helper Functions --- */
+
+/* {{{ static void php_lapack_structure_scan(const double *a, int n, int lda, php_lapack_structure_info *info)
+One pass over a square matrix to find its lower and upper bandwidth, whether
+it is exactly symmetric, and whether its diagonal is positive.
+*/
+static void php_lapack_structure_scan(const double *a, int n, int lda, php_lapack_structure_info *info)
+{
+	int i, j;
+	double v;
+
+	info->kl = 0;
+	info->ku = 0;
+	info->symmetric = 1;
+	info->positive_diagonal = 1;
+
+	for (j = 0; j < n; j++) {
+		for (i = 0; i < n; i++) {
+			v = a[i + (size_t)j * lda];
+			if (i > j) {
+				if (v != 0.0 && i - j > info->kl) {
+					info->kl = i - j;
+				}
+				if (info->symmetric && v != a[j + (size_t)i * lda]) {
+					info->symmetric = 0;
+				}
+			} else if (i < j) {
+				if (v != 0.0 && j - i > info->ku) {
+					info->ku = j - i;
+				}
+			} else if (v <= 0.0) {
+				info->positive_diagonal = 0;
+			}
+		}
+	}
+}
+/* }}} */
+
+/* {{{ static void php_lapack_structure_scan_single(const float *a, int n, int lda, php_lapack_structure_info *info)
+The same scan over a single precision matrix.
+*/
+static void php_lapack_structure_scan_single(const float *a, int n, int lda, php_lapack_structure_info *info)
+{
+	int i, j;
+	float v;
+
+	info->kl = 0;
+	info->ku = 0;
+	info->symmetric = 1;
+	info->positive_diagonal = 1;
+
+	for (j = 0; j < n; j++) {
+		for (i = 0; i < n; i++) {
+			v = a[i + (size_t)j * lda];
+			if (i > j) {
+				if (v != 0.0f && i - j > info->kl) {
+					info->kl = i - j;
+				}
+				if (info->symmetric && v != a[j + (size_t)i * lda]) {
+					info->symmetric = 0;
+				}
+			} else if (i < j) {
+				if (v != 0.0f && j - i > info->ku) {
+					info->ku = j - i;
+				}
+			} else if (v <= 0.0f) {
+				info->positive_diagonal = 0;
+			}
+		}
+	}
+}
+/* }}} */
+
+/* {{{ static int php_lapack_structure_hint(zend_long hint, int n, php_lapack_structure_info *info)
+Fill in info for an explicit hint that needs no scan. Returns the hint, or
+PHP_LAPACK_AUTO when the matrix has to be scanned.
+*/
+static int php_lapack_structure_hint(zend_long hint, int n, php_lapack_structure_info *info)
+{
+	info->kl = n - 1;
+	info->ku = n - 1;
+	info->symmetric = 0;
+	info->positive_diagonal = 0;
+
+	switch (hint) {
+		case PHP_LAPACK_GENERAL:
+		case PHP_LAPACK_SYMMETRIC:
+		case PHP_LAPACK_POSITIVE_DEFINITE:
+		case PHP_LAPACK_UPPER_TRIANGULAR:
+		case PHP_LAPACK_LOWER_TRIANGULAR:
+			info->symmetric = (hint == PHP_LAPACK_SYMMETRIC || hint == PHP_LAPACK_POSITIVE_DEFINITE);
+			return (int)hint;
+	}
+
+	return PHP_LAPACK_AUTO;
+}
+/* }}} */
+
+/* {{{ static int php_lapack_structure_classify(zend_long hint, int n, const php_lapack_structure_info *info)
+Pick the structure from the result of a scan.
+*/
+static int php_lapack_structure_classify(zend_long hint, int n, const php_lapack_structure_info *info)
+{
+	if (hint == PHP_LAPACK_BANDED) {
+		return PHP_LAPACK_BANDED;
+	} else if (info->ku == 0) {
+		return PHP_LAPACK_LOWER_TRIANGULAR;
+	} else if (info->kl == 0) {
+		return PHP_LAPACK_UPPER_TRIANGULAR;
+	} else if ((size_t)(2 * info->kl + info->ku + 1) * 4 <= (size_t)n) {
+		return PHP_LAPACK_BANDED;
+	} else if (info->symmetric) {
+		return info->positive_diagonal ? PHP_LAPACK_POSITIVE_DEFINITE : PHP_LAPACK_SYMMETRIC;
+	}
+
+	return PHP_LAPACK_GENERAL;
+}
+/* }}} */
+
+/* {{{ int php_lapack_structure(zend_long hint, const double *a, int n, int lda, php_lapack_structure_info *info)
+Resolve the structure to use for the square matrix a. An explicit hint is
+trusted, apart from BANDED which still needs the bandwidth from a scan.
+AUTO scans the matrix and picks, in order: triangular, banded (when the band
+is narrow enough to beat a dense factorisation), symmetric positive definite
+(a candidate only - the caller must fall back if the Cholesky factorisation
+fails), symmetric, and general.
+*/
+int php_lapack_structure(zend_long hint, const double *a, int n, int lda, php_lapack_structure_info *info)
+{
+	int kind = php_lapack_structure_hint(hint, n, info);
+
+	if (kind != PHP_LAPACK_AUTO) {
+		return kind;
+	}
+
+	php_lapack_structure_scan(a, n, lda, info);
+
+	return php_lapack_structure_classify(hint, n, info);
+}
+/* }}} */
+
+/* {{{ int php_lapack_structure_single(zend_long hint, const float *a, int n, int lda, php_lapack_structure_info *info)
+php_lapack_structure for a single precision matrix.
+*/
+int php_lapack_structure_single(zend_long hint, const float *a, int n, int lda, php_lapack_structure_info *info)
+{
+	int kind = php_lapack_structure_hint(hint, n, info);
+
+	if (kind != PHP_LAPACK_AUTO) {
+		return kind;
+	}
+
+	php_lapack_structure_scan_single(a, n, lda, info);
+
+	return php_lapack_structure_classify(hint, n, info);
+}
+/* }}} */
+
+/* {{{ double* php_lapack_band_pack(const double *a, int n, int lda, int kl, int ku, int ldab)
+Copy the band of a into LAPACK band storage with leading dimension ldab, with
+a(i, j) stored at ab[ldab - 1 - kl + i - j + j * ldab]. With ldab = 2kl+ku+1
+this is the layout dgbsv wants, leaving kl spare rows on top for the fill-in.
+With kl = 0 and ldab = ku+1 it is the upper symmetric band layout of dpbsv.
+*/
+double* php_lapack_band_pack(const double *a, int n, int lda, int kl, int ku, int ldab)
+{
+	double *ab;
+	int i, j, lo, hi;
+
+	ab = php_lapack_alloc((size_t)ldab * n);
+	memset(ab, 0, (size_t)ldab * n * sizeof(double));
+
+	for (j = 0; j < n; j++) {
+		lo = j - ku > 0 ? j - ku : 0;
+		hi = j + kl < n - 1 ? j + kl : n - 1;
+		for (i = lo; i <= hi; i++) {
+			ab[(ldab - 1 - kl + i - j) + (size_t)j * ldab] = a[i + (size_t)j * lda];
+		}
+	}
+
+	return ab;
+}
+/* }}} */
+
+/* {{{ float* php_lapack_band_pack_single(const float *a, int n, int lda, int kl, int ku, int ldab)
+php_lapack_band_pack for a single precision matrix.
+*/
+float* php_lapack_band_pack_single(const float *a, int n, int lda, int kl, int ku, int ldab)
+{
+	float *ab;
+	int i, j, lo, hi;
+
+	ab = php_lapack_alloc_single((size_t)ldab * n);
+	memset(ab, 0, (size_t)ldab * n * sizeof(float));
+
+	for (j = 0; j < n; j++) {
+		lo = j - ku > 0 ? j - ku : 0;
+		hi = j + kl < n - 1 ? j + kl : n - 1;
+		for (i = lo; i <= hi; i++) {
+			ab[(ldab - 1 - kl + i - j) + (size_t)j * ldab] = a[i + (size_t)j * lda];
+		}
+	}
+
+	return ab;
+}
+/* }}} */
+
+/* {{{ void php_lapack_symmetrize(double *a, int n, int lda, char uplo)
+Copy the uplo ('U' or 'L') triangle of a over the other one, as the symmetric
+drivers only fill in one half of their result.
+*/
+void php_lapack_symmetrize(double *a, int n, int lda, char uplo)
+{
+	int i, j;
+
+	for (j = 0; j < n; j++) {
+		for (i = j + 1; i < n; i++) {
+			if (uplo == 'L') {
+				a[j + (size_t)i * lda] = a[i + (size_t)j * lda];
+			} else {
+				a[i + (size_t)j * lda] = a[j + (size_t)i * lda];
+			}
+		}
+	}
+}
+/* }}} */
@@ -0,0 +1,476 @@
+/*
+  +----------------------------------------------------------------------+
+  | PHP Version 5 / lapack                                               |
+  +----------------------------------------------------------------------+
+  | Copyright (c) 2012 Ian Barber                                        |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 3.0 of the PHP license,       |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.php.net/license/3_0.txt.                                  |
+  | If you did not receive a copy of the PHP license and are unable to   |
+  | obtain it through the world-wide-web, please send a note to          |
+  | license@php.net so we can mail you a copy immediately.               |
+  +----------------------------------------------------------------------+
+  | Authors: Ian Barber <ian.barber@gmail.com>                           |
+  +----------------------------------------------------------------------+
+*/
+
+#include "php_lapack.h"
+#include "php_lapack_internal.h"
+#include "Zend/zend_exceptions.h"
+
+#include "cblas.h"
+#include <float.h>
+
+/*
+ * Truncated singular value decomposition. Lapack::truncatedSVD() finds only
+ * the k largest singular values, and their singular vectors when asked for.
+ * Lapack::SVD_EXACT selects them by index with dgesvdx. Lapack::SVD_RANDOMIZED
+ * sketches the range of A with a few dgemm passes over a random block of
+ * k + PHP_LAPACK_SVD_OVERSAMPLE columns and takes the SVD of the small
+ * projected matrix, which for k much smaller than the matrix is far cheaper
+ * in both time and memory, at the cost of a small approximation error.
+ *
+ * Lapack::pseudoInverse() and Lapack::pinvSolve() use the thin SVD of A to
+ * apply the Moore-Penrose pseudoinverse V . S+ . U^T, the latter to B
+ * directly so that the n x m pseudoinverse is never formed.
+ */
+
+/* Extra sketch columns, and power iterations to sharpen the sketch */
+#define PHP_LAPACK_SVD_OVERSAMPLE	10
+#define PHP_LAPACK_SVD_POWER		2
+
+/* --- Helper Functions --- */
+
+/* {{{ static lapack_int php_lapack_svd_orthonormalize(double *y, lapack_int m, lapack_int l)
+Replace the m x l matrix y (m >= l) with an orthonormal basis for its
+columns, by QR with dgeqrf and dorgqr.
+*/
+static lapack_int php_lapack_svd_orthonormalize(double *y, lapack_int m, lapack_int l)
+{
+	double *tau, *work, query = 0.0;
+	size_t lwork, lwork_q;
+	lapack_int info;
+
+	tau = php_lapack_arena_alloc(l, sizeof(double));
+
+	if (php_lapack_lwork_get(PHP_LAPACK_WORK_DGEQRF, m, l, 0, &lwork, NULL) == FAILURE) {
+		LAPACKE_dgeqrf_work( LAPACK_COL_MAJOR, m, l, y, m, tau, &query, -1 );
+		php_lapack_lwork_set(PHP_LAPACK_WORK_DGEQRF, m, l, 0, query, 0, &lwork, NULL);
+	}
+	if (php_lapack_lwork_get(PHP_LAPACK_WORK_DORGQR, m, l, l, &lwork_q, NULL) == FAILURE) {
+		LAPACKE_dorgqr_work( LAPACK_COL_MAJOR, m, l, l, y, m, tau, &query, -1 );
+		php_lapack_lwork_set(PHP_LAPACK_WORK_DORGQR, m, l, l, query, 0, &lwork_q, NULL);
+	}
+	work = php_lapack_arena_alloc(lwork > lwork_q ? lwork : lwork_q, sizeof(double));
+
+	info = LAPACKE_dgeqrf_work( LAPACK_COL_MAJOR, m, l, y, m, tau, work, (lapack_int)lwork );
+	if (info == 0) {
+		info = LAPACKE_dorgqr_work( LAPACK_COL_MAJOR, m, l, l, y, m, tau, work, (lapack_int)lwork_q );
+	}
+
+	return info;
+}
+/* }}} */
+
+/* {{{ static lapack_int php_lapack_svd_exact(double *a, lapack_int m, lapack_int n, lapack_int k, double *s, double *u, double *v)
+The k largest singular values of a (which is overwritten) into s, and when
+u and v are not NULL the m x k left and n x k right singular vectors. Uses
+dgesvdx where the library has it, and otherwise a full dgesdd cut down to k.
+*/
+static lapack_int php_lapack_svd_exact(double *a, lapack_int m, lapack_int n, lapack_int k, double *s, double *u, double *v)
+{
+	double *sx, *vt, *work, query = 0.0, dummy = 0.0;
+	lapack_int info, mn = m < n ? m : n;
+	lapack_int *iwork;
+	size_t lwork;
+#ifdef HAVE_LAPACKE_DGESVDX
+	lapack_int ns = 0;
+	char job = u != NULL ? 'V' : 'N';
+
+	/* dgesvdx wants room for all min(m, n) values even when asked for k */
+	sx = php_lapack_arena_alloc(mn, sizeof(double));
+	vt = u != NULL ? php_lapack_arena_alloc((size_t)k * n, sizeof(double)) : &dummy;
+	iwork = php_lapack_arena_alloc(12 * (size_t)mn, sizeof(lapack_int));
+
+	if (php_lapack_lwork_get(PHP_LAPACK_WORK_DGESVDX, m, n, job == 'V' ? -k : k, &lwork, NULL) == FAILURE) {
+		LAPACKE_dgesvdx_work( LAPACK_COL_MAJOR, job, job, 'I', m, n, a, m, 0.0, 0.0, 1, k, &ns, sx,
+							  u != NULL ? u : &dummy, m, vt, u != NULL ? k : 1, &query, -1, iwork );
+		php_lapack_lwork_set(PHP_LAPACK_WORK_DGESVDX, m, n, job == 'V' ? -k : k, query, 0, &lwork, NULL);
+	}
+	work = php_lapack_arena_alloc(lwork, sizeof(double));
+
+	info = LAPACKE_dgesvdx_work( LAPACK_COL_MAJOR, job, job, 'I', m, n, a, m, 0.0, 0.0, 1, k, &ns, sx,
+								 u != NULL ? u : &dummy, m, vt, u != NULL ? k : 1, work, (lapack_int)lwork, iwork );
+	if (info == 0 && ns != k) {
+		info = -1;
+	}
+
+	if (info == 0) {
+		memcpy(s, sx, k * sizeof(double));
+		if (v != NULL) {
+			php_lapack_transpose(vt, k, n, k, v, n);
+		}
+	}
+#else
+	double *ux;
+	char jobz = u != NULL ? 'S' : 'N';
+
+	sx = php_lapack_arena_alloc(mn, sizeof(double));
+	ux = u != NULL ? php_lapack_arena_alloc((size_t)m * mn, sizeof(double)) : &dummy;
+	vt = u != NULL ? php_lapack_arena_alloc((size_t)mn * n, sizeof(double)) : &dummy;
+	iwork = php_lapack_arena_alloc(8 * (size_t)mn, sizeof(lapack_int));
+
+	if (php_lapack_lwork_get(PHP_LAPACK_WORK_DGESDD, m, n, jobz, &lwork, NULL) == FAILURE) {
+		LAPACKE_dgesdd_work( LAPACK_COL_MAJOR, jobz, m, n, a, m, sx, ux, m, vt, mn, &query, -1, iwork );
+		php_lapack_lwork_set(PHP_LAPACK_WORK_DGESDD, m, n, jobz, query, 0, &lwork, NULL);
+	}
+	work = php_lapack_arena_alloc(lwork, sizeof(double));
+
+	info = LAPACKE_dgesdd_work( LAPACK_COL_MAJOR, jobz, m, n, a, m, sx, ux, m, vt, mn, work, (lapack_int)lwork, iwork );
+
+	if (info == 0) {
+		memcpy(s, sx, k * sizeof(double));
+		if (u != NULL) {
+			memcpy(u, ux, (size_t)m * k * sizeof(double));
+			php_lapack_transpose(vt, k, n, mn, v, n);
+		}
+	}
+#endif
+
+	return info;
+}
+/* }}} */
+
+/* {{{ static lapack_int php_lapack_svd_randomized(const double *a, lapack_int m, lapack_int n, lapack_int lda, lapack_int k, double *s, double *u, double *v)
+Approximate the k largest singular triplets of a, which is only read, with
+a randomized range finder: Y = (A A^T)^q A Omega for a Gaussian Omega,
+orthonormalised between passes, then B = Q^T A and the SVD of the small B.
+u and v are filled in as for php_lapack_svd_exact when not NULL.
+*/
+static lapack_int php_lapack_svd_randomized(const double *a, lapack_int m, lapack_int n, lapack_int lda, lapack_int k, double *s, double *u, double *v)
+{
+	double *omega, *y, *b, *sb, *ub, *vtb, *work, query = 0.0, dummy = 0.0;
+	lapack_int info, l, q, mn = m < n ? m : n;
+	lapack_int *iwork;
+	/* A fixed seed, so that the same matrix always gives the same answer */
+	lapack_int iseed[4] = {1, 3, 5, 7};
+	size_t lwork;
+	char jobz = u != NULL ? 'S' : 'N';
+
+	l = k + PHP_LAPACK_SVD_OVERSAMPLE < mn ? k + PHP_LAPACK_SVD_OVERSAMPLE : mn;
+
+	omega = php_lapack_arena_alloc((size_t)n * l, sizeof(double));
+	y = php_lapack_arena_alloc((size_t)m * l, sizeof(double));
+
+	/* Y = A . Omega, filled a column at a time as n * l may not fit a lapack_int */
+	for (q = 0; q < l; q++) {
+		info = LAPACKE_dlarnv_work( 3, iseed, n, omega + (size_t)q * n );
+		if (info != 0) {
+			return info;
+		}
+	}
+	cblas_dgemm( CblasColMajor, CblasNoTrans, CblasNoTrans, m, l, n,
+				 1.0, a, lda, omega, n, 0.0, y, m );
+
+	/* Power iterations, Y = A . (A^T . Y), reusing Omega for A^T . Y */
+	for (q = 0; q < PHP_LAPACK_SVD_POWER; q++) {
+		if ((info = php_lapack_svd_orthonormalize(y, m, l)) != 0) {
+			return info;
+		}
+		cblas_dgemm( CblasColMajor, CblasTrans, CblasNoTrans, n, l, m,
+					 1.0, a, lda, y, m, 0.0, omega, n );
+		if ((info = php_lapack_svd_orthonormalize(omega, n, l)) != 0) {
+			return info;
+		}
+		cblas_dgemm( CblasColMajor, CblasNoTrans, CblasNoTrans, m, l, n,
+					 1.0, a, lda, omega, n, 0.0, y, m );
+	}
+	if ((info = php_lapack_svd_orthonormalize(y, m, l)) != 0) {
+		return info;
+	}
+
+	/* B = Q^T . A, l x n */
+	b = php_lapack_arena_alloc((size_t)l * n, sizeof(double));
+	cblas_dgemm( CblasColMajor, CblasTrans, CblasNoTrans, l, n, m,
+				 1.0, y, m, a, lda, 0.0, b, l );
+
+	sb = php_lapack_arena_alloc(l, sizeof(double));
+	ub = u != NULL ? php_lapack_arena_alloc((size_t)l * l, sizeof(double)) : &dummy;
+	vtb = u != NULL ? php_lapack_arena_alloc((size_t)l * n, sizeof(double)) : &dummy;
+	iwork = php_lapack_arena_alloc(8 * (size_t)l, sizeof(lapack_int));
+
+	if (php_lapack_lwork_get(PHP_LAPACK_WORK_DGESDD, l, n, jobz, &lwork, NULL) == FAILURE) {
+		LAPACKE_dgesdd_work( LAPACK_COL_MAJOR, jobz, l, n, b, l, sb, ub, l, vtb, l, &query, -1, iwork );
+		php_lapack_lwork_set(PHP_LAPACK_WORK_DGESDD, l, n, jobz, query, 0, &lwork, NULL);
+	}
+	work = php_lapack_arena_alloc(lwork, sizeof(double));
+
+	info = LAPACKE_dgesdd_work( LAPACK_COL_MAJOR, jobz, l, n, b, l, sb, ub, l, vtb, l, work, (lapack_int)lwork, iwork );
+	if (info != 0) {
+		return info;
+	}
+
+	memcpy(s, sb, k * sizeof(double));
+	if (u != NULL) {
+		/* U = Q . Ub, keeping the first k columns */
+		cblas_dgemm( CblasColMajor, CblasNoTrans, CblasNoTrans, m, k, l,
+					 1.0, y, m, ub, l, 0.0, u, m );
+		php_lapack_transpose(vtb, k, n, l, v, n);
+	}
+
+	return 0;
+}
+/* }}} */
+
+/* --- Lapack Truncated SVD --- */
+
+/* {{{ array Lapack::truncatedSVD(array|LapackMatrix A, int k [, int method [, array &U [, array &V]]]);
+Calculate the k largest singular values of A, in descending order. When
+arrays are passed for U and V they are replaced with the m x k left and
+n x k right singular vectors, so that A is approximately U . diag(s) . V^T;
+otherwise only the values are computed. method is Lapack::SVD_EXACT (the
+default) or Lapack::SVD_RANDOMIZED.
+*/
+PHP_METHOD(Lapack, truncatedSVD)
+{
+	zval *a, *uz = NULL, *vz = NULL;
+	double *al, *s, *u = NULL, *v = NULL;
+	zend_long k, method = PHP_LAPACK_SVD_EXACT;
+	lapack_int info, lda;
+	int m, n;
+	php_lapack_matrix_object *intern;
+	zend_bool as_matrix = 0, vectors;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS(), "zl|lz!z!", &a, &k, &method, &uz, &vz) == FAILURE) {
+		return;
+	}
+
+	php_lapack_arena_begin();
+
+	if (method != PHP_LAPACK_SVD_EXACT && method != PHP_LAPACK_SVD_RANDOMIZED) {
+		LAPACK_THROW("Invalid method - must be Lapack::SVD_EXACT or Lapack::SVD_RANDOMIZED", 102);
+	}
+
+	if (php_lapack_operand_shape(a, &m, &n, &as_matrix) == FAILURE) {
+		LAPACK_THROW("Invalid input matrix", 102);
+	}
+
+	if (k < 1 || k > (m < n ? m : n)) {
+		LAPACK_THROW("Invalid number of singular values - must be between 1 and the smaller dimension of A", 102);
+	}
+
+	vectors = php_lapack_output_wanted(uz) || php_lapack_output_wanted(vz);
+
+	/* The randomized method only reads A, so a LapackMatrix is used in place */
+	if (method == PHP_LAPACK_SVD_RANDOMIZED && Z_TYPE_P(a) != IS_ARRAY) {
+		intern = Z_LAPACK_MATRIX_P(a);
+		al = NULL;
+		lda = intern->ld;
+	} else {
+		intern = NULL;
+		al = php_lapack_alloc((size_t)m * n);
+		php_lapack_linearize_operand_into(a, al, m, n, m);
+		lda = m;
+	}
+
+	s = php_lapack_alloc(k);
+	if (vectors) {
+		u = php_lapack_alloc((size_t)m * k);
+		v = php_lapack_alloc((size_t)n * k);
+	}
+
+	if (method == PHP_LAPACK_SVD_EXACT) {
+		php_lapack_blas_threads_for((double)m * n * (m < n ? m : n));
+		info = php_lapack_svd_exact(al, m, n, k, s, u, v);
+	} else {
+		php_lapack_blas_threads_for((double)m * n * k * (2 * PHP_LAPACK_SVD_POWER + 2));
+		info = php_lapack_svd_randomized(intern != NULL ? intern->data : al, m, n, lda, k, s, u, v);
+	}
+	php_lapack_stats_info(info);
+
+	if (info == 0) {
+		if (vectors) {
+			if (php_lapack_output_wanted(uz)) {
+				php_lapack_assign_matrix(uz, &u, m, k, m, as_matrix);
+			}
+			if (php_lapack_output_wanted(vz)) {
+				php_lapack_assign_matrix(vz, &v, n, k, n, as_matrix);
+			}
+		}
+		php_lapack_return_matrix(return_value, &s, 1, k, 1, as_matrix);
+	} else {
+		array_init(return_value);
+	}
+
+	php_lapack_free(al);
+	php_lapack_free(s);
+	php_lapack_free(u);
+	php_lapack_free(v);
+
+	return;
+}
+/* }}} */
+
+/* {{{ static lapack_int php_lapack_svd_pinv(double *a, lapack_int m, lapack_int n, double rcond, double **u, double **vt, lapack_int *rank)
+Take the thin SVD of a, which is overwritten, with dgesdd and count the
+singular values above rcond times the largest as the rank r. The first r
+columns of u come back divided by their singular values, so that the
+pseudoinverse is VT(1:r, :)^T . U(:, 1:r)^T. u is m x min(m, n) and vt is
+min(m, n) x n, both from the arena. A negative rcond means max(m, n) times
+the machine precision.
+*/
+static lapack_int php_lapack_svd_pinv(double *a, lapack_int m, lapack_int n, double rcond, double **u, double **vt, lapack_int *rank)
+{
+	double *s, *work, query = 0.0;
+	lapack_int info, j, mn = m < n ? m : n;
+	lapack_int *iwork;
+	size_t lwork;
+
+	s = php_lapack_arena_alloc(mn, sizeof(double));
+	*u = php_lapack_arena_alloc((size_t)m * mn, sizeof(double));
+	*vt = php_lapack_arena_alloc((size_t)mn * n, sizeof(double));
+	iwork = php_lapack_arena_alloc(8 * (size_t)mn, sizeof(lapack_int));
+
+	if (php_lapack_lwork_get(PHP_LAPACK_WORK_DGESDD, m, n, 'S', &lwork, NULL) == FAILURE) {
+		LAPACKE_dgesdd_work( LAPACK_COL_MAJOR, 'S', m, n, a, m, s, *u, m, *vt, mn, &query, -1, iwork );
+		php_lapack_lwork_set(PHP_LAPACK_WORK_DGESDD, m, n, 'S', query, 0, &lwork, NULL);
+	}
+	work = php_lapack_arena_alloc(lwork, sizeof(double));
+
+	info = LAPACKE_dgesdd_work( LAPACK_COL_MAJOR, 'S', m, n, a, m, s, *u, m, *vt, mn, work, (lapack_int)lwork, iwork );
+	if (info != 0) {
+		return info;
+	}
+
+	if (rcond < 0.0) {
+		rcond = (m > n ? m : n) * DBL_EPSILON;
+	}
+
+	/* The singular values are in descending order, and all zero for a zero A */
+	for (j = 0; j < mn && s[j] > rcond * s[0]; j++) {
+		cblas_dscal(m, 1.0 / s[j], *u + (size_t)j * m, 1);
+	}
+	*rank = j;
+
+	return 0;
+}
+/* }}} */
+
+/* {{{ array Lapack::pseudoInverse(array|LapackMatrix A [, float rcond]);
+Find the Moore-Penrose pseudoinverse of the m x n matrix A, an n x m matrix.
+Singular values below rcond times the largest count as zero, by default
+max(m, n) times the machine precision. Works for rectangular and rank
+deficient A, and equals the inverse when A is square and invertible.
+*/
+PHP_METHOD(Lapack, pseudoInverse)
+{
+	zval *a;
+	double *al, *u, *vt, *out = NULL;
+	double rcond = -1.0;
+	lapack_int info, rank = 0;
+	int m, n;
+	zend_bool as_matrix = 0;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS(), "z|d", &a, &rcond) == FAILURE) {
+		return;
+	}
+
+	php_lapack_arena_begin();
+
+	al = php_lapack_linearize_operand(a, &m, &n, &as_matrix);
+	if (al == NULL) {
+		LAPACK_THROW("Invalid input matrix - argument 1", 102);
+	}
+
+	php_lapack_blas_threads_for((double)m * n * (m < n ? m : n));
+	info = php_lapack_svd_pinv(al, m, n, rcond, &u, &vt, &rank);
+	php_lapack_stats_info(info);
+
+	if (info == 0) {
+		out = php_lapack_alloc((size_t)n * m);
+		if (rank > 0) {
+			/* A+ = V . (U S+)^T, over the first rank columns of each */
+			cblas_dgemm( CblasColMajor, CblasTrans, CblasTrans, n, m, rank,
+						 1.0, vt, m < n ? m : n, u, m, 0.0, out, n );
+		} else {
+			memset(out, 0, (size_t)n * m * sizeof(double));
+		}
+		php_lapack_return_matrix(return_value, &out, n, m, n, as_matrix);
+	} else {
+		array_init(return_value);
+	}
+
+	php_lapack_free(al);
+	php_lapack_free(out);
+
+	return;
+}
+/* }}} */
+
+/* {{{ array Lapack::pinvSolve(array|LapackMatrix A, array|LapackMatrix B [, float rcond]);
+Return X = A+ . B, the minimum norm least squares solution of A X = B, for
+an m x n A and m x nrhs B. A+ is applied as V . (S+ . (U^T . B)) with two
+products of the size of B, without forming it. rcond is as for
+pseudoInverse().
+*/
+PHP_METHOD(Lapack, pinvSolve)
+{
+	zval *a, *b;
+	double *al, *bl, *u, *vt, *t, *x = NULL;
+	double rcond = -1.0;
+	lapack_int info, rank = 0;
+	int m, n, mb, nrhs;
+	zend_bool as_matrix = 0;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS(), "zz|d", &a, &b, &rcond) == FAILURE) {
+		return;
+	}
+
+	php_lapack_arena_begin();
+
+	al = php_lapack_linearize_operand(a, &m, &n, &as_matrix);
+	if (al == NULL) {
+		LAPACK_THROW("Invalid input matrix - argument 1", 102);
+	}
+
+	bl = php_lapack_linearize_operand(b, &mb, &nrhs, &as_matrix);
+	if (bl == NULL) {
+		php_lapack_free(al);
+		LAPACK_THROW("Invalid input matrix - argument 2", 102);
+	} else if (mb != m) {
+		php_lapack_free(al);
+		php_lapack_free(bl);
+		LAPACK_THROW("Invalid input matrix - argument 2, wrong number of rows", 102);
+	}
+
+	php_lapack_blas_threads_for((double)m * n * ((m < n ? m : n) + nrhs));
+	info = php_lapack_svd_pinv(al, m, n, rcond, &u, &vt, &rank);
+	php_lapack_stats_info(info);
+
+	if (info == 0) {
+		x = php_lapack_alloc((size_t)n * nrhs);
+		if (rank > 0) {
+			/* T = S+ . U^T . B, rank x nrhs, with S+ already applied to U */
+			t = php_lapack_arena_alloc((size_t)rank * nrhs, sizeof(double));
+			cblas_dgemm( CblasColMajor, CblasTrans, CblasNoTrans, rank, nrhs, m,
+						 1.0, u, m, bl, m, 0.0, t, rank );
+			/* X = V . T */
+			cblas_dgemm( CblasColMajor, CblasTrans, CblasNoTrans, n, nrhs, rank,
+						 1.0, vt, m < n ? m : n, t, rank, 0.0, x, n );
+		} else {
+			memset(x, 0, (size_t)n * nrhs * sizeof(double));
+		}
+		php_lapack_return_matrix(return_value, &x, n, nrhs, n, as_matrix);
+	} else {
+		array_init(return_value);
+	}
+
+	php_lapack_free(al);
+	php_lapack_free(bl);
+	php_lapack_free(x);
+
+	return;
+}
+/* }}} */
@@ -31,10 +31,50 @@
 
 #include "php.h"
 
-#ifdef ZTS
-# define LAPACK_G(v) TSRMG(lapack_globals_id, zend_lapack_globals *, v)
-#else
-# define LAPACK_G(v) (lapack_globals.v)
+/* Number of cached workspace size queries, a power of two */
+#define PHP_LAPACK_LWORK_CACHE 32
+
+typedef struct _php_lapack_lwork_entry {
+	int routine;				/* 0 for an unused entry */
+	int m;
+	int n;
+	int k;
+	size_t lwork;
+	size_t liwork;
+} php_lapack_lwork_entry;
+
+ZEND_BEGIN_MODULE_GLOBALS(lapack)
+	zend_long precision;
+	zend_long max_threads;
+	zend_long parallel_threshold;
+	int blas_threads;			/* last count given to the BLAS backend */
+	/* Workspace arena, see lapack_arena.c */
+	char *arena;
+	size_t arena_size;
+	size_t arena_used;
+	size_t arena_peak;
+	void *arena_overflow;
+	php_lapack_lwork_entry lwork_cache[PHP_LAPACK_LWORK_CACHE];
+	/* Call statistics, see lapack_stats.c */
+	void *stats;				/* counters of this request, per method */
+	int stats_depth;
+	uint64_t stats_convert_ns;	/* of the call being counted */
+	uint64_t stats_assemble_ns;
+	uint64_t stats_bytes;
+	size_t stats_workspace;
+	zend_long stats_info;
+	zend_long stats_refine_iter;
+	zend_long stats_refine_fallback;
+	zend_long trace_threshold;
+	zend_long cache_size;		/* bytes of the shared matrix cache, see lapack_cache.c */
+ZEND_END_MODULE_GLOBALS(lapack)
+
+ZEND_EXTERN_MODULE_GLOBALS(lapack)
+
+#define LAPACK_G(v) ZEND_MODULE_GLOBALS_ACCESSOR(lapack, v)
+
+#if defined(ZTS) && defined(COMPILE_DL_LAPACK)
+ZEND_TSRMLS_CACHE_EXTERN()
 #endif
 
 extern zend_module_entry lapack_module_entry;
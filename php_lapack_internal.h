@@ -20,6 +20,253 @@
 
 #include <lapacke.h>
 
+/* Alignment (in bytes) of the column-major buffers owned by LapackMatrix */
+#define PHP_LAPACK_ALIGNMENT 64
+
+/* Tile size used when transposing between row and column major layouts */
+#define PHP_LAPACK_BLOCK 32
+
+/* Largest value a lapack_int holds, 64 bit when built against an ILP64
+   LAPACKE (see --with-lapack-ilp64) */
+#define PHP_LAPACK_INT_MAX (sizeof(lapack_int) == 8 ? (size_t)INT64_MAX : (size_t)INT_MAX)
+
+/* Layouts accepted by LapackMatrix::fromString() and toString() */
+#define PHP_LAPACK_ROW_MAJOR 101
+#define PHP_LAPACK_COL_MAJOR 102
+
+/* Matrix structure hints, exposed as Lapack class constants */
+#define PHP_LAPACK_AUTO					0
+#define PHP_LAPACK_GENERAL				1
+#define PHP_LAPACK_SYMMETRIC			2
+#define PHP_LAPACK_POSITIVE_DEFINITE	3
+#define PHP_LAPACK_UPPER_TRIANGULAR		4
+#define PHP_LAPACK_LOWER_TRIANGULAR		5
+#define PHP_LAPACK_BANDED				6
+
+/* Lapack::truncatedSVD() methods, exposed as Lapack class constants */
+#define PHP_LAPACK_SVD_EXACT			1
+#define PHP_LAPACK_SVD_RANDOMIZED		2
+
+/* Preconditioners of the sparse iterative solvers, exposed as Lapack class
+   constants */
+#define PHP_LAPACK_PRECONDITION_NONE	0
+#define PHP_LAPACK_PRECONDITION_JACOBI	1
+#define PHP_LAPACK_PRECONDITION_ILU0	2
+
+/* Values of the lapack.precision INI setting */
+#define PHP_LAPACK_DOUBLE				0
+#define PHP_LAPACK_SINGLE				1
+#define PHP_LAPACK_MIXED				2	/* double, with single precision factorisations in solveLinearEquation */
+
+#define LAPACK_THROW(message, code) \
+		zend_throw_exception(php_lapack_exception_sc_entry, message, (zend_long)code); \
+		return;
+
+extern zend_class_entry *php_lapack_exception_sc_entry;
+extern zend_class_entry *php_lapack_matrix_sc_entry;
+
+/* LapackMatrix: a dense column-major matrix of doubles. Element (i, j) lives
+   at data[i + j * ld], and ld is at least m. When buffer is set, data points
+   into that binary string rather than at a php_lapack_alloc block, and must
+   be treated as read only. The same goes for map, a read only file mapping
+   of map_len bytes made by Lapack::load(), and for cache, an entry of the
+   shared matrix cache returned by Lapack::cacheFetch(). */
+typedef struct _php_lapack_matrix_object {
+	double *data;
+	int m;
+	int n;
+	int ld;
+	zend_string *buffer;
+	void *map;
+	size_t map_len;
+	void *cache;
+	zend_object std;
+} php_lapack_matrix_object;
+
+static inline php_lapack_matrix_object *php_lapack_matrix_from_obj(zend_object *obj) {
+	return (php_lapack_matrix_object *)((char *)(obj) - XtOffsetOf(php_lapack_matrix_object, std));
+}
+
+#define Z_LAPACK_MATRIX_P(zv) php_lapack_matrix_from_obj(Z_OBJ_P(zv))
+
+/* Aligned buffers, must be released with php_lapack_free */
+double *php_lapack_alloc(size_t count);
+void php_lapack_free(double *ptr);
+
+/* Aligned single precision buffers, also released with php_lapack_free */
+#define php_lapack_alloc_single(count) ((float *)php_lapack_alloc(((count) + 1) / 2))
+
+/* Per call workspace arena and cached workspace queries, see lapack_arena.c */
+void php_lapack_arena_begin(void);
+void *php_lapack_arena_alloc(size_t count, size_t size);
+void php_lapack_arena_release(void);
+int php_lapack_lwork_get(int routine, int m, int n, int k, size_t *lwork, size_t *liwork);
+void php_lapack_lwork_set(int routine, int m, int n, int k, double query, lapack_int iquery, size_t *lwork, size_t *liwork);
+
+/* Routines whose workspace queries are cached */
+#define PHP_LAPACK_WORK_DGETRI			1
+#define PHP_LAPACK_WORK_DSYTRF			2
+#define PHP_LAPACK_WORK_DSYSV			3
+#define PHP_LAPACK_WORK_DGELS			4
+#define PHP_LAPACK_WORK_DGELSD			5
+#define PHP_LAPACK_WORK_DSYEVD			6
+#define PHP_LAPACK_WORK_DGEEV			7
+#define PHP_LAPACK_WORK_DGESDD			8
+#define PHP_LAPACK_WORK_DGEQRF			10
+#define PHP_LAPACK_WORK_DORMQR			11
+#define PHP_LAPACK_WORK_DORGQR			12
+#define PHP_LAPACK_WORK_DGESVDX			13
+#define PHP_LAPACK_WORK_DSYEVR			14
+#define PHP_LAPACK_WORK_SSYSV			21
+#define PHP_LAPACK_WORK_SGELS			22
+#define PHP_LAPACK_WORK_SGELSD			23
+#define PHP_LAPACK_WORK_SSYEVD			24
+#define PHP_LAPACK_WORK_SGEEV			25
+#define PHP_LAPACK_WORK_SGESDD			26
+
+/* Marshalling between PHP arrays, LapackMatrix objects and linear buffers */
+int php_lapack_array_shape(zval *inarray, int *m, int *n);
+int php_lapack_linearize_array_into(zval *inarray, double *outarray, int m, int n, int ld);
+double *php_lapack_linearize_array(zval *inarray, int *m, int *n);
+int php_lapack_operand_shape(zval *operand, int *m, int *n, zend_bool *is_matrix);
+int php_lapack_linearize_operand_into(zval *operand, double *outarray, int m, int n, int ld);
+double *php_lapack_linearize_operand(zval *operand, int *m, int *n, zend_bool *is_matrix);
+void php_lapack_reassemble_row(zval *row, double *inarray, int n, int stride);
+void php_lapack_reassemble_array(zval *return_value, double *inarray, int m, int n, int stride);
+void php_lapack_matrix_wrap(zval *object, double *data, int m, int n, int ld);
+void php_lapack_return_matrix(zval *return_value, double **data, int m, int n, int ld, zend_bool as_matrix);
+zend_bool php_lapack_output_wanted(zval *output);
+void php_lapack_assign_matrix(zval *output, double **data, int m, int n, int ld, zend_bool as_matrix);
+void php_lapack_transpose(const double *in, int m, int n, int ldin, double *out, int ldout);
+
+/* Structure detection, see lapack_structure.c */
+typedef struct _php_lapack_structure_info {
+	int kl;						/* lower bandwidth */
+	int ku;						/* upper bandwidth */
+	zend_bool symmetric;
+	zend_bool positive_diagonal;
+} php_lapack_structure_info;
+
+int php_lapack_structure(zend_long hint, const double *a, int n, int lda, php_lapack_structure_info *info);
+double *php_lapack_band_pack(const double *a, int n, int lda, int kl, int ku, int ldab);
+void php_lapack_symmetrize(double *a, int n, int lda, char uplo);
+int php_lapack_structure_single(zend_long hint, const float *a, int n, int lda, php_lapack_structure_info *info);
+float *php_lapack_band_pack_single(const float *a, int n, int lda, int kl, int ku, int ldab);
+
+/* Eigenvalue and eigenvector output shared by both precisions */
+void php_lapack_eigen_results(zval *return_value, zval *leig, zval *reig, lapack_int n,
+	double *wr, double *wi, double *vl, double *vr, lapack_int ldv, zend_bool as_matrix);
+
+/* Single precision drivers used when lapack.precision is "single", see
+   lapack_single.c. The arguments are the already parsed method arguments. */
+void php_lapack_single_solve(zval *return_value, zval *a, zval *b, zend_long structure);
+void php_lapack_single_least_squares(zval *return_value, zval *a, zval *b, zend_bool svd);
+void php_lapack_single_eigen(zval *return_value, zval *a, zval *leig, zval *reig, zend_long structure);
+void php_lapack_single_singular_values(zval *return_value, zval *a);
+void php_lapack_single_shape_regression(zval *return_value, zval *M, zval *P, zval *W);
+
+/* BLAS backend threading, see lapack_pool.c */
+const char *php_lapack_blas_backend(void);
+int php_lapack_blas_threads(void);
+int php_lapack_blas_set_threads(int threads);
+void php_lapack_blas_pin(void);
+void php_lapack_blas_unpin(void);
+void php_lapack_blas_threads_init(void);
+void php_lapack_blas_threads_for(double work);
+
+/* Native thread pool, see lapack_pool.c */
+typedef void (*php_lapack_task_func)(void *ctx, size_t task);
+int php_lapack_pool_threads(zend_long requested, size_t ntasks);
+void php_lapack_pool_run(size_t ntasks, php_lapack_task_func func, void *ctx, int nthreads);
+
+/* Call statistics, see lapack_stats.c */
+#define PHP_LAPACK_STATS_CONVERT	0
+#define PHP_LAPACK_STATS_ASSEMBLE	1
+uint64_t php_lapack_stats_clock(void);
+void php_lapack_stats_phase(int phase, uint64_t start, size_t bytes);
+void php_lapack_stats_info(lapack_int info);
+void php_lapack_stats_refinement(lapack_int iter);
+void php_lapack_stats_startup(void);
+void php_lapack_stats_shutdown(void);
+void php_lapack_stats_request_end(void);
+void php_lapack_stats_info_table(void);
+
+/* Shared matrix cache, see lapack_cache.c */
+void php_lapack_cache_release(void *entry);
+void php_lapack_cache_shutdown(void);
+void php_lapack_cache_info_table(void);
+
+PHP_MINIT_FUNCTION(lapack_matrix);
+PHP_MINIT_FUNCTION(lapack_factor);
+PHP_MINIT_FUNCTION(lapack_shape);
+PHP_MINIT_FUNCTION(lapack_lsq);
+PHP_MINIT_FUNCTION(lapack_async);
+PHP_MINIT_FUNCTION(lapack_sparse);
+PHP_MINIT_FUNCTION(lapack_cache);
+
+/* Batched drivers, see lapack_batch.c */
+PHP_METHOD(Lapack, solveLinearEquationBatch);
+PHP_METHOD(Lapack, leastSquaresByFactorisationBatch);
+PHP_METHOD(Lapack, singularValuesBatch);
+
+/* Factorisation objects, see lapack_factor.c */
+PHP_METHOD(Lapack, luFactor);
+PHP_METHOD(Lapack, qrFactor);
+PHP_METHOD(Lapack, choleskyFactor);
+
+/* Shape regression and model objects, see lapack_shape.c */
+PHP_METHOD(Lapack, shapeRegressionModel);
+PHP_METHOD(Lapack, shapeModel);
+
+/* Truncated SVD and pseudoinverse, see lapack_svd.c */
+PHP_METHOD(Lapack, truncatedSVD);
+PHP_METHOD(Lapack, pseudoInverse);
+PHP_METHOD(Lapack, pinvSolve);
+
+/* The buffers of a factorisation object, for storing it in the shared cache.
+   ntau and nipiv are 0 when the kind has no tau or ipiv. */
+typedef struct _php_lapack_factor_parts {
+	int kind;
+	int m;
+	int n;
+	lapack_int info;
+	zend_bool as_matrix;
+	double *data;
+	double *tau;
+	int ntau;
+	lapack_int *ipiv;
+	int nipiv;
+} php_lapack_factor_parts;
+
+int php_lapack_factor_export(zval *object, php_lapack_factor_parts *parts);
+void php_lapack_factor_cached(zval *object, const php_lapack_factor_parts *parts, void *entry);
+
+/* Matrix multiplication, see lapack_multiply.c */
+PHP_METHOD(Lapack, multiply);
+PHP_METHOD(Lapack, multiplyChain);
+
+/* Streaming least squares, see lapack_lsq.c */
+PHP_METHOD(Lapack, leastSquaresStream);
+
+/* Matrix files, see lapack_npy.c */
+PHP_METHOD(Lapack, load);
+PHP_METHOD(Lapack, save);
+
+/* Sparse iterative solvers, see lapack_sparse.c */
+PHP_METHOD(Lapack, solveSparse);
+PHP_METHOD(Lapack, leastSquaresSparse);
+
+/* Asynchronous calls, see lapack_async.c */
+PHP_METHOD(Lapack, async);
+
+/* Shared matrix cache, see lapack_cache.c */
+PHP_METHOD(Lapack, cacheStore);
+PHP_METHOD(Lapack, cacheFetch);
+
+/* Call statistics, see lapack_stats.c */
+PHP_METHOD(Lapack, stats);
+PHP_METHOD(Lapack, resetStats);
+
 #endif /* _PHP_LAPACK_INTERNAL_H_ */
 
 
@@ -34,6 +34,18 @@ foreach($result as $k => $r) {
 }
 var_dump($result);
 
+/* One equation in two unknowns: the solution has more rows than B */
+foreach (Lapack::leastSquaresByFactorisation(array(array(1, 1)), array(array(2, 4))) as $row) {
+    echo round($row[0], 4), " ", round($row[1], 4), "\n";
+}
+
+/* B with more rows than A */
+try {
+    Lapack::leastSquaresByFactorisation(array(array(1, 2), array(3, 4)), array(array(1), array(2), array(3)));
+} catch (Lapackexception $e) {
+    echo $e->getMessage(), "\n";
+}
+
 try {
     $result = Lapack::leastSquaresByFactorisation(array(array()), array(array()));
 } catch(Exception $e) {
@@ -77,5 +89,8 @@ array(4) {
     float(0.14)
   }
 }
+1 2
+1 2
+Invalid input matrix - argument 2
 Invalid input matrix - argument 1
 Invalid input matrix - argument 1
\ No newline at end of file
@@ -12,12 +12,17 @@ function printEigVal($e) {
 }
 
 function printEig($e) {
-    foreach( $e as $row ) {
-        foreach( $row as $col ) {
-            if(count($col) == 1) {
-                echo " ", printEigVal($col[0]);
+    foreach( $e['real'] as $i => $row ) {
+        foreach( $row as $j => $re ) {
+            // a column belongs to a complex pair if any imaginary part is set
+            $complex = false;
+            foreach( $e['imag'] as $im ) {
+                $complex = $complex || $im[$j] != 0;
+            }
+            if(!$complex) {
+                echo " ", printEigVal($re);
             } else {
-                echo "( ", printEigVal($col[0]), ", ", printEigVal($col[1]), ") ";
+                echo "( ", printEigVal($re), ", ", printEigVal($e['imag'][$i][$j]), ") ";
             }
         }
         echo "\n";
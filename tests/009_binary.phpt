@@ -0,0 +1,39 @@
+--TEST--
+Test creating and returning matrices as packed binary strings
+--SKIPIF--
+<?php
+if (!extension_loaded('lapack')) die('skip');
+?>
+--FILE--
+<?php
+
+// 2x3 matrix, row-major and column-major
+$rows = pack('d*', 1, 2, 3, 4, 5, 6);
+$cols = pack('d*', 1, 4, 2, 5, 3, 6);
+
+$a = LapackMatrix::fromString($rows, 2, 3, LapackMatrix::ROW_MAJOR);
+$b = LapackMatrix::fromString($cols, 2, 3);
+var_dump($a->toArray() == $b->toArray());
+echo $a->rows(), "x", $a->columns(), "\n";
+echo implode(",", unpack('d*', $a->toString())), "\n";
+echo implode(",", unpack('d*', $b->toString(LapackMatrix::ROW_MAJOR))), "\n";
+
+// binary in, binary out
+$a = LapackMatrix::fromString(pack('d*', 2, 0, 0, 4), 2, 2);
+$b = LapackMatrix::fromString(pack('d*', 2, 8), 2, 1);
+$x = Lapack::solveLinearEquation($a, $b);
+echo implode(",", unpack('d*', $x->toString())), "\n";
+
+try {
+    LapackMatrix::fromString(pack('d*', 1, 2, 3), 2, 2);
+} catch(Lapackexception $e) {
+    echo $e->getMessage(), "\n";
+}
+?>
+--EXPECT--
+bool(true)
+2x3
+1,4,2,5,3,6
+1,2,3,4,5,6
+1,2
+Invalid input buffer - length does not match rows x columns doubles
@@ -0,0 +1,87 @@
+--TEST--
+Test the batched linear equation, least squares and singular value functions
+--SKIPIF--
+<?php
+if (!extension_loaded('lapack')) die('skip');
+?>
+--FILE--
+<?php
+
+include __DIR__ . '/lapack_helpers.inc';
+
+$as = array();
+$bs = array();
+for ($k = 0; $k < 200; $k++) {
+    $n = 3 + $k % 6;
+    $a = array();
+    $b = array();
+    for ($i = 0; $i < $n; $i++) {
+        for ($j = 0; $j < $n; $j++) {
+            $a[$i][$j] = ($i == $j) ? $n + 1.0 : sin($k + $i * $n + $j);
+        }
+        $b[$i] = array(cos($k + $i), $i);
+    }
+    $as["p$k"] = $a;
+    $bs["p$k"] = $b;
+}
+
+$batch = Lapack::solveLinearEquationBatch($as, $bs, 4);
+$same = true;
+foreach ($as as $key => $a) {
+    if (roundAll($batch[$key]) != roundAll(Lapack::solveLinearEquation($a, $bs[$key]))) {
+        $same = false;
+    }
+}
+var_dump(count($batch), $same);
+
+$batch = Lapack::singularValuesBatch($as);
+$same = true;
+foreach ($as as $key => $a) {
+    if (roundAll($batch[$key]) != roundAll(Lapack::singularValues($a))) {
+        $same = false;
+    }
+}
+var_dump($same);
+
+$a = array(
+    array( 1.44,  -7.84,  -4.39,   4.53),
+    array(-9.96,  -0.28,  -3.24,   3.83),
+    array(-7.55,   3.24,   6.27,  -6.64),
+    array( 8.34,   8.09,   5.28,   2.06),
+    array( 7.08,   2.52,   0.74,  -2.47),
+    array(-5.45,  -5.70,  -1.19,   4.70),
+);
+$b = array(
+    array( 8.58,   9.35),
+    array( 8.26,  -4.43),
+    array( 8.48,  -0.70),
+    array(-5.28,  -0.26),
+    array( 5.72,  -7.36),
+    array( 8.93,  -2.52),
+);
+$batch = Lapack::leastSquaresByFactorisationBatch(array($a, new LapackMatrix($a)), array($b, $b));
+var_dump(roundAll($batch[0]) == roundAll(Lapack::leastSquaresByFactorisation($a, $b)));
+echo get_class($batch[1]), "\n";
+
+// singular systems give an empty array
+$batch = Lapack::solveLinearEquationBatch(array(array(array(1, 2), array(2, 4))), array(array(array(1), array(2))));
+var_dump($batch);
+
+try {
+    Lapack::solveLinearEquationBatch(array($a), array($b));
+} catch(Lapackexception $e) {
+    echo $e->getMessage(), "\n";
+}
+?>
+--EXPECT--
+int(200)
+bool(true)
+bool(true)
+bool(true)
+LapackMatrix
+array(1) {
+  [0]=>
+  array(0) {
+  }
+}
+Matrix must be square - argument 1, entry 0
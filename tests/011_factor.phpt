@@ -0,0 +1,106 @@
+--TEST--
+Test reusing LU, QR and Cholesky factorisations
+--SKIPIF--
+<?php
+if (!extension_loaded('lapack')) die('skip');
+?>
+--FILE--
+<?php
+
+include __DIR__ . '/lapack_helpers.inc';
+
+$a = array(
+    array( 6.80,  -6.05,  -0.45,   8.32,  -9.67   ),
+    array(-2.11,  -3.30,   2.58,   2.71,  -5.14   ),
+    array( 5.66,   5.36,  -2.70,   4.35,  -7.26   ),
+    array( 5.97,  -4.44,   0.27,  -7.17,   6.08   ),
+    array( 8.23,   1.08,   9.04,   2.14,  -6.87   ),
+);
+
+$b = array(
+   array(  4.02,  -1.56,   9.81   ),
+   array(  6.19,   4.00,  -4.09   ),
+   array( -8.22,  -8.67,  -4.57   ),
+   array( -7.57,   1.75,  -8.61   ),
+   array( -3.03,   2.86,   8.99   ),
+);
+
+$expected = roundAll(Lapack::solveLinearEquation($a, $b));
+
+$lu = Lapack::luFactor($a);
+$qr = Lapack::qrFactor($a);
+echo get_class($lu), " ", get_class($qr), "\n";
+var_dump(roundAll($lu->solve($b)) == $expected);
+var_dump(roundAll($qr->solve($b)) == $expected);
+var_dump($lu instanceof LapackFactorization);
+
+$magic = array(
+    array( 8, 1, 6 ),
+    array( 3, 5, 7 ),
+    array( 4, 9, 2 ),
+);
+echo round(Lapack::luFactor($magic)->determinant(), 6), "\n";
+echo round(Lapack::qrFactor($magic)->determinant(), 6), "\n";
+var_dump(roundAll(Lapack::luFactor($magic)->inverse()) == roundAll(Lapack::inverse($magic)));
+
+$spd = array(
+    array( 4, 2 ),
+    array( 2, 3 ),
+);
+$ch = Lapack::choleskyFactor($spd);
+echo round($ch->determinant(), 6), "\n";
+var_dump(roundAll($ch->solve(array(array(2), array(5)))));
+var_dump(roundAll($ch->inverse()));
+
+// singular
+$lu = Lapack::luFactor(array(array(1, 2), array(2, 4)));
+var_dump($lu->determinant() == 0);
+var_dump($lu->solve(array(array(1), array(2))));
+
+try {
+    Lapack::choleskyFactor(array(array(1, 2), array(2, 1)));
+} catch(Lapackexception $e) {
+    echo $e->getMessage(), "\n";
+}
+?>
+--EXPECT--
+LapackLU LapackQR
+bool(true)
+bool(true)
+bool(true)
+-360
+-360
+bool(true)
+8
+array(2) {
+  [0]=>
+  array(1) {
+    [0]=>
+    float(-0.5)
+  }
+  [1]=>
+  array(1) {
+    [0]=>
+    float(2)
+  }
+}
+array(2) {
+  [0]=>
+  array(2) {
+    [0]=>
+    float(0.38)
+    [1]=>
+    float(-0.25)
+  }
+  [1]=>
+  array(2) {
+    [0]=>
+    float(-0.25)
+    [1]=>
+    float(0.5)
+  }
+}
+bool(true)
+array(0) {
+}
+Matrix is not positive definite
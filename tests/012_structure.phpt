@@ -0,0 +1,131 @@
+--TEST--
+Test structure-aware solving, inversion and eigenvalues
+--SKIPIF--
+<?php
+if (!extension_loaded('lapack')) die('skip');
+?>
+--FILE--
+<?php
+
+include __DIR__ . '/lapack_helpers.inc';
+
+function check($a, $b) {
+    $expected = roundAll(Lapack::solveLinearEquation($a, $b, Lapack::GENERAL));
+    var_dump(roundAll(Lapack::solveLinearEquation($a, $b)) == $expected);
+}
+
+$b = array(array(1), array(2), array(3));
+
+// positive definite, indefinite symmetric, upper and lower triangular
+$spd = array(array(4, 2, 0), array(2, 5, 1), array(0, 1, 3));
+$sym = array(array(1, 2, 3), array(2, -4, 5), array(3, 5, 6));
+$upper = array(array(2, 1, 4), array(0, 3, 5), array(0, 0, 6));
+$lower = array(array(2, 0, 0), array(1, 3, 0), array(4, 5, 6));
+check($spd, $b);
+check($sym, $b);
+check($upper, $b);
+check($lower, $b);
+
+// a positive diagonal does not make a symmetric matrix positive definite
+$notpd = array(array(1, 2), array(2, 1));
+var_dump(roundAll(Lapack::solveLinearEquation($notpd, array(array(3), array(3)), Lapack::POSITIVE_DEFINITE)));
+
+// tridiagonal systems, symmetric and not, go through the banded drivers
+$n = 16;
+$tri = $band = array();
+$rhs = array();
+for ($i = 0; $i < $n; $i++) {
+    $tri[$i] = $band[$i] = array_fill(0, $n, 0);
+    $tri[$i][$i] = 2;
+    $band[$i][$i] = 4;
+    if ($i > 0) {
+        $tri[$i][$i - 1] = -1;
+        $band[$i][$i - 1] = 1;
+    }
+    if ($i < $n - 1) {
+        $tri[$i][$i + 1] = -1;
+        $band[$i][$i + 1] = -2;
+    }
+    $rhs[$i] = array($i + 1);
+}
+check($tri, $rhs);
+check($band, $rhs);
+check(new LapackMatrix($tri), new LapackMatrix($rhs));
+
+// inverses
+var_dump(roundAll(Lapack::inverse($spd)) == roundAll(Lapack::inverse($spd, Lapack::GENERAL)));
+var_dump(roundAll(Lapack::inverse($sym)) == roundAll(Lapack::inverse($sym, Lapack::GENERAL)));
+var_dump(roundAll(Lapack::inverse($upper)) == roundAll(Lapack::inverse($upper, Lapack::GENERAL)));
+var_dump(roundAll(Lapack::inverse($notpd, Lapack::POSITIVE_DEFINITE)));
+
+// symmetric eigenvalues come back real and in ascending order
+$right = array();
+var_dump(roundAll(Lapack::eigenValues(array(array(2, 1), array(1, 2)), null, $right)));
+$right = roundAll($right['real']);
+var_dump(abs($right[0][0]) == 0.71 && abs($right[1][1]) == 0.71);
+
+try {
+    Lapack::solveLinearEquation(array(array(1, 2, 3)), array(array(1)));
+} catch(Lapackexception $e) {
+    echo $e->getMessage(), "\n";
+}
+try {
+    Lapack::solveLinearEquation($spd, array(array(1)));
+} catch(Lapackexception $e) {
+    echo $e->getMessage(), "\n";
+}
+?>
+--EXPECT--
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+array(2) {
+  [0]=>
+  array(1) {
+    [0]=>
+    float(1)
+  }
+  [1]=>
+  array(1) {
+    [0]=>
+    float(1)
+  }
+}
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+array(2) {
+  [0]=>
+  array(2) {
+    [0]=>
+    float(-0.33)
+    [1]=>
+    float(0.67)
+  }
+  [1]=>
+  array(2) {
+    [0]=>
+    float(0.67)
+    [1]=>
+    float(-0.33)
+  }
+}
+array(2) {
+  [0]=>
+  array(1) {
+    [0]=>
+    float(1)
+  }
+  [1]=>
+  array(1) {
+    [0]=>
+    float(3)
+  }
+}
+bool(true)
+Matrix must be square
+Invalid input matrix - argument 2
@@ -0,0 +1,125 @@
+--TEST--
+Test single precision mode against the double precision results
+--SKIPIF--
+<?php
+if (!extension_loaded('lapack')) die('skip');
+?>
+--FILE--
+<?php
+
+function toArray($m) {
+    return $m instanceof LapackMatrix ? $m->toArray() : $m;
+}
+
+function close($x, $y) {
+    $x = toArray($x);
+    $y = toArray($y);
+    if (count($x) != count($y)) {
+        return false;
+    }
+    foreach ($x as $i => $row) {
+        if (count($row) != count($y[$i])) {
+            return false;
+        }
+        foreach ($row as $j => $v) {
+            if (abs($v - $y[$i][$j]) > 1e-3 * max(1, abs($y[$i][$j]))) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+function compare($name, $args) {
+    ini_set('lapack.precision', 'double');
+    $expected = call_user_func_array(array('Lapack', $name), $args);
+    ini_set('lapack.precision', 'single');
+    $result = call_user_func_array(array('Lapack', $name), $args);
+    ini_set('lapack.precision', 'double');
+    echo $name, ": ";
+    var_dump(close($result, $expected));
+    return $result;
+}
+
+$a = array(
+    array( 1.44,  -7.84,  -4.39,   4.53),
+    array(-9.96,  -0.28,  -3.24,   3.83),
+    array(-7.55,   3.24,   6.27,  -6.64),
+    array( 8.34,   8.09,   5.28,   2.06),
+    array( 7.08,   2.52,   0.74,  -2.47),
+    array(-5.45,  -5.70,  -1.19,   4.70),
+);
+$b = array(
+    array( 8.58,   9.35),
+    array( 8.26,  -4.43),
+    array( 8.48,  -0.70),
+    array(-5.28,  -0.26),
+    array( 5.72,  -7.36),
+    array( 8.93,  -2.52),
+);
+$sq = array_slice($a, 0, 4);
+$sqb = array_slice($b, 0, 4);
+$spd = array(array(4, 2, 0), array(2, 5, 1), array(0, 1, 3));
+
+compare('leastSquaresByFactorisation', array($a, $b));
+compare('leastSquaresBySVD', array($a, $b));
+// one equation in two unknowns, so the solution has more rows than B
+compare('leastSquaresByFactorisation', array(array(array(1, 1)), array(array(2, 4))));
+compare('leastSquaresBySVD', array(array(array(1, 1)), array(array(2, 4))));
+ini_set('lapack.precision', 'single');
+try {
+    Lapack::leastSquaresBySVD(array(array(1, 2), array(3, 4)), array(array(1), array(2), array(3)));
+} catch (Lapackexception $e) {
+    echo $e->getMessage(), "\n";
+}
+ini_set('lapack.precision', 'double');
+compare('singularValues', array($a));
+compare('solveLinearEquation', array($sq, $sqb));
+compare('solveLinearEquation', array($spd, array(array(1), array(2), array(3))));
+$m = compare('solveLinearEquation', array(new LapackMatrix($sq), $sqb));
+echo get_class($m), "\n";
+compare('eigenValues', array($spd));
+compare('shapeRegressionModel', array(
+    array(array(1, 2), array(2, 1), array(3, 5), array(4, 3), array(5, 8)),
+    array(array(1, 0, 2), array(0, 1, 1), array(2, 1, 0), array(1, 1, 1)),
+    array(array(0.5, 1, 2), array(1, 0.5, 1), array(2, 2, 0.5), array(1, 3, 2), array(0, 1, 1)),
+));
+
+// eigenvalues of a general matrix, compared in sorted order
+$g = array(
+    array(-1.01,   0.86,  -4.60,  3.31,  -4.81  ),
+    array( 3.98,   0.53,  -7.04,  5.29,   3.55  ),
+    array( 3.30,   8.26,  -3.89,  8.20,  -1.51  ),
+    array( 4.43,   4.96,  -7.66, -7.33,   6.18  ),
+    array( 7.31,  -6.43,  -6.16,  2.47,   5.58  ),
+);
+$expected = Lapack::eigenValues($g);
+ini_set('lapack.precision', 'single');
+$result = Lapack::eigenValues($g);
+ini_set('lapack.precision', 'double');
+$sort = function($x, $y) {
+    return $x[0] == $y[0] ? (isset($x[1]) ? $x[1] : 0) <=> (isset($y[1]) ? $y[1] : 0) : $x[0] <=> $y[0];
+};
+usort($expected, $sort);
+usort($result, $sort);
+var_dump(close($result, $expected));
+
+var_dump(ini_set('lapack.precision', 'quad'));
+echo ini_get('lapack.precision'), "\n";
+?>
+--EXPECT--
+leastSquaresByFactorisation: bool(true)
+leastSquaresBySVD: bool(true)
+leastSquaresByFactorisation: bool(true)
+leastSquaresBySVD: bool(true)
+Invalid input matrix - argument 2
+singularValues: bool(true)
+solveLinearEquation: bool(true)
+solveLinearEquation: bool(true)
+solveLinearEquation: bool(true)
+LapackMatrix
+eigenValues: bool(true)
+shapeRegressionModel: bool(true)
+bool(true)
+bool(false)
+double
@@ -0,0 +1,61 @@
+--TEST--
+Test workspace reuse across calls and shapes, and that failed calls do not leak
+--SKIPIF--
+<?php
+if (!extension_loaded('lapack')) die('skip');
+?>
+--FILE--
+<?php
+
+include __DIR__ . '/lapack_helpers.inc';
+
+// Alternate between shapes so the arena grows, shrinks back into use and the
+// cached workspace sizes are looked up for several shapes
+$first = array();
+$same = true;
+for ($round = 0; $round < 3; $round++) {
+    foreach (array(3, 12, 5, 40) as $n) {
+        $a = matrix($n + 2, $n, $n, $n);
+        $b = matrix($n + 2, 2, $n + 1, 2);
+        $r = array(
+            Lapack::leastSquaresByFactorisation($a, $b),
+            Lapack::leastSquaresBySVD($a, $b),
+            Lapack::singularValues($a),
+            Lapack::eigenValues(matrix($n, $n, $n, $n)),
+            Lapack::inverse(matrix($n, $n, $n + 3, $n), Lapack::SYMMETRIC),
+            Lapack::qrFactor($a)->solve($b),
+        );
+        if ($round == 0) {
+            $first[$n] = $r;
+        } else if ($r != $first[$n]) {
+            $same = false;
+        }
+    }
+}
+var_dump($same);
+
+// Calls that throw part way through must not leak their buffers
+$w = matrix(4, 3, 1, 3);
+$m = matrix(5, 2, 2, 2);
+$p = matrix(6, 3, 3, 3);
+$before = 0;
+for ($i = 0; $i < 2000; $i++) {
+    try {
+        Lapack::shapeRegressionModel($m, $p, $w);
+    } catch (Lapackexception $e) {
+    }
+    try {
+        Lapack::solveLinearEquation($p, $m);
+    } catch (Lapackexception $e) {
+    }
+    if ($i == 100) {
+        $before = memory_get_usage();
+    }
+}
+var_dump(memory_get_usage() - $before < 4096);
+echo $e->getMessage(), "\n";
+?>
+--EXPECT--
+bool(true)
+bool(true)
+Matrix must be square
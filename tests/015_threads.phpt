@@ -0,0 +1,50 @@
+--TEST--
+Test BLAS thread count settings
+--SKIPIF--
+<?php
+if (!extension_loaded('lapack')) die('skip');
+?>
+--FILE--
+<?php
+
+echo ini_get('lapack.max_threads'), " ", ini_get('lapack.parallel_threshold'), "\n";
+
+$a = array();
+for ($i = 0; $i < 60; $i++) {
+    for ($j = 0; $j < 60; $j++) {
+        $a[$i][$j] = cos($i * 5 + $j) + ($i == $j ? 60 : 0);
+    }
+}
+$b = array_slice($a, 0, 60);
+
+$expected = Lapack::solveLinearEquation($a, $b);
+
+var_dump(Lapack::setThreads(2));
+echo ini_get('lapack.max_threads'), "\n";
+
+// Everything above the threshold, on two threads
+ini_set('lapack.parallel_threshold', 0);
+$x = Lapack::solveLinearEquation($a, $b);
+$diff = 0;
+foreach ($x as $i => $row) {
+    foreach ($row as $j => $v) {
+        $diff = max($diff, abs($v - $expected[$i][$j]));
+    }
+}
+var_dump($diff < 1e-10);
+
+var_dump(Lapack::setThreads(0));
+
+try {
+    Lapack::setThreads(-1);
+} catch (Lapackexception $e) {
+    echo $e->getMessage(), "\n";
+}
+?>
+--EXPECT--
+0 1000000
+int(0)
+2
+bool(true)
+int(2)
+Invalid thread count - must be 0 or greater
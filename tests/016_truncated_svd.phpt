@@ -0,0 +1,87 @@
+--TEST--
+Calculate the largest singular values and vectors of a matrix
+--SKIPIF--
+<?php
+if (!extension_loaded('lapack')) die('skip');
+?>
+--FILE--
+<?php
+
+include __DIR__ . '/lapack_helpers.inc';
+
+$a = array(
+    array( 7.52,  -1.10,  -7.95,  1.08  ),
+    array(-0.76,   0.62,   9.34, -7.10  ),
+    array( 5.13,   6.62,  -5.66,  0.87  ),
+    array(-4.75,   8.52,   5.75,  5.30  ),
+    array( 1.33,   4.91,  -5.49, -3.52  ),
+    array(-2.40,  -6.77,   2.34,  3.95  ),
+);
+
+// values only
+var_dump(roundAll(Lapack::truncatedSVD($a, 2)));
+var_dump(roundAll(Lapack::truncatedSVD($a, 2, Lapack::SVD_RANDOMIZED)));
+
+// with vectors, A . v = s . u for each pair
+foreach (array(Lapack::SVD_EXACT, Lapack::SVD_RANDOMIZED) as $method) {
+    $u = array();
+    $v = array();
+    $s = Lapack::truncatedSVD($a, 3, $method, $u, $v);
+    echo count($u), "x", count($u[0]), " ", count($v), "x", count($v[0]), "\n";
+
+    $err = 0;
+    for ($c = 0; $c < 3; $c++) {
+        for ($i = 0; $i < 6; $i++) {
+            $av = 0;
+            for ($j = 0; $j < 4; $j++) {
+                $av += $a[$i][$j] * $v[$j][$c];
+            }
+            $err = max($err, abs($av - $s[0][$c] * $u[$i][$c]));
+        }
+    }
+    var_dump($err < 1e-8);
+}
+
+$m = new LapackMatrix($a);
+$u = array();
+$s = Lapack::truncatedSVD($m, 1, Lapack::SVD_RANDOMIZED, $u);
+echo get_class($s), " ", get_class($u), " ", $u->rows(), "x", $u->columns(), "\n";
+
+try {
+    Lapack::truncatedSVD($a, 5);
+} catch (Lapackexception $e) {
+    echo $e->getMessage(), "\n";
+}
+
+try {
+    Lapack::truncatedSVD($a, 2, 99);
+} catch (Lapackexception $e) {
+    echo $e->getMessage(), "\n";
+}
+?>
+--EXPECT--
+array(1) {
+  [0]=>
+  array(2) {
+    [0]=>
+    float(18.37)
+    [1]=>
+    float(13.63)
+  }
+}
+array(1) {
+  [0]=>
+  array(2) {
+    [0]=>
+    float(18.37)
+    [1]=>
+    float(13.63)
+  }
+}
+6x3 4x3
+bool(true)
+6x3 4x3
+bool(true)
+LapackMatrix LapackMatrix 6x1
+Invalid number of singular values - must be between 1 and the smaller dimension of A
+Invalid method - must be Lapack::SVD_EXACT or Lapack::SVD_RANDOMIZED
@@ -0,0 +1,77 @@
+--TEST--
+Calculate selected eigenvalues and eigenvectors of a symmetric matrix
+--SKIPIF--
+<?php
+if (!extension_loaded('lapack')) die('skip');
+?>
+--FILE--
+<?php
+
+include __DIR__ . '/lapack_helpers.inc';
+
+// eigenvalues 2 - 2cos(k pi / 5): 0.38, 1.38, 2.62, 3.62
+$a = array(
+    array( 2, -1,  0,  0),
+    array(-1,  2, -1,  0),
+    array( 0, -1,  2, -1),
+    array( 0,  0, -1,  2),
+);
+
+// largest |A v - lambda v| over the returned pairs
+function residual($a, $w, $v) {
+    $err = 0;
+    foreach ($w[0] as $c => $lambda) {
+        foreach ($a as $i => $row) {
+            $av = 0;
+            foreach ($row as $j => $x) {
+                $av += $x * $v[$j][$c];
+            }
+            $err = max($err, abs($av - $lambda * $v[$i][$c]));
+        }
+    }
+    return $err;
+}
+
+echo json_encode(roundAll(Lapack::topEigen($a, 2))), "\n";
+echo json_encode(roundAll(Lapack::eigenRange($a, 1, 3))), "\n";
+var_dump(Lapack::eigenRange($a, 10, 20));
+
+$v = array();
+$w = Lapack::topEigen($a, 3, $v);
+echo count($v), "x", count($v[0]), "\n";
+var_dump(residual($a, $w, $v) < 1e-10);
+
+$v = array();
+$w = Lapack::eigenRange($a, 0, 2, $v);
+echo count($v), "x", count($v[0]), "\n";
+var_dump(residual($a, $w, $v) < 1e-10);
+
+// eigenvectors of a LapackMatrix come back as LapackMatrix objects
+$right = array();
+Lapack::eigenValues(new LapackMatrix($a), null, $right);
+echo get_class($right['real']), " ", get_class($right['imag']), "\n";
+
+try {
+    Lapack::topEigen($a, 5);
+} catch (Lapackexception $e) {
+    echo $e->getMessage(), "\n";
+}
+
+try {
+    Lapack::eigenRange($a, 3, 1);
+} catch (Lapackexception $e) {
+    echo $e->getMessage(), "\n";
+}
+?>
+--EXPECT--
+[[3.62,2.62]]
+[[1.38,2.62]]
+array(0) {
+}
+4x3
+bool(true)
+4x2
+bool(true)
+LapackMatrix LapackMatrix
+Invalid number of eigenvalues - must be between 1 and the size of A
+Invalid range - lo must be less than hi
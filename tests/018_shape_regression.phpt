@@ -0,0 +1,51 @@
+--TEST--
+Shape regression model over many vertices
+--SKIPIF--
+<?php
+if (!extension_loaded('lapack')) die('skip');
+?>
+--FILE--
+<?php
+
+include __DIR__ . '/lapack_helpers.inc';
+
+// R = P . G, and with P the identity the model is G itself, so every row
+// of a large R must be its row of P times G, whichever block it fell in
+function check($ns, $nf, $np, $nc) {
+    $M = matrix($ns, $nf, 1);
+    $W = matrix($ns, $np, 2);
+    $P = matrix($nc, $np, 3);
+
+    $G = Lapack::shapeRegressionModel($M, Lapack::identity($np), $W);
+    $R = Lapack::shapeRegressionModel($M, $P, $W);
+    $RM = Lapack::shapeRegressionModel($M, new LapackMatrix($P), $W);
+
+    $err = 0;
+    $rm = $RM->toArray();
+    foreach ($P as $i => $p) {
+        for ($j = 0; $j <= $nf; $j++) {
+            $x = 0;
+            foreach ($p as $k => $v) {
+                $x += $v * $G[$k][$j];
+            }
+            $err = max($err, abs($x - $R[$i][$j]), abs($rm[$i][$j] - $R[$i][$j]));
+        }
+    }
+    echo count($R), "x", count($R[0]), " ", get_class($RM), " ";
+    var_dump($err < 1e-8);
+}
+
+check(30, 4, 6, 2500);
+// few subjects and many components, and fewer subjects than features
+check(6, 9, 20, 1500);
+
+try {
+    Lapack::shapeRegressionModel(matrix(5, 2, 1), array(array(1, 2), array(3)), matrix(5, 2, 2));
+} catch (Lapackexception $e) {
+    echo $e->getMessage(), "\n";
+}
+?>
+--EXPECT--
+2500x5 LapackMatrix bool(true)
+1500x10 LapackMatrix bool(true)
+Invalid input matrix - argument 2 (P)
@@ -0,0 +1,77 @@
+--TEST--
+Shape model objects with batched predict and refit
+--SKIPIF--
+<?php
+if (!extension_loaded('lapack')) die('skip');
+?>
+--FILE--
+<?php
+
+include __DIR__ . '/lapack_helpers.inc';
+
+$M = matrix(12, 3, 1);
+$W = matrix(12, 5, 2);
+$P = matrix(30, 5, 3);
+$X = matrix(4, 3, 4);
+
+$model = Lapack::shapeModel($M, $P, $W);
+echo get_class($model), "\n";
+$R = Lapack::shapeRegressionModel($M, $P, $W);
+var_dump(diff($model->matrix(), $R) < 1e-10);
+
+// each prediction is R . [x, 1]
+$Y = $model->predict($X);
+echo count($Y), "x", count($Y[0]), "\n";
+$expect = array();
+foreach ($X as $k => $x) {
+    $x[] = 1;
+    foreach ($R as $i => $r) {
+        $v = 0;
+        foreach ($r as $j => $c) {
+            $v += $c * $x[$j];
+        }
+        $expect[$k][$i] = $v;
+    }
+}
+var_dump(diff($Y, $expect) < 1e-10);
+
+$packed = $model->predict($X, true);
+echo count($packed), " ", strlen($packed[0]), "\n";
+$err = 0;
+foreach ($packed as $k => $s) {
+    $f = array_values(unpack('g*', $s));
+    foreach ($f as $i => $v) {
+        $err = max($err, abs($v - $expect[$k][$i]));
+    }
+}
+var_dump($err < 1e-5);
+
+$P2 = matrix(9, 5, 5);
+var_dump(diff($model->refit($P2)->matrix(), Lapack::shapeRegressionModel($M, $P2, $W)) < 1e-10);
+$W2 = matrix(12, 2, 6);
+$P3 = matrix(9, 2, 7);
+var_dump(diff($model->refit($P3, $W2)->matrix(), Lapack::shapeRegressionModel($M, $P3, $W2)) < 1e-10);
+
+$small = Lapack::shapeModel($M, $P, $W, false);
+try {
+    $small->refit($P3, $W2);
+} catch (Lapackexception $e) {
+    echo $e->getMessage(), "\n";
+}
+try {
+    $model->predict(matrix(2, 4, 1));
+} catch (Lapackexception $e) {
+    echo $e->getMessage(), "\n";
+}
+?>
+--EXPECT--
+LapackShapeModel
+bool(true)
+4x30
+bool(true)
+4 120
+bool(true)
+bool(true)
+bool(true)
+Model was fitted without keeping its factors
+Invalid input matrix - argument 1, wrong number of measurements
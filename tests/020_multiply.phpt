@@ -0,0 +1,85 @@
+--TEST--
+Matrix multiplication and chains
+--SKIPIF--
+<?php
+if (!extension_loaded('lapack')) die('skip');
+?>
+--FILE--
+<?php
+
+include __DIR__ . '/lapack_helpers.inc';
+
+function t($a) {
+    $t = array();
+    foreach ($a as $i => $row) {
+        foreach ($row as $j => $v) {
+            $t[$j][$i] = $v;
+        }
+    }
+    return $t;
+}
+
+function mul($a, $b) {
+    $c = array();
+    foreach ($a as $i => $row) {
+        for ($j = 0; $j < count($b[0]); $j++) {
+            $c[$i][$j] = 0;
+            foreach ($row as $k => $v) {
+                $c[$i][$j] += $v * $b[$k][$j];
+            }
+        }
+    }
+    return $c;
+}
+
+$a = matrix(4, 3, 1);
+$b = matrix(3, 5, 2);
+$c = matrix(4, 5, 3);
+
+var_dump(diff(Lapack::multiply($a, $b), mul($a, $b)) < 1e-12);
+var_dump(diff(Lapack::multiply(t($a), $b, true), mul($a, $b)) < 1e-12);
+var_dump(diff(Lapack::multiply($a, t($b), false, true), mul($a, $b)) < 1e-12);
+
+// 2 . A . B + 0.5 . C
+$expect = mul($a, $b);
+foreach ($expect as $i => $row) {
+    foreach ($row as $j => $v) {
+        $expect[$i][$j] = 2 * $v + 0.5 * $c[$i][$j];
+    }
+}
+$r = Lapack::multiply(new LapackMatrix($a), $b, false, false, 2.0, 0.5, $c);
+echo get_class($r), "\n";
+var_dump(diff($r->toArray(), $expect) < 1e-12);
+
+// a chain where left to right is far from the cheapest order
+$x = matrix(30, 2, 4);
+$y = matrix(2, 40, 5);
+$z = matrix(40, 3, 6);
+$w = matrix(3, 30, 7);
+$expect = mul(mul(mul($x, $y), $z), $w);
+var_dump(diff(Lapack::multiplyChain(array($x, $y, $z, $w)), $expect) < 1e-10);
+var_dump(diff(Lapack::multiplyChain(array($x, t($y), $z, new LapackMatrix(t($w))), array(false, true, false, true))->toArray(), $expect) < 1e-10);
+var_dump(diff(Lapack::multiplyChain(array(t($x)), array(true)), $x) < 1e-15);
+
+try {
+    Lapack::multiply($a, $c);
+} catch (Lapackexception $e) {
+    echo $e->getMessage(), "\n";
+}
+try {
+    Lapack::multiplyChain(array($x, $z));
+} catch (Lapackexception $e) {
+    echo $e->getMessage(), "\n";
+}
+?>
+--EXPECT--
+bool(true)
+bool(true)
+bool(true)
+LapackMatrix
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+Invalid input matrix - argument 2, wrong number of rows
+Invalid input matrix - argument 1, matrices do not chain
@@ -0,0 +1,82 @@
+--TEST--
+Loading and saving .npy matrix files
+--SKIPIF--
+<?php
+if (!extension_loaded('lapack')) die('skip');
+if (pack('S', 1) !== "\x01\x00") die('skip little endian only');
+?>
+--FILE--
+<?php
+
+function npy($header, $data) {
+    $header .= str_repeat(' ', 63 - (10 + strlen($header)) % 64) . "\n";
+    return "\x93NUMPY\x01\x00" . pack('v', strlen($header)) . $header . $data;
+}
+
+$dir = sys_get_temp_dir();
+$a = array(array(1.5, 2, 3), array(4, 5, -6.25));
+
+Lapack::save("$dir/lapack_021.npy", $a);
+$data = file_get_contents("$dir/lapack_021.npy");
+echo substr($data, 10, 58), "\n";
+var_dump(strlen($data) % 64 == 48, substr($data, 128) === pack('d*', 1.5, 4, 2, 5, 3, -6.25));
+
+$m = Lapack::load("$dir/lapack_021.npy");
+echo get_class($m), " ", $m->rows(), "x", $m->columns(), "\n";
+var_dump($m->toArray() == $a);
+var_dump(Lapack::multiply($m, $a, false, true)->toArray() == Lapack::multiply($a, $a, false, true));
+
+Lapack::save("$dir/lapack_021.npy", new LapackMatrix($a), true);
+var_dump(Lapack::load("$dir/lapack_021.npy")->toArray() == $a);
+
+// row-major float32 as NumPy writes by default
+file_put_contents("$dir/lapack_021.npy", npy("{'descr': '<f4', 'fortran_order': False, 'shape': (2, 3), }", pack('g*', 1.5, 2, 3, 4, 5, -6.25)));
+var_dump(Lapack::load("$dir/lapack_021.npy")->toArray() == $a);
+
+file_put_contents("$dir/lapack_021.npy", npy("{'descr': '<f8', 'fortran_order': False, 'shape': (3,), }", pack('d*', 1, 2, 3)));
+var_dump(Lapack::load("$dir/lapack_021.npy")->toArray());
+
+file_put_contents("$dir/lapack_021.npy", npy("{'descr': '<i8', 'fortran_order': False, 'shape': (3,), }", pack('q*', 1, 2, 3)));
+try {
+    Lapack::load("$dir/lapack_021.npy");
+} catch (Lapackexception $e) {
+    echo $e->getCode(), "\n";
+}
+
+file_put_contents("$dir/lapack_021.npy", npy("{'descr': '<f8', 'fortran_order': True, 'shape': (3, 3), }", pack('d*', 1, 2, 3)));
+try {
+    Lapack::load("$dir/lapack_021.npy");
+} catch (Lapackexception $e) {
+    echo $e->getMessage(), "\n";
+}
+unlink("$dir/lapack_021.npy");
+
+try {
+    Lapack::load("$dir/lapack_021.npy");
+} catch (Lapackexception $e) {
+    echo $e->getMessage(), "\n";
+}
+?>
+--EXPECT--
+{'descr': '<f8', 'fortran_order': True, 'shape': (2, 3), }
+bool(true)
+bool(true)
+LapackMatrix 2x3
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+array(1) {
+  [0]=>
+  array(3) {
+    [0]=>
+    float(1)
+    [1]=>
+    float(2)
+    [2]=>
+    float(3)
+  }
+}
+106
+Invalid matrix file - shorter than its header says
+Unable to open matrix file
@@ -0,0 +1,75 @@
+--TEST--
+Streaming least squares over chunks of rows
+--SKIPIF--
+<?php
+if (!extension_loaded('lapack')) die('skip');
+?>
+--FILE--
+<?php
+
+include __DIR__ . '/lapack_helpers.inc';
+
+$a = matrix(50, 4, 1);
+$b = matrix(50, 2, 2);
+
+$ls = Lapack::leastSquaresStream(4);
+echo get_class($ls), " ", count($ls->solve()), "\n";
+echo $ls->addRows(array_slice($a, 0, 3), array_slice($b, 0, 3)), " ";
+echo $ls->addRows(new LapackMatrix(array_slice($a, 3, 30)), array_slice($b, 3, 30)), " ";
+echo $ls->addRows(array_slice($a, 33), array_slice($b, 33)), "\n";
+$x = $ls->solve();
+echo get_class($x), "\n";
+var_dump(diff($x->toArray(), Lapack::leastSquaresByFactorisation($a, $b)) < 1e-10);
+
+// ridge is least squares with sqrt(ridge) . I appended to A and zeros to B
+$ridge = 0.5;
+$ls = Lapack::leastSquaresStream(4, $ridge);
+$ls->addRows(array_slice($a, 0, 20), array_slice($b, 0, 20));
+$ls->addRows(array_slice($a, 20), array_slice($b, 20));
+$ra = $a;
+$rb = $b;
+for ($i = 0; $i < 4; $i++) {
+    $ra[] = array_fill(0, 4, 0.0);
+    $ra[count($ra) - 1][$i] = sqrt($ridge);
+    $rb[] = array(0.0, 0.0);
+}
+var_dump(diff($ls->solve(), Lapack::leastSquaresByFactorisation($ra, $rb)) < 1e-10);
+
+// forgetting weights row i of N by sqrt(f^(N - 1 - i))
+$f = 0.9;
+$ls = Lapack::leastSquaresStream(4, 0.0, $f);
+$ls->addRows(array_slice($a, 0, 7), array_slice($b, 0, 7));
+$ls->addRows(array_slice($a, 7), array_slice($b, 7));
+$wa = $a;
+$wb = $b;
+foreach ($wa as $i => $row) {
+    $w = sqrt(pow($f, 49 - $i));
+    foreach ($row as $j => $v) {
+        $wa[$i][$j] = $v * $w;
+    }
+    foreach ($wb[$i] as $j => $v) {
+        $wb[$i][$j] = $v * $w;
+    }
+}
+var_dump(diff($ls->solve(), Lapack::leastSquaresByFactorisation($wa, $wb)) < 1e-8);
+
+try {
+    $ls->addRows(matrix(2, 4, 1), matrix(2, 3, 1));
+} catch (Lapackexception $e) {
+    echo $e->getMessage(), "\n";
+}
+try {
+    Lapack::leastSquaresStream(3, 0.0, 1.5);
+} catch (Lapackexception $e) {
+    echo $e->getMessage(), "\n";
+}
+?>
+--EXPECT--
+LapackLeastSquares 0
+3 33 50
+LapackMatrix
+bool(true)
+bool(true)
+bool(true)
+Invalid input matrix - argument 2, wrong number of columns
+Invalid forgetting factor - must be greater than 0 and at most 1
@@ -0,0 +1,90 @@
+--TEST--
+Call statistics
+--SKIPIF--
+<?php
+if (!extension_loaded('lapack')) die('skip');
+?>
+--INI--
+lapack.trace_threshold=0
+--FILE--
+<?php
+
+Lapack::resetStats();
+
+$a = array(
+    array(4.0, 1.0),
+    array(1.0, 3.0),
+);
+$b = array(array(1.0), array(2.0));
+$singular = array(
+    array(1.0, 2.0),
+    array(3.0, 6.0),
+);
+
+Lapack::solveLinearEquation($a, $b);
+Lapack::solveLinearEquation($a, $b);
+var_dump(Lapack::solveLinearEquation($singular, $b));
+$lu = Lapack::luFactor($a);
+$lu->solve($b);
+
+$stats = Lapack::stats();
+var_dump(array_keys($stats));
+
+$solve = $stats['request']['Lapack::solveLinearEquation'];
+var_dump(array_keys($solve));
+var_dump($solve['calls'], $solve['info_nonzero']);
+var_dump($solve['bytes'] > 0, $solve['compute_ns'] >= 0);
+
+/* Inherited methods are counted under the class that defines them */
+var_dump($stats['request']['LapackFactorization::solve']['calls']);
+var_dump($stats['process']['Lapack::luFactor']['calls']);
+var_dump(isset($stats['request']['Lapack::eigenValues']));
+
+Lapack::resetStats();
+var_dump(Lapack::stats());
+
+?>
+--EXPECT--
+array(0) {
+}
+array(2) {
+  [0]=>
+  string(7) "request"
+  [1]=>
+  string(7) "process"
+}
+array(9) {
+  [0]=>
+  string(5) "calls"
+  [1]=>
+  string(10) "convert_ns"
+  [2]=>
+  string(10) "compute_ns"
+  [3]=>
+  string(11) "assemble_ns"
+  [4]=>
+  string(5) "bytes"
+  [5]=>
+  string(14) "workspace_peak"
+  [6]=>
+  string(12) "info_nonzero"
+  [7]=>
+  string(21) "refinement_iterations"
+  [8]=>
+  string(20) "refinement_fallbacks"
+}
+int(3)
+int(1)
+bool(true)
+bool(true)
+int(1)
+int(1)
+bool(false)
+array(2) {
+  ["request"]=>
+  array(0) {
+  }
+  ["process"]=>
+  array(0) {
+  }
+}
@@ -0,0 +1,100 @@
+--TEST--
+Asynchronous calls with LapackFuture
+--SKIPIF--
+<?php
+if (!extension_loaded('lapack')) die('skip');
+?>
+--FILE--
+<?php
+
+include __DIR__ . '/lapack_helpers.inc';
+
+$a = array(
+    array(4.0, 1.0, 0.5),
+    array(1.0, 3.0, 0.2),
+    array(0.5, 0.2, 2.0),
+    array(1.0, 1.0, 1.0),
+);
+$b = array(array(1.0), array(2.0), array(3.0), array(4.0));
+$square = array_slice($a, 0, 3);
+$bs = array_slice($b, 0, 3);
+
+$futures = array(
+    'solve' => Lapack::async('solveLinearEquation', $square, $bs),
+    'qr' => Lapack::async('leastSquaresByFactorisation', $a, $b),
+    'svd' => Lapack::async('leastSquaresBySVD', $a, $b),
+    'values' => Lapack::async('singularValues', $a),
+);
+var_dump(get_class($futures['qr']));
+
+var_dump(diff($futures['solve']->wait(), Lapack::solveLinearEquation($square, $bs, Lapack::GENERAL)) < 1e-12);
+var_dump(diff($futures['qr']->wait(), Lapack::leastSquaresByFactorisation($a, $b)) < 1e-12);
+var_dump(diff($futures['svd']->wait(), Lapack::leastSquaresBySVD($a, $b)) < 1e-12);
+var_dump(diff($futures['values']->wait(), Lapack::singularValues($a)) < 1e-12);
+
+/* One equation in two unknowns, so the solution has more rows than B */
+$under = Lapack::async('leastSquaresBySVD', array(array(1.0, 1.0)), array(array(2.0, 4.0)));
+var_dump(diff($under->wait(), array(array(1.0, 2.0), array(1.0, 2.0))) < 1e-12);
+
+/* After wait() the future is ready, and keeps its result */
+var_dump($futures['svd']->isReady());
+var_dump($futures['svd']->wait() === $futures['svd']->wait());
+
+/* LapackMatrix operands give a LapackMatrix */
+$f = Lapack::async('singularValues', new LapackMatrix($a));
+while (!$f->isReady()) {
+    usleep(100);
+}
+var_dump(get_class($f->wait()));
+
+/* A singular system fails as the synchronous call does */
+var_dump(Lapack::async('solveLinearEquation', array(array(1.0, 2.0), array(2.0, 4.0)), array(array(1.0), array(1.0)))->wait());
+
+/* A future dropped unread is waited for */
+Lapack::async('singularValues', $a);
+
+try {
+    Lapack::async('eigenValues', $square);
+} catch (Lapackexception $e) {
+    var_dump($e->getCode());
+}
+try {
+    Lapack::async('solveLinearEquation', $a, $b);
+} catch (Lapackexception $e) {
+    echo $e->getMessage(), "\n";
+}
+try {
+    Lapack::async('leastSquaresBySVD', $a, $bs);
+} catch (Lapackexception $e) {
+    echo $e->getMessage(), "\n";
+}
+try {
+    Lapack::async('singularValues', $a, $b);
+} catch (Lapackexception $e) {
+    var_dump($e->getCode());
+}
+try {
+    $f = new LapackFuture();
+    $f->wait();
+} catch (Lapackexception $e) {
+    var_dump($e->getCode());
+}
+
+?>
+--EXPECT--
+string(12) "LapackFuture"
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+string(12) "LapackMatrix"
+array(0) {
+}
+int(102)
+Matrix must be square
+Invalid input matrix - argument 2
+int(102)
+int(104)
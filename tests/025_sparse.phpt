@@ -0,0 +1,163 @@
+--TEST--
+Sparse matrices and iterative solvers
+--SKIPIF--
+<?php
+if (!extension_loaded('lapack')) die('skip');
+?>
+--FILE--
+<?php
+
+include __DIR__ . '/lapack_helpers.inc';
+
+/* Triplets of an n x n tridiagonal matrix, with the given off diagonals */
+function tridiagonal($n, $lower, $upper) {
+    $r = $c = $v = array();
+    for ($i = 0; $i < $n; $i++) {
+        $r[] = $i; $c[] = $i; $v[] = 4.0;
+        if ($i > 0) {
+            $r[] = $i; $c[] = $i - 1; $v[] = $lower;
+        }
+        if ($i < $n - 1) {
+            $r[] = $i; $c[] = $i + 1; $v[] = $upper;
+        }
+    }
+    return LapackSparse::fromTriplets($n, $n, $r, $c, $v);
+}
+
+$n = 40;
+$b = array();
+for ($i = 0; $i < $n; $i++) {
+    $b[] = array(sin($i));
+}
+
+/* Building, with repeats added up */
+$s = LapackSparse::fromTriplets(2, 3, array(1, 0, 1, 1), array(2, 0, 2, 0), array(1.0, 2.0, 3.0, 5.0));
+var_dump($s->rows(), $s->columns(), $s->nonZeros());
+var_dump($s->toArray() == array(array(2.0, 0.0, 0.0), array(5.0, 0.0, 4.0)));
+var_dump($s->multiply(array(array(1.0), array(1.0), array(1.0))) == array(array(2.0), array(9.0)));
+var_dump($s->multiply(array(array(1.0), array(1.0)), true) == array(array(7.0), array(0.0), array(4.0)));
+
+/* Conjugate gradients on a positive definite system */
+$spd = tridiagonal($n, -1.0, -1.0);
+$dense = Lapack::solveLinearEquation($spd->toArray(), $b);
+$status = array();
+$x = Lapack::solveSparse($spd, $b, Lapack::AUTO, Lapack::PRECONDITION_NONE, 1e-12, 0, $status);
+var_dump($status['method'], $status['converged'], diff($x, $dense) < 1e-9);
+
+$x = Lapack::solveSparse($spd, $b, Lapack::POSITIVE_DEFINITE, Lapack::PRECONDITION_JACOBI, 1e-12, 0, $status);
+var_dump($status['converged'], diff($x, $dense) < 1e-9);
+
+/* ILU(0) of a tridiagonal matrix is its exact LU, so one step is enough */
+$x = Lapack::solveSparse($spd, $b, Lapack::AUTO, Lapack::PRECONDITION_ILU0, 1e-12, 0, $status);
+var_dump($status['iterations'], diff($x, $dense) < 1e-9);
+
+/* GMRES on a general system */
+$general = tridiagonal($n, -1.0, 0.5);
+$dense = Lapack::solveLinearEquation($general->toArray(), $b);
+foreach (array(Lapack::PRECONDITION_NONE, Lapack::PRECONDITION_JACOBI, Lapack::PRECONDITION_ILU0) as $p) {
+    $x = Lapack::solveSparse($general, $b, Lapack::AUTO, $p, 1e-12, 200, $status);
+    var_dump($status['method'], $status['converged'], diff($x, $dense) < 1e-9);
+}
+
+/* Running out of iterations still gives the last iterate */
+$x = Lapack::solveSparse($general, $b, Lapack::GENERAL, Lapack::PRECONDITION_NONE, 1e-12, 2, $status);
+var_dump($status['iterations'], $status['converged'], count($x));
+
+/* LSQR on an overdetermined system, against the dense solution */
+$r = $c = $v = array();
+$m = 60;
+$k = 10;
+for ($i = 0; $i < $m; $i++) {
+    for ($j = 0; $j < $k; $j++) {
+        if (($i + 2 * $j) % 3 == 0 || $i == $j) {
+            $r[] = $i; $c[] = $j; $v[] = cos($i * $k + $j) + ($i == $j ? 3.0 : 0.0);
+        }
+    }
+}
+$tall = LapackSparse::fromTriplets($m, $k, $r, $c, $v);
+$bt = array();
+for ($i = 0; $i < $m; $i++) {
+    $bt[] = array(cos($i), 1.0);
+}
+$dense = Lapack::leastSquaresByFactorisation($tall->toArray(), $bt);
+$x = Lapack::leastSquaresSparse($tall, $bt, Lapack::PRECONDITION_NONE, 1e-14, 100, $status);
+var_dump($status['method'], diff($x, $dense) < 1e-8);
+$x = Lapack::leastSquaresSparse($tall, new LapackMatrix($bt), Lapack::PRECONDITION_JACOBI, 1e-14, 100);
+var_dump(get_class($x), diff($x->toArray(), $dense) < 1e-8);
+
+/* ILU(0) with a zero pivot breaks down */
+$zero = LapackSparse::fromTriplets(2, 2, array(0, 1), array(1, 0), array(1.0, 1.0));
+var_dump(Lapack::solveSparse($zero, array(array(1.0), array(2.0)), Lapack::GENERAL, Lapack::PRECONDITION_ILU0, 1e-10, 0, $status), $status['converged']);
+
+try {
+    LapackSparse::fromTriplets(2, 2, array(0, 2), array(0, 0), array(1.0, 1.0));
+} catch (Lapackexception $e) {
+    echo $e->getMessage(), "\n";
+}
+try {
+    LapackSparse::fromTriplets(2, 2, array(0, 1), array(0), array(1.0, 1.0));
+} catch (Lapackexception $e) {
+    echo $e->getMessage(), "\n";
+}
+try {
+    Lapack::solveSparse($tall, $bt);
+} catch (Lapackexception $e) {
+    var_dump($e->getCode());
+}
+try {
+    Lapack::solveSparse($spd, array(array(1.0)));
+} catch (Lapackexception $e) {
+    echo $e->getMessage(), "\n";
+}
+try {
+    Lapack::leastSquaresSparse($tall, $bt, Lapack::PRECONDITION_ILU0);
+} catch (Lapackexception $e) {
+    var_dump($e->getCode());
+}
+try {
+    $e = new LapackSparse();
+    $e->rows();
+} catch (Lapackexception $e) {
+    var_dump($e->getCode());
+}
+
+?>
+--EXPECT--
+int(2)
+int(3)
+int(3)
+bool(true)
+bool(true)
+bool(true)
+string(2) "cg"
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+int(1)
+bool(true)
+string(5) "gmres"
+bool(true)
+bool(true)
+string(5) "gmres"
+bool(true)
+bool(true)
+string(5) "gmres"
+bool(true)
+bool(true)
+int(2)
+bool(false)
+int(40)
+string(4) "lsqr"
+bool(true)
+string(12) "LapackMatrix"
+bool(true)
+array(0) {
+}
+bool(false)
+Invalid triplets - coordinate out of range
+Invalid triplets - rows, columns and values must be the same length
+int(103)
+Invalid input matrix - argument 2
+int(102)
+int(104)
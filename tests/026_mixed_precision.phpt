@@ -0,0 +1,74 @@
+--TEST--
+Mixed precision solves against the double precision results
+--SKIPIF--
+<?php
+if (!extension_loaded('lapack')) die('skip');
+?>
+--FILE--
+<?php
+
+include __DIR__ . '/lapack_helpers.inc';
+
+$general = array();
+$spd = array();
+$hilbert = array();
+$b = array();
+for ($i = 0; $i < 20; $i++) {
+    for ($j = 0; $j < 20; $j++) {
+        $general[$i][$j] = sin($i * 7 + $j * 3) + ($i == $j ? 20 : 0);
+        $spd[$i][$j] = 1.0 / (1 + abs($i - $j)) + ($i == $j ? 20 : 0);
+    }
+    $b[$i] = array(cos($i), 1.0);
+}
+for ($i = 0; $i < 12; $i++) {
+    for ($j = 0; $j < 12; $j++) {
+        $hilbert[$i][$j] = 1.0 / ($i + $j + 1);
+    }
+}
+$singular = array(
+    array(1.0, 2.0),
+    array(3.0, 6.0),
+);
+
+$x = Lapack::solveLinearEquation($general, $b);
+$y = Lapack::solveLinearEquation($spd, $b);
+
+ini_set('lapack.precision', 'mixed');
+Lapack::resetStats();
+
+$iterations = null;
+var_dump(diff(Lapack::solveLinearEquation($general, $b, Lapack::AUTO, $iterations), $x) < 1e-12);
+var_dump($iterations >= 0);
+var_dump(diff(Lapack::solveLinearEquation($spd, $b, Lapack::AUTO, $iterations), $y) < 1e-12);
+var_dump($iterations >= 0);
+
+/* Refinement cannot converge on a badly conditioned matrix */
+Lapack::solveLinearEquation($hilbert, array_slice($b, 0, 12), Lapack::GENERAL, $iterations);
+var_dump($iterations < 0);
+
+var_dump(Lapack::solveLinearEquation($singular, array(array(1.0), array(2.0)), Lapack::AUTO, $iterations));
+var_dump($iterations < 0);
+
+/* Triangular systems do not use the mixed routines */
+Lapack::solveLinearEquation(array(array(2.0, 0.0), array(1.0, 1.0)), array(array(1.0), array(2.0)), Lapack::AUTO, $iterations);
+var_dump($iterations);
+
+$stats = Lapack::stats()['request']['Lapack::solveLinearEquation'];
+var_dump($stats['refinement_fallbacks']);
+
+ini_set('lapack.precision', 'double');
+Lapack::solveLinearEquation($general, $b, Lapack::AUTO, $iterations);
+var_dump($iterations);
+?>
+--EXPECT--
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+array(0) {
+}
+bool(true)
+int(0)
+int(2)
+int(0)
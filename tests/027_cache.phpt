@@ -0,0 +1,97 @@
+--TEST--
+Shared matrix cache
+--SKIPIF--
+<?php
+if (!extension_loaded('lapack')) die('skip');
+if (PHP_OS_FAMILY === 'Windows') die('skip needs anonymous shared mappings');
+?>
+--INI--
+lapack.cache_size=262144
+--FILE--
+<?php
+
+include __DIR__ . '/lapack_helpers.inc';
+
+var_dump(Lapack::cacheFetch('k0'));
+
+/* Three 100 x 100 matrices fill the cache */
+for ($k = 0; $k < 3; $k++) {
+    var_dump(Lapack::cacheStore("k$k", matrix(100, 100, $k)));
+}
+$m = Lapack::cacheFetch('k0');
+var_dump($m instanceof LapackMatrix, $m->rows(), $m->columns(), $m->toArray() == matrix(100, 100, 0));
+unset($m);
+
+/* k1 is now the least recently used */
+var_dump(Lapack::cacheStore('k3', new LapackMatrix(matrix(100, 100, 3))));
+var_dump(Lapack::cacheFetch('k1'));
+var_dump(Lapack::cacheFetch('k0') !== null);
+
+/* A fetched entry is neither evicted nor overwritten */
+$pin = Lapack::cacheFetch('k2');
+var_dump(Lapack::cacheStore('k4', matrix(100, 100, 4)));
+var_dump(Lapack::cacheStore('k2', matrix(100, 100, 5)));
+var_dump($pin->toArray() == matrix(100, 100, 2));
+var_dump(Lapack::cacheFetch('k2')->toArray() == matrix(100, 100, 5));
+unset($pin);
+
+/* Too large for the whole cache */
+var_dump(Lapack::cacheStore('big', matrix(200, 200, 6)));
+
+/* Factorisations come back ready to solve */
+$a = array(
+    array(4.0, 1.0, 2.0),
+    array(1.0, 5.0, 1.0),
+    array(2.0, 1.0, 6.0),
+);
+$b = array(array(1.0), array(2.0), array(3.0));
+foreach (array('luFactor', 'qrFactor', 'choleskyFactor') as $method) {
+    $f = Lapack::$method($a);
+    var_dump(Lapack::cacheStore($method, $f));
+    $cached = Lapack::cacheFetch($method);
+    var_dump(get_class($cached), $cached->solve($b) == $f->solve($b), $cached->determinant() == $f->determinant());
+}
+
+try {
+    Lapack::cacheStore('', $a);
+} catch (Lapackexception $e) {
+    echo $e->getMessage(), " ", $e->getCode(), "\n";
+}
+
+try {
+    Lapack::cacheStore('bad', 'not a matrix');
+} catch (Lapackexception $e) {
+    echo $e->getMessage(), " ", $e->getCode(), "\n";
+}
+?>
+--EXPECT--
+NULL
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+int(100)
+int(100)
+bool(true)
+bool(true)
+NULL
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+bool(false)
+bool(true)
+string(8) "LapackLU"
+bool(true)
+bool(true)
+bool(true)
+string(8) "LapackQR"
+bool(true)
+bool(true)
+bool(true)
+string(14) "LapackCholesky"
+bool(true)
+bool(true)
+Invalid key - must not be empty 102
+Invalid input matrix - argument 2 102
@@ -0,0 +1,72 @@
+--TEST--
+Array conversion across strips, mixed value types and non-list rows
+--SKIPIF--
+<?php
+if (!extension_loaded('lapack')) die('skip');
+?>
+--FILE--
+<?php
+
+$m = 75;
+$n = 41;
+$a = array();
+for ($i = 0; $i < $m; $i++) {
+    for ($j = 0; $j < $n; $j++) {
+        $a[$i][$j] = $i * 100.0 + $j;
+    }
+}
+$matrix = new LapackMatrix($a);
+var_dump($matrix->toArray() === $a);
+
+/* Ints and numeric strings among the floats */
+$b = $a;
+$b[3][5] = 305;
+$b[33][0] = "3300";
+$b[34][40] = true;
+$expected = $a;
+$expected[34][40] = 1.0;
+var_dump((new LapackMatrix($b))->toArray() === $expected);
+
+/* A row with string keys, and a row with holes, in the middle of a strip */
+$c = $a;
+$c[10] = array();
+for ($j = 0; $j < $n; $j++) {
+    $c[10]["k$j"] = 1000.0 + $j;
+}
+$row = $a[40];
+$row[] = 0.0;
+unset($row[3]);
+$c[40] = $row;
+$expected = $a;
+$expected[10] = array();
+for ($j = 0; $j < $n; $j++) {
+    $expected[10][$j] = 1000.0 + $j;
+}
+$expected[40] = array_values($row);
+var_dump((new LapackMatrix($c))->toArray() === $expected);
+
+/* References to rows and values */
+$d = $a;
+$r = &$d[50];
+$v = &$d[60][7];
+var_dump((new LapackMatrix($d))->toArray() === $a);
+
+/* A single column and a single row */
+$col = array();
+for ($i = 0; $i < $m; $i++) {
+    $col[] = array((float)$i);
+}
+var_dump((new LapackMatrix($col))->toArray() === $col);
+var_dump((new LapackMatrix(array($a[0])))->toArray() === array($a[0]));
+
+/* Results large enough to be reassembled in strips */
+var_dump(Lapack::multiply($a, Lapack::identity($n)) == $a);
+?>
+--EXPECT--
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+bool(true)
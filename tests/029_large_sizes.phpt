@@ -0,0 +1,65 @@
+--TEST--
+Sizes beyond the range of the LAPACK integer and of size_t products
+--SKIPIF--
+<?php
+if (!extension_loaded('lapack')) die('skip');
+?>
+--FILE--
+<?php
+
+var_dump(Lapack::identity(3));
+
+foreach (array(0, 2147483648, PHP_INT_MAX) as $size) {
+    try {
+        Lapack::identity($size);
+    } catch (Lapackexception $e) {
+        echo $e->getMessage(), " (", $e->getCode(), ")\n";
+    }
+}
+
+/* rows x columns x 8 does not fit in 64 bits */
+try {
+    LapackMatrix::fromString(str_repeat("\0", 16), 2147483647, 2147483647);
+} catch (Lapackexception $e) {
+    echo $e->getMessage(), "\n";
+}
+
+ob_start();
+phpinfo(INFO_MODULES);
+var_dump((bool)preg_match('/LAPACK integer width => (32|64)-bit/', ob_get_clean()));
+?>
+--EXPECT--
+array(3) {
+  [0]=>
+  array(3) {
+    [0]=>
+    float(1)
+    [1]=>
+    float(0)
+    [2]=>
+    float(0)
+  }
+  [1]=>
+  array(3) {
+    [0]=>
+    float(0)
+    [1]=>
+    float(1)
+    [2]=>
+    float(0)
+  }
+  [2]=>
+  array(3) {
+    [0]=>
+    float(0)
+    [1]=>
+    float(0)
+    [2]=>
+    float(1)
+  }
+}
+Invalid input size - must be between 1 and INT_MAX (102)
+Invalid input size - must be between 1 and INT_MAX (102)
+Invalid input size - must be between 1 and INT_MAX (102)
+Invalid input buffer - length does not match rows x columns doubles
+bool(true)
@@ -0,0 +1,115 @@
+--TEST--
+Moore-Penrose pseudoinverse and pinvSolve
+--SKIPIF--
+<?php
+if (!extension_loaded('lapack')) die('skip');
+?>
+--FILE--
+<?php
+
+/* Adding 0.0 turns -0 into 0 */
+function show($m) {
+    foreach ($m as $r) {
+        $out = array();
+        foreach ($r as $v) {
+            $out[] = round($v, 4) + 0.0;
+        }
+        echo implode(" ", $out), "\n";
+    }
+    echo "--\n";
+}
+
+/* Tall, full column rank: (A^T A)^-1 A^T */
+$tall = array(
+    array(1, 2),
+    array(3, 4),
+    array(5, 6),
+);
+show(Lapack::pseudoInverse($tall));
+
+/* Wide, the transpose of the above */
+show(Lapack::pseudoInverse(array(array(1, 3, 5), array(2, 4, 6))));
+
+/* Rank one, A^T / 25 */
+show(Lapack::pseudoInverse(array(array(1, 2), array(2, 4))));
+
+/* Zero matrix */
+show(Lapack::pseudoInverse(array(array(0, 0, 0), array(0, 0, 0))));
+
+/* rcond drops the small singular value */
+$d = array(array(1, 0), array(0, 1e-8));
+show(Lapack::pseudoInverse($d));
+show(Lapack::pseudoInverse($d, 1e-6));
+
+/* Square and invertible, the inverse */
+$magic = array(array(8, 1, 6), array(3, 5, 7), array(4, 9, 2));
+$pinv = Lapack::pseudoInverse($magic);
+$inv = Lapack::inverse($magic);
+$err = 0;
+for ($i = 0; $i < 3; $i++) {
+    for ($j = 0; $j < 3; $j++) {
+        $err = max($err, abs($pinv[$i][$j] - $inv[$i][$j]));
+    }
+}
+var_dump($err < 1e-12);
+
+/* pinvSolve is A+ . B without forming A+ */
+$b = array(array(1, 10), array(2, 20), array(4, 40));
+show(Lapack::pinvSolve($tall, $b));
+show(Lapack::multiply(Lapack::pseudoInverse($tall), $b));
+
+/* Minimum norm solution of an underdetermined rank one system */
+show(Lapack::pinvSolve(array(array(1, 2), array(2, 4)), array(array(5), array(10))));
+
+$m = Lapack::pseudoInverse(new LapackMatrix($tall));
+echo get_class($m), " ", $m->rows(), "x", $m->columns(), "\n";
+$x = Lapack::pinvSolve(new LapackMatrix($tall), $b);
+echo get_class($x), " ", $x->rows(), "x", $x->columns(), "\n";
+
+try {
+    Lapack::pinvSolve($tall, array(array(1), array(2)));
+} catch (Lapackexception $e) {
+    echo $e->getMessage(), "\n";
+}
+
+try {
+    Lapack::pseudoInverse(array());
+} catch (Lapackexception $e) {
+    echo $e->getMessage(), "\n";
+}
+?>
+--EXPECT--
+-1.3333 -0.3333 0.6667
+1.0833 0.3333 -0.4167
+--
+-1.3333 1.0833
+-0.3333 0.3333
+0.6667 -0.4167
+--
+0.04 0.08
+0.08 0.16
+--
+0 0
+0 0
+0 0
+--
+1 0
+0 100000000
+--
+1 0
+0 0
+--
+bool(true)
+0.6667 6.6667
+0.0833 0.8333
+--
+0.6667 6.6667
+0.0833 0.8333
+--
+1
+2
+--
+LapackMatrix 2x3
+LapackMatrix 2x2
+Invalid input matrix - argument 2, wrong number of rows
+Invalid input matrix - argument 1